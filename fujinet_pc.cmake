@@ -134,6 +134,16 @@ set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DMG_TLS=1")
 # CONFIGURE_FILE(${CMAKE_CURRENT_SOURCE_DIR}/config.h.in ${CMAKE_CURRENT_BINARY_DIR}/include/config.h)
 # set(INCLUDE_DIRS include ${CMAKE_CURRENT_BINARY_DIR}/include
 
+# cmake -DBUS_TRACE=1 ... records bus transaction timing, see lib/bus/BusTrace.h
+if(DEFINED BUS_TRACE)
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DBUS_TRACE=1")
+endif()
+
+# cmake -DDEBUG_ASYNC=1 ... queues debug output for a background thread, see lib/utils/DebugLog.h
+if(DEFINED DEBUG_ASYNC)
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DDEBUG_ASYNC=1")
+endif()
+
 # Add additional debug if set
 if(DEFINED DEBUG_NO_REBOOT)
     set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -DDEBUG_NO_REBOOT=1")
@@ -144,7 +154,7 @@ set(INCLUDE_DIRS include
     lib/FileSystem
     lib/tcpip lib/ftp lib/TNFSlib lib/telnet lib/fnjson lib/fnsgml
     lib/webdav lib/http lib/sam lib/task
-    lib/modem-sniffer lib/printer-emulator
+    lib/modem-engine lib/modem-sniffer lib/printer-emulator
     lib/network-protocol
     lib/fuji lib/bus lib/device lib/device/fujiDevice lib/media
     lib/encrypt lib/base64
@@ -191,6 +201,8 @@ set(SOURCES src/main.cpp
     lib/utils/peoples_url_parser.h lib/utils/peoples_url_parser.cpp
     lib/utils/punycode.h lib/utils/punycode.cpp
     lib/utils/U8Char.h lib/utils/U8Char.cpp
+    lib/utils/DebugLog.h lib/utils/DebugLog.cpp
+    lib/utils/record_utils.h lib/utils/record_utils.cpp
     lib/hardware/fnWiFi.h lib/hardware/fnDummyWiFi.h lib/hardware/fnDummyWiFi.cpp
     lib/hardware/led.h lib/hardware/led.cpp
     lib/hardware/COMChannel.h lib/hardware/COMChannel.cpp
@@ -198,6 +210,7 @@ set(SOURCES src/main.cpp
     lib/hardware/TTYChannel.h lib/hardware/TTYChannel.cpp
     lib/hardware/fnSystem.h lib/hardware/fnSystem.cpp lib/hardware/fnSystemNet.cpp
     lib/FileSystem/fnDirCache.h lib/FileSystem/fnDirCache.cpp
+    lib/FileSystem/fnDirCacheStore.h lib/FileSystem/fnDirCacheStore.cpp
     lib/FileSystem/fnFileCache.h lib/FileSystem/fnFileCache.cpp
     lib/FileSystem/fnFS.h lib/FileSystem/fnFS.cpp
     lib/FileSystem/fnFsSPIFFS.h lib/FileSystem/fnFsSPIFFS.cpp
@@ -210,10 +223,12 @@ set(SOURCES src/main.cpp
     lib/FileSystem/fnFile.h lib/FileSystem/fnFile.cpp
     lib/FileSystem/fnFileLocal.h lib/FileSystem/fnFileLocal.cpp
     lib/FileSystem/fnFileTNFS.h lib/FileSystem/fnFileTNFS.cpp
+    lib/FileSystem/fnFileBuffered.h lib/FileSystem/fnFileBuffered.cpp
     lib/FileSystem/fnFileSMB.h lib/FileSystem/fnFileSMB.cpp
     lib/FileSystem/fnFileNFS.h lib/FileSystem/fnFileNFS.cpp
     lib/FileSystem/fnFileMem.h lib/FileSystem/fnFileMem.cpp
     lib/FileSystem/fnFileHTTP.h lib/FileSystem/fnFileHTTP.cpp
+    lib/FileSystem/fnFileFTP.h lib/FileSystem/fnFileFTP.cpp
     lib/FileSystem/fnio.h lib/FileSystem/fnio.cpp
     lib/tcpip/fnDNS.h lib/tcpip/fnDNS.cpp
     lib/tcpip/fnUDP.h lib/tcpip/fnUDP.cpp
@@ -272,6 +287,7 @@ set(SOURCES src/main.cpp
     lib/network-protocol/GDRIVE.h lib/network-protocol/GDRIVE.cpp
     lib/network-protocol/ONEDRIVE.h lib/network-protocol/ONEDRIVE.cpp
     lib/network-protocol/Mailbox.h lib/network-protocol/Mailbox.cpp
+    lib/network-protocol/MailboxCache.h lib/network-protocol/MailboxCache.cpp
     lib/network-protocol/GMAIL.h lib/network-protocol/GMAIL.cpp
     lib/network-protocol/IMAPS.h lib/network-protocol/IMAPS.cpp
     lib/network-protocol/Test.h lib/network-protocol/Test.cpp
@@ -296,6 +312,7 @@ set(SOURCES src/main.cpp
     lib/fuji/fujiHost.h lib/fuji/fujiHost.cpp
     lib/fuji/fujiDisk.h lib/fuji/fujiDisk.cpp
     lib/bus/bus.h lib/bus/bus.cpp
+    lib/bus/BusTrace.h lib/bus/BusTrace.cpp
     lib/device/device.h
     lib/device/disk.h
     lib/device/printer.h
@@ -310,10 +327,12 @@ set(SOURCES src/main.cpp
     lib/device/network.h
     lib/device/netstream.h
     lib/device/siocpm.h
+    lib/modem-engine/modem-engine.h lib/modem-engine/modem-engine.cpp
     lib/modem-sniffer/modem-sniffer.h lib/modem-sniffer/modem-sniffer.cpp
     lib/media/media.h
     lib/encoding/base64.h lib/encoding/base64.cpp
     lib/encoding/hash.h lib/encoding/hash.cpp
+    lib/encoding/mime.h lib/encoding/mime.cpp
     lib/qrcode/qrcode.h lib/qrcode/qrcode.c
     lib/qrcode/qrmanager.h lib/qrcode/qrmanager.cpp
     lib/encrypt/crypt.h lib/encrypt/crypt.cpp
@@ -521,6 +540,7 @@ if(FUJINET_TARGET STREQUAL "LYNX")
     lib/printer-emulator/coleco_printer.h lib/printer-emulator/coleco_printer.cpp
 
     components/lz4/lib/lz4.h components/lz4/lib/lz4.c
+    components/lz4/lib/lz4hc.h components/lz4/lib/lz4hc.c
     )
 endif()
 
@@ -17,6 +17,11 @@
 #undef DEBUG
 #endif
 
+// DEBUG_ASYNC queues messages for a background task, see lib/utils/DebugLog.h
+#ifndef DEBUG
+#undef DEBUG_ASYNC
+#endif
+
 /*
   Debugging Macros
 */
@@ -67,6 +72,25 @@
         #define Debug_memory()
     #endif // ESP_PLATFORM
 #endif // Debug_memory
+
+#ifdef DEBUG_ASYNC
+    #include "../lib/utils/DebugLog.h"
+
+    // Same output as above, but the caller only copies its arguments
+    #define DEBUG_LOG(call) do { \
+        static DebugLogSite _debug_log_site(__FILE__, __FUNCTION__, __LINE__); \
+        debugLog.call; \
+    } while (0)
+
+    #undef Debug_print
+    #undef Debug_printf
+    #undef Debug_println
+    #undef Debug_printv
+    #define Debug_print(...) DEBUG_LOG(print(_debug_log_site, DebugLogLevel::Debug, false, ##__VA_ARGS__))
+    #define Debug_printf(...) DEBUG_LOG(printf(_debug_log_site, DebugLogLevel::Debug, false, __VA_ARGS__))
+    #define Debug_println(...) DEBUG_LOG(print(_debug_log_site, DebugLogLevel::Debug, true, ##__VA_ARGS__))
+    #define Debug_printv(format, ...) DEBUG_LOG(printf(_debug_log_site, DebugLogLevel::Verbose, true, format, ##__VA_ARGS__))
+#endif // DEBUG_ASYNC
 #endif // DEBUG
 
 #ifndef DEBUG
@@ -21,9 +21,10 @@ public:
     std::vector<uint8_t> data;
     uint8_t entry_count;
     bool is_last_group;
+    bool is_partial;
     uint8_t index;
 
-    DirectoryPageGroup() : entry_count(0), is_last_group(false) {
+    DirectoryPageGroup() : entry_count(0), is_last_group(false), is_partial(false) {
         // Pre-allocate space for header to avoid reallocation
         data.resize(HEADER_SIZE, 0);
     }
@@ -59,8 +60,8 @@ public:
             return;
         }
 
-        // Set flags (bit 7 indicates last group)
-        data[0] = is_last_group ? 0x80 : 0x00;
+        // Set flags (bit 7 indicates last group, bit 6 a listing still loading)
+        data[0] = (is_last_group ? 0x80 : 0x00) | (is_partial ? 0x40 : 0x00);
         // Set entry count
         data[1] = entry_count;
         // Set data size (excluding header)
@@ -3,10 +3,19 @@
 
 #include <cstring>
 #include <algorithm>
-#include "compat_string.h"
 
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#include "../../include/debug.h"
 #include "utils.h"
+#include "record_utils.h"
 
+// Stack for the background fill; the producer talks to the server from it
+#define DIRCACHE_STACKSIZE 8192
+#define DIRCACHE_PRIORITY 5
 
 bool _fsdir_sort_name_ascend(const fsdir_entry* left, const fsdir_entry* right)
 {
@@ -45,78 +54,254 @@ typedef bool (*sort_fn_t)(const fsdir_entry* left, const fsdir_entry* right);
 
 void DirCache::clear()
 {
+    stop();
+
+    std::lock_guard<std::mutex> lock(_mutex);
     _entries_filtered.clear();
     _entries_filtered.shrink_to_fit();
     _entries.clear();
     _entries.shrink_to_fit();
+    _incoming.clear();
+    _incoming.shrink_to_fit();
     _current = 0;
+    _sort_pending = false;
+    _replace_pending = false;
+    _refresh = false;
+    _failed = false;
+    _pattern.clear();
+    _diropts = 0;
 }
 
 fsdir_entry &DirCache::new_entry()
 {
+    std::lock_guard<std::mutex> lock(_mutex);
     _entries.push_back(fsdir_entry());
     return _entries.back();
 }
 
-void DirCache::apply_filter(const char *pattern, uint16_t diropts)
+bool DirCache::empty()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.empty() && !_loading;
+}
+
+bool DirCache::matches(const fsdir_entry &entry)
 {
-	char realpat[MAX_PATHLEN];
-	//char *thepat = nullptr;
-    bool have_pattern = pattern != nullptr && pattern[0] != '\0';
-	bool filter_dirs = have_pattern && pattern[strlen(pattern)-1] == '/';
-	if (filter_dirs) {
-		strlcpy (realpat, pattern, sizeof (realpat));
-		realpat[strlen(realpat)-1] = '\0';
-	}
-	//thepat = filter_dirs ? realpat : (char *)pattern;
+    // Files are always matched against the pattern, directories only when it
+    // ends in '/'
+    bool have_pattern = !_pattern.empty();
+    bool filter_dirs = have_pattern && _pattern.back() == '/';
+
+    return !(have_pattern && (!entry.isDir || filter_dirs) &&
+             util_wildcard_match(entry.filename, _pattern.c_str()) == false);
+}
+
+void DirCache::sort_filtered()
+{
+    _sort_pending = false;
+
+    // Choose the appropriate sorting function
+    sort_fn_t sortfn;
+    if (_diropts & DIR_OPTION_FILEDATE)
+    {
+        sortfn = (_diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_time_descend : _fsdir_sort_time_ascend;
+    }
+    else
+    {
+        sortfn = (_diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_name_descend : _fsdir_sort_name_ascend;
+    }
 
+    // Sort directory entries
+    std::sort(_entries_filtered.begin(), _entries_filtered.end(),
+              [this, sortfn](uint32_t left, uint32_t right) {
+                  return sortfn(&_entries[left], &_entries[right]);
+              });
+}
+
+void DirCache::filter()
+{
     _entries_filtered.clear();
     _entries_filtered.shrink_to_fit();
 
     // Filter directory entries
     for (unsigned i=0; i<_entries.size(); ++i)
     {
-        fsdir_entry& entry = _entries[i];
-        // Skip this entry if we have a search filter and it doesn't match it
-        if (have_pattern && (
-            !entry.isDir || (entry.isDir && filter_dirs)
-            ) && util_wildcard_match(entry.filename, pattern) == false)
-            continue;
-        _entries_filtered.push_back(&entry);
+        if (matches(_entries[i]))
+            _entries_filtered.push_back(i);
     }
 
-    // Choose the appropriate sorting function
+    _sort_pending = false;
+
+    if (_diropts & DIR_OPTION_UNSORTED)
+        return;
+
+    // Entries still arriving are served as they come; sort once we have them all
+    if (_loading && !_refresh)
+        _sort_pending = true;
+    else
+        sort_filtered();
+}
+
+void DirCache::apply_filter(const char *pattern, uint16_t diropts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _pattern = pattern != nullptr ? pattern : "";
+    _diropts = diropts;
     _current = 0;
 
-    if (diropts & DIR_OPTION_UNSORTED)
+    filter();
+    settle();
+}
+
+// Swap in a refreshed listing
+void DirCache::replace()
+{
+    _entries.swap(_incoming);
+    _incoming.clear();
+    _incoming.shrink_to_fit();
+    _replace_pending = false;
+    filter();
+}
+
+// Between passes (at position 0, nothing loading), show the final listing
+void DirCache::settle()
+{
+    if (_current != 0 || _loading)
         return;
+    if (_replace_pending)
+        replace();
+    else if (_sort_pending)
+        sort_filtered();
+}
 
-    // Choose the appropriate sorting function
-    sort_fn_t sortfn;
-    if (diropts & DIR_OPTION_FILEDATE)
+#ifdef ESP_PLATFORM
+void DirCache::fill_task(void *arg)
+{
+    ((DirCache *)arg)->fill_run();
+    vTaskDelete(nullptr);
+}
+#endif
+
+void DirCache::fill_async(producer_t producer, bool refresh)
+{
+    if (refresh)
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_time_descend : _fsdir_sort_time_ascend;
+        stop();
+        _incoming.clear();
+        _replace_pending = false;
     }
     else
+        clear();
+
+    _producer = producer;
+    _refresh = refresh;
+    _loading = true;
+
+#ifdef ESP_PLATFORM
+    if (xTaskCreate(fill_task, "dircache", DIRCACHE_STACKSIZE, this, DIRCACHE_PRIORITY, nullptr) != pdPASS)
+    {
+        Debug_println("DirCache::fill_async - no task, filling in the foreground");
+        fill_run();
+    }
+#else
+    _thread = std::thread(&DirCache::fill_run, this);
+#endif
+}
+
+void DirCache::fill_run()
+{
+    bool complete = _producer(*this);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Debug_printf("DirCache: listing %s, %u entries\n", complete ? "complete" : "stopped",
+                 (unsigned)_entries.size());
+    _producer = nullptr;
+    _loading = false;
+    if (_refresh)
+    {
+        // A refresh that didn't finish leaves the old listing in place
+        _refresh = false;
+        if (complete)
+            _replace_pending = true;
+        else
+            _incoming.clear();
+    }
+    _failed = !complete;
+    // Nobody has started reading yet: hand out the final view right away
+    settle();
+    _cond.notify_all();
+}
+
+void DirCache::stop()
+{
     {
-        sortfn = (diropts & DIR_OPTION_DESCENDING) ? _fsdir_sort_name_descend : _fsdir_sort_name_ascend;
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cancel = true;
+        _cond.wait(lock, [this] { return !_loading; });
+        _cancel = false;
     }
+#ifndef ESP_PLATFORM
+    if (_thread.joinable())
+        _thread.join();
+#endif
+}
 
-    // Sort directory entries
-    std::sort(_entries_filtered.begin(), _entries_filtered.end(), sortfn);
+bool DirCache::add(const fsdir_entry &entry)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_cancel)
+        return false;
+
+    if (_refresh)
+    {
+        _incoming.push_back(entry);
+        return true;
+    }
+
+    _entries.push_back(entry);
+    if (matches(entry))
+    {
+        _entries_filtered.push_back(_entries.size() - 1);
+        _cond.notify_all();
+    }
+    return true;
+}
+
+bool DirCache::partial()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _loading || _sort_pending || _replace_pending;
+}
+
+bool DirCache::failed()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _failed && !_loading;
 }
 
 fsdir_entry *DirCache::read()
 {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    // Stay behind the producer; the first read waits for a page's worth
+    size_t want = _current == 0 ? DIRCACHE_FIRST_PAGE : _current + 1;
+    _cond.wait(lock, [this, want] { return !_loading || _refresh || _entries_filtered.size() >= want; });
+    settle();
+
     if(_current < _entries_filtered.size())
-        return _entries_filtered[_current++];
+    {
+        _entry = _entries[_entries_filtered[_current++]];
+        return &_entry;
+    }
     else
         return nullptr;
 }
 
 uint16_t DirCache::tell()
 {
-    if(_entries_filtered.empty())
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_entries_filtered.empty() && !_loading)
         return FNFS_INVALID_DIRPOS;
     else
         return _current;
@@ -124,11 +309,69 @@ uint16_t DirCache::tell()
 
 success_is_true DirCache::seek(uint16_t pos)
 {
-    if(pos <= _entries_filtered.size())
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // Positions past what has arrived are fine while the listing is loading;
+    // read() waits for them
+    if(pos <= _entries_filtered.size() || _loading)
     {
         _current = pos;
+        settle();
         RETURN_SUCCESS_AS_TRUE();
     }
     else
         RETURN_ERROR_AS_FALSE();
 }
+
+// ─── persistence ──────────────────────────────────────────────────────────────
+
+void DirCache::serialize(std::string &out)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto &list = _refresh ? _incoming : _entries;
+
+    record_put_le(out, list.size(), 4);
+    for (const fsdir_entry &e : list)
+    {
+        record_put_str(out, std::string(e.filename, strnlen(e.filename, sizeof(e.filename) - 1)));
+        record_put_le(out, e.isDir ? 1 : 0, 1);
+        record_put_le(out, e.size, 4);
+        record_put_le(out, (uint64_t)e.modified_time, 8);
+    }
+}
+
+bool DirCache::deserialize(const std::string &data, size_t pos)
+{
+    RecordReader r(data, pos);
+    uint32_t count = r.le(4);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _entries_filtered.clear();
+    _current = 0;
+    // An entry takes at least 15 bytes; don't trust a damaged count
+    _entries.reserve(r.ok() ? std::min<size_t>(count, data.size() / 15) : 0);
+
+    bool ok = r.ok();
+    for (uint32_t i = 0; i < count && ok; i++)
+    {
+        fsdir_entry e = {};
+        std::string name = r.str();
+        if (name.size() >= sizeof(e.filename))
+        {
+            ok = false;
+            break;
+        }
+        memcpy(e.filename, name.data(), name.size());
+        e.filename[name.size()] = '\0';
+        e.isDir = r.le(1) != 0;
+        e.size = r.le(4);
+        e.modified_time = (time_t)r.le(8);
+        ok = r.ok();
+        _entries.push_back(e);
+    }
+
+    if (!ok)
+        _entries.clear();
+    return ok;
+}
@@ -2,34 +2,101 @@
 #define FN_DIRCACHE_H
 
 #include <vector>
+#include <string>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef ESP_PLATFORM
 #include "../../include/PSRAMAllocator.h"
+#else
+#include <thread>
 #endif
 
 #include "fnFS.h"
 
+// While a listing is still arriving, the first read waits for this many
+// matching entries (or the end of the listing), so short directories still
+// come back sorted.
+#define DIRCACHE_FIRST_PAGE 64
+
 class DirCache
 {
+public:
+    // Runs on its own task, adding entries with add() until it returns
+    // false. Returns whether it got the whole listing.
+    typedef std::function<bool(DirCache &)> producer_t;
+
 private:
 #ifdef ESP_PLATFORM
     std::vector<fsdir_entry,PSRAMAllocator<fsdir_entry>> _entries;
-    std::vector<fsdir_entry *,PSRAMAllocator<fsdir_entry *>> _entries_filtered;
+    std::vector<uint32_t,PSRAMAllocator<uint32_t>> _entries_filtered;
+    std::vector<fsdir_entry,PSRAMAllocator<fsdir_entry>> _incoming;
 #else
     std::vector<fsdir_entry> _entries;
-    std::vector<fsdir_entry *> _entries_filtered;
+    std::vector<uint32_t> _entries_filtered;
+    std::vector<fsdir_entry> _incoming;  // refreshed listing, see fill_async()
 #endif
     uint16_t _current = 0;
 
+    // Copy handed out by read(), so entries can move while the producer adds
+    fsdir_entry _entry;
+
+    // Background fill; everything below and the vectors above are guarded by
+    // _mutex while a producer is running
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    producer_t _producer;
+    bool _loading = false;      // producer still running
+    bool _cancel = false;       // producer asked to stop at its next add()
+    bool _sort_pending = false; // view is in arrival order, sort at position 0
+    bool _refresh = false;      // producer fills _incoming, readers keep _entries
+    bool _replace_pending = false; // _incoming is complete, swap in at position 0
+    bool _failed = false;       // producer stopped short of the whole listing
+    std::string _pattern;
+    uint16_t _diropts = 0;
+#ifdef ESP_PLATFORM
+    static void fill_task(void *arg);
+#else
+    std::thread _thread;
+#endif
+
+    void fill_run();
+    void stop();
+    bool matches(const fsdir_entry &entry);
+    void sort_filtered();
+    void filter();
+    void replace();
+    void settle();
+
 public:
     // DirCache();
-    // ~DirCache();
+    ~DirCache() { stop(); }
 
     void clear();
     fsdir_entry &new_entry();
     void apply_filter(const char *pattern, uint16_t diropts);
 
-    bool empty() {return _entries.empty();}
+    bool empty();
+
+    // Start filling the cache in the background. Readers get entries in
+    // arrival order as they come in; once the listing is complete, the
+    // sorted view takes over at the next return to position 0.
+    // With refresh, the current entries (say, from DirCacheStore) are served
+    // meanwhile and the new listing replaces them the same way.
+    void fill_async(producer_t producer, bool refresh = false);
+    // Producer side: add one entry, false once the cache wants it to stop
+    bool add(const fsdir_entry &entry);
+    // Entries read so far may not be the final (complete, sorted) listing
+    bool partial();
+    // The last fill didn't get the whole listing: what's served is cut short,
+    // or after a failed refresh, old. List again rather than reuse it.
+    bool failed();
+
+    // The listing being filled, or the current one, for DirCacheStore.
+    // serialize() appends to out; deserialize() replaces the entries.
+    void serialize(std::string &out);
+    bool deserialize(const std::string &data, size_t pos = 0);
 
     fsdir_entry *read();
     uint16_t tell();
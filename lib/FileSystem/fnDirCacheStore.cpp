@@ -0,0 +1,172 @@
+
+#include "fnDirCacheStore.h"
+
+#include <cstdio>
+#include <list>
+#include <mutex>
+
+#include "../../include/debug.h"
+#include "record_utils.h"
+
+#include "fnFsSD.h"
+
+// Directory on SD card for stored listings
+#define DIRCACHESTORE_DIRECTORY "/FujiNet/dircache"
+// Bumped when the file layout changes; older files are ignored
+#define DIRCACHESTORE_MAGIC "FNDL"
+#define DIRCACHESTORE_VERSION 1
+// Bytes of recent listings kept in memory (PSRAM on ESP)
+#ifdef ESP_PLATFORM
+#define DIRCACHESTORE_MEMORY (256 * 1024)
+#else
+#define DIRCACHESTORE_MEMORY (4 * 1024 * 1024)
+#endif
+
+namespace {
+
+struct Stored
+{
+    std::string key;
+    std::string record;
+};
+
+std::mutex store_mutex;
+std::list<Stored> recent; // most recently used first
+size_t recent_bytes = 0;
+
+std::string make_key(const std::string &host, const std::string &path)
+{
+    return host + '\n' + path;
+}
+
+} // namespace
+
+std::string DirCacheStore::file_path(const std::string &key)
+{
+    return std::string(DIRCACHESTORE_DIRECTORY) + '/' + record_file_name(key, "DIR");
+}
+
+bool DirCacheStore::fresh(time_t saved)
+{
+    time_t now = time(nullptr);
+    // A clock that went backwards (not yet set after a reboot) proves nothing
+    return now >= saved && now - saved < DIRCACHESTORE_TTL;
+}
+
+bool DirCacheStore::parse(const std::string &record, const std::string &key, const std::string &validator,
+                          DirCache &cache, time_t *saved)
+{
+    if (record.compare(0, 4, DIRCACHESTORE_MAGIC) != 0)
+        return false;
+    RecordReader r(record, 4);
+    if (r.le(1) != DIRCACHESTORE_VERSION || r.str() != key)
+        return false;
+    std::string stored_validator = r.str();
+    uint64_t when = r.le(8);
+    if (!r.ok() || (!validator.empty() && stored_validator != validator))
+        return false;
+
+    if (!cache.deserialize(record, r.pos()))
+        return false;
+    if (saved != nullptr)
+        *saved = (time_t)when;
+    return true;
+}
+
+void DirCacheStore::remember(const std::string &key, const std::string &record)
+{
+    for (auto it = recent.begin(); it != recent.end(); ++it)
+    {
+        if (it->key == key)
+        {
+            recent_bytes -= it->record.size();
+            recent.erase(it);
+            break;
+        }
+    }
+
+    if (record.size() > DIRCACHESTORE_MEMORY / 4)
+        return;
+
+    recent.push_front(Stored{key, record});
+    recent_bytes += record.size();
+    while (recent_bytes > DIRCACHESTORE_MEMORY)
+    {
+        recent_bytes -= recent.back().record.size();
+        recent.pop_back();
+    }
+}
+
+bool DirCacheStore::load(const std::string &host, const std::string &path, const std::string &validator,
+                         DirCache &cache, time_t *saved)
+{
+    std::string key = make_key(host, path);
+    std::lock_guard<std::mutex> lock(store_mutex);
+
+    for (auto it = recent.begin(); it != recent.end(); ++it)
+    {
+        if (it->key != key)
+            continue;
+        if (!parse(it->record, key, validator, cache, saved))
+            return false;
+        recent.splice(recent.begin(), recent, it);
+        Debug_printf("DirCacheStore: \"%s\" from memory\n", path.c_str());
+        return true;
+    }
+
+    if (!fnSDFAT.running())
+        return false;
+
+    std::string file = file_path(key);
+    FILE *f = fnSDFAT.file_open(file.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+
+    std::string record;
+    char buf[512];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        record.append(buf, n);
+    fclose(f);
+
+    if (!parse(record, key, validator, cache, saved))
+        return false;
+    remember(key, record);
+    Debug_printf("DirCacheStore: \"%s\" from %s\n", path.c_str(), file.c_str());
+    return true;
+}
+
+void DirCacheStore::save(const std::string &host, const std::string &path, const std::string &validator,
+                         DirCache &cache)
+{
+    std::string key = make_key(host, path);
+
+    std::string record(DIRCACHESTORE_MAGIC);
+    record_put_le(record, DIRCACHESTORE_VERSION, 1);
+    record_put_str(record, key);
+    record_put_str(record, validator);
+    record_put_le(record, (uint64_t)time(nullptr), 8);
+    cache.serialize(record);
+
+    std::lock_guard<std::mutex> lock(store_mutex);
+    remember(key, record);
+
+    if (!fnSDFAT.running())
+        return;
+    fnSDFAT.create_path(DIRCACHESTORE_DIRECTORY);
+    std::string file = file_path(key);
+    FILE *f = fnSDFAT.file_open(file.c_str(), "wb");
+    if (f == nullptr)
+    {
+        Debug_printf("DirCacheStore: can't write %s\n", file.c_str());
+        return;
+    }
+    size_t written = fwrite(record.data(), 1, record.size(), f);
+    fclose(f);
+    if (written != record.size())
+    {
+        // A short file would only fail to parse later; don't leave it around
+        Debug_printf("DirCacheStore: short write to %s\n", file.c_str());
+        fnSDFAT.remove(file.c_str());
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef FN_DIRCACHESTORE_H
+#define FN_DIRCACHESTORE_H
+
+#include <string>
+#include <ctime>
+
+#include "fnDirCache.h"
+
+// Seconds a listing without a validator (FTP) is used as is; after that it
+// is still served, but while a fresh one is fetched
+#define DIRCACHESTORE_TTL 600
+
+/*
+ * DirCacheStore - directory listings kept across mounts, so going back to a
+ * directory doesn't have to list it again.
+ *
+ * A listing is stored under its host and path with a validator the file
+ * system picks: the directory's modification time where the server has
+ * one (TNFS, SMB, NFS), nothing where it doesn't (FTP). The file system
+ * checks the validator on the next visit, or the listing's age against
+ * DIRCACHESTORE_TTL, and lists the directory again when it changed.
+ * Adding, removing or renaming an entry changes a directory's mtime;
+ * rewriting a file in place does not, so sizes can be as of the last listing.
+ *
+ * Recent listings are held in memory; with an SD card they are also written
+ * to /FujiNet/dircache and survive a reboot. Safe to call from a DirCache
+ * producer task.
+ */
+class DirCacheStore
+{
+public:
+    // Load the stored listing of path on host into cache. With a validator,
+    // only a listing saved with the same one will do. saved, if given, gets
+    // the time it was stored. Returns false if there is none.
+    static bool load(const std::string &host, const std::string &path, const std::string &validator,
+                     DirCache &cache, time_t *saved = nullptr);
+
+    // Store the listing in cache (the one being filled, during a refresh)
+    static void save(const std::string &host, const std::string &path, const std::string &validator,
+                     DirCache &cache);
+
+    // Stored at `saved` and not yet DIRCACHESTORE_TTL old
+    static bool fresh(time_t saved);
+
+private:
+    static bool parse(const std::string &record, const std::string &key, const std::string &validator,
+                      DirCache &cache, time_t *saved);
+    static void remember(const std::string &key, const std::string &record);
+    static std::string file_path(const std::string &key);
+};
+
+#endif // FN_DIRCACHESTORE_H
@@ -127,6 +127,9 @@ public:
     virtual uint16_t dir_tell() = 0;
     // Sets current position in directory stream. Returns false on error.
     virtual success_is_true dir_seek(uint16_t position) = 0;
+    // True while the open directory is still being listed in the background
+    // (entries so far come in server order) or not yet re-read sorted.
+    virtual bool dir_partial() { return false; }
 };
 
 #endif //_FN_FS_
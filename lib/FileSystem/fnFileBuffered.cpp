@@ -0,0 +1,355 @@
+
+#include "fnFileBuffered.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utility>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#elif defined(ESP_PLATFORM)
+#include <esp_heap_caps.h>
+#include <sys/poll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "../../include/debug.h"
+
+// Upper bound on a window; the server's negotiated maximum can be far larger.
+#ifdef ESP_PLATFORM
+#define FN_BUFFERED_CHUNK 16384
+#else
+#define FN_BUFFERED_CHUNK 65536
+#endif
+
+static uint8_t *window_alloc(size_t len)
+{
+#ifdef ESP_PLATFORM
+    return (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+    return (uint8_t *)malloc(len);
+#endif
+}
+
+FileHandlerBuffered::FileHandlerBuffered(uint32_t chunk)
+{
+    _chunk = (chunk == 0 || chunk > FN_BUFFERED_CHUNK) ? FN_BUFFERED_CHUNK : chunk;
+}
+
+FileHandlerBuffered::~FileHandlerBuffered()
+{
+    free(_window.buf);
+    free(_ahead.buf);
+    free(_wbuf);
+}
+
+int FileHandlerBuffered::wait_socket(intptr_t fd, int events, int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = (decltype(pfd.fd))fd;
+    pfd.events = (short)events;
+    pfd.revents = 0;
+#if defined(_WIN32)
+    int result = WSAPoll(&pfd, 1, timeout_ms);
+#else
+    int result = poll(&pfd, 1, timeout_ms);
+#endif
+    return result <= 0 ? result : pfd.revents;
+}
+
+int FileHandlerBuffered::close(bool destroy)
+{
+    int result = write_flush();
+    if (_werror)
+        result = -1;
+    _werror = false;
+    drop_ahead();
+    _window.valid = false;
+
+    if (raw_close() < 0)
+        result = -1;
+    if (destroy)
+        delete this;
+    return result;
+}
+
+// Copy written bytes into a window that covers them, extending a short
+// (end of file) window when the write carries on from its end.
+void FileHandlerBuffered::patch(Window &w, const uint8_t *data, uint32_t len, uint64_t off)
+{
+    if (!w.valid)
+        return;
+
+    uint64_t begin = off > w.start ? off : w.start;
+    uint64_t end = off + len < w.start + _chunk ? off + len : w.start + _chunk;
+    if (begin >= end || begin > w.start + w.len)
+        return;
+
+    memcpy(w.buf + (begin - w.start), data + (begin - off), end - begin);
+    if (end - w.start > w.len)
+        w.len = end - w.start;
+}
+
+int FileHandlerBuffered::write_flush()
+{
+    uint32_t sent = 0;
+    while (sent < _wlen)
+    {
+        int result = raw_pwrite(_wbuf + sent, _wlen - sent, _wstart + sent);
+        if (result <= 0)
+        {
+            Debug_printf("FileHandlerBuffered: write of %u bytes at %llu failed\n",
+                         _wlen - sent, (unsigned long long)(_wstart + sent));
+            _wlen = 0;
+            _werror = true;
+            return -1;
+        }
+        sent += result;
+    }
+    _wlen = 0;
+    return 0;
+}
+
+// The buffer belongs to the transport until its read completes. If waiting
+// failed (say, timed out), a late reply may still land in it, so it is left
+// to the transport and reads stay on demand from then on.
+int FileHandlerBuffered::wait_ahead()
+{
+    int result = raw_pread_wait();
+    _ahead_pending = false;
+    if (result < 0)
+    {
+        Debug_println("FileHandlerBuffered: background read failed, reading on demand");
+        _ahead.buf = nullptr;
+        _async = false;
+    }
+    return result;
+}
+
+void FileHandlerBuffered::drop_ahead()
+{
+    if (_ahead_pending)
+        wait_ahead();
+    _ahead.valid = false;
+}
+
+void FileHandlerBuffered::prefetch(uint64_t pos)
+{
+    if (!_async || ((_ahead_pending || _ahead.valid) && _ahead.start == pos))
+        return;
+
+    drop_ahead();
+    if (!_async || (_ahead.buf == nullptr && (_ahead.buf = window_alloc(_chunk)) == nullptr))
+        return;
+
+    // The server has to have gathered writes in this range before it reads it
+    if (_wlen > 0 && _wstart < pos + _chunk && _wstart + _wlen > pos && write_flush() < 0)
+        return;
+
+    _ahead.start = pos;
+    _ahead_stale = false;
+    _ahead_pending = raw_pread_start(_ahead.buf, _chunk, pos);
+    _async = _ahead_pending;
+}
+
+bool FileHandlerBuffered::fill_window(uint64_t pos)
+{
+    uint64_t start = pos - pos % _chunk;
+    bool sequential = _window.valid && _window.len == _chunk && start == _window.start + _chunk;
+
+    // The server has to have the gathered writes before we read them back.
+    if (_wlen > 0 && _wstart < start + _chunk && _wstart + _wlen > start)
+        write_flush();
+
+    if (_ahead_pending && _ahead.start == start)
+    {
+        int result = wait_ahead();
+        _ahead.valid = result > 0 && !_ahead_stale;
+        _ahead.len = result > 0 ? result : 0;
+    }
+    if (_ahead.valid && _ahead.start == start)
+    {
+        std::swap(_window, _ahead);
+        _ahead.valid = false;
+        if (_window.len == _chunk)
+            prefetch(start + _chunk);
+        return true;
+    }
+
+    if (_window.buf == nullptr && (_window.buf = window_alloc(_chunk)) == nullptr)
+        return false;
+
+    _window.valid = false;
+    uint32_t got = 0;
+    while (got < _chunk)
+    {
+        int result = raw_pread(_window.buf + got, _chunk - got, start + got);
+        if (result <= 0)
+            break;
+        got += result;
+    }
+    if (got == 0)
+        return false;
+
+    _window.start = start;
+    _window.len = got;
+    _window.valid = true;
+
+    if (sequential && got == _chunk)
+        prefetch(start + _chunk);
+    return true;
+}
+
+size_t FileHandlerBuffered::read(void *ptr, size_t size, size_t count)
+{
+    if (size == 0 || count == 0 || ptr == nullptr)
+        return 0;
+
+    size_t want = size * count;
+    size_t got = 0;
+    uint8_t *out = (uint8_t *)ptr;
+
+    while (got < want)
+    {
+        if (!_window.valid || _position < _window.start || _position >= _window.start + _window.len)
+        {
+            if (!fill_window(_position) || _position >= _window.start + _window.len)
+            {
+                _eof = true;
+                break;
+            }
+        }
+
+        uint32_t off = _position - _window.start;
+        size_t n = _window.len - off;
+        if (n > want - got)
+            n = want - got;
+        memcpy(out + got, _window.buf + off, n);
+        got += n;
+        _position += n;
+    }
+
+    return got / size; // number of complete elements read (fread semantics)
+}
+
+size_t FileHandlerBuffered::write(const void *ptr, size_t size, size_t count)
+{
+    if (size == 0 || count == 0 || ptr == nullptr)
+        return 0;
+
+    // A deferred write failed since the caller last heard from us
+    if (_werror)
+    {
+        _werror = false;
+        return 0;
+    }
+
+    if (_wbuf == nullptr && (_wbuf = window_alloc(_chunk)) == nullptr)
+        return 0;
+
+    size_t len = size * count;
+    size_t done = 0;
+    const uint8_t *src = (const uint8_t *)ptr;
+
+    while (done < len)
+    {
+        // Only a run of contiguous writes is gathered
+        if (_wlen > 0 && _position != _wstart + _wlen && write_flush() < 0)
+            break;
+        if (_wlen == 0)
+            _wstart = _position;
+
+        uint32_t n = _chunk - _wlen;
+        if (n > len - done)
+            n = len - done;
+        memcpy(_wbuf + _wlen, src + done, n);
+
+        patch(_window, src + done, n, _position);
+        patch(_ahead, src + done, n, _position);
+        if (_ahead_pending && _position < _ahead.start + _chunk && _position + n > _ahead.start)
+            _ahead_stale = true;
+
+        _wlen += n;
+        _position += n;
+        done += n;
+
+        if (_wlen == _chunk && write_flush() < 0)
+            break;
+    }
+
+    if (_werror)
+    {
+        _werror = false;
+        return 0;
+    }
+    _eof = false;
+    return count;
+}
+
+int FileHandlerBuffered::seek(long int off, int whence)
+{
+    int64_t new_pos;
+    switch (whence)
+    {
+    case SEEK_SET:
+        new_pos = off;
+        break;
+    case SEEK_CUR:
+        new_pos = (int64_t)_position + off;
+        break;
+    case SEEK_END:
+    {
+        uint64_t size;
+        if (raw_size(&size) < 0)
+            return -1;
+        if (_wlen > 0 && _wstart + _wlen > size)
+            size = _wstart + _wlen;
+        new_pos = (int64_t)size + off;
+        break;
+    }
+    default:
+        Debug_printf("FileHandlerBuffered::seek - invalid whence: %d\n", whence);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (new_pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    _position = new_pos;
+    _eof = false;
+    return 0;
+}
+
+long int FileHandlerBuffered::tell()
+{
+    return (long)_position;
+}
+
+int FileHandlerBuffered::flush()
+{
+    int result = write_flush();
+    if (_werror)
+        result = -1;
+    _werror = false;
+    if (raw_fsync() != 0)
+        result = -1;
+    return result;
+}
+
+int FileHandlerBuffered::eof()
+{
+    return _eof ? 1 : 0;
+}
+
+void FileHandlerBuffered::invalidate_cache()
+{
+    drop_ahead();
+    _window.valid = false;
+}
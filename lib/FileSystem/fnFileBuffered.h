@@ -0,0 +1,98 @@
+#ifndef FN_FILEBUFFERED_H
+#define FN_FILEBUFFERED_H
+
+#include <stdint.h>
+#include <cstddef>
+
+#include "fnFile.h"
+
+// How long raw_pread_wait() waits for the server before giving up
+#define FN_BUFFERED_TIMEOUT_MS 10000
+
+/*
+ * FileHandlerBuffered - shared buffering for FileHandlers on network file
+ * protocols (SMB, NFS), where every call to the server is a round trip.
+ *
+ * Reads are served from an aligned window of `chunk` bytes (the server's
+ * negotiated maximum, capped), so a media layer reading 128-512 byte sectors
+ * costs one request per window. After two windows in a row, the next one is
+ * fetched in the background while the host works through the current one,
+ * if the subclass has an async read.
+ *
+ * Writes are gathered into one contiguous run and sent when it fills, when a
+ * write lands somewhere else, when a read needs that range, or on flush and
+ * close. Written bytes also update the read window, so reads always see
+ * them. A failed deferred write is reported by the next write or flush.
+ *
+ * seek() and tell() only move the logical position.
+ */
+class FileHandlerBuffered : public FileHandler
+{
+public:
+    virtual ~FileHandlerBuffered() override;
+
+    virtual int close(bool destroy=true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+    virtual int eof() override;
+    virtual void invalidate_cache() override;
+
+protected:
+    // chunk: largest read/write the server accepts; capped at FN_BUFFERED_CHUNK
+    explicit FileHandlerBuffered(uint32_t chunk);
+
+    // Transport, implemented by the protocol. Return bytes transferred (0 at
+    // end of file for reads) or <0 on error; a short result is not an error.
+    virtual int raw_pread(uint8_t *buf, uint32_t len, uint64_t off) = 0;
+    virtual int raw_pwrite(const uint8_t *buf, uint32_t len, uint64_t off) = 0;
+    virtual int raw_fsync() = 0;
+    virtual int raw_size(uint64_t *size) = 0;
+    virtual int raw_close() = 0;
+
+    // Optional background read: start reading into buf and return true, then
+    // raw_pread_wait() returns its raw_pread()-style result, giving up after
+    // FN_BUFFERED_TIMEOUT_MS without a reply. Without one, windows are only
+    // read on demand. After a failed wait the buffer is left to the transport.
+    virtual bool raw_pread_start(uint8_t *buf, uint32_t len, uint64_t off) { return false; }
+    virtual int raw_pread_wait() { return -1; }
+
+    // Wait up to timeout_ms for poll() events on a socket; returns revents,
+    // 0 on timeout or <0 on error. For raw_pread_wait() implementations.
+    static int wait_socket(intptr_t fd, int events, int timeout_ms);
+
+private:
+    struct Window
+    {
+        uint8_t *buf = nullptr;
+        uint64_t start = 0;
+        uint32_t len = 0;
+        bool valid = false;
+    };
+
+    uint32_t _chunk;
+    uint64_t _position = 0;
+    bool _eof = false;
+
+    Window _window;             // window reads are served from
+    Window _ahead;              // next window, read in the background
+    bool _ahead_pending = false;
+    bool _ahead_stale = false;  // written to while its read was in flight
+    bool _async = true;         // raw_pread_start() hasn't failed yet
+
+    uint8_t *_wbuf = nullptr;   // gathered writes, starting at _wstart
+    uint64_t _wstart = 0;
+    uint32_t _wlen = 0;
+    bool _werror = false;
+
+    bool fill_window(uint64_t pos);
+    void prefetch(uint64_t pos);
+    void drop_ahead();
+    int wait_ahead();
+    int write_flush();
+    void patch(Window &w, const uint8_t *data, uint32_t len, uint64_t off);
+};
+
+#endif // FN_FILEBUFFERED_H
@@ -0,0 +1,306 @@
+
+#include "fnFileFTP.h"
+
+#ifndef FNIO_IS_STDIO
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#include "../../include/debug.h"
+#include "fnSystem.h"
+
+// Bytes gathered per window. The transfer keeps running between windows, so
+// this only sets how long a random read waits, not how far ahead we fetch.
+#define FTP_STREAM_WINDOW 8192
+
+// A forward jump this short is cheaper to read through than to abort the
+// transfer and restart it (ABOR, EPSV, REST, RETR and a new data connection).
+#define FTP_STREAM_SKIP 32768
+
+static uint8_t *stream_buf_alloc(size_t len)
+{
+#ifdef ESP_PLATFORM
+    uint8_t *buf = (uint8_t *)heap_caps_malloc(len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    // No PSRAM, or none left: a window is small enough for internal RAM
+    if (buf != nullptr)
+        return buf;
+#endif
+    return (uint8_t *)malloc(len);
+}
+
+FileHandlerFTP::FileHandlerFTP(fnFTP *ftp, const std::string &path, long size)
+    : _ftp(ftp), _path(path), _size(size), _position(0),
+      _streaming(false), _stream_pos(0),
+      _buf(nullptr), _buf_start(-1), _buf_len(0), _eof(false)
+{
+    _buf = stream_buf_alloc(FTP_STREAM_WINDOW);
+}
+
+FileHandlerFTP::~FileHandlerFTP()
+{
+    if (_ftp != nullptr)
+    {
+        stop_transfer();
+        _ftp->logout();
+        delete _ftp;
+    }
+    if (_buf != nullptr)
+        free(_buf);
+}
+
+// Log in and check that the file can be read from an arbitrary offset.
+FileHandlerFTP *FileHandlerFTP::create(const std::string &host, unsigned short port,
+                                       const std::string &user, const std::string &password,
+                                       const std::string &path)
+{
+    fnFTP *ftp = new fnFTP();
+    if (ftp == nullptr)
+        return nullptr;
+
+    if (ftp->login(user, password, host, port) != FUJI_ERROR::NONE)
+    {
+        delete ftp;
+        return nullptr;
+    }
+
+    // Streaming needs a known size (SEEK_END / filesize()) and REST.
+    long size = ftp->get_file_size(path);
+    bool restart = size >= 0 && ftp->restart_supported();
+    if (!restart)
+    {
+        Debug_printf("FileHandlerFTP::create - can't stream \"%s\" (restart=%d, size=%ld)\r\n",
+                     path.c_str(), restart, size);
+        ftp->logout();
+        delete ftp;
+        return nullptr;
+    }
+
+    FileHandlerFTP *fh = new FileHandlerFTP(ftp, path, size);
+    if (fh->_buf == nullptr)
+    {
+        Debug_printf("FileHandlerFTP::create - no memory for a read window\r\n");
+        delete fh; // logs out
+        return nullptr;
+    }
+
+    Debug_printf("FileHandlerFTP::create - streaming \"%s\", size=%ld\r\n", path.c_str(), size);
+    return fh;
+}
+
+bool FileHandlerFTP::start_transfer(long pos)
+{
+    if (!_ftp->control_connected() && _ftp->reconnect() != FUJI_ERROR::NONE)
+        return false;
+
+    if (_ftp->open_file(_path, false, pos) != FUJI_ERROR::NONE)
+        return false;
+
+    _streaming = true;
+    _stream_pos = pos;
+    return true;
+}
+
+void FileHandlerFTP::stop_transfer()
+{
+    if (!_streaming)
+        return;
+
+    _ftp->abort_transfer();
+    _streaming = false;
+}
+
+long FileHandlerFTP::receive(uint8_t *dst, long want)
+{
+    long total = 0;
+    uint64_t last_data = fnSystem.millis();
+
+    while (total < want)
+    {
+        int available = _ftp->data_available();
+        if (available > 0)
+        {
+            long n = want - total;
+            if (n > available)
+                n = available;
+            if (n > 0xFFFF)
+                n = 0xFFFF;
+            if (_ftp->read_file(dst + total, (unsigned short)n) != FUJI_ERROR::NONE)
+                break;
+            total += n;
+            last_data = fnSystem.millis();
+            continue;
+        }
+
+        if (_ftp->data_connected() == FUJI_ERROR::NONE) // server finished the RETR
+        {
+            _streaming = false;
+            break;
+        }
+        if (fnSystem.millis() - last_data > FTP_TIMEOUT)
+        {
+            Debug_printf("FileHandlerFTP::receive - timed out at %ld\r\n", _stream_pos + total);
+            break;
+        }
+#ifdef ESP_PLATFORM
+        vTaskDelay(1);
+#endif
+    }
+
+    _stream_pos += total;
+    return total;
+}
+
+// Fill _buf with the window at absolute pos. An open transfer already at (or
+// just short of) pos is continued; anything else restarts the RETR there. A
+// transfer that died while idle is retried once from scratch.
+bool FileHandlerFTP::fill_window(long pos)
+{
+    _buf_start = -1;
+    _buf_len = 0;
+
+    if (_buf == nullptr || pos < 0 || pos >= _size)
+        return false;
+
+    long want = FTP_STREAM_WINDOW;
+    if (pos + want > _size)
+        want = _size - pos;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        bool fresh = false;
+
+        if (_streaming && pos > _stream_pos && pos - _stream_pos <= FTP_STREAM_SKIP)
+        {
+            while (_streaming && _stream_pos < pos)
+            {
+                long skip = pos - _stream_pos;
+                if (receive(_buf, skip < FTP_STREAM_WINDOW ? skip : FTP_STREAM_WINDOW) == 0)
+                    break;
+            }
+        }
+
+        if (!_streaming || _stream_pos != pos)
+        {
+            stop_transfer();
+            if (!start_transfer(pos))
+                return false;
+            fresh = true;
+        }
+
+        long got = receive(_buf, want);
+        if (got > 0)
+        {
+            _buf_start = pos;
+            _buf_len = got;
+            return true;
+        }
+
+        stop_transfer();
+        if (fresh)
+            return false; // a new transfer genuinely failed; don't loop forever
+    }
+
+    return false;
+}
+
+size_t FileHandlerFTP::read(void *ptr, size_t size, size_t count)
+{
+    if (size == 0 || count == 0 || ptr == nullptr)
+        return 0;
+
+    size_t want = size * count;
+    size_t got = 0;
+    uint8_t *out = (uint8_t *)ptr;
+
+    while (got < want)
+    {
+        // (Re)fill the window when the cursor falls outside the buffered range.
+        if (_buf_start < 0 || _position < _buf_start || _position >= _buf_start + _buf_len)
+        {
+            if (!fill_window(_position))
+            {
+                if (_position >= _size)
+                    _eof = true;
+                break;
+            }
+        }
+
+        long off = _position - _buf_start;
+        long avail = _buf_len - off;
+        size_t n = (want - got) < (size_t)avail ? (want - got) : (size_t)avail;
+        memcpy(out + got, _buf + off, n);
+        got += n;
+        _position += n;
+    }
+
+    return got / size; // number of complete elements read (fread semantics)
+}
+
+size_t FileHandlerFTP::write(const void *ptr, size_t size, size_t count)
+{
+    // Streamed files are opened read-only.
+    return 0;
+}
+
+int FileHandlerFTP::seek(long int off, int whence)
+{
+    long new_pos;
+    switch (whence)
+    {
+    case SEEK_SET:
+        new_pos = off;
+        break;
+    case SEEK_CUR:
+        new_pos = _position + off;
+        break;
+    case SEEK_END:
+        new_pos = _size + off;
+        break;
+    default:
+        Debug_printf("FileHandlerFTP::seek - invalid whence: %d\r\n", whence);
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (new_pos < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Purely logical - the next read() moves the transfer if it has to.
+    _position = new_pos;
+    _eof = false;
+    return 0;
+}
+
+long int FileHandlerFTP::tell()
+{
+    return _position;
+}
+
+int FileHandlerFTP::flush()
+{
+    return 0;
+}
+
+int FileHandlerFTP::eof()
+{
+    return _eof ? 1 : 0;
+}
+
+int FileHandlerFTP::close(bool destroy)
+{
+    if (destroy)
+        delete this;
+    return 0;
+}
+
+#endif // !FNIO_IS_STDIO
@@ -0,0 +1,80 @@
+#ifndef FN_FILEFTP_H
+#define FN_FILEFTP_H
+
+#include "fnio.h"
+
+#ifndef FNIO_IS_STDIO
+
+#include <stdint.h>
+#include <string>
+
+#include "fnFile.h"
+#include "fnFTP.h"
+
+/*
+ * FileHandlerFTP - read-only FileHandler that streams a remote file with
+ * restarted (REST + RETR) transfers instead of caching the whole file.
+ *
+ * The handler logs in on its own control connection, so directory browsing on
+ * the FileSystemFTP doesn't interrupt it, and keeps it for the life of the
+ * handler. seek() just moves a logical cursor; read() fills a window buffer
+ * from the data connection. The RETR is left open after each window, so
+ * sequential reads keep draining the same transfer (the server's send-ahead
+ * is the prefetch) and only a read elsewhere aborts it and restarts at the
+ * new offset.
+ *
+ * create() returns nullptr unless the server reports the file size and
+ * accepts REST and a read window can be allocated, so the caller can fall
+ * back to caching.
+ */
+class FileHandlerFTP : public FileHandler
+{
+protected:
+    fnFTP *_ftp;            // private control connection
+    std::string _path;
+
+    long _size;             // total file size (always known when constructed)
+    long _position;         // logical read cursor
+
+    bool _streaming;        // a RETR is open on _ftp
+    long _stream_pos;       // absolute offset of the next byte it will deliver
+
+    uint8_t *_buf;          // read window buffer
+    long _buf_start;        // absolute offset of _buf[0], or -1 when empty
+    long _buf_len;          // valid bytes in _buf
+    bool _eof;
+
+private:
+    // Fill _buf with the window starting at absolute pos, continuing the open
+    // transfer when it's already there. Returns false on EOF/error.
+    bool fill_window(long pos);
+    // Read up to want bytes of the open transfer into dst. Returns the count,
+    // short at the end of the transfer or on a stall.
+    long receive(uint8_t *dst, long want);
+    // Start a RETR at pos, logging in again if the control connection dropped.
+    bool start_transfer(long pos);
+    void stop_transfer();
+
+public:
+    FileHandlerFTP(fnFTP *ftp, const std::string &path, long size);
+    virtual ~FileHandlerFTP() override;
+
+    // Log in and probe for the file size and REST support. Returns a new
+    // handler on success, or nullptr when the server can't restart transfers
+    // (caller should fall back to caching the whole file).
+    static FileHandlerFTP *create(const std::string &host, unsigned short port,
+                                  const std::string &user, const std::string &password,
+                                  const std::string &path);
+
+    virtual int close(bool destroy = true) override;
+    virtual int seek(long int off, int whence) override;
+    virtual long int tell() override;
+    virtual size_t read(void *ptr, size_t size, size_t count) override;
+    virtual size_t write(const void *ptr, size_t size, size_t count) override;
+    virtual int flush() override;
+    virtual int eof() override;
+};
+
+#endif // !FNIO_IS_STDIO
+
+#endif // FN_FILEFTP_H
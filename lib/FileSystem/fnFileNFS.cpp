@@ -3,9 +3,20 @@
 
 #include "fnFileNFS.h"
 #include "../../include/debug.h"
+#include "fnSystem.h"
+
+
+static uint32_t nfs_chunk(struct nfs_context *nfs)
+{
+    size_t rmax = nfs_get_readmax(nfs);
+    size_t wmax = nfs_get_writemax(nfs);
+    size_t chunk = rmax < wmax ? rmax : wmax;
+    return chunk > UINT32_MAX ? UINT32_MAX : (uint32_t)chunk;
+}
 
 
 FileHandlerNFS::FileHandlerNFS(struct nfs_context *nfs, struct nfsfh *handle)
+    : FileHandlerBuffered(nfs_chunk(nfs))
 {
     Debug_println("new FileHandlerNFS");
     _nfs = nfs;
@@ -17,10 +28,11 @@ FileHandlerNFS::~FileHandlerNFS()
 {
     Debug_println("delete FileHandlerNFS");
     if (_handle != nullptr) close(false);
+    delete _read;
 }
 
 
-int FileHandlerNFS::close(bool destroy)
+int FileHandlerNFS::raw_close()
 {
     Debug_println("FileHandlerNFS::close");
     int result = 0;
@@ -30,105 +42,96 @@ int FileHandlerNFS::close(bool destroy)
         _handle = nullptr;
         _nfs = nullptr;
     }
-    if (destroy) delete this;
     return result;
 }
 
 
-int FileHandlerNFS::seek(long int off, int whence)
+int FileHandlerNFS::raw_size(uint64_t *size)
 {
-    Debug_println("FileHandlerNFS::seek");
-    uint64_t new_pos;
-    if (nfs_lseek(_nfs, _handle, off, whence, &new_pos) < 0)
+    struct nfs_stat_64 st;
+    if (nfs_fstat64(_nfs, _handle, &st) < 0)
     {
         Debug_printf("%s\n", nfs_get_error(_nfs));
         return -1;
     }
-    Debug_printf("new pos is %llu\n", new_pos);
+    *size = st.nfs_size;
     return 0;
 }
 
 
-long int FileHandlerNFS::tell()
+int FileHandlerNFS::raw_pread(uint8_t *buf, uint32_t len, uint64_t off)
 {
-    Debug_println("FileHandlerNFS::tell");
-    uint64_t pos;
-    if (nfs_lseek(_nfs, _handle, 0, SEEK_CUR, &pos) < 0)
-    {
+    int result;
+    while ((result = nfs_pread(_nfs, _handle, buf, len, off)) < 0 && errno == EAGAIN)
+        ;
+    if (result < 0)
         Debug_printf("%s\n", nfs_get_error(_nfs));
-        return -1;
-    }
-    return (long)pos;
+    return result;
 }
 
 
-size_t FileHandlerNFS::read(void *ptr, size_t size, size_t count)
+int FileHandlerNFS::raw_pwrite(const uint8_t *buf, uint32_t len, uint64_t off)
 {
-    Debug_println("FileHandlerNFS::read");
-
-    size_t bytes_remaining = size * count;
-    size_t bytes_read = 0;
     int result;
-    while (bytes_remaining > 0)
+    while ((result = nfs_pwrite(_nfs, _handle, buf, len, off)) < 0 && errno == EAGAIN)
+        ;
+    if (result < 0)
+        Debug_printf("%s\n", nfs_get_error(_nfs));
+    return result;
+}
+
+
+void FileHandlerNFS::pread_cb(int err, struct nfs_context *nfs, void *data, void *private_data)
+{
+    AsyncRead *read = (AsyncRead *)private_data;
+    read->result = err;
+    read->done = true;
+}
+
+
+bool FileHandlerNFS::raw_pread_start(uint8_t *buf, uint32_t len, uint64_t off)
+{
+    if (_read == nullptr)
+        _read = new AsyncRead();
+    _read->done = false;
+    if (nfs_pread_async(_nfs, _handle, buf, len, off, pread_cb, _read) < 0)
     {
-        result = nfs_read(_nfs, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
-        {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", nfs_get_error(_nfs));
-                break;
-            }
-        }
-        else if (result == 0)
-        {
-            break; // EOF
-        }
-        else
-        {
-            bytes_read += result;
-            bytes_remaining -= result;
-        }
+        _read->done = true;
+        return false;
     }
 
-    return (size_t)(size * count == bytes_read ? count : bytes_read / size);
+    // Send the request now, so the server works while the host does
+    int revents = wait_socket(nfs_get_fd(_nfs), nfs_which_events(_nfs), 0);
+    if (revents > 0)
+        nfs_service(_nfs, revents);
+    return true;
 }
 
 
-size_t FileHandlerNFS::write(const void *ptr, size_t size, size_t count)
+int FileHandlerNFS::raw_pread_wait()
 {
-    Debug_println("FileHandlerNFS::write");
-
-    size_t bytes_remaining = size * count;
-    size_t bytes_written = 0;
-    int result;
-    while (bytes_remaining > 0)
+    uint64_t start = fnSystem.millis();
+    while (!_read->done)
     {
-        result = nfs_write(_nfs, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
+        int revents = wait_socket(nfs_get_fd(_nfs), nfs_which_events(_nfs), 1000);
+        if (revents < 0 || nfs_service(_nfs, revents) < 0)
         {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", nfs_get_error(_nfs));
-                break;
-            }
+            Debug_printf("%s\n", nfs_get_error(_nfs));
+            _read = nullptr; // still pending, see AsyncRead
+            return -1;
         }
-        else
+        if (fnSystem.millis() - start > FN_BUFFERED_TIMEOUT_MS)
         {
-            bytes_written += result;
-            bytes_remaining -= result;
+            Debug_println("FileHandlerNFS: no reply to background read");
+            _read = nullptr;
+            return -1;
         }
     }
-
-    return (size_t)(size * count == bytes_written ? count : bytes_written / size);
+    return _read->result;
 }
 
 
-int FileHandlerNFS::flush()
+int FileHandlerNFS::raw_fsync()
 {
     Debug_println("FileHandlerNFS::flush");
     int result;
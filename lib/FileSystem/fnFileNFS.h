@@ -5,24 +5,37 @@
 #include <cstddef>
 #include <nfsc/libnfs.h>
 
-#include "fnFile.h"
+#include "fnFileBuffered.h"
 
 
-class FileHandlerNFS : public FileHandler
+class FileHandlerNFS : public FileHandlerBuffered
 {
 protected:
     struct nfs_context *_nfs;
     struct nfsfh *_handle;
+
+    // background read state, set by pread_cb(); on the heap, so a reply
+    // after raw_pread_wait() gave up still has somewhere to go
+    struct AsyncRead
+    {
+        bool done = true;
+        int result = 0;
+    };
+    AsyncRead *_read = nullptr;
+
+    static void pread_cb(int err, struct nfs_context *nfs, void *data, void *private_data);
+
+    virtual int raw_pread(uint8_t *buf, uint32_t len, uint64_t off) override;
+    virtual int raw_pwrite(const uint8_t *buf, uint32_t len, uint64_t off) override;
+    virtual int raw_fsync() override;
+    virtual int raw_size(uint64_t *size) override;
+    virtual int raw_close() override;
+    virtual bool raw_pread_start(uint8_t *buf, uint32_t len, uint64_t off) override;
+    virtual int raw_pread_wait() override;
+
 public:
     FileHandlerNFS(struct nfs_context *nfs, struct nfsfh *handle);
     virtual ~FileHandlerNFS() override;
-
-    virtual int close(bool destroy=true) override;
-    virtual int seek(long int off, int whence) override;
-    virtual long int tell() override;
-    virtual size_t read(void *ptr, size_t size, size_t count) override;
-    virtual size_t write(const void *ptr, size_t size, size_t count) override;
-    virtual int flush() override;
 };
 
 
@@ -3,9 +3,19 @@
 
 #include "fnFileSMB.h"
 #include "../../include/debug.h"
+#include "fnSystem.h"
+
+
+static uint32_t smb_chunk(struct smb2_context *smb)
+{
+    uint32_t rmax = smb2_get_max_read_size(smb);
+    uint32_t wmax = smb2_get_max_write_size(smb);
+    return rmax < wmax ? rmax : wmax;
+}
 
 
 FileHandlerSMB::FileHandlerSMB(struct smb2_context *smb, struct smb2fh *handle)
+    : FileHandlerBuffered(smb_chunk(smb))
 {
     Debug_println("new FileHandlerSMB");
     _smb = smb;
@@ -17,10 +27,11 @@ FileHandlerSMB::~FileHandlerSMB()
 {
     Debug_println("delete FileHandlerSMB");
     if (_handle != nullptr) close(false);
+    delete _read;
 }
 
 
-int FileHandlerSMB::close(bool destroy)
+int FileHandlerSMB::raw_close()
 {
     Debug_println("FileHandlerSMB::close");
     int result = 0;
@@ -30,105 +41,96 @@ int FileHandlerSMB::close(bool destroy)
         _handle = nullptr;
         _smb = nullptr;
     }
-    if (destroy) delete this;
     return result;
 }
 
 
-int FileHandlerSMB::seek(long int off, int whence)
+int FileHandlerSMB::raw_size(uint64_t *size)
 {
-    Debug_println("FileHandlerSMB::seek");
-    uint64_t new_pos;
-    if (smb2_lseek(_smb, _handle, off, whence, &new_pos) < 0)
+    struct smb2_stat_64 st;
+    if (smb2_fstat(_smb, _handle, &st) < 0)
     {
         Debug_printf("%s\n", smb2_get_error(_smb));
         return -1;
     }
-    Debug_printf("new pos is %llu\n", new_pos);
+    *size = st.smb2_size;
     return 0;
 }
 
 
-long int FileHandlerSMB::tell()
+int FileHandlerSMB::raw_pread(uint8_t *buf, uint32_t len, uint64_t off)
 {
-    Debug_println("FileHandlerSMB::tell");
-    uint64_t pos;
-    if (smb2_lseek(_smb, _handle, 0, SEEK_CUR, &pos) < 0)
-    {
+    int result;
+    while ((result = smb2_pread(_smb, _handle, buf, len, off)) < 0 && errno == EAGAIN)
+        ;
+    if (result < 0)
         Debug_printf("%s\n", smb2_get_error(_smb));
-        return -1;
-    }
-    return (long)pos;
+    return result;
 }
 
 
-size_t FileHandlerSMB::read(void *ptr, size_t size, size_t count)
+int FileHandlerSMB::raw_pwrite(const uint8_t *buf, uint32_t len, uint64_t off)
 {
-    Debug_println("FileHandlerSMB::read");
-
-    size_t bytes_remaining = size * count;
-    size_t bytes_read = 0;
     int result;
-    while (bytes_remaining > 0)
+    while ((result = smb2_pwrite(_smb, _handle, buf, len, off)) < 0 && errno == EAGAIN)
+        ;
+    if (result < 0)
+        Debug_printf("%s\n", smb2_get_error(_smb));
+    return result;
+}
+
+
+void FileHandlerSMB::pread_cb(struct smb2_context *smb2, int status, void *command_data, void *cb_data)
+{
+    AsyncRead *read = (AsyncRead *)cb_data;
+    read->result = status;
+    read->done = true;
+}
+
+
+bool FileHandlerSMB::raw_pread_start(uint8_t *buf, uint32_t len, uint64_t off)
+{
+    if (_read == nullptr)
+        _read = new AsyncRead();
+    _read->done = false;
+    if (smb2_pread_async(_smb, _handle, buf, len, off, pread_cb, _read) < 0)
     {
-        result = smb2_read(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
-        {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", smb2_get_error(_smb));
-                break;
-            }
-        }
-        else if (result == 0)
-        {
-            break; // EOF
-        }
-        else
-        {
-            bytes_read += result;
-            bytes_remaining -= result;
-        }
+        _read->done = true;
+        return false;
     }
 
-    return (size_t)(size * count == bytes_read ? count : bytes_read / size);
+    // Send the request now, so the server works while the host does
+    int revents = wait_socket(smb2_get_fd(_smb), smb2_which_events(_smb), 0);
+    if (revents > 0)
+        smb2_service(_smb, revents);
+    return true;
 }
 
 
-size_t FileHandlerSMB::write(const void *ptr, size_t size, size_t count)
+int FileHandlerSMB::raw_pread_wait()
 {
-    Debug_println("FileHandlerSMB::write");
-
-    size_t bytes_remaining = size * count;
-    size_t bytes_written = 0;
-    int result;
-    while (bytes_remaining > 0)
+    uint64_t start = fnSystem.millis();
+    while (!_read->done)
     {
-        result = smb2_write(_smb, _handle, (uint8_t *)ptr, (uint32_t)bytes_remaining);
-        if (result < 0)
+        int revents = wait_socket(smb2_get_fd(_smb), smb2_which_events(_smb), 1000);
+        if (revents < 0 || smb2_service(_smb, revents) < 0)
         {
-            if (errno == EAGAIN)
-                continue;
-            else
-            {
-                Debug_printf("%s\n", smb2_get_error(_smb));
-                break;
-            }
+            Debug_printf("%s\n", smb2_get_error(_smb));
+            _read = nullptr; // still pending, see AsyncRead
+            return -1;
         }
-        else
+        if (fnSystem.millis() - start > FN_BUFFERED_TIMEOUT_MS)
         {
-            bytes_written += result;
-            bytes_remaining -= result;
+            Debug_println("FileHandlerSMB: no reply to background read");
+            _read = nullptr;
+            return -1;
         }
     }
-
-    return (size_t)(size * count == bytes_written ? count : bytes_written / size);
+    return _read->result;
 }
 
 
-int FileHandlerSMB::flush()
+int FileHandlerSMB::raw_fsync()
 {
     Debug_println("FileHandlerSMB::flush");
     int result;
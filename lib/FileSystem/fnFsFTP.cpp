@@ -12,6 +12,8 @@
 
 #include "fnSystem.h"
 #include "fnFileCache.h"
+#include "fnFileFTP.h"
+#include "fnDirCacheStore.h"
 
 #define COPY_BLK_SIZE 4096
 
@@ -19,6 +21,7 @@ FileSystemFTP::FileSystemFTP()
 {
     Debug_printf("FileSystemFTP::ctor\n");
     _ftp = nullptr;
+    _lister = nullptr;
     _url = nullptr;
     // invalidate _last_dir
     _last_dir[0] = '\0';
@@ -27,13 +30,19 @@ FileSystemFTP::FileSystemFTP()
 FileSystemFTP::~FileSystemFTP()
 {
     Debug_printf("FileSystemFTP::dtor\n");
+    // stop a listing still running on _lister
+    _dircache.clear();
     if (_started)
     {
-        _dircache.clear();
         _ftp->logout();
     }
     if (_ftp != nullptr)
         delete _ftp;
+    if (_lister != nullptr)
+    {
+        _lister->logout();
+        delete _lister;
+    }
 }
 
 success_is_true FileSystemFTP::start(const char *url, const char *user, const char *password)
@@ -162,8 +171,20 @@ FILE  *FileSystemFTP::file_open(const char *path, const char *mode)
 #ifndef FNIO_IS_STDIO
 FileHandler *FileSystemFTP::filehandler_open(const char *path, const char *mode)
 {
-    FileHandler *fh = cache_file(path, mode);
-    return fh;
+    // For read-only opens, serve reads from restarted transfers (no full-file
+    // cache). Falls back to caching if the server can't restart a RETR
+    // or there is no memory for a read window.
+    if (mode != nullptr && mode[0] == 'r' && strchr(mode, '+') == nullptr)
+    {
+        FileHandler *fh = FileHandlerFTP::create(
+            _url->host, _url->port.empty() ? 21 : atoi(_url->port.c_str()),
+            _username, _password, path);
+        if (fh != nullptr)
+            return fh;
+        Debug_println("FileSystemFTP::filehandler_open - can't stream, caching whole file");
+    }
+
+    return cache_file(path, mode);
 }
 
 // Read file from FTP path and write it to cache file
@@ -399,23 +420,46 @@ success_is_true FileSystemFTP::dir_open(const char  *path, const char *pattern,
     if (path == nullptr)
         RETURN_ERROR_AS_FALSE();
 
-    if (strcmp(_last_dir, path) == 0 && !_dircache.empty())
+    if (strcmp(_last_dir, path) == 0 && !_dircache.empty() && !_dircache.failed())
     {
         Debug_printf("Use directory cache\n");
     }
     else
     {
-        Debug_printf("Fill directory cache\n");
-
         _dircache.clear();
         // invalidate _last_dir
         _last_dir[0] = '\0';
 
-        // List FTP directory
-        fujiError_t res;
-        res = _ftp->open_directory(path, "");
+        // FTP has no directory mtime to check a stored listing against, so a
+        // recent one is used as is, and an older one while a fresh LIST runs
+        std::string host = "ftp://" + _username + "@" + _url->host + ":" + (_url->port.empty() ? "21" : _url->port);
+        std::string dir = path;
+        time_t saved;
+        bool stored = DirCacheStore::load(host, dir, "", _dircache, &saved);
 
-        if (res != FUJI_ERROR::NONE)
+        if (stored && DirCacheStore::fresh(saved))
+        {
+            Debug_printf("Use stored directory listing\n");
+        }
+        // Start the LIST here so a failure is still reported by dir_open();
+        // the entries are read in the background as the server sends them
+        else if (lister_connected() && _lister->start_directory(path, "") == FUJI_ERROR::NONE)
+        {
+            Debug_printf(stored ? "Refresh stored directory listing\n" : "Fill directory cache\n");
+            // Only a listing the server confirmed with a 226 is stored, or
+            // replaces the stored one being served
+            _dircache.fill_async([this, host, dir](DirCache &cache) {
+                if (!list_directory(cache))
+                    return false;
+                DirCacheStore::save(host, dir, "", cache);
+                return true;
+            }, stored);
+        }
+        else if (stored)
+        {
+            Debug_printf("Failed to refresh directory, using stored listing\n");
+        }
+        else
         {
             Debug_printf("Failed to open directory\n");
             RETURN_ERROR_AS_FALSE();
@@ -423,33 +467,6 @@ success_is_true FileSystemFTP::dir_open(const char  *path, const char *pattern,
 
         // Remember last visited directory
         strlcpy(_last_dir, path, MAX_PATHLEN);
-
-        // Populate directory cache with entries
-        string filename;
-        long filesz;
-        bool is_dir;
-        fsdir_entry *fs_de;
-
-        // get first directory entry
-        res = _ftp->read_directory(filename, filesz, is_dir);
-        while(res == FUJI_ERROR::NONE)
-        {
-            // skip hidden (must still advance to next entry, else infinite loop)
-            if (filename[0] == '.')
-                continue;
-                // new dir entry
-
-            fs_de = &_dircache.new_entry();
-                // set entry members
-            // set entry members
-            strlcpy(fs_de->filename, filename.c_str(), sizeof(fs_de->filename));
-            fs_de->isDir = is_dir;
-            fs_de->size = (uint32_t)filesz;
-            fs_de->modified_time = 0; // TODO
-
-            // get next
-            res = _ftp->read_directory(filename, filesz, is_dir);
-        }
     }
 
     // Apply pattern matching filter and sort entries
@@ -458,6 +475,40 @@ success_is_true FileSystemFTP::dir_open(const char  *path, const char *pattern,
     RETURN_SUCCESS_AS_TRUE();
 }
 
+// Runs on the directory cache's task; only it touches _lister meanwhile
+bool FileSystemFTP::list_directory(DirCache &cache)
+{
+    string filename;
+    long filesz;
+    bool is_dir;
+    fsdir_entry fs_de;
+    fnFTP::list_result_t result;
+
+    while ((result = _lister->next_directory(filename, filesz, is_dir)) == fnFTP::LIST_ENTRY)
+    {
+        // skip hidden
+        if (filename[0] == '.')
+            continue;
+
+        // set entry members
+        strlcpy(fs_de.filename, filename.c_str(), sizeof(fs_de.filename));
+        fs_de.isDir = is_dir;
+        fs_de.size = (uint32_t)filesz;
+        fs_de.modified_time = 0; // TODO
+
+        if (!cache.add(fs_de))
+        {
+            // directory closed or changed before the listing finished
+            _lister->abort_transfer();
+            return false;
+        }
+    }
+
+    // A timeout or a missing 226 leaves what arrived so far; it's served, but
+    // not as the whole directory
+    return result == fnFTP::LIST_END;
+}
+
 fsdir_entry *FileSystemFTP::dir_read()
 {
     return _dircache.read();
@@ -468,6 +519,11 @@ void FileSystemFTP::dir_close()
     // _dircache.clear();
 }
 
+bool FileSystemFTP::dir_partial()
+{
+    return _dircache.partial();
+}
+
 uint16_t FileSystemFTP::dir_tell()
 {
     return _dircache.tell();
@@ -536,3 +592,27 @@ success_is_true FileSystemFTP::ensure_connected()
     _started = true;
     RETURN_SUCCESS_AS_TRUE();
 }
+
+// Directory listings get their own control connection, logged in on first
+// use and kept for the next one
+success_is_true FileSystemFTP::lister_connected()
+{
+    if (_lister != nullptr && _lister->control_connected())
+        RETURN_SUCCESS_AS_TRUE();
+
+    if (_lister == nullptr && (_lister = new fnFTP()) == nullptr)
+        RETURN_ERROR_AS_FALSE();
+
+    fujiError_t res = _lister->login(
+        _username.c_str(),
+        _password.c_str(),
+        _url->host,
+        _url->port.empty() ? 21 : atoi(_url->port.c_str())
+    );
+
+    if (res != FUJI_ERROR::NONE) {
+        Debug_printf("Failed to log in the directory listing connection\n");
+        RETURN_ERROR_AS_FALSE();
+    }
+    RETURN_SUCCESS_AS_TRUE();
+}
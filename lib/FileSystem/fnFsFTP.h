@@ -20,6 +20,9 @@ private:
     // FTP client
     fnFTP *_ftp;
 
+    // second FTP client, for directory listings filled in the background
+    fnFTP *_lister;
+
     // directory cache
     std::string _username;
     std::string _password;
@@ -56,6 +59,7 @@ public:
     success_is_true dir_open(const char *path, const char *pattern, uint16_t diropts) override;
     fsdir_entry *dir_read() override;
     void dir_close() override;
+    bool dir_partial() override;
     uint16_t dir_tell() override;
     success_is_true dir_seek(uint16_t pos) override;
 
@@ -63,6 +67,8 @@ public:
 
 private:
     success_is_true ensure_connected();  // Check connection and reconnect if needed
+    success_is_true lister_connected();  // Log in _lister if it isn't
+    bool list_directory(DirCache &cache); // Background fill of _dircache
 
 public:
 #ifndef FNIO_IS_STDIO
@@ -10,6 +10,7 @@
 
 #include "nfsc/libnfs.h"
 #include "fnFileNFS.h"
+#include "fnDirCacheStore.h"
 
 FileSystemNFS::FileSystemNFS()
 {
@@ -199,13 +200,33 @@ success_is_true FileSystemNFS::dir_open(const char  *path, const char *pattern,
     }
     else
     {
-        Debug_printf("Fill directory cache\n");
-
         _dircache.clear();
         // invalidate _last_dir
         _last_dir[0] = '/';
         _last_dir[1] = '\0';
 
+        // A stored listing is good while the directory's mtime is unchanged
+        std::string host = std::string("nfs://") + _url->server + (_url->path ? _url->path : "");
+        std::string validator;
+        struct nfs_stat_64 st;
+        if (nfs_stat64(_nfs, nfs_path, &st) == 0)
+        {
+            char mtime[48];
+            snprintf(mtime, sizeof(mtime), "%llu.%llu", (unsigned long long)st.nfs_mtime,
+                     (unsigned long long)st.nfs_mtime_nsec);
+            validator = mtime;
+        }
+
+        if (!validator.empty() && DirCacheStore::load(host, nfs_path, validator, _dircache))
+        {
+            Debug_printf("Directory unchanged, using stored listing\n");
+            strlcpy(_last_dir, nfs_path, MAX_PATHLEN);
+            _dircache.apply_filter(pattern, diropts);
+            RETURN_SUCCESS_AS_TRUE();
+        }
+
+        Debug_printf("Fill directory cache\n");
+
         // Open NFS directory
         struct nfsdir *nfs_dir;
 
@@ -247,6 +268,9 @@ success_is_true FileSystemNFS::dir_open(const char  *path, const char *pattern,
             }
         }
         nfs_closedir(_nfs, nfs_dir);
+
+        if (!validator.empty())
+            DirCacheStore::save(host, nfs_path, validator, _dircache);
     }
 
     // Apply pattern matching filter and sort entries
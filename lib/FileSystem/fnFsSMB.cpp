@@ -9,6 +9,7 @@
 
 #include "smb2/smb2.h"
 #include "fnFileSMB.h"
+#include "fnDirCacheStore.h"
 
 FileSystemSMB::FileSystemSMB()
 {
@@ -63,10 +64,12 @@ success_is_true FileSystemSMB::start(const char *url, const char *user, const ch
         smb2_set_user(_smb, user);
         smb2_set_password(_smb, password);
         smb_error = smb2_connect_share(_smb, _url->server, _url->share, user);
+        _user = user;
     }
     else
     {
         smb_error = smb2_connect_share(_smb, _url->server, _url->share, _url->user);
+        _user = _url->user ? _url->user : "";
     }
 
 	if (smb_error != 0) 
@@ -199,13 +202,34 @@ success_is_true FileSystemSMB::dir_open(const char  *path, const char *pattern,
     }
     else
     {
-        Debug_printf("Fill directory cache\n");
-
         _dircache.clear();
         // invalidate _last_dir
         _last_dir[0] = '/';
         _last_dir[1] = '\0';
 
+        // A stored listing is good while the directory's mtime is unchanged
+        // Users can see different listings of a share, so each has their own
+        std::string host = "smb://" + _user + "@" + _url->server + "/" + _url->share;
+        std::string validator;
+        smb2_stat_64 st;
+        if (smb2_stat(_smb, smb_path, &st) == 0)
+        {
+            char mtime[48];
+            snprintf(mtime, sizeof(mtime), "%llu.%llu", (unsigned long long)st.smb2_mtime,
+                     (unsigned long long)st.smb2_mtime_nsec);
+            validator = mtime;
+        }
+
+        if (!validator.empty() && DirCacheStore::load(host, smb_path, validator, _dircache))
+        {
+            Debug_printf("Directory unchanged, using stored listing\n");
+            strlcpy(_last_dir, smb_path, MAX_PATHLEN);
+            _dircache.apply_filter(pattern, diropts);
+            RETURN_SUCCESS_AS_TRUE();
+        }
+
+        Debug_printf("Fill directory cache\n");
+
         // Open SMB directory
         struct smb2dir *smb_dir;
 
@@ -252,6 +276,9 @@ success_is_true FileSystemSMB::dir_open(const char  *path, const char *pattern,
             }
         }
         smb2_closedir(_smb, smb_dir);
+
+        if (!validator.empty())
+            DirCacheStore::save(host, smb_path, validator, _dircache);
     }
 
     // Apply pattern matching filter and sort entries
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <cstddef>
+#include <string>
 #include <smb2/libsmb2.h>
 
 #include "fnFS.h"
@@ -14,6 +15,7 @@ class FileSystemSMB : public FileSystem
 private:
     struct smb2_context *_smb;
     struct smb2_url *_url;
+    std::string _user; // who the share was connected as
 
     // directory cache
     char _last_dir[MAX_PATHLEN];
@@ -13,6 +13,7 @@
 
 #include "fnSystem.h"
 #include "fnDNS.h"
+#include "fnDirCacheStore.h"
 #include "tnfslib.h"
 #include "compat_string.h"
 #include "../../include/debug.h"
@@ -302,45 +303,108 @@ success_is_true FileSystemTNFS::dir_open(const char * path, const char *pattern,
     if(diropts & DIR_OPTION_FILEDATE)
         s_opt |= TNFS_DIRSORT_MODIFIED;
 
-    if(TNFS_RESULT_SUCCESS == tnfs_opendirx(&_mountinfo, path, s_opt, d_opt, thepat, 0))
+    _dircache.clear();
+    _dir_cached = false;
+    _dir_recording = false;
+    _dir_validator.clear();
+
+    // A traversal reaches below this directory, where its mtime says nothing
+    tnfsStat st;
+    if (!(d_opt & TNFS_DIROPT_TRAVERSE) && tnfs_stat(&_mountinfo, &st, path) == TNFS_RESULT_SUCCESS
+        && st.isDir && st.m_time != 0)
     {
-        // Save the directory for later use, making sure it starts and ends with '/''
-        if(path[0] != '/')
-        {
-            _current_dirpath[0] = '/';
-            strlcpy(_current_dirpath + 1, path, sizeof(_current_dirpath)-1);
-        }
-        else
-        {
-            strlcpy(_current_dirpath, path, sizeof(_current_dirpath));
-        }
-        int l = strlen(_current_dirpath);
-        if((l > 0) && (l < sizeof(_current_dirpath) -2) && (_current_dirpath[l -1] != '/'))
+        // The server filters and sorts, so those are part of the listing
+        _dir_key = std::string(path) + '\n' + (pattern ? pattern : "") + '\n' + std::to_string(s_opt);
+        _dir_validator = std::to_string(st.m_time);
+
+        if (DirCacheStore::load(store_host(), _dir_key, _dir_validator, _dircache))
         {
-            _current_dirpath[l] = '/';
-            _current_dirpath[l+1] = '\0';
+            Debug_printf("FileSystemTNFS::dir_open - directory unchanged, using stored listing\n");
+            _dircache.apply_filter(nullptr, DIR_OPTION_UNSORTED);
+            _dir_cached = true;
+            set_current_dirpath(path);
+            RETURN_SUCCESS_AS_TRUE();
         }
+    }
 
+    if(TNFS_RESULT_SUCCESS == tnfs_opendirx(&_mountinfo, path, s_opt, d_opt, thepat, 0))
+    {
+        _dir_recording = !_dir_validator.empty();
+        _dir_pos = 0;
+        _dir_recorded = 0;
+        set_current_dirpath(path);
         RETURN_SUCCESS_AS_TRUE();
     }
 
     RETURN_ERROR_AS_FALSE();
 }
 
+std::string FileSystemTNFS::store_host()
+{
+    return std::string("tnfs://") + _mountinfo.user + "@" + _mountinfo.hostname + ":" +
+           std::to_string(_mountinfo.port) + "/" + _mountinfo.mountpath;
+}
+
+// Save the directory for later use, making sure it starts and ends with '/'
+void FileSystemTNFS::set_current_dirpath(const char *path)
+{
+    if(path[0] != '/')
+    {
+        _current_dirpath[0] = '/';
+        strlcpy(_current_dirpath + 1, path, sizeof(_current_dirpath)-1);
+    }
+    else
+    {
+        strlcpy(_current_dirpath, path, sizeof(_current_dirpath));
+    }
+    size_t l = strlen(_current_dirpath);
+    if((l > 0) && (l < sizeof(_current_dirpath) -2) && (_current_dirpath[l -1] != '/'))
+    {
+        _current_dirpath[l] = '/';
+        _current_dirpath[l+1] = '\0';
+    }
+}
+
+// Keep entries read in order from the start; a skip ahead leaves a gap, and
+// the listing can't be stored
+void FileSystemTNFS::record_entry(const fsdir_entry &entry)
+{
+    if (_dir_recording && _dir_pos == _dir_recorded)
+    {
+        _dircache.new_entry() = entry;
+        _dir_recorded++;
+    }
+    _dir_pos++;
+}
+
 fsdir_entry * FileSystemTNFS::dir_read()
 {
     if(!_started)
         return nullptr;
 
+    if(_dir_cached)
+        return _dircache.read();
+
     tnfsStat fstat;
 
     _direntry.filename[0] = '\0';
-    if(TNFS_RESULT_SUCCESS != tnfs_readdirx(&_mountinfo, &fstat, _direntry.filename, sizeof(_direntry.filename)))
+    int result = tnfs_readdirx(&_mountinfo, &fstat, _direntry.filename, sizeof(_direntry.filename));
+    if(TNFS_RESULT_SUCCESS != result)
+    {
+        // Read through from the start: keep it for the next visit
+        if(result == TNFS_RESULT_END_OF_FILE && _dir_recording && _dir_recorded == _dir_pos)
+        {
+            DirCacheStore::save(store_host(), _dir_key, _dir_validator, _dircache);
+            _dir_recording = false;
+            _dircache.clear();
+        }
         return nullptr;
+    }
 
     _direntry.size = fstat.filesize;
     _direntry.modified_time = fstat.m_time;
     _direntry.isDir = fstat.isDir;
+    record_entry(_direntry);
 
     return &_direntry;
 }
@@ -349,7 +413,12 @@ void FileSystemTNFS::dir_close()
 {
     if(!_started)
         return;
-    tnfs_closedir(&_mountinfo);
+    if(_dir_cached)
+        _dir_cached = false;
+    else
+        tnfs_closedir(&_mountinfo);
+    _dir_recording = false;
+    _dircache.clear();
     _current_dirpath[0] = '\0';
 }
 
@@ -358,6 +427,9 @@ uint16_t FileSystemTNFS::dir_tell()
     if(!_started)
         return FNFS_INVALID_DIRPOS;;
 
+    if(_dir_cached)
+        return _dircache.tell();
+
     uint16_t position;
     if(0 != tnfs_telldir(&_mountinfo, &position))
         position = FNFS_INVALID_DIRPOS;
@@ -370,7 +442,16 @@ success_is_true FileSystemTNFS::dir_seek(uint16_t position)
     if(!_started)
         RETURN_ERROR_AS_FALSE();
 
-    RETURN_SUCCESS_IF(0 == tnfs_seekdir(&_mountinfo, position));
+    if(_dir_cached)
+        return _dircache.seek(position);
+
+    if(0 != tnfs_seekdir(&_mountinfo, position))
+        RETURN_ERROR_AS_FALSE();
+
+    _dir_pos = position;
+    if(_dir_pos > _dir_recorded)
+        _dir_recording = false;
+    RETURN_SUCCESS_AS_TRUE();
 }
 
 #ifdef ESP_PLATFORM
@@ -1,7 +1,10 @@
 #ifndef _FN_FSTNFS_
 #define _FN_FSTNFS_
 
+#include <string>
+
 #include "fnFS.h"
+#include "fnDirCache.h"
 #include "tnfslib.h"
 #ifdef ESP_PLATFORM
 #include <esp_timer.h>
@@ -19,6 +22,21 @@ private:
 #endif
     char _current_dirpath[TNFS_MAX_FILELEN];
 
+    // Listings kept in DirCacheStore, checked against the directory's mtime:
+    // an unchanged directory is served from _dircache, otherwise the entries
+    // read from the server are recorded there until the end of the listing
+    DirCache _dircache;
+    bool _dir_cached = false;    // dir_read() and friends use _dircache
+    bool _dir_recording = false; // still recording for DirCacheStore
+    uint16_t _dir_pos = 0;       // next entry the server will return
+    uint16_t _dir_recorded = 0;  // entries 0.._dir_recorded-1 are in _dircache
+    std::string _dir_key;
+    std::string _dir_validator;
+
+    std::string store_host();
+    void set_current_dirpath(const char *path);
+    void record_entry(const fsdir_entry &entry);
+
 public:
     FileSystemTNFS();
     ~FileSystemTNFS();
@@ -0,0 +1,171 @@
+#include "BusTrace.h"
+
+#include <algorithm>
+
+#include "fnSystem.h"
+
+BusTrace busTrace;
+
+#ifdef BUS_TRACE
+
+void BusTrace::command(uint8_t device, uint8_t command)
+{
+    // A command that never reached accept was ignored by every device
+    _current = {};
+    _current.start_us = fnSystem.micros();
+    _current.device = device;
+    _current.command = command;
+    _haveCommand = true;
+    _open = false;
+}
+
+void BusTrace::accept()
+{
+    uint32_t now = fnSystem.micros();
+
+    if (!_haveCommand)
+    {
+        _current = {};
+        _current.start_us = now;
+    }
+    _current.accept_us = now - _current.start_us;
+    _haveCommand = false;
+    _open = true;
+}
+
+void BusTrace::get(size_t len)
+{
+    if (_open)
+        _current.bytes_in = std::min<size_t>(_current.bytes_in + len, UINT16_MAX);
+}
+
+void BusTrace::send(size_t len, bool is_error)
+{
+    if (!_open && !_haveCommand)
+        return;
+    _current.bytes_out = std::min<size_t>(len, UINT16_MAX);
+    end(is_error ? BusTraceResult::SENT_ERROR : BusTraceResult::SENT);
+}
+
+void BusTrace::end(BusTraceResult result)
+{
+    // A device may answer without accepting first, e.g. to reject a command
+    if (!_open && !_haveCommand)
+        return;
+    _open = false;
+    _haveCommand = false;
+
+    _current.end_us = fnSystem.micros() - _current.start_us;
+    _current.result = result;
+    record(_current);
+}
+
+void BusTrace::record(const BusTraceRecord &rec)
+{
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    Slot &slot = _ring[head & (BUS_TRACE_RECORDS - 1)];
+
+    // seqlock: odd while the record is being written
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.rec = rec;
+    slot.seq.store(seq + 2, std::memory_order_release);
+    _head.store(head + 1, std::memory_order_release);
+
+    sample(rec.device, rec.command, rec.end_us,
+           rec.result == BusTraceResult::ERROR || rec.result == BusTraceResult::SENT_ERROR);
+}
+
+void BusTrace::link(uint32_t first_us, uint32_t last_us)
+{
+    sample(BUS_TRACE_LINK, BUS_TRACE_LINK_FIRST, first_us, false);
+    sample(BUS_TRACE_LINK, BUS_TRACE_LINK_LAST, last_us, false);
+}
+
+void BusTrace::sample(uint8_t device, uint8_t command, uint32_t us, bool error)
+{
+    Histogram *hist = histogram(device, command);
+    if (hist == nullptr)
+        return;
+
+    int bucket = 0;
+    while (bucket < BUS_TRACE_BUCKETS - 1 && us >= bucketLimit(bucket))
+        bucket++;
+
+    hist->count.fetch_add(1, std::memory_order_relaxed);
+    if (error)
+        hist->errors.fetch_add(1, std::memory_order_relaxed);
+    if (us > hist->max_us.load(std::memory_order_relaxed))
+        hist->max_us.store(us, std::memory_order_relaxed);
+    hist->total_us.fetch_add(us, std::memory_order_relaxed);
+    hist->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+BusTrace::Histogram *BusTrace::histogram(uint8_t device, uint8_t command)
+{
+    for (auto &hist : _hist)
+    {
+        if (!hist.used.load(std::memory_order_acquire))
+        {
+            // Claim it; only the bus task writes so there's no race
+            hist.device = device;
+            hist.command = command;
+            hist.used.store(true, std::memory_order_release);
+            return &hist;
+        }
+        if (hist.device == device && hist.command == command)
+            return &hist;
+    }
+
+    // Table full, later pairs only show up in the ring
+    return nullptr;
+}
+
+size_t BusTrace::records(BusTraceRecord *out, size_t max) const
+{
+    uint32_t head = _head.load(std::memory_order_acquire);
+    uint32_t avail = head < BUS_TRACE_RECORDS ? head : BUS_TRACE_RECORDS;
+    if (max > avail)
+        max = avail;
+
+    size_t count = 0;
+    for (uint32_t idx = head - max; idx != head; idx++)
+    {
+        const Slot &slot = _ring[idx & (BUS_TRACE_RECORDS - 1)];
+        uint32_t before = slot.seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        out[count] = slot.rec;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before)
+            continue; // overwritten while copying
+        count++;
+    }
+
+    return count;
+}
+
+size_t BusTrace::histograms(BusTraceHistogram *out, size_t max) const
+{
+    size_t count = 0;
+    for (auto &hist : _hist)
+    {
+        if (count == max || !hist.used.load(std::memory_order_acquire))
+            break;
+
+        BusTraceHistogram &h = out[count++];
+        h.device = hist.device;
+        h.command = hist.command;
+        h.count = hist.count.load(std::memory_order_relaxed);
+        h.errors = hist.errors.load(std::memory_order_relaxed);
+        h.max_us = hist.max_us.load(std::memory_order_relaxed);
+        h.total_us = hist.total_us.load(std::memory_order_relaxed);
+        for (int i = 0; i < BUS_TRACE_BUCKETS; i++)
+            h.buckets[i] = hist.buckets[i].load(std::memory_order_relaxed);
+    }
+
+    return count;
+}
+
+#endif /* BUS_TRACE */
@@ -0,0 +1,149 @@
+#ifndef BUSTRACE_H
+#define BUSTRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Bus transaction tracing
+ *
+ * Build with -D BUS_TRACE to record every bus transaction: the device and
+ * command, when the command arrived, when the device accepted it, when it
+ * finished, how many bytes went each way and how it ended. The last
+ * BUS_TRACE_RECORDS transactions are kept in a ring buffer and each
+ * device/command pair gets a latency histogram. GET /api/v1/bus/trace dumps
+ * both as JSON.
+ *
+ * The hooks are called from SystemBusBase, so every bus is covered. Buses
+ * that call command() when a command frame arrives also get the time the
+ * device took to accept it; otherwise a transaction starts at accept.
+ *
+ * A link to the host that sees the wire (NetSIO) also records, per
+ * transaction, the time from the end of the command frame until the first
+ * and the last response went out. These are the histograms of device
+ * BUS_TRACE_LINK.
+ *
+ * Only the bus task writes. Readers copy records out and drop any that
+ * were overwritten while they were being copied, so nothing takes a lock.
+ * Without BUS_TRACE every hook is an empty inline and compiles away.
+ */
+
+#define BUS_TRACE_RECORDS 256       // must be a power of two
+#define BUS_TRACE_SLOTS 64          // device/command pairs with a histogram
+#define BUS_TRACE_BUCKETS 12        // latency buckets, 100us << n
+
+// Device and commands the link's latencies are kept under
+#define BUS_TRACE_LINK 0xFF
+#define BUS_TRACE_LINK_FIRST 0x00   // command frame to first response
+#define BUS_TRACE_LINK_LAST 0x01    // command frame to last response
+
+enum class BusTraceResult : uint8_t {
+    NONE,       // transaction still open
+    SUCCESS,    // transaction_success()
+    ERROR,      // transaction_error()
+    SENT,       // transaction_send()
+    SENT_ERROR, // transaction_send(..., is_error=true)
+};
+
+struct BusTraceRecord
+{
+    uint32_t start_us;      // command arrived (or accepted), fnSystem.micros()
+    uint32_t accept_us;     // start to transaction_accept()
+    uint32_t end_us;        // start to completion
+    uint16_t bytes_in;      // transaction_get() total
+    uint16_t bytes_out;     // transaction_send() length
+    uint8_t device;
+    uint8_t command;
+    BusTraceResult result;
+};
+
+struct BusTraceHistogram
+{
+    uint8_t device;
+    uint8_t command;
+    uint32_t count;
+    uint32_t errors;
+    uint32_t max_us;
+    uint64_t total_us;
+    uint32_t buckets[BUS_TRACE_BUCKETS];
+};
+
+#ifdef BUS_TRACE
+
+class BusTrace
+{
+public:
+    void command(uint8_t device, uint8_t command);
+    void accept();
+    void get(size_t len);
+    void send(size_t len, bool is_error);
+    void end(BusTraceResult result);
+    // Latencies of one transaction as the link saw them
+    void link(uint32_t first_us, uint32_t last_us);
+
+    // Copy out up to max of the most recent records, oldest first
+    size_t records(BusTraceRecord *out, size_t max) const;
+    // Copy out up to max histograms, in the order they were first seen
+    size_t histograms(BusTraceHistogram *out, size_t max) const;
+    // Total transactions seen, including those no longer in the ring
+    uint32_t total() const { return _head.load(std::memory_order_acquire); }
+
+    static uint32_t bucketLimit(int bucket) { return 100u << bucket; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> seq{0};   // odd while being written
+        BusTraceRecord rec;
+    };
+
+    struct Histogram
+    {
+        std::atomic<bool> used{false};
+        uint8_t device;
+        uint8_t command;
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint32_t> errors{0};
+        std::atomic<uint32_t> max_us{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint32_t> buckets[BUS_TRACE_BUCKETS] = {};
+    };
+
+    BusTraceRecord _current = {};
+    bool _open = false;
+    bool _haveCommand = false;
+
+    std::atomic<uint32_t> _head{0};
+    Slot _ring[BUS_TRACE_RECORDS];
+    Histogram _hist[BUS_TRACE_SLOTS];
+
+    void record(const BusTraceRecord &rec);
+    void sample(uint8_t device, uint8_t command, uint32_t us, bool error);
+    Histogram *histogram(uint8_t device, uint8_t command);
+};
+
+#else /* !BUS_TRACE */
+
+class BusTrace
+{
+public:
+    void command(uint8_t, uint8_t) {}
+    void accept() {}
+    void get(size_t) {}
+    void send(size_t, bool) {}
+    void end(BusTraceResult) {}
+    void link(uint32_t, uint32_t) {}
+
+    size_t records(BusTraceRecord *, size_t) const { return 0; }
+    size_t histograms(BusTraceHistogram *, size_t) const { return 0; }
+    uint32_t total() const { return 0; }
+
+    static uint32_t bucketLimit(int bucket) { return 100u << bucket; }
+};
+
+#endif /* BUS_TRACE */
+
+extern BusTrace busTrace;
+
+#endif /* BUSTRACE_H */
@@ -96,13 +96,13 @@ void systemBus::adamnet_handle_bus_task(void)
 }
 #endif // ESP_PLATFORM
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
     assert(_transaction_state == TRANS_STATE::INVALID);
     _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
     assert(_transaction_state == TRANS_STATE::NO_GET
            || _transaction_state == TRANS_STATE::DID_GET);
@@ -114,7 +114,7 @@ void systemBus::transaction_success()
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
     if (busPhase.needAck())
     {
@@ -125,7 +125,7 @@ void systemBus::transaction_error()
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     assert(_transaction_state == TRANS_STATE::WILL_GET);
     _transaction_state = TRANS_STATE::DID_GET;
@@ -135,7 +135,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool err)
+void systemBus::_transaction_send(const void *data, size_t len, bool err)
 {
     assert(_transaction_state == TRANS_STATE::NO_GET);
     const uint8_t *ptr = static_cast<const uint8_t*>(data);
@@ -303,6 +303,8 @@ void systemBus::_adamnet_process_cmd()
 
         _activeDev = it->second;
         _activePacket = &tmpPacket;
+        // command() would consume the payload, the packet type is the bus command
+        busTrace.command(tmpPacket.device(), static_cast<uint8_t>(tmpPacket.type()));
 
         if (tmpPacket.type() == APT::MN_SEND)
         {
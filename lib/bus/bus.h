@@ -2,6 +2,7 @@
 #define BUS_H
 
 #include "global_types.h"
+#include "BusTrace.h"
 
 #include <string>
 
@@ -31,24 +32,49 @@ class SystemBusBase
 protected:
     transState_t _transaction_state = TRANS_STATE::INVALID;
 
+    // Protocol-specific implementations of the calls below. The public
+    // wrappers add tracing (see BusTrace.h) and otherwise just forward.
+    virtual void _transaction_accept(transState_t expectMoreData) = 0;
+    virtual void _transaction_success() = 0;
+    virtual void _transaction_error() = 0;
+    virtual success_is_true _transaction_get(void *data, size_t len) = 0;
+    virtual void _transaction_send(const void *data, size_t len, bool is_error) = 0;
+
 public:
     // Accept the current transaction and perform any protocol-specific setup
     // required before data transfer.
-    virtual void transaction_accept(transState_t expectMoreData) = 0;
+    void transaction_accept(transState_t expectMoreData) {
+        busTrace.accept();
+        _transaction_accept(expectMoreData);
+    }
 
     // Successfully complete the transaction without sending response data.
-    virtual void transaction_success() = 0;
+    void transaction_success() {
+        _transaction_success();
+        busTrace.end(BusTraceResult::SUCCESS);
+    }
 
     // Terminate the transaction without sending response data due to an error.
-    virtual void transaction_error() = 0;
+    void transaction_error() {
+        _transaction_error();
+        busTrace.end(BusTraceResult::ERROR);
+    }
 
     // Receive exactly len bytes from the current transaction. Returns false if
     // the transaction cannot be completed successfully.
-    virtual success_is_true transaction_get(void *data, size_t len) = 0;
+    success_is_true transaction_get(void *data, size_t len) {
+        success_is_true ok = _transaction_get(data, len);
+        if (ok)
+            busTrace.get(len);
+        return ok;
+    }
 
     // Send response data and complete the transaction. If is_error is true,
     // the response represents a protocol-defined error.
-    virtual void transaction_send(const void *data, size_t len, bool is_error=false) = 0;
+    void transaction_send(const void *data, size_t len, bool is_error=false) {
+        _transaction_send(data, len, is_error);
+        busTrace.send(len, is_error);
+    }
 
     inline void transaction_send(const std::string data, bool is_error=false) {
         transaction_send(data.data(), data.size(), is_error);
@@ -107,6 +107,7 @@ void systemBus::_comlynx_process_cmd()
         {
             _activeDev = devicep;
             _activePacket = tmpPacket.get();
+            busTrace.command(tmpPacket->device(), tmpPacket->command());
 
             #ifdef DEBUG
             Debug_println("---");
@@ -350,13 +351,13 @@ void systemBus::setRedeyeGameRemap(uint32_t remap)
     }
 }
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
     assert(_transaction_state == TRANS_STATE::INVALID);
     _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
     assert(_transaction_state == TRANS_STATE::NO_GET || _transaction_state == TRANS_STATE::DID_GET);
     Debug_println("transaction_complete - sent ACK");
@@ -364,7 +365,7 @@ void systemBus::transaction_success()
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
     Debug_println("transaction_error - send NAK");
     sendNakPacket();
@@ -374,7 +375,7 @@ void systemBus::transaction_error()
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     assert(_transaction_state == TRANS_STATE::WILL_GET);
     _transaction_state = TRANS_STATE::DID_GET;
@@ -384,7 +385,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_IF(to_copy != 0);
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool err)
+void systemBus::_transaction_send(const void *data, size_t len, bool err)
 {
     const uint8_t *ptr = reinterpret_cast<const uint8_t *>(data);
 
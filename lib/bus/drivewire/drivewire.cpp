@@ -358,6 +358,8 @@ bool systemBus::_transaction_handle_command(const FujiDWPacket &packet, virtualD
     if (packet.device() == OP::CLOCK)
         cmd = FUJICMD_SEND_RESPONSE;
 
+    busTrace.command(static_cast<uint8_t>(packet.device()), cmd);
+
     switch (cmd)
     {
     case FUJICMD_DEVICE_READY:
@@ -980,50 +982,48 @@ void systemBus::shutdown()
 #ifdef PINMAP_FUJIVERSAL_DRIVEWIRE
 std::unique_ptr<FujiBusPacket> systemBus::readBusPacket(int first)
 {
-    ByteBuffer packet;
-    int count = 0;
+    int val = first;
+
+    _rxParser.reset();
+    if (val < 0)
+        val = _port->read();
 
-    auto processByte = [&](int val) -> bool
+    for (; val >= 0; val = _port->read())
     {
-        if (val < 0)
-            return false;
         // Pre-frame bytes are CoCo DriveWire traffic on the shared link;
         // stash them for the bus reader instead of letting them be discarded.
-        if (count == 0 && val != SLIP_END) {
+        if (!_rxParser.inFrame() && val != SLIP_END) {
             _dbc_pushback.push_back(static_cast<uint8_t>(val));
-            return true;
+            continue;
         }
-        packet.push_back(static_cast<uint8_t>(val));
-        if (val == SLIP_END)
-            count++;
-        return true;
-    };
 
-    processByte(first);
-
-    while (count < 2)
-    {
-        if (!processByte(_port->read()))
-            break;
+        auto result = _rxParser.feed(static_cast<uint8_t>(val));
+        if (result == FujiBusParser::Result::ERROR)
+            return nullptr;
+        if (result == FujiBusParser::Result::PACKET) {
+            auto packet = std::make_unique<FujiBusPacket>();
+            packet->assign(_rxParser);
+            return packet;
+        }
     }
 
-    return FujiBusPacket::fromSerialized(packet);
+    return nullptr;
 }
 
 void systemBus::writeBusPacket(FujiBusPacket &packet)
 {
-    ByteBuffer encoded = packet.serialize();
-    _port->write(encoded.data(), encoded.size());
+    packet.serialize(_txBuffer);
+    _port->write(_txBuffer.data(), _txBuffer.size());
 }
 #endif /* PINMAP_FUJIVERSAL_DRIVEWIRE */
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
     assert(_transaction_state == TRANS_STATE::INVALID);
     _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
     assert(_transaction_state == TRANS_STATE::NO_GET
            || _transaction_state == TRANS_STATE::DID_GET);
@@ -1033,13 +1033,13 @@ void systemBus::transaction_success()
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
     _activeDev->_errorCode = NDEV_STATUS::GENERAL;
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     assert(_transaction_state == TRANS_STATE::WILL_GET);
     _transaction_state = TRANS_STATE::DID_GET;
@@ -1051,7 +1051,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool is_error)
+void systemBus::_transaction_send(const void *data, size_t len, bool is_error)
 {
     assert(_transaction_state == TRANS_STATE::NO_GET);
     if (is_error)
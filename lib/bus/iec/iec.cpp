@@ -87,27 +87,27 @@ void systemBus::shutdown()
 {
 }
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
   assert(_transaction_state == TRANS_STATE::INVALID);
   _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
   assert(_transaction_state == TRANS_STATE::NO_GET
          || _transaction_state == TRANS_STATE::DID_GET);
   _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
   _transaction_state = TRANS_STATE::INVALID;
   Debug_printf("transaction error\n");
   abort();
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     assert(_transaction_state == TRANS_STATE::WILL_GET);
     assert(_activePacket);
@@ -119,7 +119,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool err)
+void systemBus::_transaction_send(const void *data, size_t len, bool err)
 {
     assert(_transaction_state == TRANS_STATE::NO_GET);
     const uint8_t *ptr = reinterpret_cast<const uint8_t*>(data);
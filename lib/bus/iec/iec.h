@@ -71,12 +71,13 @@ public:
         return mstr::toPETSCII2(unicode);
     }
 
-    void transaction_accept(transState_t expectMoreData) override;
-    void transaction_success() override;
-    void transaction_error() override;
-    success_is_true transaction_get(void *data, size_t len) override;
-    using SystemBusBase::transaction_send;
-    void transaction_send(const void *data, size_t len, bool is_error=false) override;
+protected:
+    void _transaction_accept(transState_t expectMoreData) override;
+    void _transaction_success() override;
+    void _transaction_error() override;
+    success_is_true _transaction_get(void *data, size_t len) override;
+    void _transaction_send(const void *data, size_t len, bool is_error) override;
+public:
 
     // FIXME - bus should be creating the packet
     FujiIECPacket *_activePacket {};
@@ -118,13 +118,13 @@ void print_packet_wave(uint8_t *data, int bytes)
 
 //------------------------------------------------------------------------------
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
   assert(_transaction_state == TRANS_STATE::INVALID);
   _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
   assert(_transaction_state == TRANS_STATE::NO_GET
          || _transaction_state == TRANS_STATE::DID_GET);
@@ -137,9 +137,10 @@ void systemBus::transaction_error(spError_t err)
   _transaction_state = TRANS_STATE::INVALID;
   assert(err != SP_ERR::NOERROR);
   iwm_send_packet(_activeDev->id(), iwm_packet_type_t::status, err, nullptr, 0);
+  busTrace.end(BusTraceResult::ERROR);
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
   assert(_transaction_state == TRANS_STATE::WILL_GET);
   _transaction_state = TRANS_STATE::DID_GET;
@@ -149,7 +150,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
   RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool is_error)
+void systemBus::_transaction_send(const void *data, size_t len, bool is_error)
 {
   assert(_transaction_state == TRANS_STATE::NO_GET);
   if (is_error) {
@@ -354,6 +355,7 @@ void virtualDevice::iwm_return_badcmd(const iwm_decoded_cmd_t &cmd)
 void systemBus::iwm_process(const iwm_decoded_cmd_t &cmd)
 {
   fnLedManager.set(LED_BUS, true);
+  busTrace.command(_activeDev->id(), cmd.frame.sp_command);
 
   // SmartPort doesn't allow sending payload with STATUS commands, so
   // CONTROL is used by Fuji devices to process payload and queue up
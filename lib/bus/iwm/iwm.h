@@ -259,13 +259,15 @@ public:
 #endif
   void shutdown();
 
-  void transaction_accept(transState_t expectMoreData) override;
-  void transaction_success() override;
+protected:
+  void _transaction_accept(transState_t expectMoreData) override;
+  void _transaction_success() override;
+  void _transaction_error() override { transaction_error(SP_ERR::IOERROR); }
+  success_is_true _transaction_get(void *data, size_t len) override;
+  void _transaction_send(const void *data, size_t len, bool is_error) override;
+public:
+  using SystemBusBase::transaction_error;
   void transaction_error(spError_t err);
-  void transaction_error() override { transaction_error(SP_ERR::IOERROR); }
-  success_is_true transaction_get(void *data, size_t len) override;
-  using SystemBusBase::transaction_send;
-  void transaction_send(const void *data, size_t len, bool is_error=false) override;
 
   int numDevices();
   void addDevice(virtualDevice *pDevice, iwm_fujinet_type_t deviceType); // todo: probably get called by handle_init()
@@ -149,7 +149,7 @@ uint8_t iwm_slip::iwm_phase_vector()
 	}
 
 	// create a Request object from the data
-	std::vector<uint8_t> request_data = request_queue_.front();
+	std::vector<uint8_t> request_data = std::move(request_queue_.front());
 	request_queue_.pop();
 	current_request = Request::from_packet(request_data);
 
@@ -162,6 +162,7 @@ uint8_t iwm_slip::iwm_phase_vector()
 	std::fill(std::begin(SYSTEM_BUS.command_packet.data), std::end(SYSTEM_BUS.command_packet.data), 0);
 	// The request data is the raw bytes of the request object, we're only really interested in the header part
 	std::copy(request_data.begin(), request_data.begin() + 8, SYSTEM_BUS.command_packet.data);
+	connection_->release_buffer(std::move(request_data));
 
 	// signal we have a command to process
 	sp_command_mode = sp_cmd_state_t::command;
@@ -247,7 +248,7 @@ void iwm_slip::wait_for_requests()
 		if (!request_data.empty())
 		{
 			std::lock_guard<std::mutex> lock(queue_mutex_);
-			request_queue_.push(request_data);
+			request_queue_.push(std::move(request_data));
 		}
 	}
 }
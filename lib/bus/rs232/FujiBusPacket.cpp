@@ -22,7 +22,7 @@ struct fujibus_header {
     std::uint8_t descr;    /* Describes the fields that follow (first descriptor) */
 };
 
-static_assert(sizeof(fujibus_header) == 6, "fujibus_header must be 6 bytes");
+static_assert(sizeof(fujibus_header) == FUJIBUS_HEADER_SIZE, "fujibus_header must be 6 bytes");
 static_assert(offsetof(fujibus_header, checksum) == 4, "checksum offset mismatch");
 
 #define FUJI_DESCR_COUNT_MASK  0x07
@@ -50,156 +50,139 @@ namespace {
             v |= static_cast<std::uint32_t>(buf[offset + i]) << (8 * i);
         return v;
     }
+
+    // add a byte to a checksum, folding the carry back in
+    inline std::uint16_t checksum_add(std::uint16_t chk, std::uint8_t val)
+    {
+        chk += val;
+        return (chk >> 8) + (chk & 0xFF);
+    }
 } // namespace
 
-ByteBuffer FujiBusPacket::decodeSLIP(const ByteBuffer& input) const
-{
-    ByteBuffer output;
-    output.reserve(input.size());  // worst case, same size
+// ------------------ Parser ------------------
 
-    const std::size_t len = input.size();
-    std::size_t idx = 0;
+void FujiBusParser::reset()
+{
+    _state = State::IDLE;
+    _complete = false;
+    _frame.clear();
+    _params.clear();
+}
 
-    // Find the first SLIP_END
-    while (idx < len && input[idx] != SLIP_END)
-        ++idx;
+void FujiBusParser::startFrame()
+{
+    _complete = false;
+    _bad = false;
+    _length = 0;
+    _sum = 0;
+    _frame.clear();
+    _params.clear();
+}
 
-    if (idx == len)
-        return {}; // no frame start found
+void FujiBusParser::add(std::uint8_t val)
+{
+    std::size_t idx = _frame.size();
 
-    // Decode from the byte after the first SLIP_END
-    for (++idx; idx < len; ++idx)
+    // Once the length is known anything beyond it is an error; stop
+    // storing so line noise can't grow the buffer without bound
+    if (idx >= sizeof(fujibus_header) && idx >= _length)
     {
-        std::uint8_t val = input[idx];
-        if (val == SLIP_END)
-            break;
-
-        if (val == SLIP_ESCAPE)
-        {
-            if (++idx >= len)
-                break; // truncated escape
-            val = input[idx];
-            if (val == SLIP_ESC_END)
-                output.push_back(SLIP_END);
-            else if (val == SLIP_ESC_ESC)
-                output.push_back(SLIP_ESCAPE);
-            // else: ignore malformed escape
-        }
-        else
-        {
-            output.push_back(val);
-        }
+        _bad = true;
+        return;
     }
 
-    return output;
+    if (idx == offsetof(fujibus_header, length) + 1)
+        _length = _frame[idx - 1] | (val << 8);
+    if (idx != offsetof(fujibus_header, checksum))
+        _sum = checksum_add(_sum, val);
+    _frame.push_back(val);
 }
 
-ByteBuffer FujiBusPacket::encodeSLIP(const ByteBuffer& input) const
+FujiBusParser::Result FujiBusParser::feedByte(std::uint8_t val)
 {
-    ByteBuffer output;
-    output.reserve(input.size() * 2 + 2);  // worst case, double size + 2 ENDs
-
-    // Avoids a compiler warning with GCC 15, which did not like the initial push_back of SLIP_END on a size 0 buffer (even though reserve has it with enough space).
-    output.resize(1);
-    output[0] = SLIP_END;
+    // The frame handed out last time stays valid until now
+    if (_complete)
+        startFrame();
 
-    for (std::uint8_t val : input)
+    switch (_state)
     {
-        if (val == SLIP_END || val == SLIP_ESCAPE)
+    case State::IDLE:
+        // Anything before the first SLIP_END isn't ours
+        if (val == SLIP_END)
         {
-            output.push_back(SLIP_ESCAPE);
-            if (val == SLIP_END)
-                output.push_back(SLIP_ESC_END);
-            else
-                output.push_back(SLIP_ESC_ESC);
+            startFrame();
+            _state = State::FRAME;
         }
+        return Result::NEED_MORE;
+
+    case State::ESCAPE:
+        _state = State::FRAME;
+        if (val == SLIP_ESC_END)
+            add(SLIP_END);
+        else if (val == SLIP_ESC_ESC)
+            add(SLIP_ESCAPE);
         else
         {
-            output.push_back(val);
+            _bad = true;
+            // a truncated escape still lets the END close the frame
+            if (val == SLIP_END)
+                break;
         }
-    }
-    output.push_back(SLIP_END);
+        return Result::NEED_MORE;
 
-    return output;
-}
-
-std::uint8_t FujiBusPacket::calcChecksum(const ByteBuffer& buf) const
-{
-    std::uint16_t chk = 0;
+    case State::FRAME:
+        break;
+    }
 
-    for (std::size_t i = 0; i < buf.size(); ++i)
+    if (val == SLIP_ESCAPE)
+    {
+        _state = State::ESCAPE;
+        return Result::NEED_MORE;
+    }
+    if (val != SLIP_END)
     {
-        chk += buf[i];
-        chk = (chk >> 8) + (chk & 0xFF); // fold carry
+        add(val);
+        return Result::NEED_MORE;
     }
 
-    return static_cast<std::uint8_t>(chk);
+    // SLIP_END with nothing before it opens a frame rather than closing one
+    if (_frame.empty() && !_bad)
+        return Result::NEED_MORE;
+
+    // The closing SLIP_END may also open the next frame
+    _complete = true;
+    return finish();
 }
 
-bool FujiBusPacket::parse(const ByteBuffer& input)
+FujiBusParser::Result FujiBusParser::finish()
 {
-    ByteBuffer slipEncoded;
-
-    // Find first SLIP_END, and treat the frame as starting there
-    auto it = std::find(input.begin(), input.end(), static_cast<std::uint8_t>(SLIP_END));
-    if (it != input.end())
-        slipEncoded.assign(it, input.end());
-    else
-        slipEncoded = input;
-
-    if (slipEncoded.size() < sizeof(fujibus_header) + 2)
-        return false;
-    if (slipEncoded.front() != SLIP_END || slipEncoded.back() != SLIP_END)
-        return false;
+    if (_bad || _frame.size() < sizeof(fujibus_header) || _frame.size() != _length)
+        return Result::ERROR;
 
-    ByteBuffer decoded = decodeSLIP(slipEncoded);
-
-    if (decoded.size() < sizeof(fujibus_header))
-        return false;
-
-    // Extract header from the front of decoded
-    fujibus_header *hdr;
-    hdr = (fujibus_header *) &decoded[0];
-
-    if (hdr->length != decoded.size())
-        return false;
-
-    // Verify checksum:
-    // - ck1 is the transmitted checksum
-    // - ck2 is computed with the checksum byte zeroed
-    const std::uint8_t ck1 = hdr->checksum;
-
-    hdr->checksum = 0;
-    const std::uint8_t ck2 = calcChecksum(decoded);
-
-    if (ck1 != ck2)
-        return false;
-
-    _device  = static_cast<fujiDeviceID_t>(hdr->device);
-    _command = static_cast<fujiCommandID_t>(hdr->command);
+    if (_frame[offsetof(fujibus_header, checksum)] != static_cast<std::uint8_t>(_sum))
+        return Result::ERROR;
 
     // ---- Descriptors & params ----
 
+    // First descriptor is in the header, additional descriptors follow the
+    // header whenever bit 7 is set
     std::size_t offset = sizeof(fujibus_header);
-    ByteBuffer descrBytes;
-
-    // First descriptor is in the header
-    std::uint8_t dsc = hdr->descr;
-    descrBytes.push_back(dsc);
-
-    // Additional descriptors follow the header whenever bit 7 is set
+    std::size_t descrCount = 1;
+    std::uint8_t dsc = _frame[offsetof(fujibus_header, descr)];
     while (dsc & FUJI_DESCR_ADDTL_MASK)
     {
-        if (offset >= decoded.size())
-            return false; // malformed
+        if (offset >= _frame.size())
+            return Result::ERROR; // malformed
 
-        dsc = decoded[offset++];
-        descrBytes.push_back(dsc);
+        dsc = _frame[offset++];
+        descrCount++;
     }
 
     // Now decode each descriptor into fields
-    for (std::uint8_t dbyte : descrBytes)
+    for (std::size_t didx = 0; didx < descrCount; ++didx)
     {
+        std::uint8_t dbyte = didx ? _frame[sizeof(fujibus_header) + didx - 1]
+            : _frame[offsetof(fujibus_header, descr)];
         unsigned fieldDesc  = dbyte & FUJI_DESCR_COUNT_MASK; // 0..7
         unsigned fieldCount = numFieldsTable[fieldDesc];
         if (!fieldCount)
@@ -209,84 +192,162 @@ bool FujiBusPacket::parse(const ByteBuffer& input)
 
         for (unsigned idx = 0; idx < fieldCount; ++idx)
         {
-            if (offset + fieldSize > decoded.size())
-                return false;
+            if (offset + fieldSize > _frame.size())
+                return Result::ERROR;
 
-            std::uint32_t val = read_le(decoded, offset, fieldSize);
+            std::uint32_t val = read_le(_frame, offset, fieldSize);
             _params.emplace_back(val, static_cast<std::uint8_t>(fieldSize));
             offset += fieldSize;
         }
     }
 
     // Remaining bytes (if any) are payload
-    if (offset < decoded.size())
+    _payloadOffset = offset;
+    return Result::PACKET;
+}
+
+// ------------------ Packet ------------------
+
+bool FujiBusPacket::parse(const ByteBuffer& input)
+{
+    FujiBusParser parser;
+
+    for (std::uint8_t val : input)
     {
-        _data.emplace(decoded.begin() + static_cast<std::ptrdiff_t>(offset),
-                      decoded.end());
+        switch (parser.feed(val))
+        {
+        case FujiBusParser::Result::NEED_MORE:
+            continue;
+        case FujiBusParser::Result::ERROR:
+            return false;
+        case FujiBusParser::Result::PACKET:
+            assign(parser);
+            return true;
+        }
     }
 
-    return true;
+    return false;
+}
+
+void FujiBusPacket::assign(const FujiBusParser& parser)
+{
+    _device  = parser.device();
+    _command = parser.command();
+    _params  = parser.params();
+
+    if (!parser.payloadLength())
+    {
+        _data.reset();
+        return;
+    }
+
+    if (_data)
+        _data->assign(parser.payload(), parser.payload() + parser.payloadLength());
+    else
+        _data.emplace(parser.payload(), parser.payload() + parser.payloadLength());
 }
 
 ByteBuffer FujiBusPacket::serialize() const
 {
-    fujibus_header hdr, *hptr;
+    ByteBuffer encoded;
+    serialize(encoded);
+    return encoded;
+}
 
-    hdr.device = _device;
-    hdr.command = _command;
-    hdr.length = sizeof(hdr);
-    hdr.checksum = 0;
-    hdr.descr = 0;
+void FujiBusPacket::serialize(ByteBuffer& out) const
+{
+    // Lay the raw frame out in `out`, then SLIP-escape it in place from the
+    // back so no second buffer is needed
+    out.clear();
+    out.resize(sizeof(fujibus_header));
+
+    // Params are grouped into descriptors of same-sized fields, at most
+    // MAX_BYTES_PER_DESCR bytes each
+    auto groupSize = [this](std::size_t idx, unsigned& fieldSize) {
+        unsigned count, bytesWritten;
+        for (count = fieldSize = bytesWritten = 0; count + idx < _params.size(); count++)
+        {
+            const PacketParam& param = _params[count + idx];
+            if ((fieldSize && fieldSize != param.size) || bytesWritten == MAX_BYTES_PER_DESCR)
+                break;
+            fieldSize = param.size;
+            bytesWritten += param.size;
+        }
+        return count;
+    };
 
-    ByteBuffer output(sizeof(hdr), '\0');
+    std::uint8_t firstDescr = 0;
+    unsigned count, fieldSize;
 
-    if (!_params.empty())
+    for (std::size_t idx = 0; idx < _params.size(); idx += count)
     {
-        ByteBuffer descr;
-        unsigned fieldSize, bytesWritten;
-        unsigned idx, count, val, lenParams;
-        const PacketParam *param;
+        count = groupSize(idx, fieldSize);
 
-
-        for (idx = 0, lenParams = _params.size(); idx < lenParams; idx += count)
+        std::uint8_t fieldDescr = count;
+        if (fieldSize > 1)
         {
-            for (count = fieldSize = bytesWritten = 0; count + idx < lenParams; count++)
-            {
-                param = &_params[count + idx];
-                if ((fieldSize && fieldSize != param->size) || bytesWritten == MAX_BYTES_PER_DESCR)
-                    break;
-                fieldSize = param->size;
-
-                write_le(output, param->value, param->size);
-                bytesWritten += param->size;
-            }
-
-            uint8_t fieldDescr = count;
-            if (fieldSize > 1)
-            {
-                fieldDescr += FUJI_DESCR_EXCEEDS_U8;
-                if (fieldSize > 2)
-                    fieldDescr += FUJI_DESCR_EXCEEDS_U16;
-            }
-
-            descr.push_back(fieldDescr | FUJI_DESCR_ADDTL_MASK);
+            fieldDescr += FUJI_DESCR_EXCEEDS_U8;
+            if (fieldSize > 2)
+                fieldDescr += FUJI_DESCR_EXCEEDS_U16;
         }
+        if (idx + count < _params.size())
+            fieldDescr |= FUJI_DESCR_ADDTL_MASK;
 
-        descr.back() -= FUJI_DESCR_ADDTL_MASK;
-        hdr.descr = descr[0];
-        descr.erase(descr.begin());
-        output.insert(output.begin() + sizeof(hdr), descr.begin(), descr.end());
+        if (!idx)
+            firstDescr = fieldDescr;
+        else
+            out.push_back(fieldDescr);
     }
 
+    for (const PacketParam& param : _params)
+        write_le(out, param.value, param.size);
+
     if (_data)
-        output.insert(output.end(), _data->begin(), _data->end());
+        out.insert(out.end(), _data->begin(), _data->end());
 
-    hdr.length = output.size();
-    hptr = (fujibus_header *) output.data();
-    *hptr = hdr;
-    hptr->checksum = calcChecksum(output);
-    auto encoded = encodeSLIP(output);
-    return encoded;
+    fujibus_header *hdr = (fujibus_header *) out.data();
+    hdr->device = _device;
+    hdr->command = _command;
+    hdr->length = out.size();
+    hdr->checksum = 0;
+    hdr->descr = firstDescr;
+
+    std::uint16_t chk = 0;
+    std::size_t specials = 0;
+    for (std::uint8_t val : out)
+    {
+        chk = checksum_add(chk, val);
+        if (val == SLIP_END || val == SLIP_ESCAPE)
+            specials++;
+    }
+    hdr->checksum = static_cast<std::uint8_t>(chk);
+    if (hdr->checksum == SLIP_END || hdr->checksum == SLIP_ESCAPE)
+        specials++;
+
+    std::size_t rawLen = out.size();
+    out.resize(rawLen + specials + 2);
+
+    std::size_t dst = out.size();
+    out[--dst] = SLIP_END;
+    for (std::size_t src = rawLen; src-- > 0;)
+    {
+        std::uint8_t val = out[src];
+        if (val == SLIP_END)
+        {
+            out[--dst] = SLIP_ESC_END;
+            out[--dst] = SLIP_ESCAPE;
+        }
+        else if (val == SLIP_ESCAPE)
+        {
+            out[--dst] = SLIP_ESC_ESC;
+            out[--dst] = SLIP_ESCAPE;
+        }
+        else
+        {
+            out[--dst] = val;
+        }
+    }
+    out[--dst] = SLIP_END;
 }
 
 // ------------------ Factory ------------------
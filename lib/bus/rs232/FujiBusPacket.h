@@ -20,9 +20,72 @@ enum {
     SLIP_ESC_ESC = 0xDD,
 };
 
+// Size of the fixed header at the start of every decoded frame
+#define FUJIBUS_HEADER_SIZE 6
+
 // Raw byte buffer for on-the-wire data
 using ByteBuffer = std::vector<std::uint8_t>;
 
+/*
+ * Incremental FujiBus frame parser. Bytes are fed one at a time straight
+ * from the channel; SLIP escapes are undone, the length and checksum are
+ * checked as the frame arrives, and a complete frame is exposed in place:
+ * params and payload point into the parser's own buffer, which is reused
+ * for the next frame. Nothing is allocated once the buffers have grown to
+ * the largest frame seen.
+ */
+class FujiBusParser
+{
+public:
+    enum class Result {
+        NEED_MORE,  // frame not complete yet
+        PACKET,     // a valid frame is available until the next feed()
+        ERROR,      // a frame ended but was malformed or failed its checksum
+    };
+
+    Result feed(std::uint8_t val)
+    {
+        // Fast path for plain bytes in the body of a frame; the first byte
+        // after a frame ended has to start the next one
+        if (_state == State::FRAME && !_complete && val != SLIP_END && val != SLIP_ESCAPE
+            && _frame.size() > FUJIBUS_HEADER_SIZE && _frame.size() < _length)
+        {
+            _sum += val;
+            _sum = (_sum >> 8) + (_sum & 0xFF);
+            _frame.push_back(val);
+            return Result::NEED_MORE;
+        }
+        return feedByte(val);
+    }
+    void reset();
+
+    // True once a frame start (SLIP_END) has been seen
+    bool inFrame() const { return _state != State::IDLE; }
+
+    fujiDeviceID_t device() const { return static_cast<fujiDeviceID_t>(_frame[0]); }
+    fujiCommandID_t command() const { return static_cast<fujiCommandID_t>(_frame[1]); }
+    const std::vector<PacketParam>& params() const { return _params; }
+    const std::uint8_t *payload() const { return _frame.data() + _payloadOffset; }
+    std::size_t payloadLength() const { return _frame.size() - _payloadOffset; }
+
+private:
+    enum class State { IDLE, FRAME, ESCAPE };
+
+    State _state = State::IDLE;
+    bool _complete = false;     // last frame was handed out, clear on next byte
+    bool _bad = false;          // drop the current frame when it ends
+    std::uint16_t _length = 0;  // from the header, once bytes 2-3 are in
+    std::uint16_t _sum = 0;     // running checksum, skipping the checksum byte
+    std::size_t _payloadOffset = 0;
+    ByteBuffer _frame;          // decoded frame
+    std::vector<PacketParam> _params;
+
+    Result feedByte(std::uint8_t val);
+    void startFrame();
+    void add(std::uint8_t val);
+    Result finish();
+};
+
 class FujiBusPacket
 {
 private:
@@ -31,11 +94,7 @@ private:
     std::vector<PacketParam> _params;
     std::optional<ByteBuffer> _data;   // raw payload bytes
 
-    // Internal helpers now operate on byte buffers
-    ByteBuffer decodeSLIP(const ByteBuffer& input) const;
-    ByteBuffer encodeSLIP(const ByteBuffer& input) const;
     bool parse(const ByteBuffer& input);
-    std::uint8_t calcChecksum(const ByteBuffer& buf) const;
 
     // Variadic constructor helpers for parameters
     void processArg(std::uint8_t v)  { _params.emplace_back(v); }
@@ -68,6 +127,12 @@ public:
 
     ByteBuffer serialize() const;
 
+    // SLIP-encode into `out`, reusing its storage
+    void serialize(ByteBuffer& out) const;
+
+    // Copy the frame the parser just completed, reusing this packet's storage
+    void assign(const FujiBusParser& parser);
+
     // Accessors
     fujiDeviceID_t device() const { return _device; }
     fujiCommandID_t command() const { return _command; }
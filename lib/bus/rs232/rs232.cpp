@@ -43,27 +43,27 @@ uint8_t rs232_checksum(uint8_t *buf, unsigned short len)
     return chk;
 }
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
     assert(_transaction_state == TRANS_STATE::INVALID);
     _activePacketDataPosition = 0;
     _transaction_state = expectMoreData;
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
     assert(_transaction_state == TRANS_STATE::NO_GET || _transaction_state == TRANS_STATE::DID_GET);
     sendReplyPacket(_activeDev->_devnum, true, nullptr, 0);
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
     sendReplyPacket(_activeDev->_devnum, false, nullptr, 0);
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     assert(_transaction_state == TRANS_STATE::WILL_GET);
     _transaction_state = TRANS_STATE::DID_GET;
@@ -84,7 +84,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_send(const void *data, size_t len, bool is_error)
+void systemBus::_transaction_send(const void *data, size_t len, bool is_error)
 {
     assert(_transaction_state == TRANS_STATE::NO_GET);
     sendReplyPacket(_activeDev->_devnum, !is_error, data, len);
@@ -119,25 +119,26 @@ void systemBus::_rs232_process_cmd()
     if (val < 0)
         return;
 
-    auto tempFrame = readBusPacket(val);
-    if (!tempFrame)
+    if (!readBusPacket(_rxPacket, val))
     {
         Debug_printv("packet fail");
         return;
     }
 
+    busTrace.command(_rxPacket.device(), _rxPacket.command());
+
     // Turn on the RS232 indicator LED
     fnLedManager.set(eLed::LED_BUS, true);
 
     Debug_printf("\nCF: dev:%02x cmd:%02x dlen:%d\n",
-                 tempFrame->device(), tempFrame->command(),
-                 tempFrame->data() ? tempFrame->data()->size() : -1);
+                 _rxPacket.device(), _rxPacket.command(),
+                 _rxPacket.data() ? _rxPacket.data()->size() : -1);
 
 
-    _activePacket = tempFrame.get();
+    _activePacket = &_rxPacket;
     _activeDev = nullptr;
 
-    if (tempFrame->device() == FUJI_DEVICEID_DISK && _fujiDev != nullptr
+    if (_rxPacket.device() == FUJI_DEVICEID_DISK && _fujiDev != nullptr
         && _fujiDev->boot_config)
     {
         _activeDev = &_fujiDev->bootdisk;
@@ -149,7 +150,7 @@ void systemBus::_rs232_process_cmd()
         // or go back to WAIT
         for (auto devicep : _daisyChain)
         {
-            if (tempFrame->device() == devicep->_devnum)
+            if (_rxPacket.device() == devicep->_devnum)
             {
                 _activeDev = devicep;
                 break;
@@ -158,7 +159,7 @@ void systemBus::_rs232_process_cmd()
     }
 
     if (_activeDev != nullptr)
-        _activeDev->rs232_process(*tempFrame);
+        _activeDev->rs232_process(_rxPacket);
 
     fnLedManager.set(eLed::LED_BUS, false);
 }
@@ -361,42 +362,50 @@ void systemBus::setBaudrate(int baud)
 
 std::unique_ptr<FujiBusPacket> systemBus::readBusPacket(int first)
 {
-    ByteBuffer packet;
-    int count = 0;
+    auto packet = std::make_unique<FujiBusPacket>();
+    if (!readBusPacket(*packet, first))
+        return nullptr;
+    return packet;
+}
 
-    // Define the logic once in a local lambda
-    auto processByte = [&](int val) -> bool
-    {
-        if (val < 0)
-            return false;
-        packet.push_back(static_cast<uint8_t>(val));
-        if (val == SLIP_END)
-            count++;
-        return true;
-    };
+// Feed bytes from the port straight into the parser until a frame ends
+bool systemBus::readBusPacket(FujiBusPacket &packet, int first)
+{
+    int val = first;
 
-    processByte(first);
+    _rxParser.reset();
+    if (val < 0)
+        val = _port->read();
 
-    while (count < 2)
+    for (; val >= 0; val = _port->read())
     {
-        if (!processByte(_port->read()))
-            break;
-    }
-
+        switch (_rxParser.feed(static_cast<uint8_t>(val)))
+        {
+        case FujiBusParser::Result::NEED_MORE:
+            continue;
+        case FujiBusParser::Result::ERROR:
+            Debug_printv("bad frame");
+            return false;
+        case FujiBusParser::Result::PACKET:
 #ifdef DEBUG_RAW_PACKET
-    Debug_printv("Received %d:\n%s", packet.size(),
-                 util_hexdump(packet.data(), packet.size()).c_str());
+            Debug_printv("Received payload %d:\n%s", _rxParser.payloadLength(),
+                         util_hexdump(_rxParser.payload(), _rxParser.payloadLength()).c_str());
 #endif // DEBUG_RAW_PACKET
-    return FujiBusPacket::fromSerialized(packet);
+            packet.assign(_rxParser);
+            return true;
+        }
+    }
+
+    return false;
 }
 
 void systemBus::writeBusPacket(FujiBusPacket &packet)
 {
-    ByteBuffer encoded = packet.serialize();
-    _port->write(encoded.data(), encoded.size());
+    packet.serialize(_txBuffer);
+    _port->write(_txBuffer.data(), _txBuffer.size());
 #ifdef DEBUG_RAW_PACKET
-    Debug_printv("Sent %d:\n%s", encoded.size(),
-                 util_hexdump(encoded.data(), encoded.size()).c_str());
+    Debug_printv("Sent %d:\n%s", _txBuffer.size(),
+                 util_hexdump(_txBuffer.data(), _txBuffer.size()).c_str());
 #endif // DEBUG_RAW_PACKET
     return;
 }
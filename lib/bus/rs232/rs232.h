@@ -119,6 +119,11 @@ private:
     FujiBusPacket *_activePacket;
     size_t _activePacketDataPosition;
 
+    // Reused for every frame so bus traffic doesn't allocate
+    FujiBusParser _rxParser;
+    FujiBusPacket _rxPacket;
+    ByteBuffer _txBuffer;
+
     std::forward_list<virtualDevice *> _daisyChain;
 
     int _command_frame_counter = 0;
@@ -168,14 +173,16 @@ public:
     bool shuttingDown = false;                                  // TRUE if we are in shutdown process
     bool getShuttingDown() { return shuttingDown; };
 
-    void transaction_accept(transState_t expectMoreData) override;
-    void transaction_success() override;
-    void transaction_error() override;
-    success_is_true transaction_get(void *data, size_t len) override;
-    using SystemBusBase::transaction_send;
-    void transaction_send(const void *data, size_t len, bool is_error=false) override;
+protected:
+    void _transaction_accept(transState_t expectMoreData) override;
+    void _transaction_success() override;
+    void _transaction_error() override;
+    success_is_true _transaction_get(void *data, size_t len) override;
+    void _transaction_send(const void *data, size_t len, bool is_error) override;
+public:
 
     std::unique_ptr<FujiBusPacket> readBusPacket(int first=-1);
+    bool readBusPacket(FujiBusPacket &packet, int first=-1);
     void writeBusPacket(FujiBusPacket &packet);
     void sendReplyPacket(fujiDeviceID_t source, bool ack, const void *data, size_t length);
     template<typename... Args>
@@ -1,6 +1,7 @@
 #ifdef BUILD_ATARI
 
 #include "NetSIO.h"
+#include "../BusTrace.h"
 #include "fnSystem.h"
 #include "fnWiFi.h"
 #include "../../include/debug.h"
@@ -37,8 +38,15 @@ NetSIO::NetSIO() :
     _sync_request_num(-1),
     _sync_write_size(-1),
     _errcount(0),
-    _credit(3)
-{}
+    _credit(3),
+    _txlen(0),
+    _flushing(false),
+    _cmd_time(0),
+    _ack_time(0),
+    _done_time(0)
+{
+    _txbuf[0] = NETSIO_DATA_BLOCK;
+}
 
 NetSIO::~NetSIO()
 {
@@ -145,6 +153,9 @@ void NetSIO::end()
 {
     if (_fd >= 0)
     {
+        flush_data();
+        end_transaction();
+
         uint8_t disconnect = NETSIO_DEVICE_DISCONNECT;
         send(_fd, (char *)&disconnect, 1, 0);
         closesocket(_fd);
@@ -153,6 +164,7 @@ void NetSIO::end()
         Debug_printf("### NetSIO stopped ###\n");
     }
     _initialized = false;
+    drop_data();
 }
 
 bool NetSIO::poll(int ms)
@@ -289,6 +301,9 @@ int NetSIO::handle_netsio()
     if (!resume_test())
         return 0;
 
+    // anything the device wrote goes out before we look at the next message
+    flush_data();
+
     received = recv(_fd, (char *)rxbuf, sizeof(rxbuf), 0);
     if (received > 0)
     {
@@ -334,9 +349,11 @@ int NetSIO::handle_netsio()
 
             case NETSIO_COMMAND_OFF:
                 _command_asserted = false;
+                _cmd_time = fnSystem.micros();
                 break;
 
             case NETSIO_COMMAND_ON:
+                end_transaction();
                 _command_asserted = true;
                 _sync_request_num = -1; // cancel any sync request
                 _sync_write_size = -1;
@@ -527,10 +544,72 @@ void NetSIO::flushOutput()
 {
     if (_initialized)
     {
+        flush_data();
         wait_sock_writable(500);
     }
 }
 
+/* Send data bytes collected by dataOut() as one NETSIO_DATA_BLOCK.
+   Called before any other message goes out, so ordering is kept.
+   The bytes stay queued until they are sent; false if they weren't.
+*/
+bool NetSIO::flush_data()
+{
+    // waiting for credit below runs handle_netsio(), which flushes too
+    if (_txlen == 0 || _flushing)
+        return true;
+    if (!_initialized)
+    {
+        drop_data();
+        return false;
+    }
+
+    _flushing = true;
+    bool sent = wait_for_credit(1) && write_sock(_txbuf, _txlen + 1) > 0;
+    _flushing = false;
+
+    if (sent)
+    {
+        _txlen = 0;
+        mark_response();
+        return true;
+    }
+
+    if (!_initialized)
+        drop_data(); // disconnected while waiting, there's no one to send to
+    else
+        Debug_printf("NetSIO flush_data() send failed, %u bytes kept\n", (unsigned)_txlen);
+    return false;
+}
+
+// Discard data bytes that can no longer be sent
+void NetSIO::drop_data()
+{
+    if (_txlen == 0)
+        return;
+    Debug_printf("NetSIO connection lost, %u data bytes dropped\n", (unsigned)_txlen);
+    _txlen = 0;
+}
+
+// Device sent something in response to the current command
+void NetSIO::mark_response()
+{
+    if (_cmd_time == 0)
+        return;
+
+    _done_time = fnSystem.micros();
+    if (_ack_time == 0)
+        _ack_time = _done_time;
+}
+
+// Account the finished command, if it was answered
+void NetSIO::end_transaction()
+{
+    if (_cmd_time != 0 && _ack_time != 0)
+        busTrace.link(_ack_time - _cmd_time, _done_time - _cmd_time);
+    _cmd_time = _ack_time = _done_time = 0;
+}
+
 /* Changes baud rate
 */
 void NetSIO::setBaudrate(uint32_t baud)
@@ -546,6 +625,7 @@ void NetSIO::setBaudrate(uint32_t baud)
     txbuf[2] = (baud >> 8) & 0xff;
     txbuf[3] = (baud >> 16) & 0xff;
     txbuf[4] = (baud >> 24) & 0xff;
+    flush_data();
     wait_for_credit(1);
     send(_fd, (char *)txbuf, sizeof(txbuf), 0);
     _baud = baud;
@@ -602,10 +682,8 @@ void NetSIO::handle_write_sync(uint8_t c)
 
 size_t NetSIO::dataOut(const void *buffer, size_t size)
 {
-    int result;
-    int to_send;
-    int txbytes = 0;
-    uint8_t txbuf[513];
+    size_t to_copy;
+    size_t txbytes = 0;
     uint8_t *ptr = (uint8_t *) buffer;
 
     if (!_initialized)
@@ -618,24 +696,25 @@ size_t NetSIO::dataOut(const void *buffer, size_t size)
         size--;
     }
 
+    // Queue the bytes, they go out on flushOutput(), when the buffer fills
+    // or ahead of the next message. COMPLETE, the data frame and its
+    // checksum are three writes but end up in one datagram.
     while (size)
     {
-        // send block
-        to_send = std::min(size, sizeof(txbuf) - 1);
-        txbuf[0] = NETSIO_DATA_BLOCK;
-        memcpy(txbuf+1, ptr+txbytes, to_send);
-        // ? calculate credit based on amount of data ?
-        if (!wait_for_credit(1))
-            break;
-        result = write_sock(txbuf, to_send+1);
-        if (result > 0)
+        to_copy = std::min(size, (size_t)NETSIO_TXBUF_SIZE - _txlen);
+        memcpy(_txbuf + 1 + _txlen, ptr, to_copy);
+        _txlen += to_copy;
+        ptr += to_copy;
+        size -= to_copy;
+        txbytes += to_copy;
+
+        if (_txlen == NETSIO_TXBUF_SIZE)
         {
-            result--;
-            txbytes += result;
-            size -= result;
+            // Bytes of this call still queued are lost if the flush drops them
+            size_t queued = std::min(txbytes, _txlen);
+            if (!flush_data())
+                return _txlen == 0 ? txbytes - queued : txbytes;
         }
-        else if (result < 0)
-            break;
     }
     return txbytes;
 }
@@ -680,8 +759,11 @@ ssize_t NetSIO::sendSyncResponse(uint8_t response_type, uint8_t ack_byte,
     _sync_request_num = -1;
     _sync_write_size = -1;
 
+    flush_data();
     wait_for_credit(1);
     ssize_t result = write_sock(txbuf, sizeof(txbuf));
+    if (result > 0 && response_type != NETSIO_EMPTY_SYNC)
+        mark_response();
     return (result > 0 && response_type != NETSIO_EMPTY_SYNC) ? 1 : 0; // amount of data bytes written
 }
 
@@ -692,6 +774,7 @@ void NetSIO::busIdle(uint16_t ms)
     cmd[1] = ms & 0xff;
     cmd[2] = (ms >> 8) & 0xff;
 
+    flush_data();
     wait_for_credit(1);
     write_sock(cmd, sizeof(cmd));
 }
@@ -709,6 +792,7 @@ void NetSIO::setProceed(bool level)
     Debug_print(level ? "_" : "-");
     last_level = new_level;
 
+    flush_data();
     wait_for_credit(1);
     uint8_t cmd = level ? NETSIO_PROCEED_ON : NETSIO_PROCEED_OFF;
     write_sock(&cmd, 1);
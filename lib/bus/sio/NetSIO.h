@@ -45,6 +45,11 @@
 
 #define NETSIO_PORT             9997
 
+// Data bytes written by the device are collected and sent as one
+// NETSIO_DATA_BLOCK (COMPLETE + data frame + checksum in a single datagram)
+#define NETSIO_TXBUF_SIZE       512
+
+
 class NetSIO : public IOChannel
 {
 private:
@@ -71,7 +76,22 @@ private:
     // flow control
     int _credit;
 
+    // pending outbound data, _txbuf[0] is the NETSIO_DATA_BLOCK message id
+    uint8_t _txbuf[NETSIO_TXBUF_SIZE + 1];
+    size_t _txlen;
+    bool _flushing;
+
+    // transaction latency: command frame end -> first response -> last
+    // response, recorded in busTrace (see BusTrace.h)
+    uint64_t _cmd_time;
+    uint64_t _ack_time;
+    uint64_t _done_time;
+
     void handle_write_sync(uint8_t c);
+    bool flush_data();
+    void drop_data();
+    void mark_response();
+    void end_transaction();
 
 protected:
     void suspend(int ms=5000);
@@ -96,7 +96,7 @@ void systemBus::_sio_error()
    len = length of buffer
    err = along with data, send ERROR status to Atari rather than COMPLETE
 */
-void systemBus::transaction_send(const void *data, size_t len, bool is_error)
+void systemBus::_transaction_send(const void *data, size_t len, bool is_error)
 {
     assert(_transaction_state == TRANS_STATE::NO_GET);
 
@@ -132,7 +132,7 @@ void systemBus::transaction_send(const void *data, size_t len, bool is_error)
    len = length
    Returns TRUE on success, FALSE on error
 */
-success_is_true systemBus::transaction_get(void *data, size_t len)
+success_is_true systemBus::_transaction_get(void *data, size_t len)
 {
     // Retrieve data frame from computer
     Debug_printf("<-SIO read %hu bytes\n", len);
@@ -147,7 +147,7 @@ success_is_true systemBus::transaction_get(void *data, size_t len)
     RETURN_SUCCESS_AS_TRUE();
 }
 
-void systemBus::transaction_accept(transState_t expectMoreData)
+void systemBus::_transaction_accept(transState_t expectMoreData)
 {
     assert(_transaction_state == TRANS_STATE::INVALID);
     _transaction_state = expectMoreData;
@@ -158,14 +158,14 @@ void systemBus::transaction_accept(transState_t expectMoreData)
         _sio_ack();
 }
 
-void systemBus::transaction_success()
+void systemBus::_transaction_success()
 {
     assert(_transaction_state == TRANS_STATE::NO_GET || _transaction_state == TRANS_STATE::DID_GET);
     _sio_complete();
     _transaction_state = TRANS_STATE::INVALID;
 }
 
-void systemBus::transaction_error()
+void systemBus::_transaction_error()
 {
     // Not yet ACKed -> the command itself was invalid: NAK.  Already
     // ACKed -> failure during/after processing: ERROR ('E' -> 144).
@@ -248,6 +248,7 @@ void systemBus::_sio_process_cmd()
     uint8_t ck = sio_checksum((uint8_t *)&tmpFrame.frame.commanddata, sizeof(tmpFrame.frame.commanddata)); // Calculate Checksum
     if (ck == tmpFrame.frame.checksum)
     {
+        busTrace.command(tmpFrame.device(), tmpFrame.command());
         _activeFrame = &tmpFrame;
 #ifndef ESP_PLATFORM
         // reset counter if checksum was correct
@@ -6,8 +6,11 @@
 #include <string.h>
 
 #include "lz4.h"
+#include "lz4hc.h"
 #include "../../include/debug.h"
 
+#include "fnSystem.h"
+
 #include "media.h"
 #include "utils.h"
 
@@ -21,6 +24,8 @@ lynxDisk::lynxDisk()
 // Destructor
 lynxDisk::~lynxDisk()
 {
+    clear_block_cache();
+
     if (_media != nullptr)
     {
         delete _media;
@@ -52,6 +57,7 @@ mediatype_t lynxDisk::mount(FILE *f, const char *filename, uint32_t disksize,
         delete _media;
         _media = nullptr;
     }
+    clear_block_cache();
 
     // Determine MediaType based on filename extension
     if (disk_type == MEDIATYPE_UNKNOWN && filename != nullptr)
@@ -63,6 +69,7 @@ mediatype_t lynxDisk::mount(FILE *f, const char *filename, uint32_t disksize,
         _media = new MediaTypeROM();
         mt = _media->mount(f, disksize);
         device_active = true;
+        prefill_block_cache();
         break;
     default:
         device_active = false;
@@ -81,6 +88,90 @@ void lynxDisk::unmount()
         _media->unmount();
         device_active = false;
     }
+    clear_block_cache();
+}
+
+void lynxDisk::clear_block_cache()
+{
+    if (_cache_hits || _cache_misses)
+        Debug_printf("lynxdisk cache - hits: %lu, misses: %lu, compress time: %llu us\n",
+                     (unsigned long)_cache_hits, (unsigned long)_cache_misses,
+                     (unsigned long long)_cache_compress_us);
+
+    _block_cache.clear();
+    _block_cache.shrink_to_fit();
+    _cache_hits = 0;
+    _cache_misses = 0;
+    _cache_compress_us = 0;
+}
+
+/**
+ * Read a block from media and store it in the cache in the form it is sent
+ * on the bus. LZ4-HC is used when hc_level > 0, otherwise fast LZ4.
+ * Returns false if the block couldn't be read.
+ */
+bool lynxDisk::compress_block(uint32_t block, int hc_level)
+{
+    uint8_t compressed_block[MEDIA_BLOCK_SIZE*2];           // compressed data may be larger than blocksize
+
+    if (_media->read(block, nullptr))           // returns TRUE if error occurred
+        return false;
+
+    uint64_t start = fnSystem.micros();
+
+    // Try compressing the block
+    // using LZ4 for now, since Fujinet already supplied it
+    // first byte sent is the compression type field, followed by data, up to 1024 bytes
+    int c_size;
+    if (hc_level > 0)
+        c_size = LZ4_compress_HC((const char *) _media->_media_blockbuff, (char *) &compressed_block[1],
+                                 MEDIA_BLOCK_SIZE, MEDIA_BLOCK_SIZE, hc_level);
+    else
+        c_size = LZ4_compress_default((const char *) _media->_media_blockbuff, (char *) &compressed_block[1],
+                                      MEDIA_BLOCK_SIZE, MEDIA_BLOCK_SIZE);
+
+    lynx_cached_block_t &cached = _block_cache[block];
+    if ((c_size <= BLOCK_COMPRESS_CUTOFF) && (c_size > 0)) {
+        compressed_block[0] = BLOCK_LZ4;
+        cached.assign(compressed_block, compressed_block + c_size + 1);
+    }
+    else {
+        cached.resize(MEDIA_BLOCK_SIZE + 1);
+        cached[0] = BLOCK_RAW;
+        memcpy(&cached[1], _media->_media_blockbuff, MEDIA_BLOCK_SIZE);
+    }
+
+    _cache_compress_us += fnSystem.micros() - start;
+    return true;
+}
+
+// Size the cache for the mounted image, optionally compressing every block up front
+void lynxDisk::prefill_block_cache()
+{
+    if (_media == nullptr)
+        return;
+
+    _block_cache.resize(_media->num_blocks());
+
+    if (LYNX_DISK_CACHE_HC_LEVEL <= 0)
+        return;
+
+    uint64_t start = fnSystem.micros();
+    uint32_t cached_bytes = 0;
+
+    for (uint32_t b = 0; b < _media->num_blocks(); b++)
+    {
+        if (!compress_block(b, LYNX_DISK_CACHE_HC_LEVEL))
+            break;
+        cached_bytes += _block_cache[b].size();
+    }
+
+    // Leave the media positioned as if freshly mounted
+    _media->_media_last_block = INVALID_SECTOR_VALUE - 1;
+
+    Debug_printf("lynxdisk::prefill_block_cache - %lu blocks, %lu bytes cached in %llu us\n",
+                 (unsigned long)_media->num_blocks(), (unsigned long)cached_bytes,
+                 (unsigned long long)(fnSystem.micros() - start));
 }
 
 error_is_true lynxDisk::write_blank(FILE *fileh, uint32_t numBlocks)
@@ -100,42 +191,37 @@ error_is_true lynxDisk::write_blank(FILE *fileh, uint32_t numBlocks)
 
 void lynxDisk::read_block(uint32_t block)
 {
-    uint8_t compressed_block[MEDIA_BLOCK_SIZE*2];           // compressed data may be larger than blocksize
-    uint8_t compression_type;
-
     if (_media == nullptr) {
         Debug_println("lynxdisk::read_block - _media is null");
         SYSTEM_BUS.transaction_error();
         return;
     }
 
-    blockNum = block;       // save the block (caching?)
+    blockNum = block;
 
-    // Read the block
     Debug_printf("lynxdisk::read_block - block: %lu\n", block);
-    if (_media->read(block, nullptr)) {         // returns TRUE if error occurred
-        Debug_println("lynxdisk::read_block - media->read returned false");
+
+    if (block >= _block_cache.size()) {
+        Debug_printf("lynxdisk::read_block - block %lu out of range\n", block);
         SYSTEM_BUS.transaction_error();
+        return;
     }
 
-    // Try compressing the block
-    // using LZ4 for now, since Fujinet already supplied it
-    // first byte sent is the compression type field, followed by data, up to 1024 bytes
-    //
-    // LZ4LIB_API int LZ4_compress_default(const char* src, char* dst, int srcSize, int dstCapacity);
-    int c_size = LZ4_compress_default((const char *) _media->_media_blockbuff, (char *) &compressed_block[1], 1024, 1024);
-
-    if ((c_size <= BLOCK_COMPRESS_CUTOFF) && (c_size > 0)) {
-        Debug_printf("lynxdisk::read_block - sending compressed LZ4, size:%d\n", c_size);
-        compressed_block[0] = BLOCK_LZ4;
-        SYSTEM_BUS.transaction_send(compressed_block, c_size+1);
-    }
+    // Blocks are compressed once and then served from the cache
+    if (!_block_cache[block].empty())
+        _cache_hits++;
+    else if (compress_block(block, 0))
+        _cache_misses++;
     else {
-        Debug_printf("lynxdisk::read_block - sending raw 1024 bytes, compressed size was: %d\n", c_size);
-        compressed_block[0] = BLOCK_RAW;
-        memcpy(&compressed_block[1], _media->_media_blockbuff, MEDIA_BLOCK_SIZE);
-        SYSTEM_BUS.transaction_send(&compressed_block, MEDIA_BLOCK_SIZE+1);
+        Debug_println("lynxdisk::read_block - media->read returned error");
+        SYSTEM_BUS.transaction_error();
+        return;
     }
+
+    const lynx_cached_block_t &cached = _block_cache[block];
+    Debug_printf("lynxdisk::read_block - sending %s, size:%u\n",
+                 cached[0] == BLOCK_LZ4 ? "compressed LZ4" : "raw", (unsigned)cached.size() - 1);
+    SYSTEM_BUS.transaction_send(cached.data(), cached.size());
 }
 
 void lynxDisk::write_block(uint32_t block)
@@ -152,6 +238,9 @@ void lynxDisk::write_block(uint32_t block)
 
     Debug_printf("lynxdisk::write_block - block:%ld written\n", block);
 
+    if (block < _block_cache.size())
+        _block_cache[block].clear();
+
     blockNum = 0xFFFFFFFF;
     _media->_media_last_block = 0xFFFFFFFE;
 
@@ -1,11 +1,17 @@
 #ifndef LYNX_DISK_H
 #define LYNX_DISK_H
 
+#include <vector>
+
 #include "../disk.h"
 #include "bus.h"
 #include "global_types.h"
 #include "media.h"
 
+#ifdef ESP_PLATFORM
+#include "../../include/PSRAMAllocator.h"
+#endif
+
 typedef enum
 {
 	BLOCK_RAW = 0,
@@ -15,6 +21,21 @@ typedef enum
 
 #define BLOCK_COMPRESS_CUTOFF   950
 
+// Compression level used by the mount-time cache pre-pass. 0 disables the
+// pre-pass and blocks are compressed with fast LZ4 on first read instead;
+// a non-zero value pre-compresses the whole image with LZ4-HC at that level.
+#ifndef LYNX_DISK_CACHE_HC_LEVEL
+#define LYNX_DISK_CACHE_HC_LEVEL 0
+#endif
+
+// Block as it is sent on the bus: compression type byte followed by payload.
+// An empty vector means the block has not been compressed yet.
+#ifdef ESP_PLATFORM
+typedef std::vector<uint8_t, PSRAMAllocator<uint8_t>> lynx_cached_block_t;
+#else
+typedef std::vector<uint8_t> lynx_cached_block_t;
+#endif
+
 
 class lynxDisk : public virtualDevice
 {
@@ -22,11 +43,21 @@ private:
     MediaType *_media = nullptr;
   
     unsigned long blockNum=INVALID_SECTOR_VALUE;
-    
+
+    // Compressed blocks of the mounted image, indexed by block number
+    std::vector<lynx_cached_block_t> _block_cache;
+    uint32_t _cache_hits = 0;
+    uint32_t _cache_misses = 0;
+    uint64_t _cache_compress_us = 0;
+
     void comlynx_process(const FujiLynxPacket &packet) override;
     void read_block(uint32_t block);
     void write_block(uint32_t block);
 
+    bool compress_block(uint32_t block, int hc_level);
+    void prefill_block_cache();
+    void clear_block_cache();
+
 public:
     lynxDisk();
     mediatype_t mount(FILE *f, const char *filename, uint32_t disksize,
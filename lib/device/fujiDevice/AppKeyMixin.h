@@ -25,13 +25,9 @@ struct appkey
 class AppKeyMixin : public FujiDeviceMixin
 {
 private:
-    FujiMixinCommandHandlers handlers;
-
     appkey _current_appkey;
 
 protected:
-    FujiMixinCommandHandlers commandHandlers() override { return handlers; }
-
     void appkey_open(const FUJI_COMMAND_PACKET &packet);
     void appkey_close(const FUJI_COMMAND_PACKET &packet);
 
@@ -42,13 +38,13 @@ protected:
     virtual void appkey_write(const FUJI_COMMAND_PACKET &packet);
 
  public:
-    AppKeyMixin() {
-        handlers = {
-          { FUJICMD_OPEN_APPKEY,  FM_CMD_HANDLER(appkey_open)  },
-          { FUJICMD_CLOSE_APPKEY, FM_CMD_HANDLER(appkey_close) },
-          { FUJICMD_READ_APPKEY,  FM_CMD_HANDLER(appkey_read)  },
-          { FUJICMD_WRITE_APPKEY, FM_CMD_HANDLER(appkey_write) },
-        };
+    static constexpr auto commands() {
+        return std::to_array<FujiMixinCommand<AppKeyMixin>>({
+          { FUJICMD_OPEN_APPKEY,  &AppKeyMixin::appkey_open  },
+          { FUJICMD_CLOSE_APPKEY, &AppKeyMixin::appkey_close },
+          { FUJICMD_READ_APPKEY,  &AppKeyMixin::appkey_read  },
+          { FUJICMD_WRITE_APPKEY, &AppKeyMixin::appkey_write },
+        });
     }
 };
 
@@ -1,7 +1,67 @@
 #include "Base64Mixin.h"
-#include "base64.h"
 #include "debug.h"
 
+// The first INPUT after a COMPUTE, or after switching between encode and
+// decode, starts over and drops any output that wasn't read.
+void Base64Mixin::base64_begin(Base64Stream stream)
+{
+    if (_stream == stream)
+        return;
+
+    _encoder.reset();
+    _decoder.reset();
+    _output.clear();
+    _sent = 0;
+    _stream = stream;
+}
+
+bool Base64Mixin::base64_get_chunk(uint16_t len)
+{
+    if (!len)
+    {
+        Debug_printf("Invalid length. Aborting");
+        SYSTEM_BUS.transaction_error();
+        return false;
+    }
+
+    _chunk.resize(len);
+    SYSTEM_BUS.transaction_get(_chunk.data(), len);
+    return true;
+}
+
+bool Base64Mixin::base64_check_output(uint16_t len)
+{
+    size_t pending = _output.size() - _sent;
+
+    if (!len)
+    {
+        Debug_printf("Refusing to send a zero byte buffer. Aborting\n");
+        SYSTEM_BUS.transaction_error();
+        return false;
+    }
+    else if (len > pending)
+    {
+        Debug_printf("Requested %u bytes, but buffer is only %u bytes, aborting.\n", len, pending);
+        SYSTEM_BUS.transaction_error();
+        return false;
+    }
+
+    Debug_printf("Requested %u bytes\n", len);
+    return true;
+}
+
+void Base64Mixin::base64_sent(uint16_t len)
+{
+    _sent += len;
+    if (_sent == _output.size())
+    {
+        // All read: give the memory back
+        _output = std::string();
+        _chunk = std::string();
+        _sent = 0;
+    }
+}
+
 void Base64Mixin::encode_input(const FUJI_COMMAND_PACKET &packet)
 {
     uint16_t len = packet.param(0);
@@ -10,41 +70,28 @@ void Base64Mixin::encode_input(const FUJI_COMMAND_PACKET &packet)
 
     Debug_printf("Base64Mixin: enode_input\n");
 
-    if (!len)
-    {
-        Debug_printf("Invalid length. Aborting");
-        SYSTEM_BUS.transaction_error();
+    if (!base64_get_chunk(len))
         return;
-    }
 
-    std::string p(len, 0);
-    SYSTEM_BUS.transaction_get(p.data(), len);
-    base64.base64_buffer += p;
+    base64_begin(Base64Stream::ENCODING);
+    _encoder.update(_chunk.data(), _chunk.size(), _output);
     SYSTEM_BUS.transaction_success();
 }
 
 void Base64Mixin::encode_compute(const FUJI_COMMAND_PACKET &packet)
 {
-    size_t out_len;
-
     /* ACK before CPU work (matches sio_hash_compute); NetSIO/tight SIO timing
      * otherwise leaves the host waiting past dtimlo (Atari status 138 timeout). */
     SYSTEM_BUS.transaction_accept(TRANS_STATE::NO_GET);
 
     Debug_printf("Base64Mixin: ENCODE COMPUTE\n");
 
-    std::unique_ptr<char[]> p = Base64::encode(base64.base64_buffer.c_str(), base64.base64_buffer.size(), &out_len);
-    if (!p)
-    {
-        Debug_printf("base64_encode compute failed\n");
-        SYSTEM_BUS.transaction_error();
-        return;
-    }
-
-    base64.base64_buffer.clear();
-    base64.base64_buffer = std::string(p.get(), out_len);
+    // The input has already been encoded, only the last group is left
+    if (_stream == Base64Stream::ENCODING)
+        _encoder.finish(_output);
+    _stream = Base64Stream::IDLE;
 
-    Debug_printf("Resulting BASE64 encoded data is: %u bytes\n", out_len);
+    Debug_printf("Resulting BASE64 encoded data is: %u bytes\n", _output.size() - _sent);
     SYSTEM_BUS.transaction_success();
 }
 
@@ -54,7 +101,7 @@ void Base64Mixin::encode_length(const FUJI_COMMAND_PACKET &packet)
     Debug_printf("Base64Mixin: ENCODE LENGTH\n");
 
     u32ne_t len;
-    len = base64.base64_buffer.length();
+    len = _output.size() - _sent;
     Debug_printf("base64 buffer length: %u bytes\n", (size_t) len);
 
     SYSTEM_BUS.transaction_send(&len, sizeof(len), false);
@@ -67,28 +114,12 @@ void Base64Mixin::encode_output(const FUJI_COMMAND_PACKET &packet)
     SYSTEM_BUS.transaction_accept(TRANS_STATE::NO_GET);
     Debug_printf("Base64Mixin: ENCODE OUTPUT\n");
 
-    if (!len)
-    {
-        Debug_printf("Refusing to send a zero byte buffer. Aborting\n");
-        SYSTEM_BUS.transaction_error();
+    if (!base64_check_output(len))
         return;
-    }
-    else if (len > base64.base64_buffer.length())
-    {
-        Debug_printf("Requested %u bytes, but buffer is only %u bytes, aborting.\n", len, base64.base64_buffer.length());
-        SYSTEM_BUS.transaction_error();
-        return;
-    }
-    else
-    {
-        Debug_printf("Requested %u bytes\n", len);
-    }
 
-    std::string result = base64.base64_buffer.substr(0, len);
-    result = SYSTEM_BUS.unicodeTextToNative(result);
+    std::string result = SYSTEM_BUS.unicodeTextToNative(_output.substr(_sent, len));
     SYSTEM_BUS.transaction_send(result);
-    base64.base64_buffer.erase(0, len);
-    base64.base64_buffer.shrink_to_fit();
+    base64_sent(len);
 }
 
 void Base64Mixin::decode_input(const FUJI_COMMAND_PACKET &packet)
@@ -99,40 +130,40 @@ void Base64Mixin::decode_input(const FUJI_COMMAND_PACKET &packet)
 
     Debug_printf("Base64Mixin: DECODE INPUT\n");
 
-    if (!len)
-    {
-        Debug_printf("Invalid length. Aborting");
-        SYSTEM_BUS.transaction_error();
+    if (!base64_get_chunk(len))
         return;
-    }
 
-    std::string p(len, 0);
-    SYSTEM_BUS.transaction_get(p.data(), p.size());
-    p = SYSTEM_BUS.nativeTextToUnicode(p);
-    base64.base64_buffer += p;
+    std::string p = SYSTEM_BUS.nativeTextToUnicode(_chunk);
+    base64_begin(Base64Stream::DECODING);
+    _decoder.update(p.data(), p.size(), _output);
     SYSTEM_BUS.transaction_success();
 }
 
 void Base64Mixin::decode_compute(const FUJI_COMMAND_PACKET &packet)
 {
-    size_t out_len;
-
     SYSTEM_BUS.transaction_accept(TRANS_STATE::NO_GET);
 
     Debug_printf("Base64Mixin: DECODE COMPUTE\n");
 
-    std::unique_ptr<unsigned char[]> p = Base64::decode(base64.base64_buffer.c_str(), base64.base64_buffer.size(), &out_len);
-    if (!p)
+    if (_stream != Base64Stream::DECODING)
     {
-        Debug_printf("base64_encode compute failed\n");
+        Debug_printf("Nothing to decode\n");
         SYSTEM_BUS.transaction_error();
         return;
     }
 
-    base64.base64_buffer.clear();
-    base64.base64_buffer = std::string((const char *)p.get(), out_len);
+    bool ok = _decoder.finish(_output);
+    _stream = Base64Stream::IDLE;
+    if (!ok)
+    {
+        Debug_printf("base64_decode compute failed\n");
+        _output.clear();
+        _sent = 0;
+        SYSTEM_BUS.transaction_error();
+        return;
+    }
 
-    Debug_printf("Resulting BASE64 encoded data is: %u bytes\n", out_len);
+    Debug_printf("Resulting BASE64 decoded data is: %u bytes\n", _output.size() - _sent);
     SYSTEM_BUS.transaction_success();
 }
 
@@ -142,7 +173,7 @@ void Base64Mixin::decode_length(const FUJI_COMMAND_PACKET &packet)
     Debug_printf("Base64Mixin: DECODE LENGTH\n");
 
     u32ne_t len;
-    len = base64.base64_buffer.length();
+    len = _output.size() - _sent;
     Debug_printf("base64 buffer length: %u bytes\n", (size_t) len);
 
     SYSTEM_BUS.transaction_send(&len, sizeof(len), false);
@@ -155,26 +186,9 @@ void Base64Mixin::decode_output(const FUJI_COMMAND_PACKET &packet)
     SYSTEM_BUS.transaction_accept(TRANS_STATE::NO_GET);
     Debug_printf("Base64Mixin: DECODE OUTPUT\n");
 
-    if (!len)
-    {
-        Debug_printf("Refusing to send a zero byte buffer. Aborting\n");
-        SYSTEM_BUS.transaction_error();
+    if (!base64_check_output(len))
         return;
-    }
-    else if (len > base64.base64_buffer.length())
-    {
-        Debug_printf("Requested %u bytes, but buffer is only %u bytes, aborting.\n", len, base64.base64_buffer.length());
-        SYSTEM_BUS.transaction_error();
-        return;
-    }
-    else
-    {
-        Debug_printf("Requested %u bytes\n", len);
-    }
 
-    std::vector<unsigned char> p(len);
-    memcpy(p.data(), base64.base64_buffer.data(), len);
-    base64.base64_buffer.erase(0, len);
-    base64.base64_buffer.shrink_to_fit();
-    SYSTEM_BUS.transaction_send(p.data(), len, false);
+    SYSTEM_BUS.transaction_send(_output.data() + _sent, len, false);
+    base64_sent(len);
 }
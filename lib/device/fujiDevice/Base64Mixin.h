@@ -2,15 +2,28 @@
 #define BASE64MIXIN_H
 
 #include "FujiDeviceMixin.h"
+#include "base64.h"
 
+// INPUT chunks go through the encoder or decoder as they arrive, so only
+// the output is held, and OUTPUT sends it from a read offset.
 class Base64Mixin : public FujiDeviceMixin
 {
 private:
-    FujiMixinCommandHandlers handlers;
+    enum class Base64Stream { IDLE, ENCODING, DECODING };
 
-protected:
-    FujiMixinCommandHandlers commandHandlers() override { return handlers; }
+    Base64Stream _stream = Base64Stream::IDLE;
+    Base64Encoder _encoder;
+    Base64Decoder _decoder;
+    std::string _chunk;         // one INPUT's data, reused
+    std::string _output;        // produced, not yet sent from _sent on
+    size_t _sent = 0;
+
+    void base64_begin(Base64Stream stream);
+    bool base64_get_chunk(uint16_t len);
+    bool base64_check_output(uint16_t len);
+    void base64_sent(uint16_t len);
 
+protected:
     void encode_input(const FUJI_COMMAND_PACKET &packet);
     void encode_compute(const FUJI_COMMAND_PACKET &packet);
     void encode_length(const FUJI_COMMAND_PACKET &packet);
@@ -21,17 +34,17 @@ protected:
     void decode_output(const FUJI_COMMAND_PACKET &packet);
 
 public:
-    Base64Mixin() {
-        handlers = {
-            { FUJICMD_BASE64_ENCODE_INPUT,   FM_CMD_HANDLER(encode_input)   },
-            { FUJICMD_BASE64_ENCODE_COMPUTE, FM_CMD_HANDLER(encode_compute) },
-            { FUJICMD_BASE64_ENCODE_LENGTH,  FM_CMD_HANDLER(encode_length)  },
-            { FUJICMD_BASE64_ENCODE_OUTPUT,  FM_CMD_HANDLER(encode_output)  },
-            { FUJICMD_BASE64_DECODE_INPUT,   FM_CMD_HANDLER(decode_input)   },
-            { FUJICMD_BASE64_DECODE_COMPUTE, FM_CMD_HANDLER(decode_compute) },
-            { FUJICMD_BASE64_DECODE_LENGTH,  FM_CMD_HANDLER(decode_length)  },
-            { FUJICMD_BASE64_DECODE_OUTPUT,  FM_CMD_HANDLER(decode_output)  },
-        };
+    static constexpr auto commands() {
+        return std::to_array<FujiMixinCommand<Base64Mixin>>({
+            { FUJICMD_BASE64_ENCODE_INPUT,   &Base64Mixin::encode_input   },
+            { FUJICMD_BASE64_ENCODE_COMPUTE, &Base64Mixin::encode_compute },
+            { FUJICMD_BASE64_ENCODE_LENGTH,  &Base64Mixin::encode_length  },
+            { FUJICMD_BASE64_ENCODE_OUTPUT,  &Base64Mixin::encode_output  },
+            { FUJICMD_BASE64_DECODE_INPUT,   &Base64Mixin::decode_input   },
+            { FUJICMD_BASE64_DECODE_COMPUTE, &Base64Mixin::decode_compute },
+            { FUJICMD_BASE64_DECODE_LENGTH,  &Base64Mixin::decode_length  },
+            { FUJICMD_BASE64_DECODE_OUTPUT,  &Base64Mixin::decode_output  },
+        });
     }
 };
 
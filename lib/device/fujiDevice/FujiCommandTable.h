@@ -0,0 +1,75 @@
+#ifndef FUJICOMMANDTABLE_H
+#define FUJICOMMANDTABLE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/*
+ * Compile-time command dispatch for the fujiDevice mixins
+ *
+ * Each mixin lists the commands it handles in a static constexpr
+ * commands() function. FujiDeviceChain merges those lists into one
+ * 256-entry table at compile time, so finding a command's handler is a
+ * single array index with no allocation. Two mixins claiming the same
+ * command is caught at compile time.
+ *
+ * The table holds plain function pointers to small thunks that call the
+ * mixin's member function. A table of the owner's member function pointers
+ * would need a base-to-derived conversion, which GCC won't do in a constant
+ * expression.
+ *
+ * Nothing here depends on the bus, so the table can be built for any
+ * packet type.
+ */
+
+template <typename Mixin, typename Packet>
+struct FujiCommand
+{
+    uint8_t command;
+    void (Mixin::*handler)(const Packet &);
+};
+
+template <typename Owner, typename Packet>
+struct FujiCommandTable
+{
+    using Handler = void (*)(Owner &, const Packet &);
+
+    std::array<Handler, 256> handlers{};
+    bool duplicate = false;     // some command was listed twice
+
+    constexpr Handler operator[](uint8_t command) const { return handlers[command]; }
+};
+
+namespace fuji_command_table
+{
+
+template <typename Owner, typename Packet, typename Mixin, size_t Index>
+void call(Owner &owner, const Packet &packet)
+{
+    constexpr auto handler = Mixin::commands()[Index].handler;
+    (static_cast<Mixin &>(owner).*handler)(packet);
+}
+
+template <typename Owner, typename Packet, typename Mixin, size_t... Index>
+constexpr void add(FujiCommandTable<Owner, Packet> &table, std::index_sequence<Index...>)
+{
+    constexpr auto commands = Mixin::commands();
+    ((table.duplicate |= table.handlers[commands[Index].command] != nullptr,
+      table.handlers[commands[Index].command] = &call<Owner, Packet, Mixin, Index>), ...);
+}
+
+} // namespace fuji_command_table
+
+// Owner must derive from each of Mixins
+template <typename Owner, typename Packet, typename... Mixins>
+constexpr FujiCommandTable<Owner, Packet> makeFujiCommandTable()
+{
+    FujiCommandTable<Owner, Packet> table;
+    (fuji_command_table::add<Owner, Packet, Mixins>(
+         table, std::make_index_sequence<Mixins::commands().size()>()), ...);
+    return table;
+}
+
+#endif /* FUJICOMMANDTABLE_H */
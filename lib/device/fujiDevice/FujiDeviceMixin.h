@@ -3,38 +3,25 @@
 
 #include "bus.h"
 #include "fujiCommandID.h"
-
-#include <unordered_map>
-
-class FujiDeviceMixin;
-using FujiMixinCommandHandlers = std::unordered_map<
-    fujiCommandID_t,
-    void (FujiDeviceMixin::*)(const FUJI_COMMAND_PACKET&)
-    >;
-
-#define FM_CMD_HANDLER(Method) \
-    static_cast<void (FujiDeviceMixin::*)(const FUJI_COMMAND_PACKET&)>(&std::remove_pointer_t<decltype(this)>::Method)
-
+#include "FujiCommandTable.h"
+
+// A mixin lists its commands as
+//
+//   static constexpr auto commands() {
+//       return std::to_array<FujiMixinCommand<MyMixin>>({
+//           { FUJICMD_..., &MyMixin::handler },
+//       });
+//   }
+//
+// and FujiDeviceChain (fujiDevice.h) dispatches to them.
+template <typename Mixin>
+using FujiMixinCommand = FujiCommand<Mixin, FUJI_COMMAND_PACKET>;
 
 class FujiDeviceMixin : public virtual virtualDevice
 {
-protected:
-    virtual FujiMixinCommandHandlers commandHandlers() = 0;
-
 public:
-    bool recognizesCommand(const FUJI_COMMAND_PACKET &packet) {
-        auto handlers = commandHandlers();
-        return handlers.find(packet.command()) != handlers.end();
-    }
-    virtual bool processCommand(const FUJI_COMMAND_PACKET &packet) {
-        auto handlers = commandHandlers();
-        auto cmdHandler = handlers.find(packet.command());
-        if (cmdHandler == handlers.end())
-            return false;
-        auto cmdMethod = cmdHandler->second;
-        (this->*cmdMethod)(packet);
-        return true;
-    }
+    // Implemented once for all the mixins by FujiDeviceChain
+    virtual bool processCommand(const FUJI_COMMAND_PACKET &packet) = 0;
 };
 
 #endif /* FUJIDEVICEMIXIN_H */
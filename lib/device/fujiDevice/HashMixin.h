@@ -6,15 +6,9 @@
 
 class HashMixin : public FujiDeviceMixin
 {
-private:
-    FujiMixinCommandHandlers handlers = {
-    };
-
 protected:
     Hash::Algorithm _algorithm = Hash::Algorithm::UNKNOWN;
 
-    FujiMixinCommandHandlers commandHandlers() override { return handlers; }
-
     void hash_input(const FUJI_COMMAND_PACKET &packet);
     void hash_compute(const FUJI_COMMAND_PACKET &packet);
     void hash_length(const FUJI_COMMAND_PACKET &packet);
@@ -22,15 +16,15 @@ protected:
     void hash_clear(const FUJI_COMMAND_PACKET &packet);
 
 public:
-    HashMixin() {
-        handlers = {
-            { FUJICMD_HASH_INPUT,            FM_CMD_HANDLER(hash_input)   },
-            { FUJICMD_HASH_COMPUTE,          FM_CMD_HANDLER(hash_compute) },
-            { FUJICMD_HASH_COMPUTE_NO_CLEAR, FM_CMD_HANDLER(hash_compute) },
-            { FUJICMD_HASH_LENGTH,           FM_CMD_HANDLER(hash_length)  },
-            { FUJICMD_HASH_OUTPUT,           FM_CMD_HANDLER(hash_output)  },
-            { FUJICMD_HASH_CLEAR,            FM_CMD_HANDLER(hash_clear)   },
-        };
+    static constexpr auto commands() {
+        return std::to_array<FujiMixinCommand<HashMixin>>({
+            { FUJICMD_HASH_INPUT,            &HashMixin::hash_input   },
+            { FUJICMD_HASH_COMPUTE,          &HashMixin::hash_compute },
+            { FUJICMD_HASH_COMPUTE_NO_CLEAR, &HashMixin::hash_compute },
+            { FUJICMD_HASH_LENGTH,           &HashMixin::hash_length  },
+            { FUJICMD_HASH_OUTPUT,           &HashMixin::hash_output  },
+            { FUJICMD_HASH_CLEAR,            &HashMixin::hash_clear   },
+        });
     }
 };
 
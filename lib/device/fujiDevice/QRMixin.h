@@ -6,13 +6,7 @@
 
 class QRMixin : public FujiDeviceMixin
 {
-private:
-    FujiMixinCommandHandlers handlers = {
-    };
-
 protected:
-    FujiMixinCommandHandlers commandHandlers() override { return handlers; }
-
     void qr_input(const FUJI_COMMAND_PACKET &packet);
     void qr_length(const FUJI_COMMAND_PACKET &packet);
     void qr_output(const FUJI_COMMAND_PACKET &packet);
@@ -25,17 +19,17 @@ protected:
     }
 
 public:
-    QRMixin() {
-        handlers = {
-            { FUJICMD_QRCODE_INPUT,  FM_CMD_HANDLER(qr_input)  },
-            { FUJICMD_QRCODE_ENCODE, FM_CMD_HANDLER(qr_encode) },
-            { FUJICMD_QRCODE_LENGTH, FM_CMD_HANDLER(qr_length) },
-            { FUJICMD_QRCODE_OUTPUT, FM_CMD_HANDLER(qr_output) },
+    static constexpr auto commands() {
+        return std::to_array<FujiMixinCommand<QRMixin>>({
+            { FUJICMD_QRCODE_INPUT,  &QRMixin::qr_input  },
+            { FUJICMD_QRCODE_ENCODE, &QRMixin::qr_encode },
+            { FUJICMD_QRCODE_LENGTH, &QRMixin::qr_length },
+            { FUJICMD_QRCODE_OUTPUT, &QRMixin::qr_output },
 #if 0
             // FIXME - this is missing
-            { FUJICMD_QRCODE_CLEAR,  FM_CMD_HANDLER(qr_clear)  },
+            { FUJICMD_QRCODE_CLEAR,  &QRMixin::qr_clear  },
 #endif
-        };
+        });
     }
 };
 
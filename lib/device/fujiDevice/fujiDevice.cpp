@@ -741,7 +741,11 @@ void fujiDevice::fujicmd_close_directory()
  * PageGroup structure:
  * Byte  0    : Flags
  *              - Bit 7: Last group (1=yes, 0=no)
- *              - Bits 6-0: Reserved
+ *              - Bit 6: Partial listing (1=yes, 0=no): the directory was still
+ *                       being read from the server, so its entries are in server
+ *                       order. Poll by reading from position 0 again; once the
+ *                       bit is clear, the listing is complete and sorted.
+ *              - Bits 5-0: Reserved
  * Byte  1    : Number of directory entries in this group
  * Bytes 2-3  : Group data size (16-bit little-endian, excluding header)
  * Byte  4    : Group index (0-based, calculated as dir_pos/group_size)
@@ -818,6 +822,8 @@ void fujiDevice::fujicmd_read_directory_block(uint8_t num_pages, uint8_t group_s
             group.is_last_group = true;
         }
 
+        group.is_partial = _fnHosts[_current_open_directory_slot].dir_partial();
+
         // this sets all the data for the group up correctly for us to insert into the block
         group.finalize();
 
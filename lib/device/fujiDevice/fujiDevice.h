@@ -113,24 +113,38 @@ concept FujiPacketLike = requires(T p) {
 static_assert(FujiPacketLike<FUJI_COMMAND_PACKET>,
               "FUJI_COMMAND_PACKET must satisfy FujiPacketLike");
 
-// This class inherits from all the mixins you list and tries each one in order
+// This class inherits from all the mixins you list and dispatches each
+// command to the mixin that handles it, through a table built at compile
+// time from their commands() lists (see FujiCommandTable.h)
 template<typename... FujiDeviceMixins>
 requires FujiPacketLike<FUJI_COMMAND_PACKET>
 class FujiDeviceChain : public FujiDeviceMixins...
 {
+ private:
+    using CommandTable = FujiCommandTable<FujiDeviceChain, FUJI_COMMAND_PACKET>;
+
+    static const CommandTable &commandTable() {
+        static constexpr CommandTable table =
+            makeFujiCommandTable<FujiDeviceChain, FUJI_COMMAND_PACKET, FujiDeviceMixins...>();
+        static_assert(!table.duplicate, "two mixins handle the same command");
+        return table;
+    }
+
  protected:
     bool tryAllMixins(const FUJI_COMMAND_PACKET &packet) {
-        // Try each mixin's processCommand() until one returns true
-        return (FujiDeviceMixins::processCommand(packet) || ...);
+        auto handler = commandTable()[packet.command()];
+        if (handler == nullptr)
+            return false;
+        handler(*this, packet);
+        return true;
     }
     bool checkAllMixins(const FUJI_COMMAND_PACKET &packet) {
-        // Try each mixin's processCommand() until one returns true
-        return (FujiDeviceMixins::recognizesCommand(packet) || ...);
+        return commandTable()[packet.command()] != nullptr;
     }
 
  public:
     bool processCommand(const FUJI_COMMAND_PACKET &packet) override {
-        return (FujiDeviceMixins::processCommand(packet) || ...);
+        return tryAllMixins(packet);
     }
 };
 
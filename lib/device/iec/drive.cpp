@@ -14,6 +14,16 @@ using namespace std;
 // To be safe, BUFFER_SIZE should always be >=256
 #define BUFFER_SIZE 512
 
+// Number of buffers read ahead from file streams by a background task while
+// the current buffer is sent out on the bus (0 disables read-ahead). Streams
+// no larger than a single buffer are always read synchronously.
+#ifndef IEC_PREFETCH_DEPTH
+#define IEC_PREFETCH_DEPTH 2
+#endif
+#define IEC_PREFETCH_STACKSIZE 8192
+#define IEC_PREFETCH_PRIORITY  5
+#define IEC_PREFETCH_CPUAFFINITY 0
+
 
 #define ST_OK                  0
 #define ST_SCRATCHED           1
@@ -151,6 +161,18 @@ iecChannelHandlerFile::iecChannelHandlerFile(iecDrive *drive, MStream *stream, i
   m_timeStart = esp_timer_get_time();
   m_byteCount = 0;
   m_transportTimeUS = 0;
+
+  m_ownData = m_data;
+  m_prefetching = false;
+  m_prefetchEOS = false;
+  m_prefetchStop = false;
+  m_prefetchSlot = -1;
+  m_prefetchFixLoadAddress = -1;
+  m_prefetchSize = 0;
+  m_resumePos = 0;
+  m_freeBuffers = nullptr;
+  m_fullBuffers = nullptr;
+  m_prefetchDone = nullptr;
 }
 
 
@@ -158,6 +180,8 @@ iecChannelHandlerFile::~iecChannelHandlerFile()
 {
   double seconds = (esp_timer_get_time()-m_timeStart) / 1000000.0;
 
+  endPrefetch(false);
+
   if( m_stream->mode == std::ios_base::out && m_len>0 )
     writeBufferData();
 
@@ -169,7 +193,7 @@ iecChannelHandlerFile::~iecChannelHandlerFile()
 
   double tseconds = m_transportTimeUS / 1000000.0;
   cps = m_byteCount / (seconds-tseconds);
-  Debug_printv("Transport (network/sd) took %0.3f seconds, pure IEC transfers @ %0.2fcps", tseconds, cps);
+  Debug_printv("Transport (network/sd) stalled the bus for %0.3f seconds, pure IEC transfers @ %0.2fcps", tseconds, cps);
 
 #ifdef ENABLE_DISPLAY
     DISPLAY.idle();
@@ -189,6 +213,9 @@ uint8_t iecChannelHandlerFile::writeBufferData()
   else
   */
     {
+      // a channel that was read from may be written to, stop reading ahead first
+      endPrefetch(true);
+
       Debug_printv("bufferSize[%d]", m_len);
       uint64_t t = esp_timer_get_time();
       size_t n = m_stream->write(m_data, m_len);
@@ -205,6 +232,29 @@ uint8_t iecChannelHandlerFile::writeBufferData()
 }
 
 
+size_t iecChannelHandlerFile::fillBuffer(uint8_t *buf)
+{
+  size_t len = 0;
+
+  if( m_fixLoadAddress>=0 && m_stream->position()==0 )
+    {
+      len = m_stream->read(buf, BUFFER_SIZE);
+      if( len>=2 )
+        {
+          buf[0] = (m_fixLoadAddress & 0x00FF);
+          buf[1] = (m_fixLoadAddress & 0xFF00) >> 8;
+        }
+      m_fixLoadAddress = -1;
+    }
+
+  // try to fill buffer
+  while( len<BUFFER_SIZE && !m_stream->eos() )
+    len += m_stream->read(buf+len, BUFFER_SIZE-len);
+
+  return len;
+}
+
+
 uint8_t iecChannelHandlerFile::readBufferData()
 {
   /*
@@ -213,39 +263,32 @@ uint8_t iecChannelHandlerFile::readBufferData()
     return ST_FILE_TYPE_MISMATCH;
   else
   */
+  if( m_prefetching )
+    return readPrefetched();
+  else
     {
       Debug_printv("size[%lu] avail[%lu] pos[%lu]", m_stream->size(), m_stream->available(), m_stream->position());
       if (m_stream->size() == 0)
         return ST_FILE_NOT_FOUND;
 
+#if IEC_PREFETCH_DEPTH > 0
+      if( m_stream->available() > BUFFER_SIZE )
+        {
+          startPrefetch();
+          if( m_prefetching )
+            return readPrefetched();
+        }
+#endif
+
 #ifdef ENABLE_DISPLAY
       // send progress percentage
       uint8_t percent = (m_stream->position() * 100) / m_stream->size();
       DISPLAY.progress = percent;
 #endif
 
-      if( m_fixLoadAddress>=0 && m_stream->position()==0 )
-        {
-          uint64_t t = esp_timer_get_time();
-          m_len = m_stream->read(m_data, BUFFER_SIZE);
-          m_transportTimeUS += (esp_timer_get_time()-t);
-          if( m_len>=2 )
-            {
-              m_data[0] = (m_fixLoadAddress & 0x00FF);
-              m_data[1] = (m_fixLoadAddress & 0xFF00) >> 8;
-            }
-          m_fixLoadAddress = -1;
-        }
-      else
-        m_len = 0;
-
-      // try to fill buffer
-      while( m_len<BUFFER_SIZE && !m_stream->eos() )
-        {
-          uint64_t t = esp_timer_get_time();
-          m_len += m_stream->read(m_data+m_len, BUFFER_SIZE-m_len);
-          m_transportTimeUS += (esp_timer_get_time()-t);
-        }
+      uint64_t t = esp_timer_get_time();
+      m_len = fillBuffer(m_data);
+      m_transportTimeUS += (esp_timer_get_time()-t);
 
       m_byteCount += m_len;
     }
@@ -253,6 +296,160 @@ uint8_t iecChannelHandlerFile::readBufferData()
   return ST_OK;
 }
 
+
+void iecChannelHandlerFile::startPrefetch()
+{
+  size_t count = IEC_PREFETCH_DEPTH + 1; // the read-ahead buffers plus the one on the bus
+
+  m_prefetchBuffers.clear();
+  for( size_t i=0; i<count; i++ )
+    {
+      uint8_t *data = (uint8_t *) heap_caps_malloc(BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if( data==nullptr )
+        data = (uint8_t *) malloc(BUFFER_SIZE);
+      if( data==nullptr )
+        break;
+      m_prefetchBuffers.push_back({data, 0, 0});
+    }
+
+  // one extra slot in the free queue for the token that wakes the task to stop
+  m_freeBuffers  = xQueueCreate(count + 1, sizeof(uint8_t));
+  m_fullBuffers  = xQueueCreate(count, sizeof(uint8_t));
+  m_prefetchDone = xSemaphoreCreateBinary();
+
+  m_prefetchStop = false;
+  m_prefetchEOS = false;
+  m_prefetchSlot = -1;
+  m_prefetchSize = m_stream->size();
+  m_prefetchFixLoadAddress = m_fixLoadAddress;
+  m_resumePos = m_stream->position();
+
+  if( m_prefetchBuffers.size()<2 || m_freeBuffers==nullptr || m_fullBuffers==nullptr || m_prefetchDone==nullptr ||
+      xTaskCreatePinnedToCore(prefetchTask, "iec_prefetch", IEC_PREFETCH_STACKSIZE, this,
+                              IEC_PREFETCH_PRIORITY, nullptr, IEC_PREFETCH_CPUAFFINITY) != pdPASS )
+    {
+      Debug_printv("Could not start read-ahead, reading synchronously");
+      freePrefetch();
+      return;
+    }
+
+  for( uint8_t i=0; i<m_prefetchBuffers.size(); i++ )
+    xQueueSend(m_freeBuffers, &i, 0);
+
+  m_prefetching = true;
+}
+
+
+void iecChannelHandlerFile::prefetchTask(void *arg)
+{
+  iecChannelHandlerFile *handler = (iecChannelHandlerFile *) arg;
+  uint8_t slot;
+
+  while( xQueueReceive(handler->m_freeBuffers, &slot, portMAX_DELAY)==pdTRUE && !handler->m_prefetchStop )
+    {
+      prefetchBuffer &b = handler->m_prefetchBuffers[slot];
+      b.len = handler->fillBuffer(b.data);
+      b.pos = handler->m_stream->position();
+      xQueueSend(handler->m_fullBuffers, &slot, portMAX_DELAY);
+
+      // an empty buffer marks the end of the stream
+      if( b.len==0 )
+        break;
+    }
+
+  xSemaphoreGive(handler->m_prefetchDone);
+  vTaskDelete(NULL);
+}
+
+
+uint8_t iecChannelHandlerFile::readPrefetched()
+{
+  // the buffer just sent out on the bus can be filled again
+  if( m_prefetchSlot>=0 )
+    {
+      uint8_t slot = m_prefetchSlot;
+      xQueueSend(m_freeBuffers, &slot, 0);
+      m_prefetchSlot = -1;
+    }
+
+  if( m_prefetchEOS )
+    {
+      m_len = 0;
+      return ST_OK;
+    }
+
+  // only time spent waiting here holds up the bus
+  uint8_t slot;
+  uint64_t t = esp_timer_get_time();
+  xQueueReceive(m_fullBuffers, &slot, portMAX_DELAY);
+  m_transportTimeUS += (esp_timer_get_time()-t);
+
+  prefetchBuffer &b = m_prefetchBuffers[slot];
+  m_prefetchSlot = slot;
+  m_data = b.data;
+  m_len = b.len;
+  m_resumePos = b.pos;
+  m_prefetchEOS = (b.len==0);
+  m_byteCount += m_len;
+
+#ifdef ENABLE_DISPLAY
+  // send progress percentage
+  DISPLAY.progress = (m_resumePos * 100) / m_prefetchSize;
+#endif
+
+  return ST_OK;
+}
+
+
+void iecChannelHandlerFile::endPrefetch(bool reposition)
+{
+  if( !m_prefetching )
+    return;
+
+  // wake the task if it is waiting for a free buffer and wait for it to finish
+  m_prefetchStop = true;
+  uint8_t wake = 0xFF;
+  xQueueSend(m_freeBuffers, &wake, 0);
+  xSemaphoreTake(m_prefetchDone, portMAX_DELAY);
+
+  // keep whatever is left of the buffer currently on the bus
+  if( m_data!=m_ownData )
+    {
+      memcpy(m_ownData, m_data, m_len);
+      m_data = m_ownData;
+    }
+
+  // the task read ahead of what was handed out, go back to where that ended
+  if( reposition )
+    {
+      if( m_resumePos==0 && m_prefetchFixLoadAddress>=0 )
+        m_fixLoadAddress = m_prefetchFixLoadAddress;
+      if( m_stream->position()!=m_resumePos )
+        m_stream->position(m_resumePos);
+    }
+
+  freePrefetch();
+  m_prefetchSlot = -1;
+  m_prefetchEOS = false;
+  m_prefetching = false;
+}
+
+
+void iecChannelHandlerFile::freePrefetch()
+{
+  for( auto &b : m_prefetchBuffers )
+    heap_caps_free(b.data);
+  m_prefetchBuffers.clear();
+
+  if( m_freeBuffers!=nullptr )  vQueueDelete(m_freeBuffers);
+  if( m_fullBuffers!=nullptr )  vQueueDelete(m_fullBuffers);
+  if( m_prefetchDone!=nullptr ) vSemaphoreDelete(m_prefetchDone);
+  m_freeBuffers = nullptr;
+  m_fullBuffers = nullptr;
+  m_prefetchDone = nullptr;
+}
+
+
 // -------------------------------------------------------------------------------------------------
 
 
@@ -502,6 +699,7 @@ iecDrive::iecDrive(uint8_t devnum) : IECFileDevice(devnum)
 #endif
   for(int i=0; i<16; i++)
     m_channels[i] = nullptr;
+  m_readChannel = -1;
 }
 
 
@@ -516,6 +714,7 @@ iecDrive::~iecDrive()
 bool iecDrive::open(uint8_t channel, const char *cname)
 {
   Debug_printv("iecDrive::open(#%d, %d, \"%s\")", m_devnr, channel, cname);
+  stopPrefetch();
 
 #ifdef USE_VDRIVE
   if( m_vdrive!=nullptr && (strncmp(cname, "//", 2)==0 || strncmp(cname, "ML:", 3)==0 || strstr(cname, "://")!=NULL) )
@@ -738,6 +937,7 @@ bool iecDrive::open(uint8_t channel, const char *cname)
 void iecDrive::close(uint8_t channel)
 {
   Debug_printv("iecDrive::close(#%d, %d)", m_devnr, channel);
+  stopPrefetch();
 
 #ifdef USE_VDRIVE
   if( m_vdrive!=nullptr )
@@ -785,7 +985,10 @@ uint8_t iecDrive::write(uint8_t channel, uint8_t *data, uint8_t dataLen, bool eo
           return 0;
         }
       else
-        return handler->write(data, dataLen);
+        {
+          if( m_readChannel>=0 ) stopPrefetch();
+          return handler->write(data, dataLen);
+        }
     }
 }
 
@@ -815,6 +1018,13 @@ uint8_t iecDrive::read(uint8_t channel, uint8_t *data, uint8_t maxDataLen, bool
         }
       else
       {
+          // streams may share a container, so only one channel reads ahead at a time
+          if( channel!=m_readChannel )
+            {
+              stopPrefetch();
+              m_readChannel = channel;
+            }
+
           uint8_t bytes_read = handler->read(data, maxDataLen);
           if( m_statusCode==ST_FILE_NOT_FOUND)
           {
@@ -832,6 +1042,7 @@ uint8_t iecDrive::read(uint8_t channel, uint8_t *data, uint8_t maxDataLen, bool
 void iecDrive::execute(const char *cmd, uint8_t cmdLen)
 {
   Debug_printv("iecDrive::execute(#%d, \"%s\", %d)", m_devnr, cmd, cmdLen);
+  stopPrefetch();
 
   std::string command = std::string(cmd, cmdLen);
 
@@ -1421,6 +1632,16 @@ void iecDrive::reset()
 }
 
 
+// Stop all channels reading ahead so the next request has the media to itself
+void iecDrive::stopPrefetch()
+{
+  for(int i=0; i<16; i++)
+    if( m_channels[i]!=nullptr )
+      m_channels[i]->stopPrefetch();
+  m_readChannel = -1;
+}
+
+
 void iecDrive::set_cwd(std::string path)
 {
     // Isolate path
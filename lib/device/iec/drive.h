@@ -8,6 +8,9 @@
 #include <cstring>
 #include <unordered_map>
 #include <esp_rom_crc.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
 
 #include "../../bus/iec/IECFileDevice.h"
 #include "../../media/media.h"
@@ -41,6 +44,9 @@ class iecChannelHandler
   virtual uint8_t readBufferData()  = 0;
   virtual MStream *getStream() { return nullptr; };
 
+  // stop any background reading ahead so the stream can be used directly
+  virtual void stopPrefetch() {};
+
  protected:
   iecDrive *m_drive;
   uint8_t  *m_data;
@@ -56,13 +62,40 @@ class iecChannelHandlerFile : public iecChannelHandler
 
   virtual uint8_t readBufferData();
   virtual uint8_t writeBufferData();
-  virtual MStream *getStream() override { return m_stream; };
+  virtual MStream *getStream() override { stopPrefetch(); return m_stream; };
+  virtual void stopPrefetch() override { endPrefetch(true); };
 
  private:
+  size_t  fillBuffer(uint8_t *buf);
+
+  // Read-ahead: a background task fills the next buffers from the stream
+  // while the current one is clocked out on the bus
+  struct prefetchBuffer
+  {
+    uint8_t  *data;
+    size_t    len;
+    uint32_t  pos;    // stream position after this buffer
+  };
+
+  void    startPrefetch();
+  void    endPrefetch(bool reposition);
+  void    freePrefetch();
+  uint8_t readPrefetched();
+  static void prefetchTask(void *arg);
+
   MStream  *m_stream;
   int       m_fixLoadAddress;
   uint32_t  m_byteCount;
   uint64_t  m_timeStart, m_transportTimeUS;
+
+  uint8_t  *m_ownData;
+  bool      m_prefetching, m_prefetchEOS;
+  volatile bool m_prefetchStop;
+  int       m_prefetchSlot, m_prefetchFixLoadAddress;
+  uint32_t  m_prefetchSize, m_resumePos;
+  std::vector<prefetchBuffer> m_prefetchBuffers;
+  QueueHandle_t     m_freeBuffers, m_fullBuffers;
+  SemaphoreHandle_t m_prefetchDone;
 };
 
 
@@ -281,9 +314,11 @@ class iecDrive : public IECFileDevice
   virtual void reset();
 
   void set_cwd(std::string path);
+  void stopPrefetch();
 
   std::unique_ptr<MFile> m_cwd;   // current working directory
   iecChannelHandler *m_channels[16];
+  int8_t  m_readChannel;
   uint8_t m_statusCode, m_statusTrk, m_numOpenChannels;
 #ifdef USE_VDRIVE
   VDrive   *m_vdrive;
@@ -1104,6 +1104,78 @@ void iwmModem::modemCommand()
     cmd = "";
 }
 
+/*
+  Send bytes received from the bus to the remote end, watching for "+++"
+*/
+void iwmModem::send_online(const uint8_t *buf, int len)
+{
+    if (len <= 0)
+        return;
+
+    // Disconnect if going to AT mode with "+++" sequence
+    escape.scan(buf, len, fnSystem.millis());
+
+    // Write the buffer to TCP finally
+    if (use_telnet == true)
+    {
+        telnet_send(telnet, (const char *)buf, len);
+    }
+    else
+        tcpClient.write(buf, len);
+
+    // And send it off to the sniffer, if enabled.
+    modemSniffer->dumpOutput((uint8_t *)buf, len);
+    _lasttime = fnSystem.millis();
+}
+
+/*
+  Gather AT command characters queued by the bus. Everything available is read at
+  once and edited by ModemCommandLine, echo goes out as one block.
+*/
+void iwmModem::handle_command_input(int avail)
+{
+    static const ModemCommandLine commandLine(MAX_CMD_LENGTH);
+
+    if (avail <= 0)
+        return;
+
+    uint8_t inBuf[TX_BUF_SIZE];
+    int len = modem_read(inBuf, (avail > TX_BUF_SIZE) ? TX_BUF_SIZE : avail);
+
+    std::string echo;
+    int i = 0;
+    while (i < len)
+    {
+        int eol;
+        i += commandLine.edit(cmd, &inBuf[i], len - i, commandEcho ? &echo : nullptr, eol);
+        if (eol < 0)
+            break;
+
+        // flip which EOL to display based on last CR or EOL received.
+        cmdAtascii = (eol == ATASCII_EOL);
+
+        // Echo has to go out before the command's response
+        if (!echo.empty())
+        {
+            modem_write((uint8_t *)echo.data(), echo.size());
+            echo.clear();
+        }
+
+        modemCommand();
+
+        // The command connected us, what was typed ahead goes to the remote end
+        if (cmdMode == false)
+        {
+            if (tcpClient.connected())
+                send_online(&inBuf[i], len - i);
+            return;
+        }
+    }
+
+    if (!echo.empty())
+        modem_write((uint8_t *)echo.data(), echo.size());
+}
+
 /*
   Handle incoming & outgoing data for modem
 */
@@ -1143,72 +1215,7 @@ void iwmModem::handle_modem()
         }
 
         // In command mode - don't exchange with TCP but gather characters to a string
-        // if (SIO_UART.available() /*|| blockWritePending == true */ )
-        if (uxQueueMessagesWaiting(mtxq))
-        {
-            char chr;
-
-            xQueueReceive(mtxq, &chr, portMAX_DELAY);
-
-            // Return, enter, new line, carriage return.. anything goes to end the command
-            if ((chr == ASCII_LF) || (chr == ASCII_CR) || (chr == ATASCII_EOL))
-            {
-                // flip which EOL to display based on last CR or EOL received.
-                if (chr == ATASCII_EOL)
-                    cmdAtascii = true;
-                else
-                    cmdAtascii = false;
-
-                modemCommand();
-            }
-            // Backspace or delete deletes previous character
-            else if ((chr == ASCII_BACKSPACE) || (chr == ASCII_DELETE))
-            {
-                size_t len = cmd.length();
-
-                if (len > 0)
-                {
-                    cmd.erase(len - 1);
-                    // We don't assume that backspace is destructive
-                    // Clear with a space
-                    if (commandEcho == true)
-                    {
-                        modem_write(ASCII_BACKSPACE);
-                        modem_write(' ');
-                        modem_write(ASCII_BACKSPACE);
-                    }
-                }
-            }
-            else if (chr == ATASCII_BACKSPACE)
-            {
-                size_t len = cmd.length();
-
-                // ATASCII backspace
-                if (len > 0)
-                {
-                    cmd.erase(len - 1);
-                    if (commandEcho == true)
-                        modem_write(ATASCII_BACKSPACE);
-                }
-            }
-            // Take into account arrow key movement and clear screen
-            else if (chr == ATASCII_CLEAR_SCREEN ||
-                     ((chr >= ATASCII_CURSOR_UP) && (chr <= ATASCII_CURSOR_RIGHT)))
-            {
-                if (commandEcho == true)
-                    modem_write(chr);
-            }
-            else
-            {
-                if (cmd.length() < MAX_CMD_LENGTH)
-                {
-                    // cmd.concat(chr);
-                    cmd += chr;
-                }
-                if (commandEcho == true)
-                    modem_write(chr);
-            }
-        }
+        handle_command_input(uxQueueMessagesWaiting(mtxq));
     }
     // Connected mode
     else
@@ -1255,34 +1262,7 @@ void iwmModem::handle_modem()
             int sioBytesRead = modem_read(&txBuf[0], // SIO_UART.readBytes(&txBuf[0],
                                           (sioBytesAvail > TX_BUF_SIZE) ? TX_BUF_SIZE : sioBytesAvail);
 
-            // Disconnect if going to AT mode with "+++" sequence
-            for (int i = 0; i < (int)sioBytesRead; i++)
-            {
-                if (txBuf[i] == '+')
-                    plusCount++;
-                else
-                    plusCount = 0;
-                if (plusCount >= 3)
-                {
-                    plusTime = fnSystem.millis();
-                }
-                if (txBuf[i] != '+')
-                {
-                    plusCount = 0;
-                }
-            }
-
-            // Write the buffer to TCP finally
-            if (use_telnet == true)
-            {
-                telnet_send(telnet, (const char *)txBuf, sioBytesRead);
-            }
-            else
-                tcpClient.write(&txBuf[0], sioBytesRead);
-
-            // And send it off to the sniffer, if enabled.
-            modemSniffer->dumpOutput(&txBuf[0], sioBytesRead);
-            _lasttime = fnSystem.millis();
+            send_online(txBuf, sioBytesRead);
         }
 
         // read from Fujinet to Atari
@@ -1313,18 +1293,15 @@ void iwmModem::handle_modem()
 
     // If we have received "+++" as last bytes from serial port and there
     // has been over a second without any more bytes, go back to command mode.
-    if (plusCount >= 3)
+    if (escape.due(fnSystem.millis()))
     {
-        if (fnSystem.millis() - plusTime > 1000)
-        {
-            Debug_println("Going back to command mode");
+        Debug_println("Going back to command mode");
 
-            at_cmd_println("OK");
+        at_cmd_println("OK");
 
-            cmdMode = true;
+        cmdMode = true;
 
-            plusCount = 0;
-        }
+        escape.reset();
     }
 
     // Go to command mode if TCP disconnected and not in command mode
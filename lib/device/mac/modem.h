@@ -6,6 +6,7 @@
 #include "fnSystem.h"
 
 #include "modem-sniffer.h"
+#include "modem-engine.h"
 
 class macModem : public macDevice
 {
@@ -195,8 +196,7 @@ private:
     fnTcpClient tcpClient;         // Modem client
     fnTcpServer tcpServer;         // Modem server
     unsigned long lastRingMs = 0;  // Time of last "RING" message (millis())
-    char plusCount = 0;            // Go to AT mode at "+++" sequence, that has to be counted
-    unsigned long plusTime = 0;    // When did we last receive a "+++" sequence
+    ModemEscape escape;            // Go to AT mode at "+++" sequence
     uint8_t txBuf[TX_BUF_SIZE];
     bool cmdOutput=true;            // toggle whether to emit command output
     bool numericResultCode=false;   // Use numeric result codes? (ATV0)
@@ -236,6 +236,8 @@ private:
     void crx_toggle(bool toggle);                // CRX active/inactive?
 
     void modemCommand(); // Execute modem AT command
+    void handle_command_input(int avail); // Gather AT command characters queued by the bus
+    void send_online(const uint8_t *buf, int len); // Send bytes from the bus to the remote end
 
     // CR/EOL aware println() functions for AT mode
     void at_connect_resultCode(int modemBaud);
@@ -1032,6 +1032,77 @@ void rc2014Modem::modemCommand()
     cmd = "";
 }
 
+/*
+  Send bytes received from the host to the remote end, watching for "+++"
+*/
+void rc2014Modem::rc2014_send_online(const uint8_t *buf, int len)
+{
+    if (len <= 0)
+        return;
+
+    // Disconnect if going to AT mode with "+++" sequence
+    escape.scan(buf, len, fnSystem.millis());
+
+    // Write the buffer to TCP finally
+    if (use_telnet == true)
+    {
+        telnet_send(telnet, (const char *)buf, len);
+    }
+    else
+        tcpClient.write(buf, len);
+
+    // And send it off to the sniffer, if enabled.
+    modemSniffer->dumpOutput((uint8_t *)buf, len);
+    _lasttime = fnSystem.millis();
+}
+
+/*
+  Gather AT command characters from the host. Everything available is read at
+  once and edited by ModemCommandLine, echo goes out as one block.
+*/
+void rc2014Modem::rc2014_handle_command_input()
+{
+    static const ModemCommandLine commandLine(MAX_CMD_LENGTH, false);
+
+    int avail = streamFifoTx.avail();
+    if (avail <= 0)
+        return;
+
+    uint8_t inBuf[TX_BUF_SIZE];
+    int len = (avail > TX_BUF_SIZE) ? TX_BUF_SIZE : avail;
+    streamFifoTx.pop(inBuf, len);
+
+    std::string echo;
+    int i = 0;
+    while (i < len)
+    {
+        int eol;
+        i += commandLine.edit(cmd, &inBuf[i], len - i, commandEcho ? &echo : nullptr, eol);
+        if (eol < 0)
+            break;
+
+        // Echo has to go out before the command's response
+        if (!echo.empty())
+        {
+            streamFifoRx.push((uint8_t *)echo.data(), echo.size());
+            echo.clear();
+        }
+
+        modemCommand();
+
+        // The command connected us, what was typed ahead goes to the remote end
+        if (cmdMode == false)
+        {
+            if (tcpClient.connected())
+                rc2014_send_online(&inBuf[i], len - i);
+            return;
+        }
+    }
+
+    if (!echo.empty())
+        streamFifoRx.push((uint8_t *)echo.data(), echo.size());
+}
+
 /*
   Handle incoming & outgoing data for modem
 */
@@ -1071,54 +1142,7 @@ void rc2014Modem::rc2014_handle_stream()
         }
 
         // In command mode - don't exchange with TCP but gather characters to a string
-        //if (SIO_UART.available() /*|| blockWritePending == true */ )
-        if (streamFifoTx.avail() > 0)
-        {
-            // get char from Atari SIO
-            //char chr = SIO_UART.read();
-            uint8_t chr = streamFifoTx.pop();
-
-            // Return, enter, new line, carriage return.. anything goes to end the command
-            if ((chr == ASCII_LF) || (chr == ASCII_CR))
-            {
-                modemCommand();
-            }
-            // Backspace or delete deletes previous character
-            else if ((chr == ASCII_BACKSPACE) || (chr == ASCII_DELETE))
-            {
-                size_t len = cmd.length();
-
-                if (len > 0)
-                {
-                    cmd.erase(len - 1);
-                    // We don't assume that backspace is destructive
-                    // Clear with a space
-                    if (commandEcho)
-                    {
-                        streamFifoRx.push(ASCII_BACKSPACE);
-                        streamFifoRx.push(' ');
-                        streamFifoRx.push(ASCII_BACKSPACE);
-                    }
-                }
-            }
-            // Take into account arrow key movement and clear screen
-            else if (chr == ATASCII_CLEAR_SCREEN ||
-                     ((chr >= ATASCII_CURSOR_UP) && (chr <= ATASCII_CURSOR_RIGHT)))
-            {
-                if (commandEcho)
-                    streamFifoRx.push(chr);
-            }
-            else
-            {
-                if (cmd.length() < MAX_CMD_LENGTH)
-                {
-                    //cmd.concat(chr);
-                    cmd += chr;
-                }
-                if (commandEcho)
-                    streamFifoRx.push(chr);
-            }
-        }
+        rc2014_handle_command_input();
     }
     // Connected mode
     else
@@ -1166,34 +1190,7 @@ void rc2014Modem::rc2014_handle_stream()
             int sioBytesRead = (sioBytesAvail > TX_BUF_SIZE) ? TX_BUF_SIZE : sioBytesAvail;
             streamFifoTx.pop(&txBuf[0], sioBytesRead);
 
-            // Disconnect if going to AT mode with "+++" sequence
-            for (int i = 0; i < (int)sioBytesRead; i++)
-            {
-                if (txBuf[i] == '+')
-                    plusCount++;
-                else
-                    plusCount = 0;
-                if (plusCount >= 3)
-                {
-                    plusTime = fnSystem.millis();
-                }
-                if (txBuf[i] != '+')
-                {
-                    plusCount = 0;
-                }
-            }
-
-            // Write the buffer to TCP finally
-            if (use_telnet == true)
-            {
-                telnet_send(telnet, (const char *)txBuf, sioBytesRead);
-            }
-            else
-                tcpClient.write(&txBuf[0], sioBytesRead);
-
-            // And send it off to the sniffer, if enabled.
-            modemSniffer->dumpOutput(&txBuf[0], sioBytesRead);
-            _lasttime = fnSystem.millis();
+            rc2014_send_online(txBuf, sioBytesRead);
         }
 
         // read from Fujinet to Atari
@@ -1224,18 +1221,15 @@ void rc2014Modem::rc2014_handle_stream()
 
     // If we have received "+++" as last bytes from serial port and there
     // has been over a second without any more bytes, go back to command mode.
-    if (plusCount >= 3)
+    if (escape.due(fnSystem.millis()))
     {
-        if (fnSystem.millis() - plusTime > 1000)
-        {
-            Debug_println("Going back to command mode");
+        Debug_println("Going back to command mode");
 
-            at_cmd_println("OK");
+        at_cmd_println("OK");
 
-            cmdMode = true;
+        cmdMode = true;
 
-            plusCount = 0;
-        }
+        escape.reset();
     }
 
     // Go to command mode if TCP disconnected and not in command mode
@@ -13,6 +13,7 @@
 #include "fnTcpServer.h"
 #include "fnTcpClient.h"
 #include "modem-sniffer.h"
+#include "modem-engine.h"
 #include "libtelnet.h"
 
 /* Keep strings under 40 characters, for the benefit of 40-column users! */
@@ -164,8 +165,7 @@ private:
     fnTcpClient tcpClient;         // Modem client
     fnTcpServer tcpServer;         // Modem server
     unsigned long lastRingMs = 0;  // Time of last "RING" message (millis())
-    char plusCount = 0;            // Go to AT mode at "+++" sequence, that has to be counted
-    unsigned long plusTime = 0;    // When did we last receive a "+++" sequence
+    ModemEscape escape;            // Go to AT mode at "+++" sequence
     uint8_t txBuf[TX_BUF_SIZE];
     bool cmdOutput=true;            // toggle whether to emit command output
     bool numericResultCode=false;   // Use numeric result codes? (ATV0)
@@ -190,6 +190,8 @@ private:
     void crx_toggle(bool toggle);                // CRX active/inactive?
 
     void modemCommand(); // Execute modem AT command
+    void rc2014_handle_command_input(); // Gather AT command characters from the host
+    void rc2014_send_online(const uint8_t *buf, int len); // Send bytes from the host to the remote end
 
     // CR/EOL aware println() functions for AT mode
     void at_connect_resultCode(int modemBaud);
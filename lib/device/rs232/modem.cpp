@@ -1460,21 +1460,7 @@ void rs232Modem::rs232_handle_modem()
                                                  ? TX_BUF_SIZE : rs232BytesAvail);
 
             // Disconnect if going to AT mode with "+++" sequence
-            for (int i = 0; i < (int)rs232BytesRead; i++)
-            {
-                if (txBuf[i] == '+')
-                    plusCount++;
-                else
-                    plusCount = 0;
-                if (plusCount >= 3)
-                {
-                    plusTime = fnSystem.millis();
-                }
-                if (txBuf[i] != '+')
-                {
-                    plusCount = 0;
-                }
-            }
+            escape.scan(txBuf, rs232BytesRead, fnSystem.millis());
 
             // Write the buffer to TCP finally
             if (use_telnet == true)
@@ -1518,18 +1504,15 @@ void rs232Modem::rs232_handle_modem()
 
     // If we have received "+++" as last bytes from serial port and there
     // has been over a second without any more bytes, go back to command mode.
-    if (plusCount >= 3)
+    if (escape.due(fnSystem.millis()))
     {
-        if (fnSystem.millis() - plusTime > 1000)
-        {
-            Debug_println("Going back to command mode");
+        Debug_println("Going back to command mode");
 
-            at_cmd_println("OK");
+        at_cmd_println("OK");
 
-            cmdMode = true;
+        cmdMode = true;
 
-            plusCount = 0;
-        }
+        escape.reset();
     }
 
     // Go to command mode if TCP disconnected and not in command mode
@@ -5,6 +5,7 @@
 #include "fnTcpClient.h"
 #include "fnTcpServer.h"
 #include "modem-sniffer.h"
+#include "modem-engine.h"
 #include "libtelnet.h"
 
 
@@ -157,8 +158,7 @@ private:
     fnTcpClient tcpClient;         // Modem client
     fnTcpServer tcpServer;         // Modem server
     unsigned long lastRingMs = 0;  // Time of last "RING" message (millis())
-    char plusCount = 0;            // Go to AT mode at "+++" sequence, that has to be counted
-    unsigned long plusTime = 0;    // When did we last receive a "+++" sequence
+    ModemEscape escape;            // Go to AT mode at "+++" sequence
     uint8_t txBuf[TX_BUF_SIZE];
     bool cmdOutput=true;            // toggle whether to emit command output
     bool numericResultCode=false;   // Use numeric result codes? (ATV0)
@@ -1571,6 +1571,85 @@ void modem::modemCommand()
     cmd = "";
 }
 
+/*
+  Send bytes received from SIO to the remote end, watching for "+++"
+*/
+void modem::sio_send_online(const uint8_t *buf, int len)
+{
+    if (len <= 0)
+        return;
+
+    escape.scan(buf, len, fnSystem.millis());
+
+    // Write the buffer to TCP finally
+    if (use_telnet == true)
+    {
+        telnet_send(telnet, (const char *)buf, len);
+    }
+    else
+    {
+        tcpClient.write(buf, len);
+    }
+    // And send it off to the sniffer, if enabled.
+    modemSniffer->dumpOutput((uint8_t *)buf, len);
+    _lasttime = fnSystem.millis();
+}
+
+/*
+  Gather AT command characters from SIO. Everything available is read at
+  once and edited by ModemCommandLine, echo goes out as one block.
+*/
+void modem::sio_handle_command_input()
+{
+    static const ModemCommandLine commandLine(MAX_CMD_LENGTH);
+
+    int avail = SYSTEM_BUS.available();
+    if (avail <= 0)
+        return;
+
+    // get chars from Atari SIO
+    uint8_t inBuf[TX_BUF_SIZE];
+    int len = SYSTEM_BUS.read(inBuf, (avail > TX_BUF_SIZE) ? TX_BUF_SIZE : avail);
+    if (len <= 0)
+    {
+        // read error or timeout
+        return;
+    }
+
+    std::string echo;
+    int i = 0;
+    while (i < len)
+    {
+        int eol;
+        i += commandLine.edit(cmd, &inBuf[i], len - i, commandEcho ? &echo : nullptr, eol);
+        if (eol < 0)
+            break;
+
+        // flip which EOL to display based on last CR or EOL received.
+        cmdAtascii = (eol == ATASCII_EOL);
+
+        // Echo has to go out before the command's response
+        if (!echo.empty())
+        {
+            SYSTEM_BUS.write((uint8_t *)echo.data(), echo.size());
+            echo.clear();
+        }
+
+        modemCommand();
+
+        // The command connected us, what was typed ahead goes to the remote end
+        if (cmdMode == false)
+        {
+            if (tcpClient.connected())
+                sio_send_online(&inBuf[i], len - i);
+            return;
+        }
+    }
+
+    if (!echo.empty())
+        SYSTEM_BUS.write((uint8_t *)echo.data(), echo.size());
+}
+
 /*
   Handle incoming & outgoing data for modem
 */
@@ -1627,78 +1706,7 @@ void modem::sio_handle_modem()
         }
 
         // In command mode - don't exchange with TCP but gather characters to a string
-        //if (SIO_UART.available() /*|| blockWritePending == true */ )
-        if (SYSTEM_BUS.available() > 0)
-        {
-            // get char from Atari SIO
-            //char chr = SIO_UART.read();
-            int intchr = SYSTEM_BUS.read();
-            if (intchr < 0)
-            {
-                // read error or timeout
-                return;
-            }
-            unsigned char chr = intchr;
-
-            // Return, enter, new line, carriage return.. anything goes to end the command
-            if ((chr == ASCII_LF) || (chr == ASCII_CR) || (chr == ATASCII_EOL))
-            {
-                // flip which EOL to display based on last CR or EOL received.
-                if (chr == ATASCII_EOL)
-                    cmdAtascii = true;
-                else
-                    cmdAtascii = false;
-
-                modemCommand();
-            }
-            // Backspace or delete deletes previous character
-            else if ((chr == ASCII_BACKSPACE) || (chr == ASCII_DELETE))
-            {
-                size_t len = cmd.length();
-
-                if (len > 0)
-                {
-                    cmd.erase(len - 1);
-                    // We don't assume that backspace is destructive
-                    // Clear with a space
-                    if (commandEcho == true)
-                    {
-                        SYSTEM_BUS.write(ASCII_BACKSPACE);
-                        SYSTEM_BUS.write(' ');
-                        SYSTEM_BUS.write(ASCII_BACKSPACE);
-                    }
-                }
-            }
-            else if (chr == ATASCII_BACKSPACE)
-            {
-                size_t len = cmd.length();
-
-                // ATASCII backspace
-                if (len > 0)
-                {
-                    cmd.erase(len - 1);
-                    if (commandEcho == true)
-                        SYSTEM_BUS.write(ATASCII_BACKSPACE);
-                }
-            }
-            // Take into account arrow key movement and clear screen
-            else if (chr == ATASCII_CLEAR_SCREEN ||
-                     ((chr >= ATASCII_CURSOR_UP) && (chr <= ATASCII_CURSOR_RIGHT)))
-            {
-                if (commandEcho == true)
-                    SYSTEM_BUS.write(chr);
-            }
-            else
-            {
-                if (cmd.length() < MAX_CMD_LENGTH)
-                {
-                    //cmd.concat(chr);
-                    cmd += chr;
-                }
-                if (commandEcho == true)
-                    SYSTEM_BUS.write(chr);
-            }
-        }
+        sio_handle_command_input();
     }
     // Connected mode
     else
@@ -1749,35 +1757,7 @@ void modem::sio_handle_modem()
             int sioBytesRead = SYSTEM_BUS.read(&txBuf[0], //SIO_UART.readBytes(&txBuf[0],
                                                (sioBytesAvail > TX_BUF_SIZE) ? TX_BUF_SIZE : sioBytesAvail);
 
-            // Disconnect if going to AT mode with "+++" sequence
-            for (int i = 0; i < (int)sioBytesRead; i++)
-            {
-                if (txBuf[i] == '+')
-                    plusCount++;
-                else
-                    plusCount = 0;
-                if (plusCount >= 3)
-                {
-                    plusTime = fnSystem.millis();
-                }
-                if (txBuf[i] != '+')
-                {
-                    plusCount = 0;
-                }
-            }
-
-            // Write the buffer to TCP finally
-            if (use_telnet == true)
-            {
-                telnet_send(telnet, (const char *)txBuf, sioBytesRead);
-            }
-            else
-            {
-                tcpClient.write(&txBuf[0], sioBytesRead);
-            }
-            // And send it off to the sniffer, if enabled.
-            modemSniffer->dumpOutput(&txBuf[0], sioBytesRead);
-            _lasttime = fnSystem.millis();
+            sio_send_online(txBuf, sioBytesRead);
 
             fnLedManager.set(eLed::LED_BT,false);
         }
@@ -1785,6 +1765,7 @@ void modem::sio_handle_modem()
         // read from Fujinet to Atari
         unsigned char buf[RECVBUFSIZE];
         int bytesAvail = 0;
+        bool drained = false;
 
         // check to see how many bytes are avail to read
         while ((bytesAvail = tcpClient.available()) > 0)
@@ -1802,7 +1783,6 @@ void modem::sio_handle_modem()
             else
             {
                 SYSTEM_BUS.write(buf, bytesRead);
-                SYSTEM_BUS.flushOutput();
             }
 
             fnLedManager.set(eLed::LED_BT,false);
@@ -1810,23 +1790,25 @@ void modem::sio_handle_modem()
             // And dump to sniffer, if enabled.
             modemSniffer->dumpInput(buf, bytesRead);
             _lasttime = fnSystem.millis();
+            drained = true;
         }
+
+        // Flush once everything available has been queued
+        if (drained)
+            SYSTEM_BUS.flushOutput();
     }
 
     // If we have received "+++" as last bytes from serial port and there
     // has been over a second without any more bytes, go back to command mode.
-    if (plusCount >= 3)
+    if (escape.due(fnSystem.millis()))
     {
-        if (fnSystem.millis() - plusTime > 1000)
-        {
-            Debug_println("Going back to command mode");
+        Debug_println("Going back to command mode");
 
-            at_cmd_println("OK");
+        at_cmd_println("OK");
 
-            cmdMode = true;
+        cmdMode = true;
 
-            plusCount = 0;
-        }
+        escape.reset();
     }
 
     // Go to command mode if TCP disconnected and not in command mode
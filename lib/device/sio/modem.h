@@ -8,6 +8,7 @@
 #include "fnTcpServer.h"
 
 #include "modem-sniffer.h"
+#include "modem-engine.h"
 #include "libtelnet.h"
 
 /* Keep strings under 40 characters, for the benefit of 40-column users! */
@@ -163,12 +164,7 @@ private:
 #else
     uint64_t lastRingMs = 0;       // Time of last "RING" message (millis())
 #endif
-    char plusCount = 0;            // Go to AT mode at "+++" sequence, that has to be counted
-#ifdef ESP_PLATFORM
-    unsigned long plusTime = 0;    // When did we last receive a "+++" sequence
-#else
-    uint64_t plusTime = 0;         // When did we last receive a "+++" sequence
-#endif
+    ModemEscape escape;            // Go to AT mode at "+++" sequence
     uint8_t txBuf[TX_BUF_SIZE];
     bool cmdOutput=true;            // toggle whether to emit command output
     bool numericResultCode=false;   // Use numeric result codes? (ATV0)
@@ -193,6 +189,8 @@ private:
     bool answered=false;
     int ringCount;                  // Keep track of how many incoming RINGs
 
+    void sio_handle_command_input();                       // Gather AT command characters from SIO
+    void sio_send_online(const uint8_t *buf, int len);     // Send bytes from SIO to the remote end
     void sio_send_firmware(uint8_t loadcommand);           // $21 and $26: Booter/Relocator download; Handler download
     void sio_poll_1();                                     // $3F, '?', Type 1 Poll
     void sio_poll_3(const FujiSIOPacket &packet);          // $40, '@', Type 3 Poll
@@ -20,14 +20,14 @@ void COMConnection::send_data(const std::vector<uint8_t> &data)
 		return;
 	}
 
-	const auto slip_data = SLIP::encode(data);
-	sp_blocking_write(port_, slip_data.data(), slip_data.size(), 60 * 1000);
+	std::lock_guard<std::mutex> lock(send_mutex_);
+	SLIP::encode_into(data.data(), data.size(), send_buffer_);
+	sp_blocking_write(port_, send_buffer_.data(), send_buffer_.size(), 60 * 1000);
 }
 
 void COMConnection::create_read_channel()
 {
 	reading_thread_ = std::thread([self = shared_from_this()]() {
-	    std::vector<uint8_t> complete_data;
 		std::vector<uint8_t> buffer(1024);
 		while (self->is_connected())
 		{
@@ -45,32 +45,12 @@ void COMConnection::create_read_channel()
 				}
 				if (bytes_read > 0)
 				{
-					// LogFileOutput("SmartPortOverSlip COMConnection, inserting data, bytes_read: %d\n", bytes_read);
-					complete_data.insert(complete_data.end(), buffer.begin(), buffer.begin() + bytes_read);
+					// frames can straddle reads, the decoder carries the partial one over
+					self->decoder_.feed(buffer.data(), bytes_read, [&self](std::vector<uint8_t> &&packet) {
+						self->packet_received(std::move(packet));
+					});
 				}
 			} while (bytes_read > 0);
-
-			if (!complete_data.empty())			
-			{
-				std::vector<std::vector<uint8_t>> decoded_packets = SLIP::split_into_packets(complete_data.data(), complete_data.size());
-				// LogFileOutput("SmartPortOverSlip COMConnection, packets decoded: %d\n", decoded_packets.size());
-
-				if (!decoded_packets.empty())
-				{
-					for (const auto &packet : decoded_packets)
-					{
-						if (!packet.empty())
-						{
-							{
-								std::lock_guard<std::mutex> lock(self->data_mutex_);
-								self->data_map_[packet[0]] = packet;
-							}
-							self->data_cv_.notify_all();
-						}
-					}
-				}
-				complete_data.clear();				
-			}
 		}
 	});
 }
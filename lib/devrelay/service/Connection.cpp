@@ -25,18 +25,44 @@
 //     }
 // }
 
+void Connection::expect_response(uint8_t request_id)
+{
+	std::lock_guard<std::mutex> lock(data_mutex_);
+	expected_.insert(request_id);
+	responses_.erase(request_id);
+}
+
+void Connection::packet_received(std::vector<uint8_t> &&packet)
+{
+	if (packet.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(data_mutex_);
+		if (expected_.count(packet[0]) > 0)
+			responses_[packet[0]] = std::move(packet);
+		else
+			requests_.push_back(std::move(packet));
+	}
+	data_cv_.notify_all();
+}
+
 // This is called after AppleWin sends a request to a device, and is waiting for the response
 std::vector<uint8_t> Connection::wait_for_response(uint8_t request_id, std::chrono::seconds timeout)
 {
 	std::unique_lock<std::mutex> lock(data_mutex_);
+	// callers that didn't register the ID up front get it registered here
+	expected_.insert(request_id);
 	// mutex is unlocked as it goes into a wait, so then the inserting thread can
 	// add to map, and this can then pick it up when notified, or timeout.
-	if (!data_cv_.wait_for(lock, timeout, [this, request_id]() { return data_map_.count(request_id) > 0; }))
+	if (!data_cv_.wait_for(lock, timeout, [this, request_id]() { return responses_.count(request_id) > 0; }))
 	{
+		expected_.erase(request_id);
 		throw std::runtime_error("Timeout waiting for response");
 	}
-	std::vector<uint8_t> response_data = data_map_[request_id];
-	data_map_.erase(request_id);
+	std::vector<uint8_t> response_data = std::move(responses_[request_id]);
+	responses_.erase(request_id);
+	expected_.erase(request_id);
 	return response_data;
 }
 
@@ -48,16 +74,11 @@ std::vector<uint8_t> Connection::wait_for_request()
 	while (is_connected_)
 	{
 		std::unique_lock<std::mutex> lock(data_mutex_);
-		if (data_cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !data_map_.empty(); }))
+		if (data_cv_.wait_for(lock, std::chrono::milliseconds(100), [this]() { return !requests_.empty(); }))
 		{
-			const auto it = data_map_.begin();
-			std::vector<uint8_t> request_data = it->second;
-			data_map_.erase(it);
-
-			// std::cout << "[" << get_timestamp() << "] Connection::wait_for_request - Processing request with ID: 0x" 
-			// 	<< std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(it->first)
-			// 	<< ", size: " << std::dec << request_data.size() << " bytes" << std::endl;
-
+			// oldest first, so pipelined requests are answered in the order sent
+			std::vector<uint8_t> request_data = std::move(requests_.front());
+			requests_.pop_front();
 			return request_data;
 		}
 	}
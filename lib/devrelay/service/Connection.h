@@ -6,11 +6,15 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <map>
 #include <mutex>
+#include <set>
 #include <thread>
 #include <vector>
 
+#include "../slip/SLIP.h"
+
 class Connection
 {
 public:
@@ -23,20 +27,41 @@ public:
 	bool is_connected() const { return is_connected_; }
 	void set_is_connected(const bool is_connected) { is_connected_ = is_connected; }
 
+	// Several requests can be in flight on one connection: register each
+	// request ID with expect_response() before sending, then collect the
+	// responses in any order. Packets whose ID nobody is waiting for are
+	// requests from the peer and queue up for wait_for_request() in the
+	// order they arrived.
+	void expect_response(uint8_t request_id);
 	std::vector<uint8_t> wait_for_response(uint8_t request_id, std::chrono::seconds timeout);
 	std::vector<uint8_t> wait_for_request();
 
+	// Give a packet buffer back once done with it
+	void release_buffer(std::vector<uint8_t> &&buffer) { pool_.release(std::move(buffer)); }
+
 	void join();
 
 private:
 	std::atomic<bool> is_connected_{false};
 
+	std::set<uint8_t> expected_;
+	std::map<uint8_t, std::vector<uint8_t>> responses_;
+	std::deque<std::vector<uint8_t>> requests_;
+
 protected:
-	std::map<uint8_t, std::vector<uint8_t>> data_map_;
+	// called by the read channel for each decoded packet
+	void packet_received(std::vector<uint8_t> &&packet);
+
+	SLIPBufferPool pool_;
+	SLIPDecoder decoder_{&pool_};
 	std::thread reading_thread_;
 
+	// SLIP encoded copy of the packet being sent, reused between sends
+	std::mutex send_mutex_;
+	std::vector<uint8_t> send_buffer_;
+
 	std::mutex data_mutex_;
 	std::condition_variable data_cv_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -11,6 +11,9 @@ Requestor::Requestor() = default;
 
 std::unique_ptr<Response> Requestor::send_request(const Request &request, Connection *connection)
 {
+	// Register for the response before sending, so it can't arrive unclaimed
+	connection->expect_response(request.get_request_sequence_number());
+
 	// Send the serialized request
 	connection->send_data(request.serialize());
 
@@ -26,7 +29,9 @@ std::unique_ptr<Response> Requestor::send_request(const Request &request, Connec
 
 	// Deserialize the response data into a Response object.
 	// Each Request type (e.g. StatusRequest) is able to deserialize into its twin Response (e.g. StatusResponse).
-	return request.deserialize(response_data);
+	auto response = request.deserialize(response_data);
+	connection->release_buffer(std::move(response_data));
+	return response;
 }
 
 uint8_t Requestor::next_request_number()
@@ -53,8 +53,10 @@ void TCPConnection::send_data(const std::vector<uint8_t> &data)
 		return;
 	}
 
-	const auto slip_data = SLIP::encode(data);
-	send(socket_, reinterpret_cast<const char *>(slip_data.data()), slip_data.size(), 0);
+	// requests can be sent from several threads once pipelined
+	std::lock_guard<std::mutex> lock(send_mutex_);
+	SLIP::encode_into(data.data(), data.size(), send_buffer_);
+	send(socket_, reinterpret_cast<const char *>(send_buffer_.data()), send_buffer_.size(), 0);
 }
 
 void TCPConnection::create_read_channel()
@@ -63,7 +65,6 @@ void TCPConnection::create_read_channel()
 
 	// Start a new thread to listen for incoming data
 	reading_thread_ = std::thread([self = std::move(self_ptr)]() {
-		std::vector<uint8_t> complete_data;
 		std::vector<uint8_t> buffer(1024);
 		bool is_initialising = true;
 
@@ -75,62 +76,38 @@ void TCPConnection::create_read_channel()
 
 		while (self->is_connected() || is_initialising)
 		{
-			int valread = 0;
-			do
+			if (is_initialising)
 			{
-				if (is_initialising)
-				{
-					is_initialising = false;
-					LogFileOutput("SmartPortOverSlip TCPConnection: connected\n");
-					self->set_is_connected(true);
-				}
-
-				valread = recv(self->get_socket(), reinterpret_cast<char *>(buffer.data()), static_cast<int>(buffer.size()), 0);
-				const int errsv = errno;
-				if (valread < 0)
-				{
-					// timeout is fine, just reloop.
-					if (errno == EAGAIN || errno == EWOULDBLOCK || errno == 0)
-					{
-						continue;
-					}
-					// otherwise it was a genuine error.
-					LogFileOutput("Error in read thread for connection, errno: %d = %s\n", errsv, strerror(errsv));
-					self->set_is_connected(false);
-				}
-				if (valread == 0)
-				{
-					// disconnected, close connection
-					LogFileOutput("TCPConnection: recv == 0, disconnecting\n");
-					self->set_is_connected(false);
-				}
-				if (valread > 0)
-				{
-					// LogFileOutput("SmartPortOverSlip TCPConnection, inserting data, valread: %d\n", valread);
-					complete_data.insert(complete_data.end(), buffer.begin(), buffer.begin() + valread);
-				}
-			} while (valread == 1024);
+				is_initialising = false;
+				LogFileOutput("SmartPortOverSlip TCPConnection: connected\n");
+				self->set_is_connected(true);
+			}
 
-			if (!complete_data.empty())
+			const int valread = recv(self->get_socket(), reinterpret_cast<char *>(buffer.data()), static_cast<int>(buffer.size()), 0);
+			const int errsv = errno;
+			if (valread < 0)
 			{
-				std::vector<std::vector<uint8_t>> decoded_packets = SLIP::split_into_packets(complete_data.data(), complete_data.size());
-				// LogFileOutput("SmartPortOverSlip TCPConnection, packets decoded: %d\n", decoded_packets.size());
-
-				if (!decoded_packets.empty())
+				// timeout is fine, just reloop.
+				if (errsv == EAGAIN || errsv == EWOULDBLOCK || errsv == 0)
 				{
-					for (const auto &packet : decoded_packets)
-					{
-						if (!packet.empty())
-						{
-							{
-								std::lock_guard<std::mutex> lock(self->data_mutex_);
-								self->data_map_[packet[0]] = packet;
-							}
-							self->data_cv_.notify_all();
-						}
-					}
+					continue;
 				}
-				complete_data.clear();
+				// otherwise it was a genuine error.
+				LogFileOutput("Error in read thread for connection, errno: %d = %s\n", errsv, strerror(errsv));
+				self->set_is_connected(false);
+			}
+			if (valread == 0)
+			{
+				// disconnected, close connection
+				LogFileOutput("TCPConnection: recv == 0, disconnecting\n");
+				self->set_is_connected(false);
+			}
+			if (valread > 0)
+			{
+				// frames can straddle recv() calls, the decoder carries the partial one over
+				self->decoder_.feed(buffer.data(), valread, [&self](std::vector<uint8_t> &&packet) {
+					self->packet_received(std::move(packet));
+				});
 			}
 		}
 		GetCommandListener().connection_closed(self.get());
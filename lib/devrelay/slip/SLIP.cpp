@@ -103,47 +103,117 @@ std::vector<std::vector<uint8_t>> SLIP::split_into_packets(const uint8_t *data,
 	// The list of decoded SLIP packets
 	std::vector<std::vector<uint8_t>> decoded_packets;
 
-	enum class State
+	SLIPDecoder decoder;
+	decoder.feed(data, bytes_read, [&decoded_packets](std::vector<uint8_t> &&packet) {
+		decoded_packets.push_back(std::move(packet));
+	});
+
+	return decoded_packets;
+}
+
+void SLIP::encode_into(const uint8_t *data, size_t len, std::vector<uint8_t> &out)
+{
+	out.clear();
+	out.reserve(len + len / 16 + 2);
+
+	out.push_back(SLIP_END);
+	for (size_t i = 0; i < len; i++)
 	{
-		NotParsing,
-		Parsing
-	} state = State::NotParsing;
+		if (data[i] == SLIP_END || data[i] == SLIP_ESC)
+		{
+			out.push_back(SLIP_ESC);
+			out.push_back(data[i] == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC);
+		}
+		else
+		{
+			out.push_back(data[i]);
+		}
+	}
+	out.push_back(SLIP_END);
+}
 
-	// Iterate over the data and find the SLIP packet boundaries
-	size_t i = 0;
-	const uint8_t *packet_start = nullptr; // Keep track of where the packet starts
-	while (i < bytes_read)
+std::vector<uint8_t> SLIPBufferPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (spares_.empty())
+		return std::vector<uint8_t>();
+
+	std::vector<uint8_t> buffer = std::move(spares_.back());
+	spares_.pop_back();
+	return buffer;
+}
+
+void SLIPBufferPool::release(std::vector<uint8_t> &&buffer)
+{
+	buffer.clear();
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (spares_.size() < SLIP_POOL_SIZE && buffer.capacity() > 0)
+		spares_.push_back(std::move(buffer));
+}
+
+void SLIPDecoder::reset()
+{
+	state_ = State::Idle;
+	packet_.clear();
+}
+
+void SLIPDecoder::feed(const uint8_t *data, size_t len, const PacketHandler &on_packet)
+{
+	for (size_t i = 0; i < len; i++)
 	{
-		switch (state)
+		const uint8_t byte = data[i];
+
+		switch (state_)
 		{
-		case State::NotParsing:
-			// If we are not yet parsing and see a SLIP_END byte (which also marks start), start parsing a new SLIP packet
-			if (data[i] == SLIP_END)
+		case State::Idle:
+			// anything outside a frame is line noise
+			if (byte == SLIP_END)
+				state_ = State::Frame;
+			break;
+
+		case State::Frame:
+			if (byte == SLIP_END)
 			{
-				state = State::Parsing;
-				packet_start = data + i; // Mark the start of the packet
+				// END closes this frame and may also open the next one, so
+				// END END between frames is just an empty frame, not passed on
+				if (!packet_.empty())
+				{
+					std::vector<uint8_t> packet = std::move(packet_);
+					packet_ = pool_ ? pool_->acquire() : std::vector<uint8_t>();
+					on_packet(std::move(packet));
+				}
 			}
+			else if (byte == SLIP_ESC)
+				state_ = State::Escape;
+			else
+				packet_.push_back(byte);
 			break;
-		case State::Parsing:
-			// If we see another SLIP_END byte, we have reached the end of the SLIP packet
-			if (data[i] == SLIP_END)
-			{
-				// Extract the SLIP packet data
-				std::vector<uint8_t> slip_packet_data(packet_start, data + i + 1); // Include all bytes in the packet
-
-				// Add the data to the list of SLIP decoded packets
-				decoded_packets.push_back(SLIP::decode(slip_packet_data));
 
-				// Transition back to the NotParsing state
-				state = State::NotParsing;
+		case State::Escape:
+			if (byte == SLIP_ESC_END)
+			{
+				packet_.push_back(SLIP_END);
+				state_ = State::Frame;
+			}
+			else if (byte == SLIP_ESC_ESC)
+			{
+				packet_.push_back(SLIP_ESC);
+				state_ = State::Frame;
+			}
+			else
+			{
+				// Invalid escape sequence
+				packet_.clear();
+				state_ = byte == SLIP_END ? State::Frame : State::Discard;
 			}
 			break;
+
+		case State::Discard:
+			if (byte == SLIP_END)
+				state_ = State::Frame;
+			break;
 		}
-		i++;
 	}
-
-	return decoded_packets;
 }
 
-
 #endif
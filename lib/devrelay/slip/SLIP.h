@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <functional>
+#include <mutex>
 #include <stdint.h>
 #include <vector>
 
@@ -9,6 +11,9 @@
 #define SLIP_ESC_END 0334 /* ESC ESC_END means END data byte */
 #define SLIP_ESC_ESC 0335 /* ESC ESC_ESC means ESC data byte */
 
+// Spare packet buffers kept for reuse
+#define SLIP_POOL_SIZE 8
+
 class SLIP
 {
 public:
@@ -16,4 +21,46 @@ public:
 	static std::vector<uint8_t> encode(const std::vector<uint8_t> &data);
 	static std::vector<uint8_t> decode(const std::vector<uint8_t> &data);
 	static std::vector<std::vector<uint8_t>> split_into_packets(const uint8_t *data, size_t bytes_read);
+
+	// encode into out, reusing its storage
+	static void encode_into(const uint8_t *data, size_t len, std::vector<uint8_t> &out);
+};
+
+// Packet buffers handed out by the decoder and given back once a packet has
+// been dealt with, so a busy connection stops allocating after warming up.
+class SLIPBufferPool
+{
+public:
+	std::vector<uint8_t> acquire();
+	void release(std::vector<uint8_t> &&buffer);
+
+private:
+	std::mutex mutex_;
+	std::vector<std::vector<uint8_t>> spares_;
+};
+
+// Incremental SLIP decoder. Bytes can be fed in any split, e.g. straight from
+// each recv(); every complete, valid frame is passed to the callback as it
+// ends. Frames with a bad escape are dropped up to the next END.
+class SLIPDecoder
+{
+public:
+	using PacketHandler = std::function<void(std::vector<uint8_t> &&packet)>;
+
+	explicit SLIPDecoder(SLIPBufferPool *pool = nullptr) : pool_(pool) {}
+
+	void feed(const uint8_t *data, size_t len, const PacketHandler &on_packet);
+	void reset();
+
+private:
+	enum class State
+	{
+		Idle,	  // waiting for END to start a frame
+		Frame,	  // inside a frame
+		Escape,	  // after ESC
+		Discard	  // bad frame, skipping to the next END
+	} state_ = State::Idle;
+
+	std::vector<uint8_t> packet_;
+	SLIPBufferPool *pool_;
 };
@@ -1,150 +1,259 @@
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstring>
 #include <cstdlib>
 #include <memory>
-#include <vector>
 #include "base64.h"
 
 Base64 base64;
 
-std::unique_ptr<char[]> Base64::base64_gen_encode(const unsigned char* src, size_t len, size_t* out_len, const char* table, int add_pad) {
-    char *out, *pos;
-    const unsigned char *end, *in;
-    size_t olen;
-    int line_len;
+namespace {
 
-    if (len >= SIZE_MAX / 4)
-        return nullptr;
-    olen = len * 4 / 3 + 4; /* 3-byte blocks to 4-byte */
-    if (add_pad)
-        olen += olen / 72; /* line feeds */
-    olen++; /* nul termination */
-    if (olen < len)
-        return nullptr; /* integer overflow */
-    out = new char[olen];
-    if (out == nullptr)
-        return nullptr;
+// Decoding tables: the character's 6-bit value, PAD for '=', or SKIP
+const uint8_t PAD = 0x40;
+const uint8_t SKIP = 0x80;
+
+constexpr std::array<uint8_t, 256> make_dtable(const char (&table)[65])
+{
+    std::array<uint8_t, 256> dtable{};
+    for (auto &d : dtable)
+        d = SKIP;
+    for (int i = 0; i < 64; i++)
+        dtable[(unsigned char) table[i]] = i;
+    dtable['='] = PAD;
+    return dtable;
+}
+
+inline void store4(char *out, uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint32_t word = (uint32_t) a << 24 | (uint32_t) b << 16 | (uint32_t) c << 8 | d;
+#else
+    uint32_t word = (uint32_t) d << 24 | (uint32_t) c << 16 | (uint32_t) b << 8 | a;
+#endif
+    std::memcpy(out, &word, 4);
+}
+
+} // namespace
+
+struct Base64Tables
+{
+    static constexpr const char *encode(bool url) { return url ? Base64::base64_url_table : Base64::base64_table; }
+    static constexpr std::array<uint8_t, 256> standard = make_dtable(Base64::base64_table);
+    static constexpr std::array<uint8_t, 256> url = make_dtable(Base64::base64_url_table);
+};
+
+size_t Base64Encoder::update(const void* src, size_t len, char* out)
+{
+    const char *table = Base64Tables::encode(_url);
+    const uint8_t *in = static_cast<const uint8_t*>(src);
+    char *pos = out;
+
+    // Complete the group left over from the last call
+    if (_carry_len) {
+        uint8_t group[3] = { _carry[0], _carry[1], 0 };
+        size_t take = std::min<size_t>(3 - _carry_len, len);
+        std::memcpy(group + _carry_len, in, take);
+        in += take;
+        len -= take;
+        if (_carry_len + take < 3) {
+            std::memcpy(_carry, group, _carry_len + take);
+            _carry_len += take;
+            return 0;
+        }
+        _carry_len = 0;
+        // Re-enter the loop below with the completed group
+        size_t n = update(group, 3, pos);
+        pos += n;
+    }
 
-    end = src + len;
-    in = src;
-    pos = out;
-    line_len = 0;
-    while (end - in >= 3) {
-        *pos++ = table[(in[0] >> 2) & 0x3f];
-        *pos++ = table[(((in[0] & 0x03) << 4) | (in[1] >> 4)) & 0x3f];
-        *pos++ = table[(((in[1] & 0x0f) << 2) | (in[2] >> 6)) & 0x3f];
-        *pos++ = table[in[2] & 0x3f];
-        in += 3;
-        line_len += 4;
-        if (add_pad && line_len >= 72) {
-            *pos++ = '\n';
-            line_len = 0;
+    while (len >= 3) {
+        // A line at a time, so the line break is checked once per line
+        size_t groups = len / 3;
+        if (!_url)
+            groups = std::min<size_t>(groups, (72 - _line_len) / 4);
+        for (size_t g = 0; g < groups; g++) {
+            uint32_t v = (uint32_t) in[0] << 16 | (uint32_t) in[1] << 8 | in[2];
+            store4(pos, table[v >> 18], table[(v >> 12) & 0x3f], table[(v >> 6) & 0x3f], table[v & 0x3f]);
+            pos += 4;
+            in += 3;
+        }
+        len -= groups * 3;
+        if (!_url) {
+            _line_len += groups * 4;
+            if (_line_len >= 72) {
+                *pos++ = '\n';
+                _line_len = 0;
+            }
         }
     }
 
-    if (end - in) {
-        *pos++ = table[(in[0] >> 2) & 0x3f];
-        if (end - in == 1) {
-            *pos++ = table[((in[0] & 0x03) << 4) & 0x3f];
-            if (add_pad)
+    std::memcpy(_carry, in, len);
+    _carry_len = len;
+    return pos - out;
+}
+
+size_t Base64Encoder::finish(char* out)
+{
+    const char *table = Base64Tables::encode(_url);
+    char *pos = out;
+
+    if (_carry_len) {
+        *pos++ = table[_carry[0] >> 2];
+        if (_carry_len == 1) {
+            *pos++ = table[(_carry[0] & 0x03) << 4];
+            if (!_url)
                 *pos++ = '=';
         } else {
-            *pos++ = table[(((in[0] & 0x03) << 4) |
-                    (in[1] >> 4)) & 0x3f];
-            *pos++ = table[((in[1] & 0x0f) << 2) & 0x3f];
+            *pos++ = table[((_carry[0] & 0x03) << 4) | (_carry[1] >> 4)];
+            *pos++ = table[(_carry[1] & 0x0f) << 2];
         }
-        if (add_pad)
+        if (!_url)
             *pos++ = '=';
-        line_len += 4;
+        _line_len += 4;
     }
 
-    if (add_pad && line_len)
+    if (!_url && _line_len)
         *pos++ = '\n';
 
-    *pos = '\0';
-    if (out_len)
-        *out_len = pos - out;
-    return std::unique_ptr<char[]>(out);
+    reset();
+    return pos - out;
+}
+
+void Base64Encoder::update(const void* src, size_t len, std::string& out)
+{
+    size_t size = out.size();
+    out.resize(size + max_update(len));
+    out.resize(size + update(src, len, &out[size]));
 }
 
-std::unique_ptr<unsigned char[]> Base64::base64_gen_decode(const char* src, size_t len, size_t* out_len, const char* table) {
-    unsigned char dtable[256], *out, *pos, block[4], tmp;
-    size_t i, count, olen;
-    int pad = 0;
-    size_t extra_pad;
+void Base64Encoder::finish(std::string& out)
+{
+    size_t size = out.size();
+    out.resize(size + MAX_FINISH);
+    out.resize(size + finish(&out[size]));
+}
 
-    std::memset(dtable, 0x80, 256);
-    for (i = 0; i < sizeof(base64_table) - 1; i++)
-        dtable[(unsigned char) table[i]] = (unsigned char) i;
-    dtable['='] = 0;
+size_t Base64Decoder::update(const char* src, size_t len, uint8_t* out)
+{
+    const uint8_t *dtable = _url ? Base64Tables::url.data() : Base64Tables::standard.data();
+    const uint8_t *in = reinterpret_cast<const uint8_t*>(src);
+    const uint8_t *end = in + len;
+    uint8_t *pos = out;
 
-    count = 0;
-    for (i = 0; i < len; i++) {
-        if (dtable[(unsigned char) src[i]] != 0x80)
-            count++;
+    while (in < end && !_done) {
+        // Fast path: four characters from the alphabet on a group boundary
+        if (_count == 0 && end - in >= 4) {
+            uint8_t a = dtable[in[0]], b = dtable[in[1]], c = dtable[in[2]], d = dtable[in[3]];
+            if (((a | b | c | d) & (PAD | SKIP)) == 0) {
+                uint32_t v = (uint32_t) a << 18 | (uint32_t) b << 12 | (uint32_t) c << 6 | d;
+                pos[0] = v >> 16;
+                pos[1] = v >> 8;
+                pos[2] = v;
+                pos += 3;
+                in += 4;
+                _valid += 4;
+                continue;
+            }
+        }
+
+        // Otherwise one character at a time until the next group boundary
+        uint8_t val = dtable[*in++];
+        if (val == SKIP)
+            continue;
+        _valid++;
+        if (val == PAD) {
+            _pad++;
+            val = 0;
+        }
+        _block[_count++] = val;
+        if (_count == 4) {
+            *pos++ = (_block[0] << 2) | (_block[1] >> 4);
+            *pos++ = (_block[1] << 4) | (_block[2] >> 2);
+            *pos++ = (_block[2] << 6) | _block[3];
+            _count = 0;
+            if (_pad) {
+                if (_pad <= 2)
+                    pos -= _pad;
+                else
+                    _failed = true; /* Invalid padding */
+                _done = true;
+            }
+        }
     }
 
-    if (count == 0)
-        return nullptr;
-    extra_pad = (4 - count % 4) % 4;
+    return pos - out;
+}
+
+size_t Base64Decoder::finish(uint8_t* out, bool& ok)
+{
+    size_t n = 0;
+    if (!_done && _count)
+        n = update("===", 4 - _count, out);
+    ok = _valid && !_failed;
+    reset();
+    return n;
+}
+
+void Base64Decoder::update(const char* src, size_t len, std::string& out)
+{
+    size_t size = out.size();
+    out.resize(size + max_update(len));
+    out.resize(size + update(src, len, reinterpret_cast<uint8_t*>(&out[size])));
+}
 
-    olen = (count + extra_pad) / 4 * 3;
-    pos = out = new unsigned char[olen];
-    if (out == nullptr)
+bool Base64Decoder::finish(std::string& out)
+{
+    bool ok;
+    size_t size = out.size();
+    out.resize(size + MAX_FINISH);
+    out.resize(size + finish(reinterpret_cast<uint8_t*>(&out[size]), ok));
+    return ok;
+}
+
+std::unique_ptr<char[]> Base64::base64_gen_encode(const unsigned char* src, size_t len, size_t* out_len, bool url) {
+    if (len >= SIZE_MAX / 4)
         return nullptr;
 
-    count = 0;
-    for (i = 0; i < len + extra_pad; i++) {
-        unsigned char val;
+    Base64Encoder encoder(url);
+    std::unique_ptr<char[]> out(new char[Base64Encoder::max_update(len) + Base64Encoder::MAX_FINISH + 1]);
+    char *pos = out.get();
+    pos += encoder.update(src, len, pos);
+    pos += encoder.finish(pos);
 
-        if (i >= len)
-            val = '=';
-        else
-            val = src[i];
-        tmp = dtable[val];
-        if (tmp == 0x80)
-            continue;
+    *pos = '\0';
+    if (out_len)
+        *out_len = pos - out.get();
+    return out;
+}
 
-        if (val == '=')
-            pad++;
-        block[count] = tmp;
-        count++;
-        if (count == 4) {
-            *pos++ = (block[0] << 2) | (block[1] >> 4);
-            *pos++ = (block[1] << 4) | (block[2] >> 2);
-            *pos++ = (block[2] << 6) | block[3];
-            count = 0;
-            if (pad) {
-                if (pad == 1)
-                    pos--;
-                else if (pad == 2)
-                    pos -= 2;
-                else {
-                    /* Invalid padding */
-                    delete[] out;
-                    return nullptr;
-                }
-                break;
-            }
-        }
-    }
+std::unique_ptr<unsigned char[]> Base64::base64_gen_decode(const char* src, size_t len, size_t* out_len, bool url) {
+    Base64Decoder decoder(url);
+    std::unique_ptr<unsigned char[]> out(new unsigned char[Base64Decoder::max_update(len) + Base64Decoder::MAX_FINISH]);
+    unsigned char *pos = out.get();
+    bool ok;
+    pos += decoder.update(src, len, pos);
+    pos += decoder.finish(pos, ok);
+    if (!ok)
+        return nullptr;
 
-    *out_len = pos - out;
-    return std::unique_ptr<unsigned char[]>(out);
+    *out_len = pos - out.get();
+    return out;
 }
 
 std::unique_ptr<char[]> Base64::encode(const void* src, size_t len, size_t* out_len) {
-    return base64_gen_encode(static_cast<const unsigned char*>(src), len, out_len, base64_table, 1);
+    return base64_gen_encode(static_cast<const unsigned char*>(src), len, out_len, false);
 }
 
 std::unique_ptr<char[]> Base64::url_encode(const void* src, size_t len, size_t* out_len) {
-    return base64_gen_encode(static_cast<const unsigned char*>(src), len, out_len, base64_url_table, 0);
+    return base64_gen_encode(static_cast<const unsigned char*>(src), len, out_len, true);
 }
 
 std::unique_ptr<unsigned char[]> Base64::decode(const char* src, size_t len, size_t* out_len) {
-    return base64_gen_decode(src, len, out_len, base64_table);
+    return base64_gen_decode(src, len, out_len, false);
 }
 
 std::unique_ptr<unsigned char[]> Base64::url_decode(const char* src, size_t len, size_t* out_len) {
-    return base64_gen_decode(src, len, out_len, base64_url_table);
+    return base64_gen_decode(src, len, out_len, true);
 }
@@ -14,13 +14,86 @@
 #include <string>
 #include <memory>
 
+/*
+ * Streaming encoder and decoder
+ *
+ * Input can arrive in chunks of any size; each update() call emits as much
+ * output as the input so far allows and carries the rest (at most one
+ * partial 3-byte or 4-character group) to the next call. finish() flushes
+ * the carry. The output is byte for byte what the one-shot Base64::encode
+ * and Base64::decode produce for the whole input, which are built on these.
+ *
+ * Whole groups take a table-driven fast path: the encoder packs each group's
+ * four characters into one 32-bit store, and the decoder looks up four
+ * characters and checks them with a single OR before combining them.
+ */
+
+class Base64Encoder {
+public:
+    // url: URL alphabet, no padding and no line breaks
+    explicit Base64Encoder(bool url = false) : _url(url) {}
+
+    void reset() { _carry_len = 0; _line_len = 0; }
+
+    // Most that update() writes for len bytes, and that finish() writes
+    static size_t max_update(size_t len) { return (len + 2) / 3 * 4 + (len + 2) / 54 + 1; }
+    static const size_t MAX_FINISH = 6;
+
+    // Encode len bytes into out, returning the number of characters written
+    size_t update(const void* src, size_t len, char* out);
+    size_t finish(char* out);
+
+    // Same, appending to a string
+    void update(const void* src, size_t len, std::string& out);
+    void finish(std::string& out);
+
+private:
+    bool _url;
+    uint8_t _carry[2];
+    uint8_t _carry_len = 0;
+    uint8_t _line_len = 0;
+};
+
+class Base64Decoder {
+public:
+    explicit Base64Decoder(bool url = false) : _url(url) {}
+
+    void reset() { _count = 0; _pad = 0; _valid = 0; _done = false; _failed = false; }
+
+    static size_t max_update(size_t len) { return (len + 3) / 4 * 3; }
+    static const size_t MAX_FINISH = 3;
+
+    // Decode len characters into out, returning the number of bytes written.
+    // Characters outside the alphabet are skipped, and anything after the
+    // first padded group is ignored.
+    size_t update(const char* src, size_t len, uint8_t* out);
+
+    // Pads a trailing partial group. ok is false if the padding was invalid
+    // or there was nothing to decode. Resets the decoder either way.
+    size_t finish(uint8_t* out, bool& ok);
+
+    void update(const char* src, size_t len, std::string& out);
+    bool finish(std::string& out);
+
+private:
+    bool _url;
+    uint8_t _block[4];
+    uint8_t _count = 0;
+    uint8_t _pad = 0;
+    bool _done = false;
+    bool _failed = false;
+    size_t _valid = 0;
+};
+
 class Base64 {
 private:
     static inline const char base64_table[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     static inline const char base64_url_table[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
 
-    static std::unique_ptr<char[]> base64_gen_encode(const unsigned char* src, size_t len, size_t* out_len, const char* table, int add_pad);
-    static std::unique_ptr<unsigned char[]> base64_gen_decode(const char* src, size_t len, size_t* out_len, const char* table);
+    static std::unique_ptr<char[]> base64_gen_encode(const unsigned char* src, size_t len, size_t* out_len, bool url);
+    static std::unique_ptr<unsigned char[]> base64_gen_decode(const char* src, size_t len, size_t* out_len, bool url);
+
+    friend struct Base64Tables;
 
 public:
     /**
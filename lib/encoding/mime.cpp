@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "mime.h"
+
+namespace {
+
+bool ci_equal(const std::string& a, const char* b)
+{
+    size_t n = strlen(b);
+    if (a.size() != n) return false;
+    for (size_t i = 0; i < n; i++)
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    return true;
+}
+
+int hexval(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+} // namespace
+
+MimeDecoder::MimeDecoder(const std::string& encoding)
+{
+    if (ci_equal(encoding, "BASE64"))
+        _encoding = Encoding::BASE64;
+    else if (ci_equal(encoding, "QUOTED-PRINTABLE"))
+        _encoding = Encoding::QUOTED_PRINTABLE;
+}
+
+void MimeDecoder::update(const char* data, size_t len, std::string& out, bool last)
+{
+    switch (_encoding)
+    {
+    case Encoding::BASE64:
+        _base64.update(data, len, out);
+        if (last)
+            _base64.finish(out); // a bad tail decodes to nothing, as before
+        break;
+
+    case Encoding::QUOTED_PRINTABLE:
+    {
+        std::string in = _carry;
+        in.append(data, len);
+        _carry.clear();
+
+        // An escape needs up to two bytes after the '=', which may be in
+        // the next chunk
+        if (!last)
+        {
+            size_t eq = in.find('=', in.size() > 2 ? in.size() - 2 : 0);
+            if (eq != std::string::npos)
+            {
+                _carry = in.substr(eq);
+                in.resize(eq);
+            }
+        }
+        out += qp_decode(in);
+        break;
+    }
+
+    default:
+        out.append(data, len);
+        break;
+    }
+}
+
+size_t MimeDecoder::encoded_size(size_t decoded) const
+{
+    if (_encoding == Encoding::BASE64)
+    {
+        // 4 characters per 3 bytes, plus a CRLF every 76 characters
+        size_t chars = (decoded + 2) / 3 * 4;
+        return chars + (chars / 76 + 1) * 2;
+    }
+    return decoded;
+}
+
+std::string MimeDecoder::qp_decode(const std::string& in)
+{
+    std::string out;
+    out.reserve(in.size());
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        char c = in[i];
+        if (c == '=')
+        {
+            if (i + 2 < in.size() && hexval(in[i + 1]) >= 0 && hexval(in[i + 2]) >= 0)
+            {
+                out += (char)((hexval(in[i + 1]) << 4) | hexval(in[i + 2]));
+                i += 2;
+            }
+            else if (i + 2 < in.size() && in[i + 1] == '\r' && in[i + 2] == '\n')
+                i += 2; // soft line break
+            else if (i + 1 < in.size() && in[i + 1] == '\n')
+                i += 1;
+            // otherwise drop a stray '='
+        }
+        else
+            out += c;
+    }
+    return out;
+}
+
+size_t text_holdback(const std::string& text, const std::string& eol, bool utf8)
+{
+    // Longest proper prefix of eol that the text ends with
+    size_t longest = eol.empty() ? 0 : std::min(eol.size() - 1, text.size());
+    for (size_t n = longest; n > 0; n--)
+    {
+        if (text.compare(text.size() - n, n, eol, 0, n) == 0)
+            return n;
+    }
+
+    if (!utf8)
+        return 0;
+
+    // Walk back over continuation bytes to the lead byte of the last sequence
+    size_t n = 0;
+    while (n < text.size() && n < 4)
+    {
+        unsigned char c = text[text.size() - 1 - n];
+        n++;
+        if ((c & 0xC0) == 0x80)
+            continue;           // continuation byte
+        size_t want = (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 1;
+        return want > n ? n : 0;
+    }
+    return 0;
+}
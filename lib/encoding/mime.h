@@ -0,0 +1,47 @@
+/*
+ * Content-Transfer-Encoding decoding (RFC 2045)
+ *
+ * MimeDecoder decodes base64 and quoted-printable a chunk at a time, so a
+ * mail part can be fetched and handed on in pieces without holding all of
+ * it. Other encodings (7bit, 8bit, binary) pass through unchanged.
+ */
+
+#ifndef MIME_H
+#define MIME_H
+
+#include <cstddef>
+#include <string>
+
+#include "base64.h"
+
+class MimeDecoder {
+public:
+    // encoding: the part's Content-Transfer-Encoding, any case
+    explicit MimeDecoder(const std::string& encoding = "");
+
+    // Decode len bytes and append them to out. Pass last=true with the final
+    // chunk (which may be empty) to flush anything held back.
+    void update(const char* data, size_t len, std::string& out, bool last = false);
+
+    // Encoded bytes to fetch for about `decoded` bytes of output
+    size_t encoded_size(size_t decoded) const;
+
+    // One-shot quoted-printable decode. Soft line breaks are removed and a
+    // stray '=' is dropped.
+    static std::string qp_decode(const std::string& in);
+
+private:
+    enum class Encoding { IDENTITY, BASE64, QUOTED_PRINTABLE };
+
+    Encoding _encoding = Encoding::IDENTITY;
+    Base64Decoder _base64;
+    std::string _carry;     // an incomplete "=XX" or soft break from the last chunk
+};
+
+// Decoded text is translated for the host a piece at a time. This is how
+// many bytes at the end of `text` to hold back for the next piece: the start
+// of a line ending `eol` (a CR that may be half a CRLF) or, with utf8, an
+// unfinished UTF-8 sequence. Nothing is held back from the last piece.
+size_t text_holdback(const std::string& text, const std::string& eol, bool utf8);
+
+#endif /* MIME_H */
@@ -814,7 +814,7 @@ int32_t fnFTP::get_file_size(string path)
     }
 }
 
-fujiError_t fnFTP::open_file(string path, bool stor)
+fujiError_t fnFTP::open_file(string path, bool stor, unsigned long offset)
 {
     if (!control->connected())
     {
@@ -836,6 +836,19 @@ fujiError_t fnFTP::open_file(string path, bool stor)
         return FUJI_ERROR::UNSPECIFIED;
     }
 
+    if (stor == false && offset > 0)
+    {
+        REST(offset);
+        if (parse_response() != FUJI_ERROR::NONE || status() != 350)
+        {
+            Debug_printf("Server could not restart at %lu. Response was: %s\r\n", offset, controlResponse.c_str());
+            data->stop();
+            if (_active_mode)
+                _active_server.stop();
+            return FUJI_ERROR::UNSPECIFIED;
+        }
+    }
+
     // Do command
     if (stor == true)
     {
@@ -870,11 +883,11 @@ fujiError_t fnFTP::open_file(string path, bool stor)
     }
 }
 
-fujiError_t fnFTP::open_directory(string path, string pattern)
+fujiError_t fnFTP::start_directory(string path, string pattern)
 {
     if (!control->connected())
     {
-        Debug_printf("fnFTP::open_directory(%s%s) attempted while not logged in. Aborting.\r\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::start_directory(%s%s) attempted while not logged in. Aborting.\r\n", path.c_str(), pattern.c_str());
         return FUJI_ERROR::UNSPECIFIED;
     }
 
@@ -888,7 +901,7 @@ fujiError_t fnFTP::open_directory(string path, string pattern)
             if (reconnect() == FUJI_ERROR::NONE)
                 continue; // successfully reconnected
         }
-        Debug_printf("fnFTP::open_directory(%s%s) could not get data port, aborting.\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::start_directory(%s%s) could not get data port, aborting.\n", path.c_str(), pattern.c_str());
         return FUJI_ERROR::UNSPECIFIED;
     }
 
@@ -897,13 +910,13 @@ fujiError_t fnFTP::open_directory(string path, string pattern)
 
     if (parse_response() != FUJI_ERROR::NONE)
     {
-        Debug_printf("fnFTP::open_directory(%s%s) Timed out waiting for 150 response.\r\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::start_directory(%s%s) Timed out waiting for 150 response.\r\n", path.c_str(), pattern.c_str());
         if (_active_mode)
             _active_server.stop();
         return FUJI_ERROR::UNSPECIFIED;
     }
 
-    Debug_printf("fnFTP::open_directory(%s%s) - %s\r\n", path.c_str(), pattern.c_str(), controlResponse.c_str());
+    Debug_printf("fnFTP::start_directory(%s%s) - %s\r\n", path.c_str(), pattern.c_str(), controlResponse.c_str());
 
     if ((is_positive_preliminary_reply() == FUJI_ERROR::NONE) && is_filesystem_related())
     {
@@ -920,10 +933,23 @@ fujiError_t fnFTP::open_directory(string path, string pattern)
 
     if (accept_active_connection() != FUJI_ERROR::NONE)
     {
-        Debug_printf("fnFTP::open_directory(%s%s) - active mode connection failed.\r\n", path.c_str(), pattern.c_str());
+        Debug_printf("fnFTP::start_directory(%s%s) - active mode connection failed.\r\n", path.c_str(), pattern.c_str());
         return FUJI_ERROR::UNSPECIFIED;
     }
 
+    // The LIST's completion reply (226) follows the data
+    _stor = false;
+    _expect_control_response = true;
+    _dir_pending.clear();
+
+    return FUJI_ERROR::NONE;
+}
+
+fujiError_t fnFTP::open_directory(string path, string pattern)
+{
+    if (start_directory(path, pattern) != FUJI_ERROR::NONE)
+        return FUJI_ERROR::UNSPECIFIED;
+
     uint8_t buf[256];
 
     // if (buf == nullptr)
@@ -970,6 +996,7 @@ fujiError_t fnFTP::open_directory(string path, string pattern)
     } while (data->available() > 0 || data->connected());
 
     data->stop();
+    _expect_control_response = false;
 
     if (tmout_counter == 0 || (got_response == false && parse_response() != FUJI_ERROR::NONE))
     {
@@ -980,6 +1007,92 @@ fujiError_t fnFTP::open_directory(string path, string pattern)
     return FUJI_ERROR::NONE; // all good.
 }
 
+fnFTP::list_result_t fnFTP::next_directory(string &name, long &filesize, bool &is_dir)
+{
+    uint64_t last_data = fnSystem.millis();
+    uint8_t buf[512];
+
+    while (true)
+    {
+        // A complete line is waiting
+        size_t eol = _dir_pending.find('\n');
+        if (eol != string::npos)
+        {
+            string line = _dir_pending.substr(0, eol);
+            _dir_pending.erase(0, eol + 1);
+            if (parse_directory_line(line, name, filesize, is_dir))
+                return LIST_ENTRY;
+            continue;
+        }
+
+        int len = data->available();
+        if (len > 0)
+        {
+            int num_read = data->read(buf, len > (int)sizeof(buf) ? (int)sizeof(buf) : len);
+            if (num_read > 0)
+                _dir_pending.append((const char *)buf, num_read);
+            last_data = fnSystem.millis();
+            continue;
+        }
+
+        if (!data->connected())
+        {
+            // A last line without a line ending
+            if (!_dir_pending.empty())
+            {
+                string line;
+                line.swap(_dir_pending);
+                if (parse_directory_line(line, name, filesize, is_dir))
+                    return LIST_ENTRY;
+            }
+
+            // A closed data connection is only the whole listing with a 226
+            data->stop();
+            _expect_control_response = false;
+            if (parse_response() != FUJI_ERROR::NONE || !is_positive_completion_reply())
+            {
+                Debug_printf("fnFTP::next_directory - no 226 after the listing\r\n");
+                return LIST_FAILED;
+            }
+            return LIST_END;
+        }
+
+        if (fnSystem.millis() - last_data > FTP_TIMEOUT)
+        {
+            Debug_printf("fnFTP::next_directory - Timeout\r\n");
+            abort_transfer();
+            return LIST_FAILED;
+        }
+        fnSystem.delay(5); // wait for more data
+    }
+}
+
+bool fnFTP::parse_directory_line(string &line, string &name, long &filesize, bool &is_dir)
+{
+    struct ftpparse parse;
+
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    if (line.empty())
+        return false;
+
+    // Lines ftpparse doesn't understand ("total 42") have no name
+    if (ftpparse(&parse, (char *)line.c_str(), line.length()) == 0 || parse.name == nullptr)
+        return false;
+    name = string(parse.name, parse.namelen);
+
+    // Strip symlink target from name (e.g., "transfer -> crossplatform/transfer/" becomes "transfer")
+    size_t arrow_pos = name.find(" -> ");
+    if (arrow_pos != string::npos)
+    {
+        name = name.substr(0, arrow_pos);
+    }
+
+    filesize = parse.size;
+    is_dir = (parse.flagtrycwd == 1);
+    return true;
+}
+
 fujiError_t fnFTP::read_directory(string &name, long &filesize, bool &is_dir)
 {
     string line;
@@ -1062,6 +1175,44 @@ fujiError_t fnFTP::close()
     return res;
 }
 
+fujiError_t fnFTP::abort_transfer()
+{
+    Debug_printf("fnFTP::abort_transfer()\r\n");
+    if (_stor)
+        return close();
+
+    // Closing the data connection first ends the transfer even on servers that
+    // don't watch the control connection during one. The server then owes the
+    // RETR's reply (426, or 226 if it had finished) unless data_connected()
+    // already took it, and always one for ABOR.
+    int replies = _expect_control_response ? 2 : 1;
+    data->stop();
+    ABOR();
+
+    fujiError_t res = FUJI_ERROR::NONE;
+    while (replies-- > 0)
+    {
+        if (parse_response() != FUJI_ERROR::NONE && _statusCode == 421)
+        {
+            Debug_printf("Timed out waiting for ABOR response.\r\n");
+            res = FUJI_ERROR::UNSPECIFIED;
+            break;
+        }
+    }
+    _expect_control_response = false;
+    control->flush();
+    return res;
+}
+
+bool fnFTP::restart_supported()
+{
+    if (!control->connected())
+        return false;
+
+    REST(0);
+    return parse_response() == FUJI_ERROR::NONE && status() == 350;
+}
+
 int fnFTP::status()
 {
     return _statusCode;
@@ -1469,6 +1620,12 @@ void fnFTP::SIZE(string path)
     control->write("SIZE " + path + "\r\n");
 }
 
+void fnFTP::REST(unsigned long offset)
+{
+    Debug_printf("fnFTP::REST(%lu)\r\n", offset);
+    control->write("REST " + std::to_string(offset) + "\r\n");
+}
+
 void fnFTP::NOOP()
 {
     Debug_printf("fnFTP::NOOP\r\n");
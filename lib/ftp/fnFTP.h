@@ -56,9 +56,23 @@ public:
      * Open file on FTP server
      * @param path to file to open.
      * @param stor TRUE means STOR, otherwise RETR
+     * @param offset for RETR, byte position to restart the transfer at (REST)
      * @return TRUE if error, FALSE if successful.
      */
-    fujiError_t open_file(string path, bool stor);
+    fujiError_t open_file(string path, bool stor, unsigned long offset = 0);
+
+    /**
+     * Stop a RETR before the end of the file, leaving the control connection
+     * ready for the next command.
+     * @return TRUE if error, FALSE if successful.
+     */
+    fujiError_t abort_transfer();
+
+    /**
+     * @brief ask the server whether it can restart transfers (REST STREAM)
+     * @return true if open_file() can be given an offset
+     */
+    bool restart_supported();
 
     /**
      * Open directory on FTP server, grab it, and return back.
@@ -76,6 +90,34 @@ public:
      */
     fujiError_t read_directory(string& name, long& filesize, bool &is_dir);
 
+    /**
+     * Start a LIST and return once its data connection is up, for reading
+     * the listing with next_directory() as it arrives.
+     * @param path directory to retrieve.
+     * @param pattern pattern to retrieve.
+     * @return TRUE if error, FALSE if successful.
+     */
+    fujiError_t start_directory(string path, string pattern);
+    /**
+     * What next_directory() got
+     */
+    enum list_result_t
+    {
+        LIST_ENTRY,  // an entry
+        LIST_END,    // end of the listing, confirmed by the server (2xx)
+        LIST_FAILED, // timeout or error: the listing may be incomplete
+    };
+
+    /**
+     * Wait for and parse the next entry of a listing from start_directory().
+     * Stop early with abort_transfer().
+     * @param name output name
+     * @param filesize output filesize
+     * @param is_dir output directory flag
+     * @return LIST_ENTRY with an entry, LIST_END or LIST_FAILED once done
+     */
+    list_result_t next_directory(string& name, long& filesize, bool &is_dir);
+
     /**
      * Read file from data socket into buffer.
      * @param buf target buffer
@@ -187,6 +229,11 @@ private:
      */
     std::stringstream dirBuffer;
 
+    /**
+     * Listing data received by next_directory() but not parsed yet
+     */
+    string _dir_pending;
+
     /**
      * The data port returned by EPSV/PASV
      */
@@ -209,6 +256,12 @@ private:
      */
     fujiError_t parse_response();
 
+    /**
+     * parse one line of LIST output
+     * @return false if the line has no entry (blank, "total 42")
+     */
+    bool parse_directory_line(string &line, string &name, long &filesize, bool &is_dir);
+
     /**
      * read single line of control response
      * @return bytes read
@@ -396,6 +449,12 @@ private:
      */
     void SIZE(string path);
 
+    /**
+     * @brief send REST command to server to set the next RETR's start position
+     * @param offset start byte position
+     */
+    void REST(unsigned long offset);
+
     /**
      * @brief send NOOP command to server
      */
@@ -206,6 +206,12 @@ void fujiHost::dir_close()
         _fs->dir_close();
 }
 
+// Open directory still loading in the background (or not yet re-read sorted)
+bool fujiHost::dir_partial()
+{
+    return _type != HOSTTYPE_UNINITIALIZED && _fs != nullptr && _fs->dir_partial();
+}
+
 bool fujiHost::file_exists(const char *path)
 {
     if (_type == HOSTTYPE_UNINITIALIZED || _fs == nullptr)
@@ -80,6 +80,7 @@ public:
     fsdir_entry_t * dir_nextfile();
     uint16_t dir_tell();
     success_is_true dir_seek(uint16_t position);
+    bool dir_partial();
 
 };
 
@@ -625,7 +625,7 @@ int fnHttpClient::PUT(const char *put_data, int put_datalen)
 #ifdef VERBOSE_HTTP
     Debug_println("fnHttpClient::PUT");
 #endif
-    if (_handle == nullptr || put_data == nullptr || put_datalen < 1)
+    if (_handle == nullptr || put_data == nullptr || put_datalen < 0)
         return -1;
 
     // Get rid of any pending data
@@ -750,7 +750,7 @@ int fnHttpClient::POST(const char *post_data, int post_datalen)
 #ifdef VERBOSE_HTTP
     Debug_println("fnHttpClient::POST");
 #endif
-    if (_handle == nullptr || post_data == nullptr || post_datalen < 1)
+    if (_handle == nullptr || post_data == nullptr || post_datalen < 0)
         return -1;
 
     // Get rid of any pending data
@@ -161,6 +161,33 @@ void fnHttpService::set_file_content_type(httpd_req_t *req, const char *filepath
     }
 }
 
+/* Render a compiled template as response chunks, gathering the small pieces
+   into FNWS_SEND_BUFF_SIZE blocks so each tag value isn't its own send
+*/
+static void send_template_chunks(httpd_req_t *req, const fnHttpServiceParser::compiled_template &tpl)
+{
+    char buf[FNWS_SEND_BUFF_SIZE];
+    size_t used = 0;
+
+    fnHttpServiceParser::render(tpl, [req, &buf, &used](const char *data, size_t len) {
+        if (used + len > sizeof(buf) && used > 0)
+        {
+            httpd_resp_send_chunk(req, buf, used);
+            used = 0;
+        }
+        if (len > sizeof(buf))
+        {
+            httpd_resp_send_chunk(req, data, len);
+            return;
+        }
+        memcpy(buf + used, data, len);
+        used += len;
+    });
+
+    if (used > 0)
+        httpd_resp_send_chunk(req, buf, used);
+}
+
 /* Sends header.html or footer.html from SPIFFS. 0 for header, 1 for footer */
 void fnHttpService::send_header_footer(httpd_req_t *req, int headfoot)
 {
@@ -182,33 +209,15 @@ void fnHttpService::send_header_footer(httpd_req_t *req, int headfoot)
 
     // Retrieve server state
     serverstate *pState = (serverstate *)httpd_get_global_user_ctx(req->handle);
-    FILE *fInput = pState->_FS->file_open(fpath.c_str());
+    auto tpl = fnHttpServiceParser::load_template(pState->_FS, fpath.c_str());
 
-    if (fInput == nullptr)
+    if (tpl == nullptr)
     {
         Debug_println("Failed to open header file for parsing");
-    }
-    else
-    {
-        size_t sz = FileSystem::filesize(fInput) + 1;
-        char *buf = (char *)calloc(sz, 1);
-        if (buf == NULL)
-        {
-            Debug_printf("Couldn't allocate %u bytes to load file contents!\n", sz);
-        }
-        else
-        {
-            fread(buf, 1, sz, fInput);
-            string contents(buf);
-            contents = fnHttpServiceParser::parse_contents(contents);
-
-            httpd_resp_sendstr_chunk(req, contents.c_str());
-        }
-        free(buf);
+        return;
     }
 
-    if (fInput != nullptr)
-        fclose(fInput);
+    send_template_chunks(req, *tpl);
 }
 
 /* Send file content after parsing for replaceable strings
@@ -220,45 +229,21 @@ void fnHttpService::send_file_parsed(httpd_req_t *req, const char *filename)
     Debug_printf("Opening file for parsing: '%s'\n", filename);
 #endif
 
-    _fnwserr err = fnwserr_noerrr;
-
     // Retrieve server state
     serverstate *pState = (serverstate *)httpd_get_global_user_ctx(req->handle);
-    FILE *fInput = pState->_FS->file_open(filename);
+    auto tpl = fnHttpServiceParser::load_template(pState->_FS, filename);
 
-    if (fInput == nullptr)
+    if (tpl == nullptr)
     {
         Debug_println("Failed to open file for parsing");
-        err = fnwserr_fileopen;
-    }
-    else
-    {
-        // Set the response content type
-        set_file_content_type(req, filename);
-        // We're going to load the whole thing into memory, so watch out for big files!
-        size_t sz = FileSystem::filesize(fInput) + 1;
-        char *buf = (char *)calloc(sz, 1);
-        if (buf == NULL)
-        {
-            Debug_printf("Couldn't allocate %u bytes to load file contents!\n", sz);
-            err = fnwserr_memory;
-        }
-        else
-        {
-            fread(buf, 1, sz, fInput);
-            string contents(buf);
-            contents = fnHttpServiceParser::parse_contents(contents);
-
-            httpd_resp_send(req, contents.c_str(), contents.length());
-        }
-        free(buf);
+        return_http_error(req, fnwserr_fileopen);
+        return;
     }
 
-    if (fInput != nullptr)
-        fclose(fInput);
-
-    if (err != fnwserr_noerrr)
-        return_http_error(req, err);
+    // Set the response content type
+    set_file_content_type(req, filename);
+    send_template_chunks(req, *tpl);
+    httpd_resp_send_chunk(req, nullptr, 0);
 }
 
 /* Send content of given file out to client
@@ -1290,7 +1275,9 @@ typedef esp_err_t (*fn_uri_handler)(httpd_req_t *);
 
 // esp_http_server has no pre-dispatch hook, so every route is registered
 // against this trampoline with its real handler carried in user_ctx.
-static fn_uri_handler s_real_handlers[64];
+// Room for every route and the WebDAV methods (47 handlers in all).
+#define HTTP_MAX_URI_HANDLERS 64
+static fn_uri_handler s_real_handlers[HTTP_MAX_URI_HANDLERS];
 
 static esp_err_t auth_dispatch(httpd_req_t *req)
 {
@@ -2381,8 +2368,10 @@ httpd_handle_t fnHttpService::start_server(serverstate &state)
     config.task_priority = 12; // Bump this higher than fnService loop
     config.core_id = 0; // Pin to CPU core 0
     config.stack_size = 12288;
-    // Budget: 35 routes registered here + 11 WebDAV = 46 handlers
-    config.max_uri_handlers = 64;
+    config.max_uri_handlers = HTTP_MAX_URI_HANDLERS;
+    if (uris.size() + WEBDAV_URI_HANDLERS > config.max_uri_handlers)
+        Debug_printf("httpServiceInit: %u URI handlers, room for %u - raise HTTP_MAX_URI_HANDLERS\r\n",
+                     (unsigned)(uris.size() + WEBDAV_URI_HANDLERS), (unsigned)config.max_uri_handlers);
     config.max_resp_headers = 16;
     config.keep_alive_enable = true;
     config.uri_match_fn = httpd_uri_match_wildcard;
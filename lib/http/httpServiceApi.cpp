@@ -18,6 +18,7 @@
 #include "fujiDevice.h"
 #include "httpService.h"
 #include "httpServiceBrowse.h"
+#include "BusTrace.h"
 
 #ifdef BUILD_ATARI
 #include "sio/sioFuji.h"
@@ -566,6 +567,136 @@ fnHttpApi::response h_wifi_status(const request &)
     return from_cjson(root);
 }
 
+// GET /api/v1/bus/trace - Recent bus transactions and per-command latency
+fnHttpApi::response h_bus_trace(const request &)
+{
+    cJSON *root = cJSON_CreateObject();
+    if (root == nullptr)
+        return json_error("out of memory", 500);
+
+#ifdef BUS_TRACE
+    cJSON_AddBoolToObject(root, "enabled", true);
+    cJSON_AddNumberToObject(root, "total", busTrace.total());
+
+    cJSON *limits = cJSON_AddArrayToObject(root, "bucket_limits_us");
+    for (int i = 0; limits && i < BUS_TRACE_BUCKETS - 1; i++)
+        cJSON_AddItemToArray(limits, cJSON_CreateNumber(BusTrace::bucketLimit(i)));
+
+    std::vector<BusTraceHistogram> hists(BUS_TRACE_SLOTS);
+    hists.resize(busTrace.histograms(hists.data(), hists.size()));
+    cJSON *commands = cJSON_AddArrayToObject(root, "commands");
+    for (const auto &h : hists)
+    {
+        cJSON *item = cJSON_CreateObject();
+        if (commands == nullptr || item == nullptr)
+            break;
+        cJSON_AddNumberToObject(item, "device", h.device);
+        cJSON_AddNumberToObject(item, "command", h.command);
+        cJSON_AddNumberToObject(item, "count", h.count);
+        cJSON_AddNumberToObject(item, "errors", h.errors);
+        cJSON_AddNumberToObject(item, "avg_us", h.count ? (double) h.total_us / h.count : 0);
+        cJSON_AddNumberToObject(item, "max_us", h.max_us);
+        cJSON *buckets = cJSON_AddArrayToObject(item, "buckets");
+        for (int i = 0; buckets && i < BUS_TRACE_BUCKETS; i++)
+            cJSON_AddItemToArray(buckets, cJSON_CreateNumber(h.buckets[i]));
+        cJSON_AddItemToArray(commands, item);
+    }
+
+    static const char *results[] = {"open", "success", "error", "sent", "sent_error"};
+    std::vector<BusTraceRecord> recs(BUS_TRACE_RECORDS);
+    recs.resize(busTrace.records(recs.data(), recs.size()));
+    cJSON *recent = cJSON_AddArrayToObject(root, "recent");
+    for (const auto &r : recs)
+    {
+        cJSON *item = cJSON_CreateObject();
+        if (recent == nullptr || item == nullptr)
+            break;
+        cJSON_AddNumberToObject(item, "device", r.device);
+        cJSON_AddNumberToObject(item, "command", r.command);
+        cJSON_AddNumberToObject(item, "start_us", r.start_us);
+        cJSON_AddNumberToObject(item, "accept_us", r.accept_us);
+        cJSON_AddNumberToObject(item, "end_us", r.end_us);
+        cJSON_AddNumberToObject(item, "bytes_in", r.bytes_in);
+        cJSON_AddNumberToObject(item, "bytes_out", r.bytes_out);
+        cJSON_AddStringToObject(item, "result", results[static_cast<int>(r.result)]);
+        cJSON_AddItemToArray(recent, item);
+    }
+#else
+    // Built without -D BUS_TRACE
+    cJSON_AddBoolToObject(root, "enabled", false);
+#endif /* BUS_TRACE */
+
+    return from_cjson(root);
+}
+
+fnHttpApi::response h_log(const request &r)
+{
+#ifdef DEBUG_ASYNC
+    if (r.m == fnHttpApi::method::POST)
+    {
+        fnHttpApi::response err;
+        cJSON *body = parse_body(r, err);
+        if (body == nullptr)
+            return err;
+
+        const char *module = cJSON_GetStringValue(cJSON_GetObjectItem(body, "module"));
+        const char *level_name = cJSON_GetStringValue(cJSON_GetObjectItem(body, "level"));
+        DebugLogLevel level;
+        if (module == nullptr || level_name == nullptr || !DebugLog::parse_level(level_name, level))
+        {
+            cJSON_Delete(body);
+            return json_error("expected module and level (off, error, warn, info, debug, verbose)", 400);
+        }
+        debugLog.set_level(module, level);
+        cJSON_Delete(body);
+    }
+#endif /* DEBUG_ASYNC */
+
+    cJSON *root = cJSON_CreateObject();
+    if (root == nullptr)
+        return json_error("out of memory", 500);
+
+#ifdef DEBUG_ASYNC
+    cJSON_AddBoolToObject(root, "enabled", true);
+    cJSON_AddNumberToObject(root, "dropped", debugLog.dropped());
+
+    cJSON *modules = cJSON_AddArrayToObject(root, "modules");
+    for (const auto &m : debugLog.modules())
+    {
+        cJSON *item = cJSON_CreateObject();
+        if (modules == nullptr || item == nullptr)
+            break;
+        cJSON_AddStringToObject(item, "name", m.name.c_str());
+        cJSON_AddStringToObject(item, "level", DebugLog::level_name(m.level));
+        cJSON_AddNumberToObject(item, "logged", m.logged);
+        cJSON_AddNumberToObject(item, "suppressed", m.suppressed);
+        cJSON_AddItemToArray(modules, item);
+    }
+
+    // GET only: a level change answers with the module list alone
+    if (r.m == fnHttpApi::method::GET)
+    {
+        cJSON *lines = cJSON_AddArrayToObject(root, "lines");
+        for (const auto &l : debugLog.history())
+        {
+            cJSON *item = cJSON_CreateObject();
+            if (lines == nullptr || item == nullptr)
+                break;
+            cJSON_AddNumberToObject(item, "time_us", (double) l.time_us);
+            cJSON_AddStringToObject(item, "module", l.module.c_str());
+            cJSON_AddStringToObject(item, "level", DebugLog::level_name(l.level));
+            cJSON_AddStringToObject(item, "text", l.text.c_str());
+            cJSON_AddItemToArray(lines, item);
+        }
+    }
+#else
+    // Not a debug build, or built without -D DEBUG_ASYNC
+    cJSON_AddBoolToObject(root, "enabled", false);
+#endif /* DEBUG_ASYNC */
+
+    return from_cjson(root);
+}
+
 // Route table. Order only matters for readability; matching is by pattern.
 const route routes[] = {
     {FN_API_ROOT "/status",         M_GET,            h_status},
@@ -579,6 +710,8 @@ const route routes[] = {
     {FN_API_ROOT "/printer/clear",  M_POST,           h_printer_clear},
     {FN_API_ROOT "/wifi/scan",      M_POST,           h_wifi_scan},
     {FN_API_ROOT "/wifi/status",    M_GET,            h_wifi_status},
+    {FN_API_ROOT "/bus/trace",      M_GET,            h_bus_trace},
+    {FN_API_ROOT "/log",            M_GET | M_POST,   h_log},
 };
 
 // Split a '/'-delimited string into its segments (an empty leading segment
@@ -1,9 +1,19 @@
 
 #include "httpServiceParser.h"
 
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include "../../include/debug.h"
+#ifdef ESP_PLATFORM
+#include "../../include/PSRAMAllocator.h"
+#endif
 
 #include "fnSystem.h"
 #include "fnConfig.h"
@@ -21,6 +31,32 @@ using namespace std;
 
 #define MAX_PRINTER_LIST_BUFFER (2048)
 
+// Upper bound on the text kept by the compiled template cache
+#ifdef ESP_PLATFORM
+#define HTTP_TEMPLATE_CACHE_MAX_BYTES (256 * 1024)
+#else
+#define HTTP_TEMPLATE_CACHE_MAX_BYTES (1024 * 1024)
+#endif
+
+struct template_segment
+{
+    bool tag;           // false for plain text
+    uint32_t offset;    // Into the template text: the literal, or the tag name
+    uint32_t length;
+};
+
+struct fnHttpServiceParser::compiled_template
+{
+#ifdef ESP_PLATFORM
+    vector<char, PSRAMAllocator<char>> text;
+#else
+    vector<char> text;
+#endif
+    vector<template_segment> segments;
+    long size = -1;
+    time_t mtime = 0;
+};
+
 const string fnHttpServiceParser::substitute_tag(const string &tag)
 {
     enum tagids
@@ -284,14 +320,16 @@ const string fnHttpServiceParser::substitute_tag(const string &tag)
 
     // Debug_printf("Substituting tag '%s'\n", tag.c_str());
 
-    int tagid;
-    for (tagid = 0; tagid < FN_LASTTAG; tagid++)
-    {
-        if (0 == tag.compare(tagids[tagid]))
-        {
-            break;
-        }
-    }
+    // Built on first use, every tag of every page rendered is looked up here
+    static const unordered_map<string, int> ids = [&tagids]() {
+        unordered_map<string, int> m;
+        for (int i = 0; i < FN_LASTTAG; i++)
+            m[tagids[i]] = i;
+        return m;
+    }();
+
+    auto found = ids.find(tag);
+    int tagid = found == ids.end() ? FN_LASTTAG : found->second;
 
     int drive_slot, host_slot;
     char disk_id;
@@ -679,37 +717,133 @@ bool fnHttpServiceParser::is_parsable(const char *extension)
     return false;
 }
 
-/* Look for anything between <% and %> tags
- And send that to a routine that looks for suitable substitutions
- Returns string with subtitutions in place
+/* Look for anything between <% and %> tags, leaving literal chunks in
+ between
 */
-string fnHttpServiceParser::parse_contents(const string &contents)
+shared_ptr<const fnHttpServiceParser::compiled_template> fnHttpServiceParser::compile(const char *contents, size_t len)
 {
-    std::stringstream ss;
-    size_t pos = 0, x, y;
-    do
+    auto tpl = make_shared<compiled_template>();
+    tpl->text.assign(contents, contents + len);
+
+    const char *begin = tpl->text.data();
+    const char *end = begin + len;
+    const char *pos = begin;
+
+    auto add_literal = [&](const char *from, const char *to) {
+        if (to > from)
+            tpl->segments.push_back({false, (uint32_t)(from - begin), (uint32_t)(to - from)});
+    };
+
+    while (pos < end)
     {
-        x = contents.find("<%", pos);
-        if (x == string::npos)
-        {
-            ss << contents.substr(pos);
+        const char *x = std::search(pos, end, "<%", "<%" + 2);
+        if (x == end)
             break;
-        }
         // Found opening tag, now find ending
-        y = contents.find("%>", x + 2);
-        if (y == string::npos)
-        {
-            ss << contents.substr(pos);
+        const char *y = std::search(x + 2, end, "%>", "%>" + 2);
+        if (y == end)
             break;
-        }
         // Now we have starting and ending tags
-        if (x > 0)
-            ss << contents.substr(pos, x - pos);
-        ss << substitute_tag(contents.substr(x + 2, y - x - 2));
+        add_literal(pos, x);
+        tpl->segments.push_back({true, (uint32_t)(x + 2 - begin), (uint32_t)(y - x - 2)});
         pos = y + 2;
-    } while (true);
+    }
+    add_literal(pos, end);
+
+    return tpl;
+}
+
+/* Compiled templates for files under the web root, checked against the
+ file's size and modification time on every request. On SPIFFS the time
+ is always 0, so only a change of size is noticed there.
+*/
+static map<string, shared_ptr<const fnHttpServiceParser::compiled_template>> _template_cache;
+static size_t _template_cache_bytes = 0;
+static mutex _template_cache_mutex;
+
+shared_ptr<const fnHttpServiceParser::compiled_template> fnHttpServiceParser::load_template(FileSystem *fs, const char *path)
+{
+    FILE *fInput = fs->file_open(path);
+    if (fInput == nullptr)
+        return nullptr;
+
+    long size = FileSystem::filesize(fInput);
+    time_t mtime = 0;
+    struct stat st;
+    if (fstat(fileno(fInput), &st) == 0)
+        mtime = st.st_mtime;
+
+    lock_guard<mutex> lock(_template_cache_mutex);
+
+    auto cached = _template_cache.find(path);
+    if (cached != _template_cache.end())
+    {
+        if (cached->second->size == size && cached->second->mtime == mtime)
+        {
+            fclose(fInput);
+            return cached->second;
+        }
+        _template_cache_bytes -= cached->second->text.size();
+        _template_cache.erase(cached);
+    }
+
+    if (size < 0)
+    {
+        fclose(fInput);
+        return nullptr;
+    }
+
+    // The only time we hold the whole file, and only until it's compiled
+    vector<char> buf(size);
+    size_t bytes_read = fread(buf.data(), 1, size, fInput);
+    fclose(fInput);
+    if (bytes_read < (size_t)size)
+        Debug_printf("Warning: Only read %u of %ld bytes from file\n", (unsigned)bytes_read, size);
+
+    auto compiled = compile(buf.data(), bytes_read);
+    auto tpl = const_pointer_cast<compiled_template>(compiled);
+    tpl->size = size;
+    tpl->mtime = mtime;
+
+#ifdef ESP_PLATFORM
+    // Without PSRAM the pages are too big to keep around in internal RAM
+    if (fnSystem.get_psram_size() == 0)
+        return compiled;
+#endif
 
-    return ss.str();
+    if (_template_cache_bytes + bytes_read > HTTP_TEMPLATE_CACHE_MAX_BYTES)
+    {
+        _template_cache.clear();
+        _template_cache_bytes = 0;
+    }
+    if (bytes_read <= HTTP_TEMPLATE_CACHE_MAX_BYTES)
+    {
+        _template_cache[path] = compiled;
+        _template_cache_bytes += bytes_read;
+    }
+
+    return compiled;
+}
+
+/* Hand each rendered chunk to out(), literal text straight from the
+ compiled template and tag values as they're substituted. Empty chunks
+ are never passed on, as a zero length chunk ends a chunked response.
+*/
+void fnHttpServiceParser::render(const compiled_template &tpl, const render_output &out)
+{
+    for (const template_segment &seg : tpl.segments)
+    {
+        const char *text = tpl.text.data() + seg.offset;
+        if (!seg.tag)
+        {
+            out(text, seg.length);
+            continue;
+        }
+
+        string value = substitute_tag(string(text, seg.length));
+        if (!value.empty())
+            out(value.data(), value.length());
+    }
 }
 
 long fnHttpServiceParser::uptime_seconds()
@@ -12,6 +12,14 @@ If a file has an extention pre-determined to support parsing (see/update
     *       string substitute_tag(const string &tag)
     * function.
     * 
+Templates are compiled once into a list of literal chunks and tags
+and kept in memory, keyed by path and invalidated when the file's size
+or modification time changes. SPIFFS keeps no modification time (it
+reads as 0), so there a page edited to the same size is served stale
+until the next restart. Rendering walks that list and hands each
+chunk straight to the caller, so nothing the size of the page is built
+per request.
+
 See const fnHttpServiceParser::substitute_tag() for
 currently supported tags.
 
@@ -19,15 +27,26 @@ currently supported tags.
 #ifndef HTTPSERVICEPARSER_H
 #define HTTPSERVICEPARSER_H
 
+#include <functional>
+#include <memory>
 #include <string>
 
+class FileSystem;
+
 class fnHttpServiceParser
 {
+public:
+    struct compiled_template;
+    typedef std::function<void(const char *data, size_t len)> render_output;
+
+private:
     static std::string format_uptime();
     static long uptime_seconds();
     static const std::string substitute_tag(const std::string &tag);
 public:
-    static std::string parse_contents(const std::string &contents);
+    static std::shared_ptr<const compiled_template> compile(const char *contents, size_t len);
+    static std::shared_ptr<const compiled_template> load_template(FileSystem *fs, const char *path);
+    static void render(const compiled_template &tpl, const render_output &out);
     static bool is_parsable(const char *extension);
 };
 
@@ -959,7 +959,7 @@ int mgHttpClient::PUT(const char *put_data, int put_datalen)
 #ifdef VERBOSE_HTTP
     Debug_println("mgHttpClient::PUT");
 #endif
-    if (_handle == nullptr || put_data == nullptr || put_datalen < 1)
+    if (_handle == nullptr || put_data == nullptr || put_datalen < 0)
         return -1;
 
     // Get rid of any pending data
@@ -1097,7 +1097,7 @@ int mgHttpClient::POST(const char *post_data, int post_datalen)
 #ifdef VERBOSE_HTTP
     Debug_println("mgHttpClient::POST");
 #endif
-    if (_handle == nullptr || post_data == nullptr || post_datalen < 1)
+    if (_handle == nullptr || post_data == nullptr || post_datalen < 0)
         return -1;
 
     // Get rid of any pending data
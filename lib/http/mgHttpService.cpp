@@ -155,53 +155,26 @@ void fnHttpService::send_file_parsed(struct mg_connection *c, const char *filena
 {
     Debug_printf("Opening file for parsing: '%s'\n", filename);
 
-    _fnwserr err = fnwserr_noerrr;
-
     // Retrieve server state
     serverstate *pState = &fnHTTPD.state; // ops TODO
-    FILE *fInput = pState->_FS->file_open(filename);
+    auto tpl = fnHttpServiceParser::load_template(pState->_FS, filename);
 
-    if (fInput == nullptr)
+    if (tpl == nullptr)
     {
         Debug_println("Failed to open file for parsing");
-        err = fnwserr_fileopen;
-    }
-    else
-    {
-        // We're going to load the whole thing into memory, so watch out for big files!
-        size_t sz = FileSystem::filesize(fInput) + 1;
-        char *buf = (char *)calloc(sz, 1);
-        if (buf == NULL)
-        {
-            Debug_printf("Couldn't allocate %u bytes to load file contents!\n", (unsigned)sz);
-            err = fnwserr_memory;
-        }
-        else
-        {
-            size_t bytes_read = fread(buf, 1, sz - 1, fInput); // sz - 1 because we added 1 for null terminator
-            if (bytes_read < (sz - 1)) {
-                Debug_printf("Warning: Only read %u of %u bytes from file\n", (unsigned)bytes_read, (unsigned)(sz - 1));
-            }
-            string contents(buf);
-            free(buf);
-            contents = fnHttpServiceParser::parse_contents(contents);
-
-            mg_printf(c, "HTTP/1.1 200 OK\r\n");
-            // Set the response content type
-            set_file_content_type(c, filename);
-            // Set the expected length of the content
-            size_t len = contents.length();
-            mg_printf(c, "Content-Length: %lu\r\n\r\n", (unsigned long)len);
-            // Send parsed content
-            mg_send(c, contents.c_str(), len);
-        }
+        return_http_error(c, fnwserr_fileopen);
+        return;
     }
 
-    if (fInput != nullptr)
-        fclose(fInput);
-
-    if (err != fnwserr_noerrr)
-        return_http_error(c, err);
+    mg_printf(c, "HTTP/1.1 200 OK\r\n");
+    // Set the response content type
+    set_file_content_type(c, filename);
+    // Length isn't known until the tags are substituted, so send it chunked
+    mg_printf(c, "Transfer-Encoding: chunked\r\n\r\n");
+    fnHttpServiceParser::render(*tpl, [c](const char *data, size_t len) {
+        mg_http_write_chunk(c, data, len);
+    });
+    mg_http_write_chunk(c, "", 0);
 }
 
 /* Send file content after parsing for replaceable strings
@@ -277,29 +250,17 @@ void fnHttpService::send_header_footer(struct mg_connection *c, int headfoot)
 
     // Retrieve server state
     serverstate *pState = &fnHTTPD.state;
-    FILE *fInput = pState->_FS->file_open(fpath.c_str());
+    auto tpl = fnHttpServiceParser::load_template(pState->_FS, fpath.c_str());
 
-    if (fInput == nullptr)
+    if (tpl == nullptr)
     {
         Debug_printf("Failed to open '%s' for parsing\n", fpath.c_str());
         return;
     }
 
-    size_t sz = FileSystem::filesize(fInput) + 1;
-    char *buf = (char *)calloc(sz, 1);
-    if (buf == NULL)
-    {
-        Debug_printf("Couldn't allocate %u bytes to load file contents!\n", (unsigned)sz);
-    }
-    else
-    {
-        fread(buf, 1, sz - 1, fInput);
-        string contents = fnHttpServiceParser::parse_contents(string(buf));
-        free(buf);
-        mg_http_write_chunk(c, contents.data(), contents.length());
-    }
-
-    fclose(fInput);
+    fnHttpServiceParser::render(*tpl, [c](const char *data, size_t len) {
+        mg_http_write_chunk(c, data, len);
+    });
 }
 
 /* Fetch a query variable as a string. Returns false if it isn't present.
@@ -105,7 +105,7 @@ esp_err_t webdav_handler(httpd_req_t *httpd_req)
         break;
     case HTTP_GET:
         ret = server->doGet(req, resp);
-        if ( ret == 200 )
+        if ( ret == 200 || ret == 206 || ret == 416 )
             return ESP_OK;
         break;
     case HTTP_HEAD:
@@ -185,6 +185,7 @@ void webdav_register(httpd_handle_t server, const char *root_uri, const char *ro
     http_method methods[] = {
         HTTP_COPY,
         HTTP_DELETE,
+        HTTP_GET,
         HTTP_HEAD,
         HTTP_LOCK,
         HTTP_MKCOL,
@@ -195,6 +196,7 @@ void webdav_register(httpd_handle_t server, const char *root_uri, const char *ro
         HTTP_PUT,
         HTTP_UNLOCK,
     };
+    static_assert(sizeof(methods) / sizeof(methods[0]) == WEBDAV_URI_HANDLERS, "update WEBDAV_URI_HANDLERS");
 
     for (int i = 0; i < (int)(sizeof(methods) / sizeof(methods[0])); i++)
     {
@@ -20,6 +20,9 @@
 
 #include <esp_http_server.h>
 
+// Handlers webdav_register() adds, one per WebDAV method
+#define WEBDAV_URI_HANDLERS 12
+
 esp_err_t webdav_handler(httpd_req_t *req);
 void webdav_register(httpd_handle_t server, const char *root_uri = "/", const char *root_path = "/");
 
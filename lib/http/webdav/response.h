@@ -29,7 +29,9 @@
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_201      "201 Created"
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
+#define HTTPD_206      "206 Partial Content"
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_304      "304 Not Modified"
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_403      "403 Forbidden"
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
@@ -38,10 +40,15 @@
 #define HTTPD_409      "409 Conflict"
 #define HTTPD_412      "412 Precondition Failed"
 #define HTTPD_415      "415 Unspported Media Type"
+#define HTTPD_416      "416 Range Not Satisfiable"
 #define HTTPD_500      "500 Internal Server Error"  /*!< HTTP Response 500 */
 #define HTTPD_501      "501 Not Implemented"
 #define HTTPD_507      "507 Insufficient Storage"
 
+// Small pieces written with writeChunk() are collected up to this size
+// and go out as one chunk, rather than one send per XML element
+#define WEBDAV_CHUNK_BUFFER 4096
+
 namespace WebDav
 {
 
@@ -82,9 +89,15 @@ namespace WebDav
                 case 204:
                     status = HTTPD_204;
                     break;
+                case 206:
+                    status = HTTPD_206;
+                    break;
                 case 207:
                     status = HTTPD_207;
                     break;
+                case 304:
+                    status = HTTPD_304;
+                    break;
                 case 400:
                     status = HTTPD_400;
                     break;
@@ -109,6 +122,9 @@ namespace WebDav
                 case 415:
                     status = HTTPD_415;
                     break;
+                case 416:
+                    status = HTTPD_416;
+                    break;
                 case 500:
                     status = HTTPD_500;
                     break;
@@ -142,11 +158,48 @@ namespace WebDav
 
             //Debug_printv("\r\n%x\r\n%s\r\n", len, buf);
 
+            if (!flushChunk())
+                return false;
+
             return httpd_resp_send_chunk(req, buf, len) == ESP_OK;
         }
 
+        bool writeChunk(const char *buf, ssize_t len = -1)
+        {
+            if (len == -1)
+                len = strlen(buf);
+
+            if (pending.size() + len > WEBDAV_CHUNK_BUFFER && !flushChunk())
+                return false;
+
+            if (len >= WEBDAV_CHUNK_BUFFER)
+                return sendChunk(buf, len);
+
+            if (pending.capacity() < WEBDAV_CHUNK_BUFFER)
+                pending.reserve(WEBDAV_CHUNK_BUFFER);
+            pending.append(buf, len);
+            return true;
+        }
+
+        bool writeChunk(const std::string &s)
+        {
+            return writeChunk(s.data(), s.size());
+        }
+
+        bool flushChunk()
+        {
+            if (pending.empty())
+                return true;
+
+            chunked = true;
+            bool ok = httpd_resp_send_chunk(req, pending.data(), pending.size()) == ESP_OK;
+            pending.clear();
+            return ok;
+        }
+
         void closeChunk()
         {
+            flushChunk();
             httpd_resp_send_chunk(req, NULL, 0);
             chunked = false;
         }
@@ -170,8 +223,9 @@ private:
 
         httpd_req_t *req;
         bool chunked = false;
+        std::string pending;
 
         std::map<std::string, std::string> headers;
     };
 
-} // namespace
\ No newline at end of file
+} // namespace
\ No newline at end of file
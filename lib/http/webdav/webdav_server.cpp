@@ -34,6 +34,10 @@
 
 using namespace WebDav;
 
+// Requests for more ranges than this get the whole file instead
+#define WEBDAV_MAX_RANGES 16
+#define WEBDAV_RANGE_BOUNDARY "fujinet-byteranges"
+
 static std::string toLowerCopy(std::string value)
 {
     for (char &ch : value)
@@ -465,28 +469,147 @@ static void xmlElement(std::ostringstream &s, const char *name, const char *valu
     s << "<" << name << ">" << value << "</" << name << ">\r\n";
 }
 
-void Server::sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr)
+static void xmlElement(Response &resp, const char *name, const char *value)
 {
-    std::ostringstream s;
+    resp.writeChunk("<");
+    resp.writeChunk(name);
+    resp.writeChunk(">");
+    resp.writeChunk(value);
+    resp.writeChunk("</");
+    resp.writeChunk(name);
+    resp.writeChunk(">\r\n");
+}
 
-    s << "<D:response>\r\n";
-    xmlElement(s, "D:href", msr.href.c_str());
-    s << "<D:propstat>\r\n";
+// Strong validator for a file: changes whenever it's rewritten
+static std::string entityTag(const std::string &path, MFile *mfile)
+{
+    return "\"" + mstr::sha1(path + std::to_string(mfile->getLastWrite())) + "\"";
+}
 
-    s << "<D:prop>\r\n";
-    for (const auto &p : msr.props)
-        xmlElement(s, p.first.c_str(), p.second.c_str());
+// If-None-Match / If-Range: "*" or a list of tags, weak or strong, quoted
+// or not (older releases sent the tag bare)
+static bool entityTagMatches(std::string header, const std::string &etag)
+{
+    std::string bare = etag.substr(1, etag.size() - 2);
 
-    xmlElement(s, "D:resourcetype", msr.isCollection ? "<D:collection/>" : "");
-    s << "</D:prop>\r\n";
+    mstr::trim(header);
+    if (header == "*")
+        return true;
 
-    xmlElement(s, "D:status", msr.status.c_str());
-    s << "</D:propstat>\r\n";
-    s << "</D:response>\r\n";
+    std::vector<std::string> tags = mstr::split(header, ',');
+    for (auto &tag : tags)
+    {
+        mstr::trim(tag);
+        if (mstr::startsWith(tag, "W/"))
+            tag = tag.substr(2);
+        if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"')
+            tag = tag.substr(1, tag.size() - 2);
+        if (tag == bare)
+            return true;
+    }
+    return false;
+}
 
-    //Debug_printv("[%s]", s.str().c_str());
+// Parse "bytes=first-last, first-, -suffix" into inclusive ranges within a
+// file of the given size. Returns false when the header should be ignored
+// (not bytes, malformed, or too many ranges); unsatisfiable ranges are
+// dropped, so an empty result means 416.
+static bool parseRange(std::string header, uint32_t size, std::vector<std::pair<uint32_t, uint32_t>> &ranges)
+{
+    mstr::trim(header);
+    if (!mstr::startsWith(header, "bytes=", false))
+        return false;
 
-    resp.sendChunk(s.str().c_str());
+    std::vector<std::string> specs = mstr::split(header.substr(6), ',');
+    if (specs.empty() || specs.size() > WEBDAV_MAX_RANGES)
+        return false;
+
+    for (auto &spec : specs)
+    {
+        mstr::trim(spec);
+        if (spec.empty())
+            continue;
+
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos)
+            return false;
+
+        std::string first = spec.substr(0, dash);
+        std::string last = spec.substr(dash + 1);
+        if ((first.empty() && last.empty()) || !mstr::isNumeric(first) || !mstr::isNumeric(last))
+            return false;
+
+        uint64_t start, end;
+        if (first.empty())
+        {
+            // suffix range: the last N bytes
+            uint64_t n = strtoull(last.c_str(), nullptr, 10);
+            if (n == 0 || size == 0)
+                continue;
+            start = n >= size ? 0 : size - n;
+            end = size - 1;
+        }
+        else
+        {
+            start = strtoull(first.c_str(), nullptr, 10);
+            end = last.empty() ? UINT64_MAX : strtoull(last.c_str(), nullptr, 10);
+            if (end < start)
+                return false;
+            if (start >= size)
+                continue;
+            if (end >= size)
+                end = size - 1;
+        }
+        ranges.push_back({(uint32_t)start, (uint32_t)end});
+    }
+    return true;
+}
+
+static std::string contentRange(uint32_t start, uint32_t end, uint32_t size)
+{
+    return "bytes " + std::to_string(start) + "-" + std::to_string(end) + "/" + std::to_string(size);
+}
+
+// Send length bytes starting at offset, chunk is a caller supplied buffer
+static bool sendStreamRange(Response &resp, MStream *stream, uint32_t offset, uint32_t length,
+                            uint8_t *chunk, uint32_t chunkSize)
+{
+    if (stream->position() != offset && !stream->seek(offset))
+        return false;
+
+    while (length > 0)
+    {
+        uint32_t r = stream->read(chunk, std::min(length, chunkSize));
+        if (r == 0)
+            return false;
+
+        if (!resp.sendChunk((char *)chunk, r))
+            return false;
+
+        length -= r;
+    }
+    return true;
+}
+
+void Server::sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr)
+{
+    // Written straight into the response's chunk buffer, so a Depth:1 listing
+    // of thousands of entries goes out in a few large chunks and never holds
+    // more than one chunk buffer of XML
+    resp.writeChunk("<D:response>\r\n");
+    xmlElement(resp, "D:href", msr.href.c_str());
+    resp.writeChunk("<D:propstat>\r\n");
+
+    resp.writeChunk("<D:prop>\r\n");
+    for (const auto &p : msr.props)
+        xmlElement(resp, p.first.c_str(), p.second.c_str());
+
+    xmlElement(resp, "D:resourcetype", msr.isCollection ? "<D:collection/>" : "");
+    resp.writeChunk("</D:prop>\r\n");
+
+    xmlElement(resp, "D:status", msr.status.c_str());
+    resp.writeChunk("</D:propstat>\r\n");
+    resp.writeChunk("</D:response>\r\n");
 }
 
 int Server::sendPropResponse(Response &resp, std::string path, int recurse, MFile* hint)
@@ -516,8 +639,7 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse, MFil
         r.props["D:creationdate"] = formatTime(mfile->getCreationTime());
         r.props["D:getlastmodified"] = formatTime(mfile->getLastWrite());
 
-        std::string s = path + std::to_string(mfile->getLastWrite());
-        r.props["D:getetag"] = mstr::sha1(s);
+        r.props["D:getetag"] = entityTag(path, mfile);
 
         r.isCollection = mfile->isDirectory();
         if (!r.isCollection)
@@ -662,18 +784,39 @@ int Server::doGet(Request &req, Response &resp)
     if (mfile->isDirectory())
         return 405;
 
+    std::string etag = entityTag(path, mfile.get());
+    resp.setHeader("ETag", etag);
+    resp.setHeader("Last-Modified", formatTime(mfile->getLastWrite()));
+    resp.setHeader("Accept-Ranges", "bytes");
+
+    // Revalidation: the client's copy is current
+    std::string match = req.getHeader("If-None-Match");
+    if (!match.empty() && entityTagMatches(match, etag))
+        return 304;
+
     auto stream = mfile->getSourceStream(std::ios_base::in);
     if (!stream || !stream->isOpen())
         return 404;
 
-    std::string s = path + std::to_string(mfile->getLastWrite());
+    uint32_t size = stream->size();
 
-    resp.setStatus(200);
-    resp.setHeader("ETag", mstr::sha1(s));
-    resp.setHeader("Last-Modified", formatTime(mfile->getLastWrite()));
-    resp.flushHeaders();
+    // Range is only honoured if there's no If-Range or it still matches
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    std::string range = req.getHeader("Range");
+    std::string ifRange = req.getHeader("If-Range");
+    bool partial = !range.empty() && (ifRange.empty() || entityTagMatches(ifRange, etag)) &&
+                   parseRange(range, size, ranges);
+
+    if (partial && ranges.empty())
+    {
+        stream->close();
+        resp.setStatus(416);
+        resp.setHeader("Content-Range", "bytes */" + std::to_string(size));
+        resp.flushHeaders();
+        resp.closeBody();
+        return 416;
+    }
 
-    int ret = 0;
     // 16 KB: halves the chunked-send round trips vs 8 KB. malloc lands in
     // PSRAM (above the SPIRAM_MALLOC_ALWAYSINTERNAL threshold).
     const int chunkSize = 16384;
@@ -683,24 +826,65 @@ int Server::doGet(Request &req, Response &resp)
         return 500;
     }
 
-    for (;;)
+    bool ok = true;
+    if (!partial)
     {
-        uint32_t r = stream->read(chunk, chunkSize);
-        if (r == 0)
-            break;
+        resp.setStatus(200);
+        resp.flushHeaders();
 
-        if (!resp.sendChunk((char *)chunk, r))
+        for (;;)
         {
-            ret = -1;
-            break;
+            uint32_t r = stream->read(chunk, chunkSize);
+            if (r == 0)
+                break;
+
+            if (!resp.sendChunk((char *)chunk, r))
+            {
+                ok = false;
+                break;
+            }
+        }
+    }
+    else if (ranges.size() == 1)
+    {
+        resp.setStatus(206);
+        resp.setHeader("Content-Range", contentRange(ranges[0].first, ranges[0].second, size));
+        resp.setContentType(HTTPD_TYPE_OCTET);
+        resp.flushHeaders();
+
+        ok = sendStreamRange(resp, stream, ranges[0].first, ranges[0].second - ranges[0].first + 1,
+                             chunk, chunkSize);
+    }
+    else
+    {
+        // Multiple ranges go out as multipart/byteranges, one part per range
+        // in the order asked for
+        resp.setStatus(206);
+        resp.setContentType("multipart/byteranges; boundary=" WEBDAV_RANGE_BOUNDARY);
+        resp.flushHeaders();
+
+        for (const auto &r : ranges)
+        {
+            std::string head = "\r\n--" WEBDAV_RANGE_BOUNDARY "\r\n"
+                               "Content-Type: " HTTPD_TYPE_OCTET "\r\n"
+                               "Content-Range: " + contentRange(r.first, r.second, size) + "\r\n\r\n";
+            ok = resp.sendChunk(head.c_str(), head.size()) &&
+                 sendStreamRange(resp, stream, r.first, r.second - r.first + 1, chunk, chunkSize);
+            if (!ok)
+                break;
         }
+        if (ok)
+            ok = resp.sendChunk("\r\n--" WEBDAV_RANGE_BOUNDARY "--\r\n");
     }
 
     free(chunk);
     stream->close();
     resp.closeChunk();
 
-    return ret != 0 ? 500 : 200;
+    if (!ok)
+        return 500;
+
+    return partial ? 206 : 200;
 }
 
 int Server::doHead(Request &req, Response &resp)
@@ -723,10 +907,9 @@ int Server::doHead(Request &req, Response &resp)
     if (!mfile || !mfile->exists())
         return 404;
 
-    std::string s = path + std::to_string(mfile->getLastWrite());
-
-    resp.setHeader("ETag", mstr::sha1(s));
+    resp.setHeader("ETag", entityTag(path, mfile.get()));
     resp.setHeader("Last-Modified", formatTime(mfile->getLastWrite()));
+    resp.setHeader("Accept-Ranges", "bytes");
 
     return 200;
 }
@@ -902,12 +1085,12 @@ int Server::doPropfind(Request &req, Response &resp)
     resp.setContentType("application/xml;charset=utf-8");
     resp.flushHeaders();
 
-    resp.sendChunk("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n");
-    resp.sendChunk("<D:multistatus xmlns:D=\"DAV:\">\r\n");
+    resp.writeChunk("<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n");
+    resp.writeChunk("<D:multistatus xmlns:D=\"DAV:\">\r\n");
     // Pass mfile as hint so sendPropResponse doesn't create a second MFile
     // for the same path, avoiding a duplicate exists()/isDirectory() round-trip.
     sendPropResponse(resp, path, recurse, mfile.get());
-    resp.sendChunk("</D:multistatus>\r\n");
+    resp.writeChunk("</D:multistatus>\r\n");
     resp.closeChunk();
 
     return 207;
@@ -5,8 +5,25 @@
 #include "../meat_media.h"
 #include "endianness.h"
 
+#include <cstring>
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
 // D64 Utility Functions
 
+// A whole image in the sector cache only fits with PSRAM behind it
+static bool cache_whole_images()
+{
+#ifdef ESP_PLATFORM
+    static bool psram = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+    return psram;
+#else
+    return true;
+#endif
+}
+
 bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
 {
     uint16_t sectorOffset = 0;
@@ -34,7 +51,7 @@ bool D64MStream::seekBlock(uint64_t index, uint8_t offset)
 
     // Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
 
-    return containerStream->seek((index * block_size) + offset);
+    return containerSeek((index * block_size) + offset);
 }
 
 bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
@@ -82,7 +99,7 @@ bool D64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 
     //Debug_printv("track[%d] sector[%d] speedZone[%d] sectorOffset[%d]", track, sector, speedZone(track), sectorOffset);
 
-    return containerStream->seek((sectorOffset * block_size) + offset);
+    return containerSeek((sectorOffset * block_size) + offset);
 }
 
 bool D64MStream::seekSector(std::vector<uint8_t> trackSectorOffset)
@@ -90,6 +107,145 @@ bool D64MStream::seekSector(std::vector<uint8_t> trackSectorOffset)
     return seekSector(trackSectorOffset[0], trackSectorOffset[1], trackSectorOffset[2]);
 }
 
+bool D64MStream::seek(uint32_t offset)
+{
+    _position = media_data_offset + offset;
+    return containerSeek(_position);
+}
+
+// The container is only touched when a sector isn't cached, so seeking
+// just records the position for the next readContainer()
+bool D64MStream::containerSeek(uint32_t pos)
+{
+    uint32_t size = containerStream->size();
+    if (size && pos > size)
+        return false;
+
+    container_pos = pos;
+    return true;
+}
+
+const D64MStream::SectorData* D64MStream::cachedSector(uint32_t index)
+{
+    auto found = sector_index.find(index);
+    if (found != sector_index.end())
+    {
+        cache_hits++;
+        sector_cache.splice(sector_cache.begin(), sector_cache, found->second);
+        return &found->second->data;
+    }
+
+    cache_misses++;
+
+    // Fetch a run of sectors with a single read, following chains mostly
+    // stay within a track so the next few hops will then be cached too
+    uint32_t image_size = containerStream->size();
+    uint32_t count = D64_SECTOR_READAHEAD;
+    if (image_size)
+    {
+        uint32_t image_sectors = (image_size + block_size - 1) / block_size;
+        if (index >= image_sectors)
+            return nullptr;
+        count = std::min(count, image_sectors - index);
+    }
+
+    SectorData buffer(count * block_size);
+    if (!containerStream->seek(index * block_size))
+        return nullptr;
+
+    uint32_t got = containerStream->read(buffer.data(), buffer.size());
+    if (got == 0)
+        return nullptr;
+
+    for (uint32_t i = 0; i * block_size < got; i++)
+    {
+        if (sector_index.count(index + i))
+            continue;
+
+        uint32_t start = i * block_size;
+        uint32_t end = std::min(got, (uint32_t)(start + block_size));
+        sector_cache.push_back({ index + i, SectorData(buffer.begin() + start, buffer.begin() + end) });
+        sector_index[index + i] = std::prev(sector_cache.end());
+    }
+
+    auto it = sector_index.find(index);
+    if (it == sector_index.end())
+        return nullptr;
+    sector_cache.splice(sector_cache.begin(), sector_cache, it->second);
+
+    // Small images stay cached whole, larger ones (or any without PSRAM) drop
+    // least recently used sectors
+    size_t max = (cache_whole_images() && image_size && image_size <= D64_SECTOR_CACHE_WHOLE_IMAGE)
+        ? SIZE_MAX : D64_SECTOR_CACHE_MAX;
+    while (sector_cache.size() > max)
+    {
+        sector_index.erase(sector_cache.back().index);
+        sector_cache.pop_back();
+    }
+
+    return &it->second->data;
+}
+
+void D64MStream::invalidateSectors(uint32_t pos, uint32_t size)
+{
+    uint32_t first = pos / block_size;
+    uint32_t last = (pos + size) / block_size;
+    for (uint32_t index = first; index <= last; index++)
+    {
+        auto found = sector_index.find(index);
+        if (found == sector_index.end())
+            continue;
+
+        sector_cache.erase(found->second);
+        sector_index.erase(found);
+    }
+
+    directory_indexed = false;
+    directory_index.clear();
+}
+
+uint32_t D64MStream::memoryUsage()
+{
+    std::lock_guard<std::mutex> lock(sector_cache_mutex);
+    return sector_cache.size() * block_size;
+}
+
+uint32_t D64MStream::readContainer(uint8_t *buf, uint32_t size)
+{
+    // Held while copying too, a sector evicted meanwhile would be freed
+    std::lock_guard<std::mutex> lock(sector_cache_mutex);
+    uint32_t bytesRead = 0;
+
+    while (bytesRead < size)
+    {
+        uint32_t offset = container_pos % block_size;
+        auto data = cachedSector(container_pos / block_size);
+        if (data == nullptr || offset >= data->size())
+            break;
+
+        uint32_t count = std::min(size - bytesRead, (uint32_t)(data->size() - offset));
+        memcpy(buf + bytesRead, data->data() + offset, count);
+        bytesRead += count;
+        container_pos += count;
+    }
+
+    return bytesRead;
+}
+
+uint32_t D64MStream::writeContainer(uint8_t *buf, uint32_t size)
+{
+    // Held until written, so a read can't cache the old sectors again
+    std::lock_guard<std::mutex> lock(sector_cache_mutex);
+    invalidateSectors(container_pos, size);
+
+    if (!containerStream->seek(container_pos))
+        return 0;
+
+    uint32_t bytesWritten = MMediaStream::writeContainer(buf, size);
+    container_pos += bytesWritten;
+    return bytesWritten;
+}
+
 std::string D64MStream::readBlock(uint8_t track, uint8_t sector)
 {
     return "";
@@ -201,6 +357,28 @@ bool D64MStream::isBlockFree(uint8_t track, uint8_t sector)
     return true;
 }
 
+// Walk the directory once and remember where each file's entry is
+void D64MStream::indexDirectory()
+{
+    directory_index.clear();
+
+    uint16_t index = 1;
+    while (seekEntry(index))
+    {
+        std::string entryFilename = entry.filename;
+        uint8_t i = entryFilename.find_first_of(0xA0);
+        entryFilename = mstr::toUTF8(entryFilename.substr(0, i));
+
+        // First entry wins, same as a linear search
+        directory_index.insert(std::make_pair(entryFilename, index));
+        index++;
+    }
+
+    directory_indexed = true;
+    Debug_printv("entries[%u] cache hits[%lu] misses[%lu] sectors[%u]", (unsigned)directory_index.size(),
+                 (unsigned long)cache_hits, (unsigned long)cache_misses, (unsigned)(memoryUsage() / block_size));
+}
+
 bool D64MStream::seekEntry( std::string filename )
 {
     // Read Directory Entries
@@ -209,7 +387,20 @@ bool D64MStream::seekEntry( std::string filename )
         uint16_t index = 1;
         mstr::replaceAll(filename, "\\", "/");
         bool wildcard = (mstr::contains(filename, "*") || mstr::contains(filename, "?"));
-        while (seekEntry(index))
+
+        // Exact names are looked up in the directory index
+        if (!wildcard)
+        {
+            if (!directory_indexed)
+                indexDirectory();
+
+            auto found = directory_index.find(filename);
+            if (found != directory_index.end() && seekEntry(found->second))
+                return true;
+        }
+
+        // Wildcards still need a scan
+        while (wildcard && seekEntry(index))
         {
             std::string entryFilename = entry.filename;
             uint8_t i = entryFilename.find_first_of(0xA0);
@@ -536,7 +727,10 @@ bool D64MFile::rewindDirectory()
 {
     dirIsOpen = true;
     Debug_printv("streamFile->url[%s]", streamFile->url.c_str());
-    auto image = ImageBroker::obtain<D64MStream>(streamFile->url);
+    // Held until the listing ends, so the broker can't evict the image (and
+    // its entry counter) between calls
+    dirImage = ImageBroker::obtain<D64MStream>(streamFile->url);
+    auto image = dirImage;
     if (image == nullptr)
         return false;
 
@@ -566,7 +760,7 @@ MFile *D64MFile::getNextFileInDir()
         rewindDirectory();
 
     // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<D64MStream>(streamFile->url);
+    auto image = dirImage;
     if (image == nullptr)
         goto exit;
 
@@ -594,6 +788,8 @@ MFile *D64MFile::getNextFileInDir()
 exit:
     // Debug_printv( "END OF DIRECTORY");
     dirIsOpen = false;
+    dirImage.reset();
+    ImageBroker::validate();
     return nullptr;
 }
 
@@ -20,11 +20,26 @@
 #include <map>
 #include <bitset>
 #include <ctime>
+#include <list>
+#include <mutex>
+#include <unordered_map>
 
 #include "../meat_media.h"
 #include "string_utils.h"
 #include "utils.h"
 
+#ifdef ESP_PLATFORM
+#include "../../../include/PSRAMAllocator.h"
+#endif
+
+// Images up to this size are cached whole, larger ones (DNP, D90) through
+// an LRU of D64_SECTOR_CACHE_MAX sectors, as are all images without PSRAM
+#define D64_SECTOR_CACHE_WHOLE_IMAGE (1024 * 1024)
+#define D64_SECTOR_CACHE_MAX 512
+
+// Sectors fetched from the container with one read on a cache miss
+#define D64_SECTOR_READAHEAD 16
+
 
 /********************************************************
  * Streams
@@ -59,6 +74,17 @@ protected:
         char id_dos[5];
     };
 
+#ifdef ESP_PLATFORM
+    typedef std::vector<uint8_t, PSRAMAllocator<uint8_t>> SectorData;
+#else
+    typedef std::vector<uint8_t> SectorData;
+#endif
+
+    struct CachedSector {
+        uint32_t index;
+        SectorData data;
+    };
+
     struct Entry {
         uint8_t next_track;
         uint8_t next_sector;
@@ -222,6 +248,9 @@ public:
     bool seekBlock( uint64_t index, uint8_t offset = 0 ) override;
     bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) override;
     bool seekSector( std::vector<uint8_t> trackSectorOffset ) override;
+    bool seek( uint32_t offset ) override;
+
+    uint32_t memoryUsage() override;
 
 
     uint16_t getSectorCount( uint16_t track )
@@ -251,7 +280,33 @@ public:
     uint8_t next_sector = 0;
     uint8_t sector_offset = 0;
 
+protected:
+    uint32_t readContainer(uint8_t *buf, uint32_t size) override;
+    uint32_t writeContainer(uint8_t *buf, uint32_t size) override;
+
 private:
+    // Sector cache, all container reads are served from here. Sectors are
+    // keyed by their offset in the container divided by block_size. The
+    // image broker sizes it from other tasks, so it is only touched with
+    // sector_cache_mutex held.
+    std::mutex sector_cache_mutex;
+    std::list<CachedSector> sector_cache;   // most recently used at front
+    std::unordered_map<uint32_t, std::list<CachedSector>::iterator> sector_index;
+    uint32_t container_pos = 0;
+    uint32_t cache_hits = 0;
+    uint32_t cache_misses = 0;
+
+    bool containerSeek( uint32_t pos );
+    // Both called with sector_cache_mutex held
+    const SectorData* cachedSector( uint32_t index );
+    void invalidateSectors( uint32_t pos, uint32_t size );
+
+    // Directory index, filename -> directory entry index
+    std::unordered_map<std::string, uint16_t> directory_index;
+    bool directory_indexed = false;
+
+    void indexDirectory();
+
     void sendListing();
 
     bool readHeader() override {
@@ -342,6 +397,7 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+    std::shared_ptr<D64MStream> dirImage;
 };
 
 
@@ -0,0 +1,127 @@
+#ifndef MEATLOAF_BROKER
+#define MEATLOAF_BROKER
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "../../include/debug.h"
+
+/********************************************************
+ * Broker cache
+ *
+ * Bounded LRU cache of shared objects keyed by URL, used
+ * by the File/Stream/Image brokers. Objects are handed out
+ * as shared_ptr so anything a caller still holds is
+ * pinned and never evicted from under its user. Objects
+ * can grow while cached (a disk image fills its sector
+ * cache as it is read), so their memory is counted again
+ * on every insert and lookup, and least recently used
+ * entries are evicted until both the entry count and the
+ * memory budget are satisfied.
+ ********************************************************/
+
+// Fixed per-entry cost, roughly the object, its URL and any
+// small buffers it owns
+#define BROKER_ENTRY_COST 1024
+
+template<class T>
+class MBrokerCache {
+    struct Entry {
+        std::string url;
+        std::shared_ptr<T> object;
+    };
+
+    std::list<Entry> lru;   // most recently used at front
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> index;
+
+    size_t max_entries;
+    size_t max_bytes;
+
+    static size_t cost(const Entry& e) {
+        return BROKER_ENTRY_COST + e.url.size() + memoryUsage(e.object.get());
+    }
+
+    // Objects may report memory they hold beyond the fixed entry cost
+    template<class U>
+    static auto memoryUsage(U* o) -> decltype(o->memoryUsage()) { return o->memoryUsage(); }
+    static size_t memoryUsage(...) { return 0; }
+
+public:
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    uint32_t evictions = 0;
+
+    MBrokerCache(size_t entries, size_t bytes) : max_entries(entries), max_bytes(bytes) {}
+
+    std::shared_ptr<T> find(const std::string& url) {
+        auto found = index.find(url);
+        if (found == index.end()) {
+            misses++;
+            return nullptr;
+        }
+
+        hits++;
+        lru.splice(lru.begin(), lru, found->second);
+        std::shared_ptr<T> object = found->second->object;
+        trim();     // it may have grown since; held here, so it stays
+        return object;
+    }
+
+    void insert(const std::string& url, std::shared_ptr<T> object) {
+        erase(url);
+        lru.push_front({url, object});
+        index[url] = lru.begin();
+        trim();
+    }
+
+    void erase(const std::string& url) {
+        auto found = index.find(url);
+        if (found == index.end())
+            return;
+
+        lru.erase(found->second);
+        index.erase(found);
+    }
+
+    void clear() {
+        index.clear();
+        lru.clear();
+    }
+
+    size_t size() const { return lru.size(); }
+
+    size_t bytes() const {
+        size_t total = 0;
+        for (auto& e : lru)
+            total += cost(e);
+        return total;
+    }
+
+    // Drop least recently used entries that nobody else holds until
+    // the cache is back within its limits
+    void trim() {
+        size_t total = bytes();
+        auto it = lru.end();
+        while (it != lru.begin() && (lru.size() > max_entries || total > max_bytes)) {
+            --it;
+            if (it->object.use_count() > 1)
+                continue;   // pinned
+
+            total -= cost(*it);
+            index.erase(it->url);
+            it = lru.erase(it);
+            evictions++;
+        }
+    }
+
+    void printStats(const char* name) {
+        Debug_printv("%s entries[%u] bytes[%u] hits[%lu] misses[%lu] evictions[%lu]", name,
+                     (unsigned)lru.size(), (unsigned)bytes(),
+                     (unsigned long)hits, (unsigned long)misses, (unsigned long)evictions);
+    }
+};
+
+#endif // MEATLOAF_BROKER
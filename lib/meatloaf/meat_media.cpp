@@ -1,6 +1,6 @@
 #include "meat_media.h"
 
-std::unordered_map<std::string, MMediaStream*> ImageBroker::image_repo;
+MBrokerCache<MMediaStream> ImageBroker::image_repo(IMAGE_BROKER_MAX_ENTRIES, IMAGE_BROKER_MAX_BYTES);
 
 // Utility Functions
 
@@ -170,7 +170,7 @@ uint32_t MMediaStream::writeContainer(uint8_t *buf, uint32_t size)
 uint8_t MMediaStream::read() 
 {
     uint8_t b = 0;
-    containerStream->read( &b, 1 );
+    readContainer( &b, 1 );
     _position++;
     return b;
 }
@@ -204,7 +204,7 @@ std::string MMediaStream::readUntil( uint8_t delimiter )
     std::string bytes = "";
     do
     {
-        s = containerStream->read( &b, 1 );
+        s = readContainer( &b, 1 );
         _position += s;
         if ( b != delimiter )
         {
@@ -220,7 +220,7 @@ std::string MMediaStream::readUntil( uint8_t delimiter )
 std::string MMediaStream::readString( uint8_t size )
 {
     uint8_t b[size];
-    if ( auto s = containerStream->read( b, size ) )
+    if ( auto s = readContainer( b, size ) )
     {
         _position += s;
         return std::string((char *)b);
@@ -232,7 +232,7 @@ std::string MMediaStream::readStringUntil( uint8_t delimiter )
 {
     uint8_t b = 0;
     std::stringstream ss;
-    while( containerStream->read( &b, 1 ) )
+    while( readContainer( &b, 1 ) )
     {
         _position++;
         if ( b == delimiter )
@@ -251,9 +251,10 @@ bool MMediaStream::seek(uint32_t offset) {
     return containerStream->seek( _position ); 
 }
 // seekCurrent = (offset) => this.containerStream.seekCurrent(offset);
+// Through seek(), so media that keep their own container position or a
+// sector cache (D64) see it too
 bool MMediaStream::seekCurrent(uint32_t offset) {
-    _position += offset;
-    return containerStream->seek( _position );
+    return seek( _position - media_data_offset + offset );
 }
 
 uint32_t MMediaStream::seekFileSize( uint8_t start_track, uint8_t start_sector )
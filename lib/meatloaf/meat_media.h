@@ -3,6 +3,7 @@
 #define MEATLOAF_MEDIA
 
 #include "meatloaf.h"
+#include "meat_broker.h"
 
 #include <map>
 #include <bitset>
@@ -163,22 +164,32 @@ private:
 /********************************************************
  * Utility implementations
  ********************************************************/
+// Images kept open for fast re-entry, see MBrokerCache
+#ifndef IMAGE_BROKER_MAX_ENTRIES
+#define IMAGE_BROKER_MAX_ENTRIES 8
+#endif
+#ifndef IMAGE_BROKER_MAX_BYTES
+#define IMAGE_BROKER_MAX_BYTES (512 * 1024)
+#endif
+
 class ImageBroker {
-    static std::unordered_map<std::string, MMediaStream*> image_repo;
+    static MBrokerCache<MMediaStream> image_repo;
 public:
-    template<class T> static T* obtain(std::string url) 
+    template<class T> static std::shared_ptr<T> obtain(std::string url) 
     {
         //Debug_printv("streams[%d] url[%s]", image_repo.size(), url.c_str());
 
         // obviously you have to supply STREAMFILE.url to this function!
-        if(image_repo.find(url)!=image_repo.end()) {
-            return (T*)image_repo.at(url);
-        }
+        auto cached = image_repo.find(url);
+        if ( cached != nullptr )
+            return std::static_pointer_cast<T>(cached);
 
         // create and add stream to broker if not found
-        auto newFile = MFSOwner::File(url);
+        std::unique_ptr<MFile> newFile(MFSOwner::File(url));
+        if ( newFile == nullptr )
+            return nullptr;
 
-        T* newStream = (T*)newFile->getSourceStream();
+        std::shared_ptr<T> newStream((T*)newFile->getSourceStream());
 
         if ( newStream != nullptr )
         {
@@ -192,35 +203,31 @@ public:
                 Debug_printv("SINGLE FILE [%s]", url.c_str());
             }
 
-            image_repo.insert(std::make_pair(url, newStream));
+            image_repo.insert(url, newStream);
             return newStream;
         }
 
-        delete newFile;
         return nullptr;
     }
 
-    static MMediaStream* obtain(std::string url) {
+    static std::shared_ptr<MMediaStream> obtain(std::string url) {
         return obtain<MMediaStream>(url);
     }
 
+    // Streams still held by a caller stay alive until released
     static void dispose(std::string url) {
-        if(image_repo.find(url)!=image_repo.end()) {
-            auto toDelete = image_repo.at(url);
-            image_repo.erase(url);
-            delete toDelete;
-        }
-        Debug_printv("streams[%d]", image_repo.size());
+        image_repo.erase(url);
+        Debug_printv("streams[%u]", (unsigned)image_repo.size());
     }
 
+    // Count again what the images hold and evict any that nobody holds
+    // while over budget; called when a directory listing lets go of one
     static void validate() {
-        
+        image_repo.trim();
     }
 
     static void clear() {
-        std::for_each(image_repo.begin(), image_repo.end(), [](auto& pair) {
-            delete pair.second;
-        });
+        image_repo.printStats("ImageBroker");
         image_repo.clear();
     }
 };
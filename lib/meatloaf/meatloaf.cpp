@@ -7,8 +7,8 @@
 #include <vector>
 #include <sstream>
 
-std::unordered_map<std::string, MFile*> FileBroker::file_repo;
-std::unordered_map<std::string, MStream*> StreamBroker::stream_repo;
+MBrokerCache<MFile> FileBroker::file_repo(FILE_BROKER_MAX_ENTRIES, SIZE_MAX);
+MBrokerCache<MStream> StreamBroker::stream_repo(STREAM_BROKER_MAX_ENTRIES, STREAM_BROKER_MAX_BYTES);
 
 #ifdef FLASH_SPIFFS
 #include "esp_spiffs.h"
@@ -16,6 +16,7 @@
 #include "peoples_url_parser.h"
 #include "string_utils.h"
 #include "U8Char.h"
+#include "meat_broker.h"
 
 #define _MEAT_NO_DATA_AVAIL (std::ios_base::eofbit)
 
@@ -146,6 +147,10 @@ public:
         return "";
     };
 
+    // Heap held by the stream beyond the object itself (buffers, caches),
+    // used by the brokers to keep their memory bounded
+    virtual uint32_t memoryUsage() { return 0; };
+
     virtual bool seekBlock( uint64_t index, uint8_t offset = 0 ) { return false; };
     virtual bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) { return false; };
     virtual bool seekSector( std::vector<uint8_t> trackSectorOffset ) { return false; };
@@ -501,23 +506,35 @@ namespace Meat {
  * Utility implementations
  ********************************************************/
 
+// Root filesystem files and streams, see MBrokerCache
+#ifndef FILE_BROKER_MAX_ENTRIES
+#define FILE_BROKER_MAX_ENTRIES 16
+#endif
+#ifndef STREAM_BROKER_MAX_ENTRIES
+#define STREAM_BROKER_MAX_ENTRIES 8
+#endif
+#ifndef STREAM_BROKER_MAX_BYTES
+#define STREAM_BROKER_MAX_BYTES (128 * 1024)
+#endif
+
 class FileBroker {
-    static std::unordered_map<std::string, MFile*> file_repo;
+    static MBrokerCache<MFile> file_repo;
 public:
-    template<class T> static T* obtain(std::string url, MFile* sourceFile) 
+    template<class T> static std::shared_ptr<T> obtain(std::string url, MFile* sourceFile) 
     {
         //Debug_printv("streams[%d] url[%s]", file_repo.size(), url.c_str());
 
         // obviously you have to supply STREAMFILE.url to this function!
-        if(file_repo.find(url)!=file_repo.end())
+        auto cached = file_repo.find(url);
+        if ( cached != nullptr )
         {
             Debug_printv("Reusing Existing MFile url[%s]", url.c_str());
-            return (T*)file_repo.at(url);
+            return std::static_pointer_cast<T>(cached);
         }
 
         // create and add stream to broker if not found
         Debug_printv("Creating New Stream url[%s]", url.c_str());
-        auto newFile = MFSOwner::File(url);
+        std::shared_ptr<T> newFile((T*)MFSOwner::File(url));
 
         if ( newFile != nullptr )
         {
@@ -525,7 +542,7 @@ public:
             if ( newFile->pathInStream == "")
             {
                 Debug_printv("ROOT FILESYSTEM... CACHING [%s]", url.c_str());
-                file_repo.insert(std::make_pair(url, newFile));
+                file_repo.insert(url, newFile);
             }
             else
             {
@@ -535,47 +552,41 @@ public:
             return newFile;
         }
 
-        delete newFile;
         return nullptr;
     }
 
-    static MFile* obtain(std::string url, MFile* sourceFile) {
+    static std::shared_ptr<MFile> obtain(std::string url, MFile* sourceFile) {
         return obtain<MFile>(url, sourceFile);
     }
 
     static void dispose(std::string url) {
-        if(file_repo.find(url)!=file_repo.end()) {
-            auto toDelete = file_repo.at(url);
-            file_repo.erase(url);
-            delete toDelete;
-        }
-        Debug_printv("streams[%d]", file_repo.size());
-    }
-
-    static void validate() {
-        
+        file_repo.erase(url);
+        Debug_printv("streams[%u]", (unsigned)file_repo.size());
     }
 };
 
 class StreamBroker {
-    static std::unordered_map<std::string, MStream*> stream_repo;
+    static MBrokerCache<MStream> stream_repo;
 public:
-    template<class T> static T* obtain(std::string url, std::ios_base::openmode mode) 
+    template<class T> static std::shared_ptr<T> obtain(std::string url, std::ios_base::openmode mode) 
     {
         //Debug_printv("streams[%d] url[%s]", stream_repo.size(), url.c_str());
 
         // obviously you have to supply STREAMFILE.url to this function!
-        if(stream_repo.find(url)!=stream_repo.end())
+        auto cached = stream_repo.find(url);
+        if ( cached != nullptr )
         {
             Debug_printv("Reusing Existing Stream url[%s]", url.c_str());
-            return (T*)stream_repo.at(url);
+            return std::static_pointer_cast<T>(cached);
         }
 
         // create and add stream to broker if not found
         Debug_printv("Creating New Stream url[%s]", url.c_str());
-        auto newFile = MFSOwner::File(url);
+        std::unique_ptr<MFile> newFile(MFSOwner::File(url));
+        if ( newFile == nullptr )
+            return nullptr;
 
-        T* newStream = (T*)newFile->createStream(mode);
+        std::shared_ptr<T> newStream((T*)newFile->createStream(mode));
 
         if ( newStream != nullptr )
         {
@@ -583,7 +594,7 @@ public:
             if ( newFile->pathInStream == "")
             {
                 Debug_printv("ROOT FILESYSTEM... CACHING [%s]", url.c_str());
-                stream_repo.insert(std::make_pair(url, newStream));
+                stream_repo.insert(url, newStream);
             }
             else
             {
@@ -593,25 +604,16 @@ public:
             return newStream;
         }
 
-        delete newFile;
         return nullptr;
     }
 
-    static MStream* obtain(std::string url, std::ios_base::openmode mode) {
+    static std::shared_ptr<MStream> obtain(std::string url, std::ios_base::openmode mode) {
         return obtain<MStream>(url, mode);
     }
 
     static void dispose(std::string url) {
-        if(stream_repo.find(url)!=stream_repo.end()) {
-            auto toDelete = stream_repo.at(url);
-            stream_repo.erase(url);
-            delete toDelete;
-        }
-        Debug_printv("streams[%d]", stream_repo.size());
-    }
-
-    static void validate() {
-        
+        stream_repo.erase(url);
+        Debug_printv("streams[%u]", (unsigned)stream_repo.size());
     }
 };
 #endif // MEATLOAF_FILE
@@ -171,7 +171,10 @@ bool T64MFile::isDirectory() {
 bool T64MFile::rewindDirectory() {
     dirIsOpen = true;
     Debug_printv("streamFile->url[%s]", streamFile->url.c_str());
-    auto image = ImageBroker::obtain<T64MStream>(streamFile->url);
+    // Held until the listing ends, so the broker can't evict the image (and
+    // its entry counter) between calls
+    dirImage = ImageBroker::obtain<T64MStream>(streamFile->url);
+    auto image = dirImage;
     if ( image == nullptr )
         Debug_printv("image pointer is null");
 
@@ -199,7 +202,7 @@ MFile* T64MFile::getNextFileInDir() {
         rewindDirectory();
 
     // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<T64MStream>(streamFile->url);
+    auto image = dirImage;
     if ( image == nullptr )
         goto exit;
 
@@ -226,6 +229,8 @@ MFile* T64MFile::getNextFileInDir() {
 exit:
     //Debug_printv( "END OF DIRECTORY");
     dirIsOpen = false;
+    dirImage.reset();
+    ImageBroker::validate();
     return nullptr;
 }
 
@@ -100,6 +100,7 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+    std::shared_ptr<T64MStream> dirImage;
 };
 
 
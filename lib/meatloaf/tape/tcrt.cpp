@@ -207,7 +207,10 @@ bool TCRTMFile::isDirectory() {
 bool TCRTMFile::rewindDirectory() {
     dirIsOpen = true;
     Debug_printv("streamFile->url[%s]", streamFile->url.c_str());
-    auto image = ImageBroker::obtain<TCRTMStream>(streamFile->url);
+    // Held until the listing ends, so the broker can't evict the image (and
+    // its entry counter) between calls
+    dirImage = ImageBroker::obtain<TCRTMStream>(streamFile->url);
+    auto image = dirImage;
     if ( image == nullptr )
         Debug_printv("image pointer is null");
 
@@ -237,7 +240,7 @@ MFile* TCRTMFile::getNextFileInDir()
         rewindDirectory();
 
     // Get entry pointed to by containerStream
-    auto image = ImageBroker::obtain<TCRTMStream>(streamFile->url);
+    auto image = dirImage;
     if ( image == nullptr )
         goto exit;
 
@@ -264,6 +267,8 @@ MFile* TCRTMFile::getNextFileInDir()
 exit:
     //Debug_printv( "END OF DIRECTORY");
     dirIsOpen = false;
+    dirImage.reset();
+    ImageBroker::validate();
     return nullptr;
 }
 
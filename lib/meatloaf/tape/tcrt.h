@@ -101,6 +101,7 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+    std::shared_ptr<TCRTMStream> dirImage;
 };
 
 
@@ -0,0 +1,116 @@
+#include "modem-engine.h"
+
+#include <algorithm>
+
+#include "../../include/atascii.h"
+
+void ModemEscape::scan(const uint8_t *buf, size_t len, uint64_t now)
+{
+    if (len == 0)
+        return;
+
+    size_t trailing = 0;
+    while (trailing < len && buf[len - 1 - trailing] == MODEM_ESCAPE_CHAR)
+        trailing++;
+
+    if (trailing == len)
+        _count += len; // the whole buffer continues a run of '+'
+    else
+        _count = trailing;
+
+    if (_count >= MODEM_ESCAPE_COUNT)
+        _time = now;
+}
+
+ModemCharClass::ModemCharClass(std::initializer_list<uint8_t> specials)
+{
+    for (uint8_t c : specials)
+        add(c, c);
+}
+
+void ModemCharClass::add(uint8_t first, uint8_t last)
+{
+    for (unsigned c = first; c <= last; c++)
+        _special[c >> 3] |= 1 << (c & 7);
+}
+
+size_t ModemCharClass::plainRun(const uint8_t *buf, size_t len) const
+{
+    size_t i = 0;
+    while (i < len && !isSpecial(buf[i]))
+        i++;
+    return i;
+}
+
+ModemCommandLine::ModemCommandLine(size_t maxLength, bool atascii)
+    : _special({ASCII_LF, ASCII_CR, ASCII_BACKSPACE, ASCII_DELETE, ATASCII_CLEAR_SCREEN}),
+      _maxLength(maxLength), _atascii(atascii)
+{
+    _special.add(ATASCII_CURSOR_UP, ATASCII_CURSOR_RIGHT);
+    if (atascii)
+    {
+        _special.add(ATASCII_EOL, ATASCII_EOL);
+        _special.add(ATASCII_BACKSPACE, ATASCII_BACKSPACE);
+    }
+}
+
+size_t ModemCommandLine::edit(std::string &cmd, const uint8_t *buf, size_t len, std::string *echo, int &eol) const
+{
+    eol = -1;
+
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t run = _special.plainRun(&buf[i], len - i);
+        if (run > 0)
+        {
+            size_t room = _maxLength - std::min(cmd.length(), _maxLength);
+            cmd.append((const char *)&buf[i], std::min(run, room));
+            if (echo != nullptr)
+                echo->append((const char *)&buf[i], run);
+            i += run;
+            continue;
+        }
+
+        uint8_t chr = buf[i++];
+
+        // Return, enter, new line, carriage return.. anything goes to end the command
+        if (chr == ASCII_LF || chr == ASCII_CR || (_atascii && chr == ATASCII_EOL))
+        {
+            eol = chr;
+            break;
+        }
+        // Backspace or delete deletes previous character
+        else if (chr == ASCII_BACKSPACE || chr == ASCII_DELETE)
+        {
+            if (!cmd.empty())
+            {
+                cmd.erase(cmd.length() - 1);
+                // We don't assume that backspace is destructive
+                // Clear with a space
+                if (echo != nullptr)
+                {
+                    *echo += ASCII_BACKSPACE;
+                    *echo += ' ';
+                    *echo += ASCII_BACKSPACE;
+                }
+            }
+        }
+        // ATASCII backspace
+        else if (chr == ATASCII_BACKSPACE)
+        {
+            if (!cmd.empty())
+            {
+                cmd.erase(cmd.length() - 1);
+                if (echo != nullptr)
+                    *echo += ATASCII_BACKSPACE;
+            }
+        }
+        // Arrow key movement and clear screen are only echoed
+        else if (echo != nullptr)
+        {
+            *echo += chr;
+        }
+    }
+    return i;
+}
@@ -0,0 +1,97 @@
+/**
+ * Bus independent pieces of the Hayes modem emulation, shared by the
+ * per-platform modem devices so their data paths work on whole buffers
+ * instead of one byte per service pass.
+ */
+
+#ifndef MODEM_ENGINE_H
+#define MODEM_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+#define MODEM_ESCAPE_CHAR '+'
+#define MODEM_ESCAPE_COUNT 3
+#define MODEM_ESCAPE_GUARD_MS 1000 // Silence required after "+++" before going to command mode
+
+class ModemEscape
+{
+    size_t _count = 0;
+    uint64_t _time = 0;
+
+public:
+    /**
+     * Account for a buffer of bytes going to the remote end.
+     * Only the trailing run of '+' can complete an escape, so the buffer is
+     * scanned backwards and the scan stops at the first other byte.
+     * @param buf bytes sent
+     * @param len number of bytes
+     * @param now current time in milliseconds
+     */
+    void scan(const uint8_t *buf, size_t len, uint64_t now);
+
+    /**
+     * Return TRUE once "+++" was the last thing sent and the guard time has passed
+     */
+    bool due(uint64_t now) const
+    {
+        return _count >= MODEM_ESCAPE_COUNT && now - _time > MODEM_ESCAPE_GUARD_MS;
+    }
+
+    void reset() { _count = 0; }
+};
+
+class ModemCharClass
+{
+    uint8_t _special[32] = {0}; // one bit per byte value
+
+public:
+    /**
+     * @param specials bytes that need individual handling in command mode
+     */
+    ModemCharClass(std::initializer_list<uint8_t> specials);
+
+    void add(uint8_t first, uint8_t last);
+
+    bool isSpecial(uint8_t c) const { return _special[c >> 3] & (1 << (c & 7)); }
+
+    /**
+     * Return the number of leading bytes in buf that aren't special, these
+     * can be appended to the command line and echoed as one block.
+     */
+    size_t plainRun(const uint8_t *buf, size_t len) const;
+};
+
+/**
+ * Command mode line editing. Input is taken a buffer at a time: runs of
+ * ordinary characters are appended to the command and echoed as one block,
+ * only line ends and editing keys are handled one byte at a time.
+ */
+class ModemCommandLine
+{
+    ModemCharClass _special;
+    size_t _maxLength;
+    bool _atascii;
+
+public:
+    /**
+     * @param maxLength longest command kept, anything more is echoed but dropped
+     * @param atascii also take ATASCII EOL and backspace as line end and backspace
+     */
+    ModemCommandLine(size_t maxLength, bool atascii = true);
+
+    /**
+     * Edit cmd with command mode input, up to and including the first line end.
+     * @param cmd command being typed
+     * @param buf input bytes
+     * @param len number of bytes
+     * @param echo if not null, the bytes to echo back are appended here
+     * @param eol set to the line end byte that completed the command, or -1
+     * @return number of bytes used, the rest follows the completed command
+     */
+    size_t edit(std::string &cmd, const uint8_t *buf, size_t len, std::string *echo, int &eol) const;
+};
+
+#endif /* MODEM_ENGINE_H */
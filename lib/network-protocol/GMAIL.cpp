@@ -450,6 +450,35 @@ void NetworkProtocolGMAIL::collect_attachments(cJSON *payload, std::vector<cJSON
         out.push_back(payload);
 }
 
+void NetworkProtocolGMAIL::cache_sync(const std::string &labelId, uint32_t total)
+{
+    if (!_cache) return;
+    _cache->validate(labelId);
+
+    // historyId moves on any change to the mailbox; until it does, the ids
+    // listed for each position still hold
+    std::string history;
+    std::string resp = api_get(std::string(GMAIL_BASE) + "/profile");
+    if (!resp.empty())
+    {
+        cJSON *j = cJSON_Parse(resp.c_str());
+        history = json_str(j, "historyId");
+        cJSON_Delete(j);
+    }
+
+    std::string state = history + ":" + std::to_string(total);
+    if (history.empty() || _cache->state() != state)
+    {
+        _cache->forget_positions();
+        _cache->set_state(state);
+    }
+}
+
+std::string NetworkProtocolGMAIL::cache_account()
+{
+    return "gmail";
+}
+
 // ─── mailbox provider hooks ───────────────────────────────────────────────────
 
 fujiError_t NetworkProtocolGMAIL::connect_and_auth()
@@ -488,11 +517,34 @@ fujiError_t NetworkProtocolGMAIL::folder_index(const std::string &folder, long r
     if (rangeEnd > maxIdx)
         rangeEnd = maxIdx;
 
-    std::vector<std::string> ids = list_message_ids(labelId, (size_t)rangeEnd + 1);
+    // Without a cache, a throwaway one keeps this to one path
+    std::shared_ptr<MailboxCache> cache = _cache ? _cache : std::make_shared<MailboxCache>();
+    cache_sync(labelId, total);
 
-    for (long i = rangeStart; i <= rangeEnd && i < (long)ids.size(); i++)
+    // Message ids for the range, unless the cache already knows them
+    bool mapped = true;
+    for (long i = rangeStart; i <= rangeEnd && mapped; i++)
+        mapped = cache->at(total - (uint32_t)i) != nullptr;
+    if (!mapped)
     {
-        std::string url = std::string(GMAIL_BASE) + "/messages/" + ids[i] +
+        std::vector<std::string> ids = list_message_ids(labelId, (size_t)rangeEnd + 1);
+        for (size_t i = 0; i < ids.size(); i++)
+            cache->place(ids[i], total - (uint32_t)i);
+    }
+
+    for (long i = rangeStart; i <= rangeEnd; i++)
+    {
+        MailboxCache::Message *m = cache->at(total - (uint32_t)i);
+        if (!m) continue;
+        if (m->hasEntry)
+        {
+            out.push_back(m->entry);
+            out.back().msgNum = total - (uint32_t)i;
+            continue;
+        }
+
+        // Metadata only for the messages not seen before
+        std::string url = std::string(GMAIL_BASE) + "/messages/" + m->key +
                           "?format=metadata&metadataHeaders=From&metadataHeaders=Subject"
                           "&metadataHeaders=Date";
         std::string resp = api_get(url);
@@ -532,6 +584,9 @@ fujiError_t NetworkProtocolGMAIL::folder_index(const std::string &folder, long r
         }
         parse_from(from, e.displayName, e.emailAddress);
 
+        m->entry = e;
+        m->hasEntry = true;
+        cache->touch();
         out.push_back(e);
         cJSON_Delete(j);
     }
@@ -565,6 +620,20 @@ fujiError_t NetworkProtocolGMAIL::message_body(const std::string &folder, uint32
 fujiError_t NetworkProtocolGMAIL::attachment_index(const std::string &folder, uint32_t seq,
                                                    std::vector<MailboxAttachmentEntry> &out)
 {
+    if (_cache)
+    {
+        uint32_t total = 0;
+        std::string labelId = label_id_for(folder, &total);
+        if (!labelId.empty())
+            cache_sync(labelId, total);
+        MailboxCache::Message *m = _cache->at(seq);
+        if (m && m->hasAttachments)
+        {
+            out = m->attachments;
+            return FUJI_ERROR::NONE;
+        }
+    }
+
     bool ok = false;
     std::string id = message_id_for_seq(folder, seq, ok);
     if (!ok)
@@ -609,6 +678,13 @@ fujiError_t NetworkProtocolGMAIL::attachment_index(const std::string &folder, ui
     }
 
     cJSON_Delete(j);
+
+    if (_cache)
+    {
+        MailboxCache::Message &m = _cache->place(id, seq);
+        m.attachments = out;
+        m.hasAttachments = true;
+    }
     return FUJI_ERROR::NONE;
 }
 
@@ -23,6 +23,10 @@
  * A folder maps to a Gmail label (case-insensitive, e.g. "Inbox" -> INBOX).
  * The message sequence number N is the message's position within the folder:
  * newest message == messagesTotal, oldest == 1.
+ *
+ * Folder and attachment indexes are cached by message id. Ids are listed
+ * again only when the mailbox historyId moves, and metadata is fetched only
+ * for messages not seen before.
  */
 class NetworkProtocolGMAIL : public NetworkProtocolMailbox
 {
@@ -44,6 +48,7 @@ protected:
     fujiError_t attachment_data(const std::string &folder, uint32_t seq, uint8_t attach,
                                 std::string &out) override;
     void mailbox_error_to_error() override;
+    std::string cache_account() override;
 
 private:
     std::string _access_token;
@@ -73,6 +78,8 @@ private:
     bool extract_body(cJSON *payload, std::string &out);
     // Collect attachment parts (parts carrying a filename) from a payload.
     void collect_attachments(cJSON *payload, std::vector<cJSON *> &out);
+    // Check the index cache against the label and the mailbox historyId.
+    void cache_sync(const std::string &labelId, uint32_t total);
 
     static constexpr const char *GMAIL_BASE = "https://gmail.googleapis.com/gmail/v1/users/me";
 };
@@ -3,7 +3,9 @@
  *
  * Uses fnTcpClientSecure for the TLS transport, a small literal-aware parser for
  * the IMAP data grammar (reused for ENVELOPE and BODYSTRUCTURE), and BODYSTRUCTURE
- * walking to select the body part and enumerate attachments.
+ * walking to select the body part and enumerate attachments. Bodies and
+ * attachments are streamed with partial fetches (BODY.PEEK[part]<offset.length>)
+ * and decoded a piece at a time.
  */
 
 #include "IMAPS.h"
@@ -18,6 +20,7 @@
 
 #include "../../include/debug.h"
 #include "../encoding/base64.h"
+#include "../encoding/mime.h"
 
 namespace {
 
@@ -83,37 +86,9 @@ std::string base64_decode(const std::string &in)
     return std::string((char *)p.get(), outlen);
 }
 
-int hexval(char c)
-{
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
-    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
-    return -1;
-}
-
 std::string qp_decode(const std::string &in)
 {
-    std::string out;
-    for (size_t i = 0; i < in.size(); i++)
-    {
-        char c = in[i];
-        if (c == '=')
-        {
-            if (i + 2 < in.size() && hexval(in[i + 1]) >= 0 && hexval(in[i + 2]) >= 0)
-            {
-                out += (char)((hexval(in[i + 1]) << 4) | hexval(in[i + 2]));
-                i += 2;
-            }
-            else if (i + 2 < in.size() && in[i + 1] == '\r' && in[i + 2] == '\n')
-                i += 2; // soft line break
-            else if (i + 1 < in.size() && in[i + 1] == '\n')
-                i += 1;
-            // otherwise drop a stray '='
-        }
-        else
-            out += c;
-    }
-    return out;
+    return MimeDecoder::qp_decode(in);
 }
 
 std::string decode_transfer(const std::string &enc, const std::string &data)
@@ -376,12 +351,22 @@ void walk_bodystructure(const ImapNode &node, const std::string &prefix, std::ve
     out.push_back(p);
 }
 
-void parse_bodystructure_leaves(const std::string &full, std::vector<MimePart> &leaves)
+// The UID of a FETCH record, if it has one.
+std::string fetch_uid(const ImapNode &node)
+{
+    for (size_t i = 0; i + 1 < node.items.size(); i += 2)
+        if (ci_equal(node.items[i].str, "UID")) return node.items[i + 1].str;
+    return "";
+}
+
+void parse_bodystructure_leaves(const std::string &full, std::vector<MimePart> &leaves,
+                                std::string *uid = nullptr)
 {
     ImapParser parser(full);
     uint32_t seq;
     ImapNode node;
     if (!parser.nextFetch(seq, node)) return;
+    if (uid) *uid = fetch_uid(node);
     for (size_t i = 0; i + 1 < node.items.size(); i += 2)
         if (ci_equal(node.items[i].str, "BODYSTRUCTURE") || ci_equal(node.items[i].str, "BODY"))
         {
@@ -390,6 +375,41 @@ void parse_bodystructure_leaves(const std::string &full, std::vector<MimePart> &
         }
 }
 
+// Fill an index entry from a "FETCH (FLAGS INTERNALDATE ENVELOPE)" record.
+void parse_index_entry(const ImapNode &node, MailboxIndexEntry &e)
+{
+    for (size_t i = 0; i + 1 < node.items.size(); i += 2)
+    {
+        const std::string &key = node.items[i].str;
+        const ImapNode &val = node.items[i + 1];
+        if (ci_equal(key, "FLAGS") && val.type == ImapNode::LIST)
+        {
+            for (const auto &f : val.items)
+                if (ci_equal(f.str, "\\Flagged")) e.important = true;
+        }
+        else if (ci_equal(key, "INTERNALDATE") && val.type == ImapNode::STRING)
+            e.timestamp = parse_internaldate(val.str);
+        else if (ci_equal(key, "ENVELOPE") && val.type == ImapNode::LIST)
+        {
+            const auto &env = val.items;
+            if (env.size() > 1 && env[1].type == ImapNode::STRING)
+                e.subject = decode_rfc2047(env[1].str);
+            if (env.size() > 2 && env[2].type == ImapNode::LIST && !env[2].items.empty())
+            {
+                const ImapNode &addr = env[2].items[0];
+                if (addr.type == ImapNode::LIST && addr.items.size() >= 4)
+                {
+                    if (addr.items[0].type == ImapNode::STRING)
+                        e.displayName = decode_rfc2047(addr.items[0].str);
+                    std::string mbox = addr.items[2].type == ImapNode::STRING ? addr.items[2].str : "";
+                    std::string host = addr.items[3].type == ImapNode::STRING ? addr.items[3].str : "";
+                    if (!mbox.empty() && !host.empty()) e.emailAddress = mbox + "@" + host;
+                }
+            }
+        }
+    }
+}
+
 int select_body_index(const std::vector<MimePart> &leaves)
 {
     for (size_t i = 0; i < leaves.size(); i++)
@@ -399,6 +419,22 @@ int select_body_index(const std::vector<MimePart> &leaves)
     return leaves.empty() ? -1 : 0;
 }
 
+// Attachment `attach` (0 -> the primary body), numbered as attachment_index lists them
+const MimePart *find_attachment(const std::vector<MimePart> &leaves, uint8_t attach)
+{
+    int bi = select_body_index(leaves);
+    if (attach == 0)
+        return bi >= 0 ? &leaves[bi] : nullptr;
+
+    int count = 0;
+    for (int i = 0; i < (int)leaves.size(); i++)
+    {
+        if (i == bi) continue;
+        if (++count == attach) return &leaves[i];
+    }
+    return nullptr;
+}
+
 std::string mime_str(const MimePart &p)
 {
     std::string t = p.type, s = p.subtype;
@@ -489,19 +525,73 @@ NetworkProtocolIMAPS::ImapStatus NetworkProtocolIMAPS::select_folder(const std::
     if (st != IMAP_OK) return st;
 
     _selectedCount = 0;
+    _uidValidity = 0;
+    _uidNext = 0;
     std::istringstream ss(full);
     std::string line;
     while (std::getline(ss, line))
-        if (!line.empty() && line[0] == '*' && line.find(" EXISTS") != std::string::npos)
+    {
+        if (line.empty() || line[0] != '*') continue;
+        size_t p;
+        if (line.find(" EXISTS") != std::string::npos)
             _selectedCount = (uint32_t)strtoul(line.c_str() + 1, nullptr, 10);
+        else if ((p = line.find("[UIDVALIDITY ")) != std::string::npos)
+            _uidValidity = (uint32_t)strtoul(line.c_str() + p + 13, nullptr, 10);
+        else if ((p = line.find("[UIDNEXT ")) != std::string::npos)
+            _uidNext = (uint32_t)strtoul(line.c_str() + p + 9, nullptr, 10);
+    }
     _selectedFolder = folder;
     return IMAP_OK;
 }
 
-bool NetworkProtocolIMAPS::fetch_section(uint32_t seq, const std::string &section, std::string &rawOut)
+void NetworkProtocolIMAPS::cache_sync()
+{
+    if (!_cache) return;
+    _cache->validate(std::to_string(_uidValidity));
+
+    std::string state = std::to_string(_uidNext) + ":" + std::to_string(_selectedCount);
+    if (_cache->state() == state && _uidNext) return;
+
+    // Positions still hold if messages were only added at the end: EXISTS
+    // grew by exactly the number of UIDs from the old UIDNEXT on.
+    bool appended = false;
+    unsigned oldNext = 0, oldCount = 0;
+    if (_uidNext && sscanf(_cache->state().c_str(), "%u:%u", &oldNext, &oldCount) == 2 &&
+        oldNext && _uidNext > oldNext && _selectedCount > oldCount)
+    {
+        std::string full;
+        if (do_command("UID SEARCH UID " + std::to_string(oldNext) + ":*", full) == IMAP_OK)
+        {
+            uint32_t added = 0;
+            std::istringstream ss(full);
+            std::string line;
+            while (std::getline(ss, line))
+                if (line.rfind("* SEARCH", 0) == 0)
+                {
+                    std::istringstream ids(line.substr(8));
+                    unsigned long uid;
+                    while (ids >> uid)
+                        if (uid >= oldNext) added++;
+                }
+            appended = oldCount + added == _selectedCount;
+        }
+    }
+    if (!appended)
+        _cache->forget_positions();
+    _cache->set_state(state);
+}
+
+bool NetworkProtocolIMAPS::fetch_section(uint32_t seq, const std::string &section, std::string &rawOut,
+                                         uint64_t offset, size_t length)
 {
+    std::string cmd = "FETCH " + std::to_string(seq);
+    if (length)
+        cmd += " BODY.PEEK[" + section + "]<" + std::to_string(offset) + "." + std::to_string(length) + ">";
+    else
+        cmd += " BODY[" + section + "]";
+
     std::string full;
-    if (do_command("FETCH " + std::to_string(seq) + " BODY[" + section + "]", full) != IMAP_OK)
+    if (do_command(cmd, full) != IMAP_OK)
         return false;
     ImapParser parser(full);
     uint32_t s;
@@ -588,55 +678,88 @@ fujiError_t NetworkProtocolIMAPS::folder_index(const std::string &folder, long r
     std::string seqset = (seqLo == seqHi) ? std::to_string(seqLo)
                                           : std::to_string(seqLo) + ":" + std::to_string(seqHi);
 
+    // Without a cache, a throwaway one keeps this to one path
+    std::shared_ptr<MailboxCache> cache = _cache ? _cache : std::make_shared<MailboxCache>();
+    cache_sync();
+
+    // Which UIDs are in the range, unless the cache already knows
+    bool mapped = true;
+    for (uint32_t seq = seqLo; seq <= seqHi && mapped; seq++)
+        mapped = cache->at(seq) != nullptr;
     std::string full;
-    if (do_command("FETCH " + seqset + " (FLAGS INTERNALDATE ENVELOPE)", full) != IMAP_OK)
+    if (!mapped)
     {
-        _lastErr = NDEV_STATUS::GENERAL;
-        return FUJI_ERROR::UNSPECIFIED;
+        if (do_command("FETCH " + seqset + " (UID)", full) != IMAP_OK)
+        {
+            _lastErr = NDEV_STATUS::GENERAL;
+            return FUJI_ERROR::UNSPECIFIED;
+        }
+        ImapParser parser(full);
+        uint32_t seq;
+        ImapNode node;
+        while (parser.nextFetch(seq, node))
+        {
+            std::string uid = fetch_uid(node);
+            if (!uid.empty()) cache->place(uid, seq);
+        }
     }
 
-    ImapParser parser(full);
-    uint32_t seq;
-    ImapNode node;
-    while (parser.nextFetch(seq, node))
+    // Envelopes only for the messages not seen before. Flags can change from
+    // another client, so the ones already cached have them fetched again.
+    std::string uids, known;
+    for (uint32_t seq = seqLo; seq <= seqHi; seq++)
+    {
+        MailboxCache::Message *m = cache->at(seq);
+        if (!m) continue;
+        std::string &list = m->hasEntry ? known : uids;
+        list += (list.empty() ? "" : ",") + m->key;
+    }
+    if (!known.empty() && do_command("UID FETCH " + known + " (UID FLAGS)", full) == IMAP_OK)
     {
-        MailboxIndexEntry e;
-        e.msgNum = seq;
-        for (size_t i = 0; i + 1 < node.items.size(); i += 2)
+        ImapParser parser(full);
+        uint32_t seq;
+        ImapNode node;
+        while (parser.nextFetch(seq, node))
         {
-            const std::string &key = node.items[i].str;
-            const ImapNode &val = node.items[i + 1];
-            if (ci_equal(key, "FLAGS") && val.type == ImapNode::LIST)
-            {
-                for (const auto &f : val.items)
-                    if (ci_equal(f.str, "\\Flagged")) e.important = true;
-            }
-            else if (ci_equal(key, "INTERNALDATE") && val.type == ImapNode::STRING)
-                e.timestamp = parse_internaldate(val.str);
-            else if (ci_equal(key, "ENVELOPE") && val.type == ImapNode::LIST)
+            MailboxCache::Message *m = cache->find(fetch_uid(node));
+            if (!m || !m->hasEntry) continue;
+            MailboxIndexEntry flags;
+            parse_index_entry(node, flags);
+            if (m->entry.important != flags.important)
             {
-                const auto &env = val.items;
-                if (env.size() > 1 && env[1].type == ImapNode::STRING)
-                    e.subject = decode_rfc2047(env[1].str);
-                if (env.size() > 2 && env[2].type == ImapNode::LIST && !env[2].items.empty())
-                {
-                    const ImapNode &addr = env[2].items[0];
-                    if (addr.type == ImapNode::LIST && addr.items.size() >= 4)
-                    {
-                        if (addr.items[0].type == ImapNode::STRING)
-                            e.displayName = decode_rfc2047(addr.items[0].str);
-                        std::string mbox = addr.items[2].type == ImapNode::STRING ? addr.items[2].str : "";
-                        std::string host = addr.items[3].type == ImapNode::STRING ? addr.items[3].str : "";
-                        if (!mbox.empty() && !host.empty()) e.emailAddress = mbox + "@" + host;
-                    }
-                }
+                m->entry.important = flags.important;
+                cache->touch();
             }
         }
-        out.push_back(e);
+    }
+    if (!uids.empty())
+    {
+        if (do_command("UID FETCH " + uids + " (UID FLAGS INTERNALDATE ENVELOPE)", full) != IMAP_OK)
+        {
+            _lastErr = NDEV_STATUS::GENERAL;
+            return FUJI_ERROR::UNSPECIFIED;
+        }
+        ImapParser parser(full);
+        uint32_t seq;
+        ImapNode node;
+        while (parser.nextFetch(seq, node))
+        {
+            std::string uid = fetch_uid(node);
+            if (uid.empty()) continue;
+            MailboxCache::Message &m = cache->place(uid, seq);
+            m.entry = MailboxIndexEntry();
+            parse_index_entry(node, m.entry);
+            m.hasEntry = true;
+        }
     }
 
-    std::sort(out.begin(), out.end(),
-              [](const MailboxIndexEntry &a, const MailboxIndexEntry &b) { return a.msgNum > b.msgNum; });
+    for (uint32_t seq = seqHi; seq >= seqLo && seq > 0; seq--)
+    {
+        MailboxCache::Message *m = cache->at(seq);
+        if (!m || !m->hasEntry) continue;
+        out.push_back(m->entry);
+        out.back().msgNum = seq;
+    }
     if (!newest) std::reverse(out.begin(), out.end());
     return FUJI_ERROR::NONE;
 }
@@ -671,14 +794,22 @@ fujiError_t NetworkProtocolIMAPS::attachment_index(const std::string &folder, ui
     if (select_folder(folder) != IMAP_OK) { _lastErr = NDEV_STATUS::FILE_NOT_FOUND; return FUJI_ERROR::UNSPECIFIED; }
     if (seq < 1 || seq > _selectedCount) { _lastErr = NDEV_STATUS::FILE_NOT_FOUND; return FUJI_ERROR::UNSPECIFIED; }
 
-    std::string bs;
-    if (do_command("FETCH " + std::to_string(seq) + " BODYSTRUCTURE", bs) != IMAP_OK)
+    cache_sync();
+    MailboxCache::Message *cached = _cache ? _cache->at(seq) : nullptr;
+    if (cached && cached->hasAttachments)
+    {
+        out = cached->attachments;
+        return FUJI_ERROR::NONE;
+    }
+
+    std::string bs, uid;
+    if (do_command("FETCH " + std::to_string(seq) + " (UID BODYSTRUCTURE)", bs) != IMAP_OK)
     {
         _lastErr = NDEV_STATUS::GENERAL;
         return FUJI_ERROR::UNSPECIFIED;
     }
     std::vector<MimePart> leaves;
-    parse_bodystructure_leaves(bs, leaves);
+    parse_bodystructure_leaves(bs, leaves, &uid);
     int bi = select_body_index(leaves);
 
     MailboxAttachmentEntry body;
@@ -699,6 +830,13 @@ fujiError_t NetworkProtocolIMAPS::attachment_index(const std::string &folder, ui
         e.length = leaves[i].size;
         out.push_back(e);
     }
+
+    if (_cache && !uid.empty())
+    {
+        MailboxCache::Message &m = _cache->place(uid, seq);
+        m.attachments = out;
+        m.hasAttachments = true;
+    }
     return FUJI_ERROR::NONE;
 }
 
@@ -716,22 +854,8 @@ fujiError_t NetworkProtocolIMAPS::attachment_data(const std::string &folder, uin
     }
     std::vector<MimePart> leaves;
     parse_bodystructure_leaves(bs, leaves);
-    int bi = select_body_index(leaves);
 
-    const MimePart *target = nullptr;
-    if (attach == 0)
-    {
-        if (bi >= 0) target = &leaves[bi];
-    }
-    else
-    {
-        int count = 0;
-        for (int i = 0; i < (int)leaves.size(); i++)
-        {
-            if (i == bi) continue;
-            if (++count == attach) { target = &leaves[i]; break; }
-        }
-    }
+    const MimePart *target = find_attachment(leaves, attach);
     if (!target)
     {
         // single-part message with no BODYSTRUCTURE parts: fall back to whole text
@@ -750,6 +874,69 @@ fujiError_t NetworkProtocolIMAPS::attachment_data(const std::string &folder, uin
     return FUJI_ERROR::NONE;
 }
 
+fujiError_t NetworkProtocolIMAPS::stream_open(const std::string &folder, uint32_t seq, uint8_t attach,
+                                              bool &streaming)
+{
+    streaming = false;
+    if (select_folder(folder) != IMAP_OK) { _lastErr = NDEV_STATUS::FILE_NOT_FOUND; return FUJI_ERROR::UNSPECIFIED; }
+    if (seq < 1 || seq > _selectedCount) { _lastErr = NDEV_STATUS::FILE_NOT_FOUND; return FUJI_ERROR::UNSPECIFIED; }
+
+    std::string bs;
+    if (do_command("FETCH " + std::to_string(seq) + " BODYSTRUCTURE", bs) != IMAP_OK)
+    {
+        _lastErr = NDEV_STATUS::GENERAL;
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+    std::vector<MimePart> leaves;
+    parse_bodystructure_leaves(bs, leaves);
+
+    // With no parts, the body is the whole text, undecoded (as attachment_data)
+    const MimePart *target = find_attachment(leaves, attach);
+    if (!target && attach != 0)
+    {
+        _lastErr = NDEV_STATUS::FILE_NOT_FOUND;
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+
+    _streamSeq = seq;
+    _streamSection = target ? target->partNum : "TEXT";
+    _streamSize = target ? target->size : 0;
+    _streamOffset = 0;
+    _streamDecoder = MimeDecoder(target ? target->encoding : "");
+    streaming = true;
+    return FUJI_ERROR::NONE;
+}
+
+fujiError_t NetworkProtocolIMAPS::stream_read(size_t want, std::string &out, bool &eof)
+{
+    size_t length = _streamDecoder.encoded_size(want);
+    std::string raw;
+    if (!fetch_section(_streamSeq, _streamSection, raw, _streamOffset, length))
+    {
+        _lastErr = NDEV_STATUS::GENERAL;
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+    _streamOffset += raw.size();
+
+    // A short piece is the end; so is reaching the size BODYSTRUCTURE gave
+    eof = raw.size() < length || (_streamSize && _streamOffset >= _streamSize);
+    _streamDecoder.update(raw.data(), raw.size(), out, eof);
+
+    // BODY.PEEK leaves \Seen alone; set it once the whole part has been read,
+    // as the plain BODY[] fetch did
+    if (eof)
+    {
+        std::string full;
+        do_command("STORE " + std::to_string(_streamSeq) + " +FLAGS.SILENT (\\Seen)", full);
+    }
+    return FUJI_ERROR::NONE;
+}
+
+std::string NetworkProtocolIMAPS::cache_account()
+{
+    return "imaps://" + _user + "@" + _host + ":" + std::to_string(_port);
+}
+
 void NetworkProtocolIMAPS::mailbox_error_to_error()
 {
     error = _lastErr;
@@ -3,6 +3,7 @@
 
 #include "Mailbox.h"
 #include "fnTcpClientSecure.h"
+#include "../encoding/mime.h"
 #include "status_error_codes.h"
 
 #include <string>
@@ -21,6 +22,9 @@
  *
  * Credentials come from the URL (user:pass@) and fall back to the login/password
  * members set by SET LOGIN / SET PASSWORD.
+ *
+ * Folder and attachment indexes are cached by UID, validated with UIDVALIDITY
+ * and UIDNEXT, so reopening only fetches envelopes for new messages.
  */
 class NetworkProtocolIMAPS : public NetworkProtocolMailbox
 {
@@ -42,6 +46,10 @@ protected:
     fujiError_t attachment_data(const std::string &folder, uint32_t seq, uint8_t attach,
                                 std::string &out) override;
     void mailbox_error_to_error() override;
+    fujiError_t stream_open(const std::string &folder, uint32_t seq, uint8_t attach,
+                            bool &streaming) override;
+    fujiError_t stream_read(size_t want, std::string &out, bool &eof) override;
+    std::string cache_account() override;
 
 private:
     enum ImapStatus { IMAP_OK, IMAP_NO, IMAP_BAD, IMAP_TIMEOUT };
@@ -53,8 +61,17 @@ private:
     uint16_t _port = 993;
     std::string _selectedFolder;
     uint32_t _selectedCount = 0;
+    uint32_t _uidValidity = 0;
+    uint32_t _uidNext = 0;      // 0 if the server didn't say
     nDevStatus_t _lastErr = NDEV_STATUS::GENERAL;
 
+    // Part being streamed: fetched from _streamOffset in the encoded part
+    uint32_t _streamSeq = 0;
+    std::string _streamSection;
+    uint64_t _streamOffset = 0;
+    uint64_t _streamSize = 0; // encoded size from BODYSTRUCTURE, 0 if unknown
+    MimeDecoder _streamDecoder;
+
     // Send "<tag> <cmd>\r\n" and read the full tagged response (literals inlined).
     ImapStatus do_command(const std::string &cmd, std::string &full);
     ImapStatus read_raw_response(const std::string &tag, std::string &full);
@@ -62,8 +79,14 @@ private:
     // SELECT a folder, populating _selectedCount from the "* n EXISTS" reply.
     ImapStatus select_folder(const std::string &folder);
 
+    // Check the index cache against the selected folder: empty it if
+    // UIDVALIDITY changed, forget positions unless messages were only added.
+    void cache_sync();
+
     // FETCH a single body section (e.g. "1", "TEXT") and return its raw bytes.
-    bool fetch_section(uint32_t seq, const std::string &section, std::string &rawOut);
+    // With a length, only that much from offset, without setting \Seen.
+    bool fetch_section(uint32_t seq, const std::string &section, std::string &rawOut,
+                       uint64_t offset = 0, size_t length = 0);
 };
 
 #endif /* NETWORKPROTOCOLIMAPS_H */
@@ -12,6 +12,9 @@
 #include <sstream>
 
 #include "../../include/debug.h"
+#include "../encoding/mime.h"
+#include "fnFsSD.h"
+#include "fnSystem.h"
 #include "status_error_codes.h"
 
 // The human-readable index/count lines are terminated with `lineEnding`, the
@@ -22,6 +25,16 @@
 #define MB_DEFAULT_RANGE 20
 // Upper bound on messages fetched for one index, to bound work and memory.
 #define MB_MAX_RANGE 200
+// Index caches live here on the SD card, one file per account and folder,
+// each holding at most this many messages.
+#define MB_CACHE_DIR "/FujiNet/mailcache"
+#define MB_CACHE_MAX 1000
+
+// Streamed pieces start small, so the first byte reaches the host quickly,
+// then track the size of its READs: doubling while it takes whole pieces,
+// shrinking to what it asks for when that's less.
+#define MB_STREAM_MIN 256
+#define MB_STREAM_MAX 4096
 
 // ─── small string/byte helpers ────────────────────────────────────────────────
 
@@ -101,6 +114,12 @@ std::string humanize_size(uint64_t n)
     return buf;
 }
 
+// The index cache used last stays in memory, so paging back and forth
+// through a folder doesn't re-read it from the SD card.
+std::shared_ptr<MailboxCache> last_cache;
+std::string last_cache_key;
+std::string last_cache_path;
+
 } // namespace
 
 // ─── construction ─────────────────────────────────────────────────────────────
@@ -146,6 +165,65 @@ std::vector<std::string> NetworkProtocolMailbox::split_path(const std::string &p
     return parts;
 }
 
+// ─── index cache ──────────────────────────────────────────────────────────────
+
+void NetworkProtocolMailbox::cache_load()
+{
+    _cache.reset();
+    std::string account = cache_account();
+    if (account.empty())
+        return;
+
+    std::string key = MailboxCache::key(account, _folder);
+    std::string path = std::string(MB_CACHE_DIR) + "/" + MailboxCache::file_name(account, _folder);
+    if (last_cache && last_cache_key == key)
+    {
+        _cache = last_cache;
+        return;
+    }
+
+    _cache = std::make_shared<MailboxCache>();
+    if (fnSDFAT.running())
+    {
+        FILE *f = fnSDFAT.file_open(path.c_str(), "rb");
+        if (f)
+        {
+            std::string data;
+            char buf[512];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+                data.append(buf, n);
+            fclose(f);
+            if (!_cache->deserialize(data, key))
+                Debug_printf("Mailbox cache %s unreadable or not this folder's, starting over\r\n", path.c_str());
+        }
+    }
+    last_cache = _cache;
+    last_cache_key = key;
+    last_cache_path = path;
+}
+
+void NetworkProtocolMailbox::cache_save()
+{
+    if (!_cache || !_cache->dirty())
+        return;
+    _cache->trim(MB_CACHE_MAX);
+    _cache->clean();
+
+    if (!fnSDFAT.running())
+        return;
+    fnSDFAT.create_path(MB_CACHE_DIR);
+    FILE *f = fnSDFAT.file_open(last_cache_path.c_str(), "wb");
+    if (!f)
+    {
+        Debug_printf("Mailbox cache %s: can't write\r\n", last_cache_path.c_str());
+        return;
+    }
+    std::string data = _cache->serialize(last_cache_key);
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
 // ─── open / dispatch ──────────────────────────────────────────────────────────
 
 fujiError_t NetworkProtocolMailbox::open(PeoplesUrlParser *urlParser, fileAccessMode_t access,
@@ -154,6 +232,9 @@ fujiError_t NetworkProtocolMailbox::open(PeoplesUrlParser *urlParser, fileAccess
     NetworkProtocol::open(urlParser, access, translate);
     error = NDEV_STATUS::SUCCESS;
     receiveBuffer->clear();
+    _streaming = false;
+    _streamWant = MB_STREAM_MIN;
+    _streamCarry.clear();
 
     bool isDir = (access == ACCESS_MODE::DIRECTORY || access == ACCESS_MODE::DIRECTORY_ALT);
     bool isRead = (access == ACCESS_MODE::READ);
@@ -248,12 +329,21 @@ fujiError_t NetworkProtocolMailbox::do_folder_index(uint8_t transByte)
 
     bool newest = opened_url->queryParam("newest", "1") != "0";
 
+    uint64_t started = fnSystem.millis();
+    cache_load();
+    size_t cached = _cache ? _cache->size() : 0;
+
     std::vector<MailboxIndexEntry> items;
-    if (folder_index(_folder, rangeStart, rangeEnd, newest, items) != FUJI_ERROR::NONE)
+    fujiError_t res = folder_index(_folder, rangeStart, rangeEnd, newest, items);
+    cache_save();
+    _cache.reset();
+    if (res != FUJI_ERROR::NONE)
     {
         mailbox_error_to_error();
         return FUJI_ERROR::UNSPECIFIED;
     }
+    Debug_printf("Mailbox index %ld-%ld: %u entries in %u ms (%u cached)\r\n", rangeStart, rangeEnd,
+                 (unsigned)items.size(), (unsigned)(fnSystem.millis() - started), (unsigned)cached);
 
     if (raw)
         format_index_raw(items);
@@ -266,6 +356,14 @@ fujiError_t NetworkProtocolMailbox::do_folder_index(uint8_t transByte)
 
 fujiError_t NetworkProtocolMailbox::do_message_body()
 {
+    if (stream_open(_folder, _seq, 0, _streaming) != FUJI_ERROR::NONE)
+    {
+        mailbox_error_to_error();
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+    if (_streaming)
+        return stream_fill();
+
     std::string body;
     if (message_body(_folder, _seq, body) != FUJI_ERROR::NONE)
     {
@@ -286,8 +384,12 @@ fujiError_t NetworkProtocolMailbox::do_attachment_index(uint8_t transByte)
     int width = transByte & 0x7F;
     if (width == 0) width = _defaultWidth; // platform default when unspecified
 
+    cache_load();
     std::vector<MailboxAttachmentEntry> items;
-    if (attachment_index(_folder, _seq, items) != FUJI_ERROR::NONE)
+    fujiError_t res = attachment_index(_folder, _seq, items);
+    cache_save();
+    _cache.reset();
+    if (res != FUJI_ERROR::NONE)
     {
         mailbox_error_to_error();
         return FUJI_ERROR::UNSPECIFIED;
@@ -304,6 +406,14 @@ fujiError_t NetworkProtocolMailbox::do_attachment_index(uint8_t transByte)
 
 fujiError_t NetworkProtocolMailbox::do_attachment_data()
 {
+    if (stream_open(_folder, _seq, _attach, _streaming) != FUJI_ERROR::NONE)
+    {
+        mailbox_error_to_error();
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+    if (_streaming)
+        return stream_fill();
+
     std::string data;
     if (attachment_data(_folder, _seq, _attach, data) != FUJI_ERROR::NONE)
     {
@@ -454,15 +564,59 @@ void NetworkProtocolMailbox::format_attachment_index_raw(const std::vector<Mailb
 
 // ─── read / status / available ────────────────────────────────────────────────
 
+fujiError_t NetworkProtocolMailbox::stream_fill()
+{
+    // Some pieces decode to nothing (a base64 chunk of line breaks), so keep
+    // going until there's something for the host or the part has ended.
+    while (_streaming && receiveBuffer->empty())
+    {
+        bool eof = false;
+        if (stream_read(_streamWant, *receiveBuffer, eof) != FUJI_ERROR::NONE)
+        {
+            _streaming = false;
+            receiveBuffer->clear();
+            mailbox_error_to_error();
+            return FUJI_ERROR::UNSPECIFIED;
+        }
+        if (eof)
+            _streaming = false;
+
+        // A CRLF or UTF-8 sequence cut between pieces is translated whole
+        receiveBuffer->insert(0, _streamCarry);
+        _streamCarry.clear();
+        if (_streaming)
+        {
+            size_t hold = text_holdback(*receiveBuffer,
+                                        translation_mode == NETPROTO_TRANS_CRLF ? "\r\n" : "",
+                                        translation_mode == NETPROTO_TRANS_PETSCII);
+            _streamCarry.assign(*receiveBuffer, receiveBuffer->size() - hold, hold);
+            receiveBuffer->resize(receiveBuffer->size() - hold);
+        }
+        translate_receive_buffer();
+    }
+    return FUJI_ERROR::NONE;
+}
+
 fujiError_t NetworkProtocolMailbox::read(unsigned short len)
 {
-    // All content is staged into receiveBuffer at open(); the device drains it.
+    // Content is staged into receiveBuffer at open(), or streamed into it a
+    // piece at a time; the device drains it.
+    if (_streaming && len)
+    {
+        if (len < _streamWant)
+            _streamWant = std::max<size_t>(len, MB_STREAM_MIN);
+        else
+            _streamWant = std::min<size_t>(_streamWant * 2, MB_STREAM_MAX);
+    }
+    if (stream_fill() != FUJI_ERROR::NONE)
+        return FUJI_ERROR::UNSPECIFIED;
     error = NDEV_STATUS::SUCCESS;
     return FUJI_ERROR::NONE;
 }
 
 fujiError_t NetworkProtocolMailbox::status(NetworkStatus *status)
 {
+    stream_fill();
     if (error == NDEV_STATUS::SUCCESS && receiveBuffer->empty())
         status->error = NDEV_STATUS::END_OF_FILE;
     else
@@ -473,5 +627,6 @@ fujiError_t NetworkProtocolMailbox::status(NetworkStatus *status)
 
 size_t NetworkProtocolMailbox::available()
 {
+    stream_fill();
     return receiveBuffer->size();
 }
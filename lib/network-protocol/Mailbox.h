@@ -20,6 +20,15 @@
  *
  * N is the message's sequence position within the folder.
  *
+ * Message bodies and attachments are streamed when the provider supports it
+ * (stream_open/stream_read): each piece is fetched and decoded as the host
+ * drains receiveBuffer, sized to its READ requests, so memory use doesn't
+ * grow with the size of the part.
+ *
+ * Providers that name an account (cache_account) get an index cache for the
+ * folder, kept on the SD card, so paging through a folder only fetches what
+ * hasn't been seen before. See MailboxCache.h.
+ *
  * Query params on a folder index: range=START-END (absolute, inclusive,
  * 0-based; default first 20) and newest=1 (default, descending; 0 ascending).
  *
@@ -34,8 +43,10 @@
 #define NETWORKPROTOCOL_MAILBOX
 
 #include "Protocol.h"
+#include "MailboxCache.h"
 
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -64,27 +75,6 @@ typedef struct _mailAttachmentItem
 static_assert(sizeof(MailIndexItem) == 220, "MailIndexItem wire layout changed");
 static_assert(sizeof(MailAttachmentItem) == 313, "MailAttachmentItem wire layout changed");
 
-// Structured index entry the provider hooks fill in (host-native types).
-struct MailboxIndexEntry
-{
-    uint32_t    msgNum = 0;
-    bool        important = false;
-    std::string displayName;
-    std::string emailAddress;
-    std::string subject;
-    uint64_t    timestamp = 0; // seconds since epoch
-};
-
-// Structured attachment entry the provider hooks fill in.
-struct MailboxAttachmentEntry
-{
-    uint8_t     attachmentNum = 0;
-    std::string displayName;
-    std::string fileName;
-    std::string mimeType;
-    uint64_t    length = 0;
-};
-
 class NetworkProtocolMailbox : public NetworkProtocol
 {
 public:
@@ -129,6 +119,35 @@ protected:
     // Map the last provider error into `error` (nDevStatus_t).
     virtual void mailbox_error_to_error() = 0;
 
+    // ---- optional streamed reads ----
+
+    // Prepare to stream attachment `attach` (0 -> primary body) of message
+    // seq. Set streaming=false to have the part staged whole through
+    // message_body() / attachment_data() instead, which is the default.
+    virtual fujiError_t stream_open(const std::string &folder, uint32_t seq, uint8_t attach,
+                                    bool &streaming)
+    {
+        streaming = false;
+        return FUJI_ERROR::NONE;
+    }
+
+    // Append about `want` decoded bytes of the part to out (possibly none,
+    // possibly more). Set eof once the part is exhausted.
+    virtual fujiError_t stream_read(size_t want, std::string &out, bool &eof)
+    {
+        eof = true;
+        return FUJI_ERROR::NONE;
+    }
+
+    // Identifies the account in the index cache's file name. Empty (the
+    // default) means no cache.
+    virtual std::string cache_account() { return ""; }
+
+    // Index cache for _folder while a folder or attachment index is being
+    // built, else nullptr. Providers consult and fill it; the base loads
+    // and saves it.
+    std::shared_ptr<MailboxCache> _cache;
+
     // ---- parsed request state (populated by open) ----
     std::string _folder;
     uint32_t    _seq = 0;
@@ -138,6 +157,19 @@ protected:
     int _defaultWidth = 40;
 
 private:
+    // Streamed read state: open until the provider reports eof.
+    bool _streaming = false;
+    size_t _streamWant = 0;
+    std::string _streamCarry; // end of the last piece, translated with the next
+
+    // Fetch the next streamed piece into an empty receiveBuffer.
+    fujiError_t stream_fill();
+
+    // Load _cache for _folder (from memory if it's the last one used), and
+    // write it back to the SD card if it changed.
+    void cache_load();
+    void cache_save();
+
     // Operation dispatch (combines path depth with access mode).
     fujiError_t do_folder_count();
     fujiError_t do_folder_index(uint8_t transByte);
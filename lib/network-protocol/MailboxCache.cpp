@@ -0,0 +1,218 @@
+/**
+ * MailboxCache - per-account, per-folder index cache for Mailbox protocols.
+ */
+
+#include "MailboxCache.h"
+
+#include <algorithm>
+
+#include "record_utils.h"
+
+// Bumped when the file layout changes; older files are ignored.
+#define MC_MAGIC "FNMC"
+#define MC_VERSION 2
+
+// ─── contents ─────────────────────────────────────────────────────────────────
+
+void MailboxCache::validate(const std::string &validity)
+{
+    if (validity == _validity)
+        return;
+    _messages.clear();
+    _bySeq.clear();
+    _state.clear();
+    _validity = validity;
+    _dirty = true;
+}
+
+void MailboxCache::set_state(const std::string &state)
+{
+    if (state == _state)
+        return;
+    _state = state;
+    _dirty = true;
+}
+
+void MailboxCache::forget_positions()
+{
+    for (auto &m : _messages)
+        m.second.seq = 0;
+    _bySeq.clear();
+    _dirty = true;
+}
+
+MailboxCache::Message *MailboxCache::at(uint32_t seq)
+{
+    auto it = _bySeq.find(seq);
+    return it == _bySeq.end() ? nullptr : find(it->second);
+}
+
+MailboxCache::Message *MailboxCache::find(const std::string &key)
+{
+    auto it = _messages.find(key);
+    if (it == _messages.end())
+        return nullptr;
+    it->second.used = ++_clock;
+    return &it->second;
+}
+
+MailboxCache::Message &MailboxCache::place(const std::string &key, uint32_t seq)
+{
+    Message &m = _messages[key];
+    m.key = key;
+    m.used = ++_clock;
+    _dirty = true;
+
+    if (m.seq == seq)
+        return m;
+    if (m.seq)
+        _bySeq.erase(m.seq);
+    if (seq)
+    {
+        // Whatever was there before has moved
+        auto old = _bySeq.find(seq);
+        if (old != _bySeq.end())
+        {
+            auto prev = _messages.find(old->second);
+            if (prev != _messages.end())
+                prev->second.seq = 0;
+        }
+        _bySeq[seq] = key;
+    }
+    m.seq = seq;
+    return m;
+}
+
+void MailboxCache::trim(size_t max)
+{
+    if (_messages.size() <= max)
+        return;
+
+    std::vector<uint32_t> used;
+    used.reserve(_messages.size());
+    for (auto &m : _messages)
+        used.push_back(m.second.used);
+    std::nth_element(used.begin(), used.end() - max, used.end());
+    uint32_t keep = *(used.end() - max);
+
+    for (auto it = _messages.begin(); it != _messages.end();)
+    {
+        if (it->second.used < keep)
+        {
+            if (it->second.seq)
+                _bySeq.erase(it->second.seq);
+            it = _messages.erase(it);
+        }
+        else
+            ++it;
+    }
+    _dirty = true;
+}
+
+// ─── persistence ──────────────────────────────────────────────────────────────
+
+std::string MailboxCache::serialize(const std::string &key) const
+{
+    std::string b = MC_MAGIC;
+    record_put_le(b, MC_VERSION, 1);
+    record_put_str(b, key);
+    record_put_str(b, _validity);
+    record_put_str(b, _state);
+    record_put_le(b, _messages.size(), 4);
+
+    for (auto &it : _messages)
+    {
+        const Message &m = it.second;
+        record_put_str(b, m.key);
+        record_put_le(b, m.seq, 4);
+        record_put_le(b, m.used, 4);
+        record_put_le(b, (m.hasEntry ? 1 : 0) | (m.hasAttachments ? 2 : 0) | (m.entry.important ? 4 : 0), 1);
+        if (m.hasEntry)
+        {
+            record_put_str(b, m.entry.displayName);
+            record_put_str(b, m.entry.emailAddress);
+            record_put_str(b, m.entry.subject);
+            record_put_le(b, m.entry.timestamp, 8);
+        }
+        if (m.hasAttachments)
+        {
+            record_put_le(b, m.attachments.size(), 1);
+            for (auto &a : m.attachments)
+            {
+                record_put_le(b, a.attachmentNum, 1);
+                record_put_str(b, a.displayName);
+                record_put_str(b, a.fileName);
+                record_put_str(b, a.mimeType);
+                record_put_le(b, a.length, 8);
+            }
+        }
+    }
+    return b;
+}
+
+bool MailboxCache::deserialize(const std::string &data, const std::string &key)
+{
+    *this = MailboxCache();
+    if (data.compare(0, 4, MC_MAGIC) != 0)
+        return false;
+
+    RecordReader r(data, 4);
+    if (r.le(1) != MC_VERSION || r.str() != key || !r.ok())
+        return false;
+
+    MailboxCache c;
+    c._validity = r.str();
+    c._state = r.str();
+    uint32_t n = r.le(4);
+    for (uint32_t i = 0; i < n && r.ok(); i++)
+    {
+        Message m;
+        m.key = r.str();
+        m.seq = r.le(4);
+        m.used = r.le(4);
+        uint8_t flags = r.le(1);
+        m.hasEntry = flags & 1;
+        m.hasAttachments = flags & 2;
+        if (m.hasEntry)
+        {
+            m.entry.important = flags & 4;
+            m.entry.displayName = r.str();
+            m.entry.emailAddress = r.str();
+            m.entry.subject = r.str();
+            m.entry.timestamp = r.le(8);
+        }
+        if (m.hasAttachments)
+        {
+            uint8_t count = r.le(1);
+            for (uint8_t k = 0; k < count && r.ok(); k++)
+            {
+                MailboxAttachmentEntry a;
+                a.attachmentNum = r.le(1);
+                a.displayName = r.str();
+                a.fileName = r.str();
+                a.mimeType = r.str();
+                a.length = r.le(8);
+                m.attachments.push_back(a);
+            }
+        }
+        c._clock = std::max(c._clock, m.used);
+        if (m.seq)
+            c._bySeq[m.seq] = m.key;
+        c._messages[m.key] = m;
+    }
+    if (!r.ok())
+        return false;
+
+    *this = std::move(c);
+    return true;
+}
+
+std::string MailboxCache::key(const std::string &account, const std::string &folder)
+{
+    return account + '\n' + folder;
+}
+
+std::string MailboxCache::file_name(const std::string &account, const std::string &folder)
+{
+    return record_file_name(key(account, folder), "IDX");
+}
@@ -0,0 +1,114 @@
+/**
+ * MailboxCache - per-account, per-folder index cache for Mailbox protocols.
+ *
+ * Holds what a provider has already fetched for a folder, keyed by a stable
+ * message id (IMAP UID, Gmail message id): the index entry and the
+ * attachment list. Each message also records its current folder position,
+ * so a range of the index can be served without asking the server.
+ *
+ * The provider decides what is still true:
+ *  - validity: when it changes (IMAP UIDVALIDITY), every id is void and the
+ *    cache empties itself.
+ *  - state: an opaque marker of the folder's contents (IMAP UIDNEXT and
+ *    EXISTS, Gmail historyId). While it is unchanged, positions hold. When
+ *    it changes, the provider either keeps them (messages were only added
+ *    at the end) or forgets them; the cached entries stay either way, since
+ *    an id's envelope doesn't change.
+ *
+ * The cache only holds data; NetworkProtocolMailbox loads and saves it on
+ * the SD card. IMAP flags are fetched again whenever a cached entry is
+ * served; Gmail labels are as of when the entry was fetched.
+ */
+
+#ifndef NETWORKPROTOCOL_MAILBOXCACHE
+#define NETWORKPROTOCOL_MAILBOXCACHE
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Structured index entry the provider hooks fill in (host-native types).
+struct MailboxIndexEntry
+{
+    uint32_t    msgNum = 0;
+    bool        important = false;
+    std::string displayName;
+    std::string emailAddress;
+    std::string subject;
+    uint64_t    timestamp = 0; // seconds since epoch
+};
+
+// Structured attachment entry the provider hooks fill in.
+struct MailboxAttachmentEntry
+{
+    uint8_t     attachmentNum = 0;
+    std::string displayName;
+    std::string fileName;
+    std::string mimeType;
+    uint64_t    length = 0;
+};
+
+class MailboxCache
+{
+public:
+    struct Message
+    {
+        std::string key;
+        uint32_t seq = 0; // folder position, 0 if not known
+
+        bool hasEntry = false;
+        MailboxIndexEntry entry;
+
+        bool hasAttachments = false;
+        std::vector<MailboxAttachmentEntry> attachments;
+
+        uint32_t used = 0; // for trim()
+    };
+
+    // Empty the cache if the folder's validity token changed.
+    void validate(const std::string &validity);
+
+    const std::string &state() const { return _state; }
+    void set_state(const std::string &state);
+
+    // Keep the entries but not where they are in the folder.
+    void forget_positions();
+
+    // Message at a folder position, or by id; nullptr if not cached.
+    Message *at(uint32_t seq);
+    Message *find(const std::string &key);
+
+    // Find or add the message with this id and record its position
+    // (0 leaves it unknown). Marks the cache changed.
+    Message &place(const std::string &key, uint32_t seq);
+
+    // Note that a Message was filled in, so the cache gets saved.
+    void touch() { _dirty = true; }
+
+    // Drop the least recently used messages beyond max.
+    void trim(size_t max);
+
+    size_t size() const { return _messages.size(); }
+    bool dirty() const { return _dirty; }
+    void clean() { _dirty = false; }
+
+    // The file records the key it was saved under (see key()); a file with
+    // another key, from a folder whose name hashes the same, isn't loaded.
+    std::string serialize(const std::string &key) const;
+    bool deserialize(const std::string &data, const std::string &key);
+
+    // Key of a folder of an account, and its cache file name (no directory).
+    static std::string key(const std::string &account, const std::string &folder);
+    static std::string file_name(const std::string &account, const std::string &folder);
+
+private:
+    std::string _validity;
+    std::string _state;
+    std::map<std::string, Message> _messages;
+    std::map<uint32_t, std::string> _bySeq;
+    uint32_t _clock = 0;
+    bool _dirty = false;
+};
+
+#endif /* NETWORKPROTOCOL_MAILBOXCACHE */
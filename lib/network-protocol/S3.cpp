@@ -11,8 +11,13 @@
 #include <cstdlib>
 #include <ctime>
 
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
 #include "../../include/debug.h"
 #include "../config/fnConfig.h"
+#include "fnSystem.h"
 #include "../encoding/hash.h"
 #include "status_error_codes.h"
 #include "utils.h"
@@ -34,6 +39,7 @@ NetworkProtocolS3::NetworkProtocolS3(std::string *rx_buf,
 NetworkProtocolS3::~NetworkProtocolS3()
 {
     Debug_printf("NetworkProtocolS3::dtor\r\n");
+    write_buf_free();
 }
 
 // ─── SigV4 / encoding helpers ─────────────────────────────────────────────────
@@ -244,6 +250,8 @@ int NetworkProtocolS3::sign_and_send(S3_HTTP_CLIENT &client,
         client.set_header(h.first.c_str(), h.second.c_str());
     for (const auto &h : unsigned_headers)
         client.set_header(h.first.c_str(), h.second.c_str());
+    // The part ETags of a multipart upload come back as a response header.
+    client.create_empty_stored_headers({"ETag"});
 
     int status;
     if (strcmp(method, "GET") == 0)
@@ -252,6 +260,8 @@ int NetworkProtocolS3::sign_and_send(S3_HTTP_CLIENT &client,
         status = client.HEAD();
     else if (strcmp(method, "PUT") == 0)
         status = client.PUT(body ? body : "", body_len);
+    else if (strcmp(method, "POST") == 0)
+        status = client.POST(body ? body : "", body_len);
     else if (strcmp(method, "DELETE") == 0)
         status = client.DELETE();
     else
@@ -379,6 +389,100 @@ std::string NetworkProtocolS3::parse_list_xml(const std::string &xml, const std:
     return "";
 }
 
+// ─── multipart upload ────────────────────────────────────────────────────────
+
+bool NetworkProtocolS3::multipart_begin(const std::string &key)
+{
+    std::string body;
+    int status = s3_do("POST", "/" + _bucket + "/" + key, {{"uploads", ""}}, {}, "", 0, &body);
+    if (status < 200 || status >= 300)
+        return false;
+
+    size_t pos = 0;
+    _upload_id = xml_unescape(extract_tag(body, "UploadId", pos));
+    _part_etags.clear();
+    Debug_printf("S3: multipart upload started, id=%s\r\n", _upload_id.c_str());
+    return !_upload_id.empty();
+}
+
+// APPEND to an object too big to buffer: copy it server-side as part 1.
+bool NetworkProtocolS3::multipart_copy_part(const std::string &key)
+{
+    std::map<std::string, std::string> q;
+    q["partNumber"] = std::to_string(_part_etags.size() + 1);
+    q["uploadId"] = _upload_id;
+    std::vector<std::pair<std::string, std::string>> amz = {
+        {"x-amz-copy-source", uri_encode("/" + _bucket + "/" + key, false)}};
+
+    std::string body;
+    int status = s3_do("PUT", "/" + _bucket + "/" + key, q, amz, "", 0, &body);
+    size_t pos = 0;
+    std::string etag = xml_unescape(extract_tag(body, "ETag", pos));
+    if (status < 200 || status >= 300 || etag.empty())
+        return false;
+
+    _part_etags.push_back(etag);
+    return true;
+}
+
+bool NetworkProtocolS3::multipart_put_part(const std::string &key, const uint8_t *data, size_t len)
+{
+    std::map<std::string, std::string> q;
+    q["partNumber"] = std::to_string(_part_etags.size() + 1);
+    q["uploadId"] = _upload_id;
+
+    uint64_t ms = fnSystem.millis();
+    S3_HTTP_CLIENT client;
+    int status = sign_and_send(client, "PUT", "/" + _bucket + "/" + key, q, {}, {},
+                               (const char *)data, (int)len);
+    _last_status = status;
+    std::string etag = client.get_header("ETag");
+    client.close();
+
+    if (status < 200 || status >= 300 || etag.empty())
+        return false;
+
+    _part_etags.push_back(etag);
+    Debug_printf("S3: part %u (%u bytes) in %lu ms\r\n", (unsigned)_part_etags.size(),
+                 (unsigned)len, (unsigned long)(fnSystem.millis() - ms));
+    return true;
+}
+
+bool NetworkProtocolS3::multipart_complete(const std::string &key)
+{
+    std::string xml = "<CompleteMultipartUpload>";
+    for (size_t i = 0; i < _part_etags.size(); i++)
+        xml += "<Part><PartNumber>" + std::to_string(i + 1) + "</PartNumber><ETag>" +
+               _part_etags[i] + "</ETag></Part>";
+    xml += "</CompleteMultipartUpload>";
+
+    std::string body;
+    int status = s3_do("POST", "/" + _bucket + "/" + key, {{"uploadId", _upload_id}}, {},
+                       xml.data(), (int)xml.size(), &body);
+    // A failure can arrive after the 200 status line, as an <Error> body.
+    if (status >= 200 && status < 300 && body.find("<Error>") != std::string::npos)
+        _last_status = status = 500;
+    if (status < 200 || status >= 300)
+        return false;
+
+    _upload_id.clear();
+    _part_etags.clear();
+    return true;
+}
+
+void NetworkProtocolS3::multipart_abort(const std::string &key)
+{
+    if (_upload_id.empty())
+        return;
+
+    Debug_printf("S3: aborting multipart upload %s\r\n", _upload_id.c_str());
+    int last = _last_status;
+    s3_do("DELETE", "/" + _bucket + "/" + key, {{"uploadId", _upload_id}}, {}, nullptr, 0, nullptr);
+    _last_status = last; // report the failure that got us here
+    _upload_id.clear();
+    _part_etags.clear();
+}
+
 // ─── NetworkProtocolFS overrides ─────────────────────────────────────────────
 
 fujiError_t NetworkProtocolS3::mount(PeoplesUrlParser *url)
@@ -402,8 +506,9 @@ fujiError_t NetworkProtocolS3::mount(PeoplesUrlParser *url)
 fujiError_t NetworkProtocolS3::umount()
 {
     _http.close();
-    _write_buf.clear();
-    _write_buf.shrink_to_fit();
+    if (!_upload_id.empty() && opened_url != nullptr)
+        multipart_abort(key_from_path(opened_url->path));
+    write_buf_free();
     _dir_entries.clear();
     _dir_idx = 0;
     return FUJI_ERROR::NONE;
@@ -443,18 +548,48 @@ fujiError_t NetworkProtocolS3::open_file_handle()
 
     if (streamMode == ACCESS_MODE::WRITE || streamMode == ACCESS_MODE::APPEND)
     {
-        _write_buf.clear();
+        _upload_id.clear();
+        _part_etags.clear();
+        _upload_failed = false;
+        if (!write_buf_alloc())
+            return FUJI_ERROR::UNSPECIFIED;
 
-        // S3 has no append; emulate by downloading the current object first.
+        // S3 has no append; emulate by starting from the current object. One
+        // that fills a part or more is copied server-side instead of read in.
         if (streamMode == ACCESS_MODE::APPEND)
         {
             std::string key = key_from_path(opened_url->path);
             if (!key.empty())
             {
-                std::string body;
-                int status = s3_do("GET", "/" + _bucket + "/" + key, {}, {}, nullptr, 0, &body);
-                if (status >= 200 && status < 300)
-                    _write_buf.assign(body.begin(), body.end());
+                S3_HTTP_CLIENT client;
+                int status = sign_and_send(client, "HEAD", "/" + _bucket + "/" + key, {}, {}, {}, nullptr, 0);
+                int cl = client.content_length();
+                client.close();
+
+                if (status >= 200 && status < 300 && cl >= (int)S3_PART_SIZE)
+                {
+                    if (!multipart_begin(key) || !multipart_copy_part(key))
+                    {
+                        multipart_abort(key);
+                        fserror_to_error();
+                        return FUJI_ERROR::UNSPECIFIED;
+                    }
+                }
+                else if (status >= 200 && status < 300)
+                {
+                    std::string body;
+                    status = s3_do("GET", "/" + _bucket + "/" + key, {}, {}, nullptr, 0, &body);
+                    if (status >= 200 && status < 300)
+                    {
+                        if (body.size() > _write_cap && !write_buf_room(body.size()))
+                        {
+                            write_buf_free();
+                            return FUJI_ERROR::UNSPECIFIED;
+                        }
+                        memcpy(_write_buf, body.data(), body.size());
+                        _write_len = body.size();
+                    }
+                }
             }
         }
         return FUJI_ERROR::NONE;
@@ -514,16 +649,103 @@ fujiError_t NetworkProtocolS3::read_file_handle(uint8_t *buf, unsigned short len
 
 fujiError_t NetworkProtocolS3::write_file_handle(uint8_t *buf, unsigned short len)
 {
-    if (_write_buf.size() + len > WRITE_BUF_LIMIT)
+    if (_upload_failed)
     {
-        Debug_printf("S3: write buffer limit (%u) reached\r\n", (unsigned)WRITE_BUF_LIMIT);
-        error = NDEV_STATUS::NO_SPACE_ON_DEVICE;
+        fserror_to_error();
         return FUJI_ERROR::UNSPECIFIED;
     }
-    _write_buf.insert(_write_buf.end(), buf, buf + len);
+
+    while (len > 0)
+    {
+        if (_write_len == _write_cap && !write_buf_room(len))
+            return FUJI_ERROR::UNSPECIFIED;
+
+        size_t n = std::min<size_t>(len, _write_cap - _write_len);
+        memcpy(_write_buf + _write_len, buf, n);
+        _write_len += n;
+        buf += n;
+        len -= n;
+    }
     return FUJI_ERROR::NONE;
 }
 
+bool NetworkProtocolS3::write_buf_alloc()
+{
+    // Start small; most objects never need a whole part
+    write_buf_free();
+    return true;
+}
+
+bool NetworkProtocolS3::write_buf_part()
+{
+#ifdef ESP_PLATFORM
+    uint8_t *part = (uint8_t *)heap_caps_malloc(S3_PART_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+    uint8_t *part = (uint8_t *)malloc(S3_PART_SIZE);
+#endif
+    if (part == nullptr)
+    {
+        Debug_printf("S3: no room for a %u byte part, objects limited to %u bytes\r\n",
+                     (unsigned)S3_PART_SIZE, (unsigned)S3_WRITE_LIMIT);
+        return false;
+    }
+    if (_write_len > 0)
+        memcpy(part, _write_buf, _write_len);
+    free(_write_buf);
+    _write_buf = part;
+    _write_cap = S3_PART_SIZE;
+    return true;
+}
+
+void NetworkProtocolS3::write_buf_free()
+{
+    free(_write_buf);
+    _write_buf = nullptr;
+    _write_cap = 0;
+    _write_len = 0;
+}
+
+bool NetworkProtocolS3::write_buf_room(size_t more)
+{
+    if (_write_cap == S3_PART_SIZE)
+    {
+        // A full part: send it now rather than holding the whole object.
+        std::string key = key_from_path(opened_url->path);
+        if ((_upload_id.empty() && !multipart_begin(key)) ||
+            !multipart_put_part(key, _write_buf, _write_len))
+        {
+            multipart_abort(key);
+            _upload_failed = true;
+            write_buf_free();
+            fserror_to_error();
+            return false;
+        }
+        _write_len = 0;
+        return true;
+    }
+
+    // Small buffer: move to a whole part once the data outgrows the limit,
+    // else grow a step at a time, up to the limit
+    size_t want = _write_len + more;
+    if (want > S3_WRITE_LIMIT && write_buf_part())
+        return true;
+    want = std::min(S3_WRITE_LIMIT, (want + S3_WRITE_STEP - 1) / S3_WRITE_STEP * S3_WRITE_STEP);
+    uint8_t *grown = want > _write_cap ? (uint8_t *)realloc(_write_buf, want) : nullptr;
+    if (grown == nullptr)
+    {
+        Debug_printf("S3: write buffer limit (%u) reached\r\n", (unsigned)want);
+        // Don't let close() store a truncated object
+        multipart_abort(key_from_path(opened_url->path));
+        _upload_failed = true;
+        write_buf_free();
+        error = NDEV_STATUS::NO_SPACE_ON_DEVICE;
+        return false;
+    }
+    _write_buf = grown;
+    _write_cap = want;
+    return true;
+}
+
 fujiError_t NetworkProtocolS3::close_file_handle()
 {
     if (streamMode == ACCESS_MODE::WRITE || streamMode == ACCESS_MODE::APPEND)
@@ -534,14 +756,32 @@ fujiError_t NetworkProtocolS3::close_file_handle()
             error = NDEV_STATUS::INVALID_DEVICESPEC;
             return FUJI_ERROR::UNSPECIFIED;
         }
+        if (_upload_failed)
+        {
+            fserror_to_error();
+            return FUJI_ERROR::UNSPECIFIED;
+        }
 
-        const char *body = _write_buf.empty() ? "" : (const char *)_write_buf.data();
-        int status = s3_do("PUT", "/" + _bucket + "/" + key, {}, {}, body, (int)_write_buf.size(), nullptr);
+        bool ok;
+        if (_upload_id.empty())
+        {
+            // Fits in one part: a plain PUT.
+            const char *body = _write_len == 0 ? "" : (const char *)_write_buf;
+            int status = s3_do("PUT", "/" + _bucket + "/" + key, {}, {}, body, (int)_write_len, nullptr);
+            ok = status >= 200 && status < 300;
+        }
+        else
+        {
+            // The last part may be short; skip it if the data ended on a part boundary.
+            ok = (_write_len == 0 || multipart_put_part(key, _write_buf, _write_len)) &&
+                 multipart_complete(key);
+            if (!ok)
+                multipart_abort(key);
+        }
 
-        _write_buf.clear();
-        _write_buf.shrink_to_fit();
+        write_buf_free();
 
-        if (status < 200 || status >= 300)
+        if (!ok)
         {
             fserror_to_error();
             return FUJI_ERROR::UNSPECIFIED;
@@ -29,7 +29,11 @@
  * Credentials come from the URL userinfo when present, otherwise fall back to
  * the [S3] fnConfig section. Requests are signed with AWS Signature V4.
  *
- * Writes are buffered and uploaded with a single PUT on close.
+ * Writes are buffered a part at a time. An object that fits in one part is
+ * uploaded with a single PUT on close; a larger one becomes a multipart
+ * upload, started when the first part fills and completed (or aborted) on
+ * close, so memory stays bounded by S3_PART_SIZE whatever the object size.
+ * Boards that can't hold a part are limited to S3_WRITE_LIMIT per object.
  */
 class NetworkProtocolS3 : public NetworkProtocolFS
 {
@@ -78,8 +82,19 @@ private:
     // Persistent client used to stream a file download across read() calls.
     S3_HTTP_CLIENT _http;
 
-    // Data accumulates here on write; uploaded by close_file_handle().
-    std::vector<uint8_t> _write_buf;
+    // Data accumulates here on write. The buffer grows up to S3_WRITE_LIMIT;
+    // past that it is swapped for a whole part (in PSRAM on ESP) and the
+    // object is sent a part at a time. A board that can't allocate a part
+    // stays limited to S3_WRITE_LIMIT and one PUT.
+    uint8_t *_write_buf = nullptr;
+    size_t _write_cap = 0;
+    size_t _write_len = 0;
+
+    // Multipart upload in progress (empty id: none yet), and the ETag of
+    // each part uploaded so far, in part order.
+    std::string _upload_id;
+    std::vector<std::string> _part_etags;
+    bool _upload_failed = false;
 
     // Parsed directory listing state.
     std::vector<S3Entry> _dir_entries;
@@ -88,8 +103,20 @@ private:
     // Last HTTP status seen (drives fserror_to_error()).
     int _last_status = 0;
 
-    // Maximum bytes buffered for a single write (single-PUT upload).
-    static constexpr size_t WRITE_BUF_LIMIT = 512 * 1024;
+    // Size of each multipart upload part; S3 rejects parts smaller than
+    // 5 MiB other than the last one.
+    static constexpr size_t S3_PART_SIZE = 5 * 1024 * 1024;
+    // Largest object (or last part) a board that can't hold a part can write
+    static constexpr size_t S3_WRITE_LIMIT = 512 * 1024;
+    static constexpr size_t S3_WRITE_STEP = 32 * 1024;
+
+    // Allocate/free _write_buf; make room once it is full (send a part, or
+    // grow a buffer below S3_WRITE_LIMIT). False with error set on failure.
+    bool write_buf_alloc();
+    // Swap the small buffer for a whole part; false (buffer kept) if it can't
+    bool write_buf_part();
+    void write_buf_free();
+    bool write_buf_room(size_t more);
 
     // Parse endpoint/bucket/region/tls and resolve credentials from url + config.
     bool parse_url(PeoplesUrlParser *url);
@@ -121,6 +148,14 @@ private:
               const char *body, int body_len,
               std::string *out_body);
 
+    // Multipart upload steps for `key`. Each returns false on failure with
+    // _last_status set; a started upload should then be aborted.
+    bool multipart_begin(const std::string &key);
+    bool multipart_copy_part(const std::string &key);
+    bool multipart_put_part(const std::string &key, const uint8_t *data, size_t len);
+    bool multipart_complete(const std::string &key);
+    void multipart_abort(const std::string &key);
+
     // Parse one page of ListObjectsV2 XML into _dir_entries; returns the
     // NextContinuationToken (empty when the listing is complete).
     std::string parse_list_xml(const std::string &xml, const std::string &prefix);
@@ -42,6 +42,19 @@
 #define SD_BASE_PATH "SD"
 #endif
 
+/**
+ * Largest request in the read and write pipelines, and how many may be
+ * outstanding at once. Keeping several in flight hides the link latency that
+ * a blocking sftp_read()/sftp_write() pays on every call.
+ */
+#ifdef ESP_PLATFORM
+#define SFTP_CHUNK_SIZE 8192
+#define SFTP_PIPELINE_DEPTH 4
+#else
+#define SFTP_CHUNK_SIZE 32768
+#define SFTP_PIPELINE_DEPTH 8
+#endif
+
 NetworkProtocolSFTP::NetworkProtocolSFTP(std::string *rx_buf, std::string *tx_buf, std::string *sp_buf)
     : NetworkProtocolFS(rx_buf, tx_buf, sp_buf)
 {
@@ -299,6 +312,18 @@ fujiError_t NetworkProtocolSFTP::open_file_handle()
     }
 
     offset = 0;
+    chunk_size = SFTP_CHUNK_SIZE;
+    if (sftp->limits != nullptr)
+    {
+        if (sftp->limits->max_read_length > 0 && sftp->limits->max_read_length < chunk_size)
+            chunk_size = sftp->limits->max_read_length;
+        if (sftp->limits->max_write_length > 0 && sftp->limits->max_write_length < chunk_size)
+            chunk_size = sftp->limits->max_write_length;
+    }
+    read_buf.clear();
+    read_pos = 0;
+    read_eof = false;
+    write_buf.clear();
     return FUJI_ERROR::NONE;
 }
 
@@ -316,27 +341,115 @@ fujiError_t NetworkProtocolSFTP::open_dir_handle()
     return FUJI_ERROR::NONE;
 }
 
-fujiError_t NetworkProtocolSFTP::read_file_handle(uint8_t *buf, unsigned short len)
+fujiError_t NetworkProtocolSFTP::read_ahead()
 {
-    unsigned short total_len = len;
+    read_buf.clear();
+    read_pos = 0;
 
-    while (total_len > 0)
+    // Top up the pipeline so the server is always working ahead of the host.
+    while (!read_eof && pending_reads.size() < SFTP_PIPELINE_DEPTH)
     {
-        ssize_t actual_len = sftp_read(fh, buf, total_len);
-
-        if (actual_len < 0)
+        sftp_aio aio = nullptr;
+        ssize_t requested = sftp_aio_begin_read(fh, chunk_size, &aio);
+        if (requested < 0)
         {
             sftp_err = sftp_get_error(sftp);
+            read_cancel(offset);
             fserror_to_error();
             return FUJI_ERROR::UNSPECIFIED;
         }
+        pending_reads.emplace_back(aio, (size_t)requested);
+    }
+
+    if (pending_reads.empty())
+        return FUJI_ERROR::NONE; // EOF
+
+    sftp_aio aio = pending_reads.front().first;
+    size_t requested = pending_reads.front().second;
+    pending_reads.pop_front();
+
+    read_buf.resize(requested);
+    ssize_t actual_len = sftp_aio_wait_read(&aio, read_buf.data(), requested);
+    if (actual_len < 0)
+    {
+        sftp_err = sftp_get_error(sftp);
+        read_buf.clear();
+        read_cancel(offset);
+        fserror_to_error();
+        return FUJI_ERROR::UNSPECIFIED;
+    }
+    read_buf.resize(actual_len);
+
+    if (actual_len == 0)
+    {
+        // The requests behind this one are past the end too.
+        read_eof = true;
+        read_cancel(offset);
+    }
+    else if ((size_t)actual_len < requested)
+    {
+        // A short reply leaves a gap before the requests behind it; ask again
+        // from the end of what arrived.
+        read_cancel(offset + actual_len);
+    }
+
+    return FUJI_ERROR::NONE;
+}
+
+void NetworkProtocolSFTP::read_cancel(uint64_t position)
+{
+    // Every request has to be collected, or libssh keeps its reply queued.
+    if (!pending_reads.empty())
+    {
+        std::vector<uint8_t> scratch(chunk_size);
+        while (!pending_reads.empty())
+        {
+            sftp_aio aio = pending_reads.front().first;
+            pending_reads.pop_front();
+            sftp_aio_wait_read(&aio, scratch.data(), scratch.size());
+        }
+    }
+
+    if (fh != nullptr)
+        sftp_seek64(fh, position);
+}
+
+void NetworkProtocolSFTP::read_discard()
+{
+    read_buf.clear();
+    read_pos = 0;
+    read_eof = false;
+    read_cancel(offset);
+}
+
+fujiError_t NetworkProtocolSFTP::read_file_handle(uint8_t *buf, unsigned short len)
+{
+    unsigned short total_len = len;
 
-        if (actual_len == 0) // EOF - zero-fill the remainder.
+    // Reads have to see what was written before them.
+    if ((!write_buf.empty() || !pending_writes.empty()) && write_flush(true) != FUJI_ERROR::NONE)
+        return FUJI_ERROR::UNSPECIFIED;
+
+    while (total_len > 0)
+    {
+        if (read_pos == read_buf.size())
         {
-            memset(buf, 0, total_len);
-            break;
+            if (read_ahead() != FUJI_ERROR::NONE)
+                return FUJI_ERROR::UNSPECIFIED;
+
+            if (read_buf.empty()) // EOF - zero-fill the remainder.
+            {
+                memset(buf, 0, total_len);
+                break;
+            }
         }
 
+        size_t actual_len = read_buf.size() - read_pos;
+        if (actual_len > total_len)
+            actual_len = total_len;
+        memcpy(buf, read_buf.data() + read_pos, actual_len);
+
+        read_pos += actual_len;
         buf += actual_len;
         total_len -= actual_len;
         offset += actual_len;
@@ -370,35 +483,91 @@ fujiError_t NetworkProtocolSFTP::read_dir_entry(char *buf, unsigned short len)
 
 fujiError_t NetworkProtocolSFTP::write_file_handle(uint8_t *buf, unsigned short len)
 {
-    unsigned short total_len = len;
+    // Read-ahead has moved the file position past offset.
+    if (read_pos < read_buf.size() || !pending_reads.empty() || read_eof)
+        read_discard();
 
-    while (total_len > 0)
+    while (len > 0)
     {
-        ssize_t actual_len = sftp_write(fh, buf, total_len);
+        size_t actual_len = chunk_size - write_buf.size();
+        if (actual_len > len)
+            actual_len = len;
+        write_buf.insert(write_buf.end(), buf, buf + actual_len);
 
+        buf += actual_len;
+        len -= actual_len;
+        offset += actual_len;
+
+        if (write_buf.size() >= chunk_size && write_flush(false) != FUJI_ERROR::NONE)
+            return FUJI_ERROR::UNSPECIFIED;
+    }
+
+    return FUJI_ERROR::NONE;
+}
+
+fujiError_t NetworkProtocolSFTP::write_flush(bool all)
+{
+    while (!write_buf.empty())
+    {
+        if (pending_writes.size() >= SFTP_PIPELINE_DEPTH && write_wait() != FUJI_ERROR::NONE)
+            return FUJI_ERROR::UNSPECIFIED;
+
+        // libssh copies the data into the request, so write_buf can be reused.
+        sftp_aio aio = nullptr;
+        ssize_t actual_len = sftp_aio_begin_write(fh, write_buf.data(), write_buf.size(), &aio);
         if (actual_len < 0)
         {
             sftp_err = sftp_get_error(sftp);
+            write_buf.clear();
             fserror_to_error();
             return FUJI_ERROR::UNSPECIFIED;
         }
+        pending_writes.push_back(aio);
+        write_buf.erase(write_buf.begin(), write_buf.begin() + actual_len);
+    }
 
-        buf += actual_len;
-        total_len -= actual_len;
-        offset += actual_len;
+    while (all && !pending_writes.empty())
+    {
+        if (write_wait() != FUJI_ERROR::NONE)
+            return FUJI_ERROR::UNSPECIFIED;
     }
 
     return FUJI_ERROR::NONE;
 }
 
+fujiError_t NetworkProtocolSFTP::write_wait()
+{
+    sftp_aio aio = pending_writes.front();
+    pending_writes.pop_front();
+
+    if (sftp_aio_wait_write(&aio) >= 0)
+        return FUJI_ERROR::NONE;
+
+    // The file is missing this chunk now, so the rest are no use either.
+    sftp_err = sftp_get_error(sftp);
+    while (!pending_writes.empty())
+    {
+        aio = pending_writes.front();
+        pending_writes.pop_front();
+        sftp_aio_wait_write(&aio);
+    }
+    write_buf.clear();
+    fserror_to_error();
+    return FUJI_ERROR::UNSPECIFIED;
+}
+
 fujiError_t NetworkProtocolSFTP::close_file_handle()
 {
+    fujiError_t res = FUJI_ERROR::NONE;
+
     if (fh != nullptr)
     {
+        res = write_flush(true);
+        read_discard();
         sftp_close(fh);
         fh = nullptr;
     }
-    return FUJI_ERROR::NONE;
+    return res;
 }
 
 fujiError_t NetworkProtocolSFTP::close_dir_handle()
@@ -529,6 +698,10 @@ fujiError_t NetworkProtocolSFTP::unlock(PeoplesUrlParser *url)
 
 off_t NetworkProtocolSFTP::seek(off_t position, int whence)
 {
+    // Pending writes may extend the file.
+    if (write_flush(true) != FUJI_ERROR::NONE)
+        return -1;
+
     // fileSize isn't fileSize, it's bytes remaining. Call stat() to fix fileSize
     stat();
 
@@ -539,6 +712,7 @@ off_t NetworkProtocolSFTP::seek(off_t position, int whence)
     else if (whence == SEEK_END)
         offset = fileSize - position;
 
+    read_discard();
     if (sftp_seek64(fh, offset) != 0)
         return -1;
 
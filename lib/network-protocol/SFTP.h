@@ -6,6 +6,9 @@
 #include <libssh/libssh.h>
 #include <libssh/sftp.h>
 
+#include <deque>
+#include <vector>
+
 class NetworkProtocolSFTP : public NetworkProtocolFS
 {
 public:
@@ -115,8 +118,9 @@ protected:
     fujiError_t read_dir_entry(char *buf, unsigned short len) override;
 
     /**
-     * @brief for len requested, break up into number of required
-     *        sftp_write() blocks.
+     * @brief Add buf to the write buffer, sending full chunks as pipelined
+     *        writes. Acknowledgements are collected as the pipeline fills.
+     * @param buf source buffer
      * @param len Requested # of bytes.
      * @return FUJI_ERROR::NONE on success, FUJI_ERROR::UNSPECIFIED on error
      */
@@ -165,6 +169,69 @@ private:
      */
     uint64_t offset = 0;
 
+    /**
+     * Request size for pipelined reads and writes, capped by the server's limits
+     */
+    size_t chunk_size = 0;
+
+    /**
+     * Outstanding read requests, oldest first, with the length each asked for
+     */
+    std::deque<std::pair<sftp_aio, size_t>> pending_reads;
+
+    /**
+     * Read-ahead: data already received that the host hasn't read yet
+     */
+    std::vector<uint8_t> read_buf;
+    size_t read_pos = 0;
+
+    /**
+     * The server reported end of file; stop asking for more.
+     */
+    bool read_eof = false;
+
+    /**
+     * Outstanding write requests, oldest first
+     */
+    std::deque<sftp_aio> pending_writes;
+
+    /**
+     * Written data not yet sent, up to chunk_size
+     */
+    std::vector<uint8_t> write_buf;
+
+    /**
+     * @brief Keep the read pipeline full and move the oldest reply into read_buf.
+     * @return FUJI_ERROR::NONE on success (read_buf is empty at EOF), FUJI_ERROR::UNSPECIFIED on error
+     */
+    fujiError_t read_ahead();
+
+    /**
+     * @brief Collect and drop every outstanding read, then set the file
+     *        position for the next request.
+     * @param position byte offset the next read or write should start at
+     */
+    void read_cancel(uint64_t position);
+
+    /**
+     * @brief Drop read-ahead data and outstanding reads, and put the file
+     *        position back at offset.
+     */
+    void read_discard();
+
+    /**
+     * @brief Send buffered write data and, if all is set, wait for every
+     *        outstanding write to be acknowledged.
+     * @return FUJI_ERROR::NONE on success, FUJI_ERROR::UNSPECIFIED if a write failed
+     */
+    fujiError_t write_flush(bool all);
+
+    /**
+     * @brief Wait for the oldest outstanding write.
+     * @return FUJI_ERROR::NONE on success, FUJI_ERROR::UNSPECIFIED if it failed
+     */
+    fujiError_t write_wait();
+
     /**
      * @brief get status of file, filling in filesize. mount() must have already been called.
      */
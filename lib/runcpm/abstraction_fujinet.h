@@ -65,6 +65,197 @@ char *full_path(char *fn)
     return full_filename;
 }
 
+/* Host file handle cache */
+/*===============================================================================*/
+// BDOS reads and writes one 128 byte record per call. Rather than reopen the
+// host file for every record, a few files are kept open, least recently used
+// going first, each with a buffer of records read ahead of, or written behind,
+// the CP/M program. A buffered write that fails is reported on the next write
+// to, or close of, the file.
+#define CPM_HANDLE_CACHE_SIZE 4
+#define CPM_HANDLE_BUFFER_SIZE (BlkSZ * 32)
+// disk.h: _CloseFile() checks with _sys_closefile()
+#define HASCLOSEFILE
+
+typedef struct
+{
+    char path[sizeof(full_filename)];
+    FILE *f;
+    bool writable;
+    uint32_t lastUse;
+    long bufPos;                 // file offset of buf[0]
+    size_t bufLen;               // bytes of buf that mirror the file
+    size_t dirtyStart, dirtyEnd; // part of buf not yet written to the file
+    bool writeFailed;            // a write-behind failed, not yet reported
+    uint8_t buf[CPM_HANDLE_BUFFER_SIZE];
+} CPM_HANDLE;
+
+CPM_HANDLE *cpmHandles[CPM_HANDLE_CACHE_SIZE];
+uint32_t cpmHandleClock = 0;
+// Path of a handle closed with an unreported write failure
+char cpmWriteFailedPath[sizeof(full_filename)] = "";
+
+bool _sys_flushhandle(CPM_HANDLE *h)
+{
+    if (h->dirtyEnd <= h->dirtyStart)
+        return true;
+
+    bool ok = fseek(h->f, h->bufPos + h->dirtyStart, SEEK_SET) == 0 &&
+              fwrite(h->buf + h->dirtyStart, 1, h->dirtyEnd - h->dirtyStart, h->f) == h->dirtyEnd - h->dirtyStart;
+    if (!ok)
+    {
+        Debug_printf("CP/M write-behind to %s failed\r\n", h->path);
+        h->writeFailed = true;
+    }
+
+    h->dirtyStart = h->dirtyEnd = 0;
+    return ok;
+}
+
+// True, once, if a buffered write to h failed since the last call
+bool _sys_writefailed(CPM_HANDLE *h)
+{
+    bool failed = h->writeFailed;
+    h->writeFailed = false;
+    return failed;
+}
+
+void _sys_closehandle(int i)
+{
+    CPM_HANDLE *h = cpmHandles[i];
+    if (h == nullptr)
+        return;
+
+    _sys_flushhandle(h);
+    if (h->writeFailed)
+        strlcpy(cpmWriteFailedPath, h->path, sizeof(cpmWriteFailedPath));
+    fclose(h->f);
+    free(h);
+    cpmHandles[i] = nullptr;
+}
+
+// Write everything buffered out, so the host file system sees what CP/M wrote
+void _sys_flushhandles()
+{
+    for (int i = 0; i < CPM_HANDLE_CACHE_SIZE; i++)
+    {
+        CPM_HANDLE *h = cpmHandles[i];
+        if (h != nullptr && h->dirtyEnd > h->dirtyStart && _sys_flushhandle(h))
+            fflush(h->f);
+    }
+}
+
+// Close the handle for a host path that is about to be deleted, renamed or recreated
+void _sys_forgethandle(const char *path)
+{
+    for (int i = 0; i < CPM_HANDLE_CACHE_SIZE; i++)
+        if (cpmHandles[i] != nullptr && strcmp(cpmHandles[i]->path, path) == 0)
+            _sys_closehandle(i);
+    if (strcmp(cpmWriteFailedPath, path) == 0)
+        cpmWriteFailedPath[0] = '\0';
+}
+
+CPM_HANDLE *_sys_gethandle(const char *path)
+{
+    int lru = 0;
+    for (int i = 0; i < CPM_HANDLE_CACHE_SIZE; i++)
+    {
+        CPM_HANDLE *h = cpmHandles[i];
+        if (h != nullptr && strcmp(h->path, path) == 0)
+        {
+            h->lastUse = ++cpmHandleClock;
+            return h;
+        }
+        if (h == nullptr || (cpmHandles[lru] != nullptr && h->lastUse < cpmHandles[lru]->lastUse))
+            lru = i;
+    }
+
+    bool writable = true;
+    FILE *f = fnSDFAT.file_open(path, "r+");
+    if (f == nullptr)
+    {
+        writable = false;
+        f = fnSDFAT.file_open(path, "r");
+    }
+    if (f == nullptr)
+        return nullptr;
+
+    CPM_HANDLE *h = (CPM_HANDLE *)malloc(sizeof(CPM_HANDLE));
+    if (h == nullptr)
+    {
+        fclose(f);
+        return nullptr;
+    }
+
+    _sys_closehandle(lru);
+
+    strlcpy(h->path, path, sizeof(h->path));
+    h->f = f;
+    h->writable = writable;
+    h->lastUse = ++cpmHandleClock;
+    h->bufPos = 0;
+    h->bufLen = 0;
+    h->dirtyStart = h->dirtyEnd = 0;
+    h->writeFailed = strcmp(cpmWriteFailedPath, path) == 0;
+    if (h->writeFailed)
+        cpmWriteFailedPath[0] = '\0';
+    cpmHandles[lru] = h;
+    return h;
+}
+
+// Copy the record at fpos into dest, reading ahead into the handle's buffer.
+// Returns 0x00 on success, 0x01 at end of file, 0x02 if the seek failed.
+uint8_t _sys_readrecord(CPM_HANDLE *h, long fpos, uint8_t *dest)
+{
+    if (fpos < h->bufPos || fpos + BlkSZ > h->bufPos + (long)h->bufLen)
+    {
+        _sys_flushhandle(h);
+        h->bufPos = fpos;
+        h->bufLen = 0;
+        if (fseek(h->f, fpos, SEEK_SET) != 0)
+            return 0x02;
+        h->bufLen = fread(h->buf, 1, CPM_HANDLE_BUFFER_SIZE, h->f);
+        // only whole records are ever handed back, as before
+        if (h->bufLen < BlkSZ)
+            return 0x01;
+    }
+
+    memcpy(dest, h->buf + (fpos - h->bufPos), BlkSZ);
+    return 0x00;
+}
+
+// Put the record at fpos into the handle's buffer, to be written later
+void _sys_writerecord(CPM_HANDLE *h, long fpos, const uint8_t *src)
+{
+    if (fpos < h->bufPos || fpos > h->bufPos + (long)h->bufLen ||
+        fpos + BlkSZ > h->bufPos + CPM_HANDLE_BUFFER_SIZE)
+    {
+        _sys_flushhandle(h);
+        h->bufPos = fpos;
+        h->bufLen = 0;
+    }
+
+    size_t off = fpos - h->bufPos;
+    memcpy(h->buf + off, src, BlkSZ);
+    if (off + BlkSZ > h->bufLen)
+        h->bufLen = off + BlkSZ;
+
+    if (h->dirtyEnd <= h->dirtyStart)
+    {
+        h->dirtyStart = off;
+        h->dirtyEnd = off + BlkSZ;
+    }
+    else
+    {
+        h->dirtyStart = std::min(h->dirtyStart, off);
+        h->dirtyEnd = std::max(h->dirtyEnd, off + BlkSZ);
+    }
+
+    if (h->bufLen == CPM_HANDLE_BUFFER_SIZE && h->dirtyEnd == CPM_HANDLE_BUFFER_SIZE)
+        _sys_flushhandle(h);
+}
+
+
 
 //
 // Hardware functions, new in 5.x
@@ -83,6 +274,7 @@ uint32 _HardwareIn(const uint32 Port)
 /*===============================================================================*/
 bool _RamLoad(char *fn, uint16_t address)
 {
+    _sys_flushhandles();
     FILE *f = fnSDFAT.file_open(full_path(fn), "r");
     bool result = false;
     uint8_t b;
@@ -137,6 +329,7 @@ int _sys_select(uint8_t *disk)
 long _sys_filesize(uint8_t *fn)
 {
     unsigned long fs = -1;
+    _sys_flushhandles();
     FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "r");
 
     if (fp)
@@ -163,6 +356,7 @@ int _sys_openfile(uint8_t *fn)
 
 int _sys_makefile(uint8_t *fn)
 {
+    _sys_forgethandle(full_path((char *)fn));
     FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "w");
     if (fp)
     {
@@ -175,6 +369,7 @@ int _sys_makefile(uint8_t *fn)
 
 int _sys_deletefile(uint8_t *fn)
 {
+    _sys_forgethandle(full_path((char *)fn));
     return fnSDFAT.remove(full_path((char *)fn));
 }
 
@@ -184,6 +379,8 @@ int _sys_renamefile(uint8_t *fn, uint8_t *newname)
 
     from = std::string(full_path((char *)fn));
     to = std::string(full_path((char *)newname));
+    _sys_forgethandle(from.c_str());
+    _sys_forgethandle(to.c_str());
 
     return fnSDFAT.rename(from.c_str(), to.c_str());
 }
@@ -195,6 +392,7 @@ void _sys_logbuffer(uint8_t *buffer)
 
 bool _sys_extendfile(char *fn, unsigned long fpos)
 {
+    _sys_flushhandles();
     FILE *fp = fnSDFAT.file_open(full_path((char *)fn), "a");
 
     if (!fp)
@@ -222,93 +420,58 @@ bool _sys_extendfile(char *fn, unsigned long fpos)
 uint8_t _sys_readseq(uint8_t *fn, long fpos)
 {
     uint8_t result = 0xff;
-    FILE *f;
-    uint8_t bytesread;
+    CPM_HANDLE *h;
     uint8_t dmabuf[BlkSZ];
-    int seekErr;
 
-    f = fnSDFAT.file_open(full_path((char *)fn), "r");
-    if (!f)
+    h = _sys_gethandle(full_path((char *)fn));
+    if (!h)
     {
         result = 0x10;
         return result;
     }
-    seekErr = fseek(f, fpos, SEEK_SET);
-    if (f)
-    {
-        if (fpos > 0 && seekErr != 0)
-        {
-            // EOF
-            result = 0x01;
-        }
-        else
-        {
-            // set DMA buffer to EOF
-            memset(dmabuf, 0x1a, BlkSZ);
-            bytesread = fread(&dmabuf[0], BlkSZ, sizeof(uint8_t), f);
-            if (bytesread)
-                memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
-            result = bytesread ? 0x00 : 0x01;
-        }
-    }
+
+    // set DMA buffer to EOF
+    memset(dmabuf, 0x1a, BlkSZ);
+    result = _sys_readrecord(h, fpos, dmabuf);
+    if (result == 0x00)
+        memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
     else
-    {
-        result = 0x10;
-    }
-    fclose(f);
+        result = 0x01; // EOF
     return (result);
 }
 
 uint8_t _sys_writeseq(uint8_t *fn, long fpos)
 {
     uint8_t result = 0xff;
-    FILE *f;
+    CPM_HANDLE *h;
 
-    if (_sys_extendfile((char *)fn, fpos))
-        f = fnSDFAT.file_open(full_path((char *)fn), "r+");
-    else
-        return result;
+    h = _sys_gethandle(full_path((char *)fn));
+    if (!h && _sys_extendfile((char *)fn, fpos))
+        h = _sys_gethandle(full_path((char *)fn));
 
-    if (f)
-    {
-        if (fseek(f, fpos, SEEK_SET) == 0)
-        {
-            if (fwrite(_RamSysAddr(dmaAddr), BlkSZ, sizeof(uint8_t), f))
-                result = 0x00;
-        }
-        else
-        {
-            result = 0x01;
-        }
-    }
-    else
+    if (h && h->writable && !_sys_writefailed(h))
     {
-        result = 0x10;
+        _sys_writerecord(h, fpos, _RamSysAddr(dmaAddr));
+        result = 0x00;
     }
-    fclose(f);
     return (result);
 }
 
 uint8_t _sys_readrand(uint8_t *fn, long fpos)
 {
     uint8 result = 0xff;
-    FILE *f;
-    uint8 bytesread;
+    CPM_HANDLE *h;
     uint8 dmabuf[BlkSZ];
     long extSize;
 
-    f = fnSDFAT.file_open(full_path((char *)fn), "r+");
-    if (f)
+    h = _sys_gethandle(full_path((char *)fn));
+    if (h)
     {
-        if (fseek(f, fpos, SEEK_SET) == 0)
-        {
-            memset(dmabuf, 0x1A, BlkSZ);
-            bytesread = fread(&dmabuf[0], BlkSZ, sizeof(uint8_t), f);
-            if (bytesread)
-                memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
-            result = bytesread ? 0x00 : 0x01;
-        }
-        else
+        memset(dmabuf, 0x1A, BlkSZ);
+        result = _sys_readrecord(h, fpos, dmabuf);
+        if (result == 0x00)
+            memcpy((uint8_t *)&RAM[dmaAddr], dmabuf, BlkSZ);
+        else if (result == 0x02)
         {
             if (fpos >= 65536L * BlkSZ)
             {
@@ -316,7 +479,7 @@ uint8_t _sys_readrand(uint8_t *fn, long fpos)
             }
             else
             {
-                extSize = _sys_filesize((uint8_t *)full_path((char *)fn));
+                extSize = _sys_filesize(fn);
 
                 // round file size up to next full logical extent
                 extSize = ExtSZ * ((extSize / ExtSZ) + ((extSize % ExtSZ) ? 1 : 0));
@@ -331,40 +494,47 @@ uint8_t _sys_readrand(uint8_t *fn, long fpos)
     {
         result = 0x10;
     }
-    fclose(f);
     return (result);
 }
 
 uint8_t _sys_writerand(uint8_t *fn, long fpos)
 {
     uint8 result = 0xff;
-    FILE *f;
+    CPM_HANDLE *h;
+
+    h = _sys_gethandle(full_path((char *)fn));
+    if (!h && _sys_extendfile((char *)fn, fpos))
+        h = _sys_gethandle(full_path((char *)fn));
 
-    if (_sys_extendfile((char *)fn, fpos))
+    if (h && h->writable && !_sys_writefailed(h))
     {
-        f = fnSDFAT.file_open(full_path((char *)fn), "r+");
+        _sys_writerecord(h, fpos, _RamSysAddr(dmaAddr));
+        result = 0x00;
     }
-    else
-        return result;
+    return (result);
+}
 
-    if (f)
+// Write out what is buffered for a file CP/M closes. Returns 0xff if that, or
+// an earlier buffered write, failed.
+uint8_t _sys_closefile(uint8_t *fn)
+{
+    const char *path = full_path((char *)fn);
+    for (int i = 0; i < CPM_HANDLE_CACHE_SIZE; i++)
     {
-        if (fseek(f, fpos, SEEK_SET) == 0)
-        {
-            if (fwrite(_RamSysAddr(dmaAddr), BlkSZ, sizeof(uint8_t), f))
-                result = 0x00;
-        }
-        else
+        CPM_HANDLE *h = cpmHandles[i];
+        if (h != nullptr && strcmp(h->path, path) == 0)
         {
-            result = 0x06;
+            if (_sys_flushhandle(h))
+                fflush(h->f);
+            return _sys_writefailed(h) ? 0xff : 0x00;
         }
     }
-    else
+    if (strcmp(cpmWriteFailedPath, path) == 0)
     {
-        result = 0x10;
+        cpmWriteFailedPath[0] = '\0';
+        return 0xff;
     }
-    fclose(f);
-    return (result);
+    return 0x00;
 }
 
 uint8_t findNextDirName[17];
@@ -433,6 +603,7 @@ uint8_t _findfirst(uint8_t isdir)
     uint8 path[4] = {'?', FOLDERCHAR, '?', 0};
     path[0] = filename[0];
     path[2] = filename[2];
+    _sys_flushhandles(); // so directory sizes include buffered records
     fnSDFAT.dir_close();
     fnSDFAT.dir_open(full_path((char *)path), "*", 0);
     _HostnameToFCBname(filename, pattern);
@@ -526,6 +697,9 @@ uint8_t _sys_makedisk(uint8_t drive)
 
 uint8_t _getch(void)
 {
+    // nothing is left buffered while CP/M waits on the keyboard
+    _sys_flushhandles();
+
     if (teeMode == true)
     {
         while (_kbhit() > 0)
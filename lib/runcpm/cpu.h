@@ -1465,7 +1465,36 @@ RUNCPM_DECL void Z80debug(void) {
 }
 #endif
 
+/* Z80run() works on local copies of the registers. Emulated memory is
+   written through a byte pointer, which may alias anything, so with the
+   registers left as globals every store would force them all to be reloaded.
+   The globals are brought up to date around anything outside the core that
+   looks at or changes them (BIOS/BDOS calls, the debugger) and on exit. */
+#define Z80_REGS(X) X(PCX) X(AF) X(BC) X(DE) X(HL) X(IX) X(IY) X(PC) X(SP) \
+	X(AF1) X(BC1) X(DE1) X(HL1) X(IFF) X(IR)
+#define Z80_LOCAL_REG(r)	int32 r = ::r;
+#define Z80_SAVE_REG(r)		::r = r;
+#define Z80_LOAD_REG(r)		r = ::r;
+#define Z80_LOCAL_REGS()	Z80_REGS(Z80_LOCAL_REG)
+#define Z80_SAVE_REGS()		do { Z80_REGS(Z80_SAVE_REG) } while (0)
+#define Z80_LOAD_REGS()		do { Z80_REGS(Z80_LOAD_REG) } while (0)
+
+#define Z80_OUT(port, value) do {		\
+	uint32 p_ = (port), v_ = (value);	\
+	Z80_SAVE_REGS();					\
+	cpu_out(p_, v_);					\
+	Z80_LOAD_REGS();					\
+} while (0)
+
+#define Z80_IN(result, port) do {		\
+	uint32 p_ = (port);					\
+	Z80_SAVE_REGS();					\
+	result = cpu_in(p_);				\
+	Z80_LOAD_REGS();					\
+} while (0)
+
 static inline void Z80run(void) {
+	Z80_LOCAL_REGS();
 	uint32 temp = 0;
 	uint32 acu = 0;
 	uint32 sum = 0;
@@ -1487,8 +1516,11 @@ static inline void Z80run(void) {
 			Debug = 1;
 			Step = -1;
 		}
-		if (Debug)
+		if (Debug) {
+			Z80_SAVE_REGS();
 			Z80debug();
+			Z80_LOAD_REGS();
+		}
 #endif
 
 		PCX = PC;
@@ -2770,7 +2802,7 @@ static inline void Z80run(void) {
 			break;
 
 		case 0xd3:      /* OUT (nn),A */
-			cpu_out(RAM_PP(PC), HIGH_REGISTER(AF));
+			Z80_OUT(RAM_PP(PC), HIGH_REGISTER(AF));
 			break;
 
 		case 0xd4:      /* CALL NC,nnnn */
@@ -2816,7 +2848,8 @@ static inline void Z80run(void) {
 			break;
 
 		case 0xdb:      /* IN A,(nn) */
-			SET_HIGH_REGISTER(AF, cpu_in(RAM_PP(PC)));
+			Z80_IN(temp, RAM_PP(PC));
+			SET_HIGH_REGISTER(AF, temp);
 			break;
 
 		case 0xdc:      /* CALL C,nnnn */
@@ -3495,13 +3528,13 @@ static inline void Z80run(void) {
 			switch (RAM_PP(PC)) {
 
 			case 0x40:      /* IN B,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_HIGH_REGISTER(BC, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x41:      /* OUT (C),B */
-				cpu_out(LOW_REGISTER(BC), HIGH_REGISTER(BC));
+				Z80_OUT(LOW_REGISTER(BC), HIGH_REGISTER(BC));
 				break;
 
 			case 0x42:      /* SBC HL,BC */
@@ -3565,13 +3598,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x48:      /* IN C,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_LOW_REGISTER(BC, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x49:      /* OUT (C),C */
-				cpu_out(LOW_REGISTER(BC), LOW_REGISTER(BC));
+				Z80_OUT(LOW_REGISTER(BC), LOW_REGISTER(BC));
 				break;
 
 			case 0x4a:      /* ADC HL,BC */
@@ -3599,13 +3632,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x50:      /* IN D,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_HIGH_REGISTER(DE, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x51:      /* OUT (C),D */
-				cpu_out(LOW_REGISTER(BC), HIGH_REGISTER(DE));
+				Z80_OUT(LOW_REGISTER(BC), HIGH_REGISTER(DE));
 				break;
 
 			case 0x52:      /* SBC HL,DE */
@@ -3632,13 +3665,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x58:      /* IN E,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_LOW_REGISTER(DE, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x59:      /* OUT (C),E */
-				cpu_out(LOW_REGISTER(BC), LOW_REGISTER(DE));
+				Z80_OUT(LOW_REGISTER(BC), LOW_REGISTER(DE));
 				break;
 
 			case 0x5a:      /* ADC HL,DE */
@@ -3666,13 +3699,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x60:      /* IN H,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_HIGH_REGISTER(HL, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x61:      /* OUT (C),H */
-				cpu_out(LOW_REGISTER(BC), HIGH_REGISTER(HL));
+				Z80_OUT(LOW_REGISTER(BC), HIGH_REGISTER(HL));
 				break;
 
 			case 0x62:      /* SBC HL,HL */
@@ -3697,13 +3730,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x68:      /* IN L,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_LOW_REGISTER(HL, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x69:      /* OUT (C),L */
-				cpu_out(LOW_REGISTER(BC), LOW_REGISTER(HL));
+				Z80_OUT(LOW_REGISTER(BC), LOW_REGISTER(HL));
 				break;
 
 			case 0x6a:      /* ADC HL,HL */
@@ -3728,13 +3761,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x70:      /* IN (C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_LOW_REGISTER(temp, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x71:      /* OUT (C),0 */
-				cpu_out(LOW_REGISTER(BC), 0);
+				Z80_OUT(LOW_REGISTER(BC), 0);
 				break;
 
 			case 0x72:      /* SBC HL,SP */
@@ -3753,13 +3786,13 @@ static inline void Z80run(void) {
 				break;
 
 			case 0x78:      /* IN A,(C) */
-				temp = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(temp, LOW_REGISTER(BC));
 				SET_HIGH_REGISTER(AF, temp);
 				AF = (AF & ~0xfe) | rotateShiftTable[temp & 0xff];
 				break;
 
 			case 0x79:      /* OUT (C),A */
-				cpu_out(LOW_REGISTER(BC), HIGH_REGISTER(AF));
+				Z80_OUT(LOW_REGISTER(BC), HIGH_REGISTER(AF));
 				break;
 
 			case 0x7a:      /* ADC HL,SP */
@@ -3806,7 +3839,7 @@ static inline void Z80run(void) {
 				HF and CF Both set if ((HL) + ((C + 1) & 255) > 255)
 				PF The parity of (((HL) + ((C + 1) & 255)) & 7) xor B)                      */
 			case 0xa2:      /* INI */
-				acu = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(acu, LOW_REGISTER(BC));
 				PUT_BYTE(HL, acu);
 				++HL;
 				temp = HIGH_REGISTER(BC);
@@ -3824,7 +3857,7 @@ static inline void Z80run(void) {
 				PF The parity of ((((HL) + L) & 7) xor B)                                       */
 			case 0xa3:      /* OUTI */
 				acu = GET_BYTE(HL);
-				cpu_out(LOW_REGISTER(BC), acu);
+				Z80_OUT(LOW_REGISTER(BC), acu);
 				++HL;
 				temp = HIGH_REGISTER(BC);
 				BC -= 0x100;
@@ -3860,7 +3893,7 @@ static inline void Z80run(void) {
 				HF and CF Both set if ((HL) + ((C - 1) & 255) > 255)
 				PF The parity of (((HL) + ((C - 1) & 255)) & 7) xor B)                      */
 			case 0xaa:      /* IND */
-				acu = cpu_in(LOW_REGISTER(BC));
+				Z80_IN(acu, LOW_REGISTER(BC));
 				PUT_BYTE(HL, acu);
 				--HL;
 				temp = HIGH_REGISTER(BC);
@@ -3870,7 +3903,7 @@ static inline void Z80run(void) {
 
 			case 0xab:      /* OUTD */
 				acu = GET_BYTE(HL);
-				cpu_out(LOW_REGISTER(BC), acu);
+				Z80_OUT(LOW_REGISTER(BC), acu);
 				--HL;
 				temp = HIGH_REGISTER(BC);
 				BC -= 0x100;
@@ -3916,7 +3949,7 @@ static inline void Z80run(void) {
 					temp = 0x100;
 				do {
 					INCR(1); /* Add one M1 cycle to refresh counter */
-					acu = cpu_in(LOW_REGISTER(BC));
+					Z80_IN(acu, LOW_REGISTER(BC));
 					PUT_BYTE(HL, acu);
 					++HL;
 				} while (--temp);
@@ -3932,7 +3965,7 @@ static inline void Z80run(void) {
 				do {
 					INCR(1); /* Add one M1 cycle to refresh counter */
 					acu = GET_BYTE(HL);
-					cpu_out(LOW_REGISTER(BC), acu);
+					Z80_OUT(LOW_REGISTER(BC), acu);
 					++HL;
 				} while (--temp);
 				temp = HIGH_REGISTER(BC);
@@ -3979,7 +4012,7 @@ static inline void Z80run(void) {
 					temp = 0x100;
 				do {
 					INCR(1); /* Add one M1 cycle to refresh counter */
-					acu = cpu_in(LOW_REGISTER(BC));
+					Z80_IN(acu, LOW_REGISTER(BC));
 					PUT_BYTE(HL, acu);
 					--HL;
 				} while (--temp);
@@ -3995,7 +4028,7 @@ static inline void Z80run(void) {
 				do {
 					INCR(1); /* Add one M1 cycle to refresh counter */
 					acu = GET_BYTE(HL);
-					cpu_out(LOW_REGISTER(BC), acu);
+					Z80_OUT(LOW_REGISTER(BC), acu);
 					--HL;
 				} while (--temp);
 				temp = HIGH_REGISTER(BC);
@@ -4683,7 +4716,7 @@ static inline void Z80run(void) {
 		}
 	}
 end_decode:
-	;
+	Z80_SAVE_REGS();
 }
 
 
@@ -320,6 +320,9 @@ RUNCPM_DECL uint8 _CloseFile(uint16 fcbaddr) {
 				if (fcbaddr == BatchFCB)
 					_Truncate((char*)filename, F->rc);	// Truncate $$$.SUB to F->rc CP/M records so SUBMIT.COM can work
 				result = 0x00;
+#ifdef HASCLOSEFILE
+				result = _sys_closefile(&filename[0]);	// Reports buffered writes that failed
+#endif
 			} else {
 				_error(errWRITEPROT);
 			}
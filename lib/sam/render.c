@@ -48,6 +48,7 @@ unsigned char trans(unsigned char mem39212, unsigned char mem39213);
 // contains the final soundbuffer
 extern int bufferpos;
 extern char *buffer;
+extern void FlushBuffer(int final);
 
 //timetable for more accurate c64 simulation
 int timetable[5][5] =
@@ -71,6 +72,7 @@ void Output8BitAry(int index, unsigned char ary[5])
         // printf("%d %d\r\n", bufferpos,k);
         buffer[bufferpos / 50 + k] = ary[k];
     }
+    FlushBuffer(0);
 }
 void Output8Bit(int index, unsigned char A)
 {
@@ -977,6 +979,7 @@ void Render()
                 // mem[54296] = X;
                 bufferpos += 150;
                 buffer[bufferpos / 50] = (X & 15) * 16;
+                FlushBuffer(0);
             }
             else
             {
@@ -984,6 +987,7 @@ void Render()
                 X = 6;
                 bufferpos += 150;
                 buffer[bufferpos / 50] = (X & 15) * 16;
+                FlushBuffer(0);
             }
 
             for (X = wait2; X > 0; X--)
@@ -49,6 +49,12 @@ unsigned char phonemeLengthOutput[60]; //tab47416
 int bufferpos = 0;
 char *buffer = NULL;
 
+// streaming output, see SetOutput()
+static sam_output_t output = NULL;
+static void *output_user = NULL;
+// room past a chunk for the samples Render() writes ahead
+#define SAM_CHUNK_SLACK 64
+
 void SetInput(char *_input)
 {
     int i, l;
@@ -70,6 +76,42 @@ char *GetBuffer() { return buffer; }
 int GetBufferLength() { return bufferpos; }
 void FreeBuffer() { if (buffer) {free(buffer); buffer = NULL;} }
 
+void SetOutput(sam_output_t _output, void *user)
+{
+    output = _output;
+    output_user = user;
+}
+
+// Hand every complete chunk to the output callback and slide the
+// samples written ahead down to the start of the window. Render()
+// only ever moves forward, so everything before bufferpos / 50 is
+// final. Taking whole samples (multiples of 50) off bufferpos keeps
+// the render position exact.
+void FlushBuffer(int final)
+{
+    int done;
+
+    if (output == NULL)
+        return;
+
+    done = bufferpos / 50;
+    if (final)
+    {
+        if (done > 0)
+            output(output_user, buffer, done);
+        bufferpos = 0;
+        return;
+    }
+
+    while (done >= SAM_CHUNK_SIZE)
+    {
+        output(output_user, buffer, SAM_CHUNK_SIZE);
+        memmove(buffer, buffer + SAM_CHUNK_SIZE, done - SAM_CHUNK_SIZE + 5);
+        bufferpos -= SAM_CHUNK_SIZE * 50;
+        done -= SAM_CHUNK_SIZE;
+    }
+}
+
 void Init();
 int Parser1();
 void Parser2();
@@ -100,14 +142,22 @@ void Init()
     SetMouthThroat(mouth, throat);
 
     bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
+    if (output != NULL)
+    {
+        // streaming only needs one chunk plus what's written ahead
+        buffer = (char *)calloc(1, SAM_CHUNK_SIZE + SAM_CHUNK_SLACK);
+    }
+    else
+    {
+        // TODO, check for free the memory, 10 seconds of output should be more than enough
+        //buffer = (char*)ps_malloc(22050 * 5);
+        // switch to ESP-IDF equivalent
 #ifdef ESP_PLATFORM
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
 #else
-    buffer = (char *)malloc(22050 * 10);
+        buffer = (char *)malloc(22050 * 10);
 #endif
+    }
     /*
     Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
     The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
@@ -193,6 +243,7 @@ int SAMMain()
     }
 
     PrepareOutput();
+    FlushBuffer(1);
 
     return 1;
 }
@@ -17,6 +17,15 @@ extern "C"
 
     int SAMMain();
 
+    // Streaming output. With an output callback set, SAMMain() renders
+    // into a small window and hands finished audio (8-bit unsigned,
+    // 22050Hz) to the callback in chunks of SAM_CHUNK_SIZE samples as it
+    // goes, the last chunk being shorter. Without one the whole utterance
+    // is collected and read back with GetBuffer()/GetBufferLength().
+#define SAM_CHUNK_SIZE 1024
+    typedef void (*sam_output_t)(void *user, const char *samples, int count);
+    void SetOutput(sam_output_t output, void *user);
+
     char *GetBuffer();
     int GetBufferLength();
     void FreeBuffer();
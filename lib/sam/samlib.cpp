@@ -13,9 +13,11 @@
   #define MA_NO_ENCODING
   #include "miniaudio.c"
   #include "compat_string.h"
+  #include <atomic>
 #endif
 
 #include "fnSystem.h"
+#include "../../include/debug.h"
 
 #ifdef __cplusplus
 extern char input[256];
@@ -39,7 +41,7 @@ const uint32_t sample_rate = 22050;//110000l;
 #endif
 
 
-void SendI2S (i2s_chan_handle_t tx_handle, char *s, size_t n)
+void SendI2S (i2s_chan_handle_t tx_handle, const char *s, size_t n)
 {
 // number of frames to try and send at once (a frame is a left and right sample)
         const size_t NUM_FRAMES_TO_SEND=1023;//1024;
@@ -216,43 +218,39 @@ void OutputSound()
 
 #else //Not def USESDL
 
+// Sound is played while SAM renders it: StartSound() opens the output,
+// PlaySound() takes each chunk handed to OutputChunk() by SetOutput(),
+// StopSound() lets the tail play out and closes the output again.
+
 #ifdef ESP_PLATFORM
-void OutputSound()
-{
 #ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
+static dac_oneshot_handle_t dac_handle = nullptr;
+#else
+static i2s_chan_handle_t pdm_handle = nullptr;
+#ifdef ESP32S3_I2S_OUT
+static i2s_chan_handle_t i2s_handle = nullptr;
+#endif
+#endif
 
-    dac_oneshot_handle_t dac_handle;
+bool StartSound()
+{
+#ifndef CONFIG_IDF_TARGET_ESP32S3
     dac_oneshot_config_t config = {
       .chan_id = DAC_CHAN_0
     };
 
-    if (dac_oneshot_new_channel(&config, &dac_handle) == ESP_OK) {
-        for (int i = 0; i < n; i++) {
-            dac_oneshot_output_voltage(dac_handle, (uint8_t)s[i]); // ensure unsigned
-            fnSystem.delay_microseconds(40);
-        }
-        dac_oneshot_del_channel(dac_handle);
+    if (dac_oneshot_new_channel(&config, &dac_handle) != ESP_OK) {
+        dac_handle = nullptr;
+        return false;
     }
 #else //Defined CONFIG_IDF_TARGET_ESP32S3
 //SampleRate = 22050
 //8 Bits
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
-    //PDMOutput *audioOutput = NULL;
-
-
-
-//#ifdef ESP32S3_I2S_OUT
-//    if (!i2sOut) {
-//#endif
 
 //PDM always but I2D only if defined ESP32S3_I2S_OUT and i2sOut is true (can change with print #1;"CTRL-A X") X : 0 Disable, 1 Enable. 
 
 //New API
 //Init/Config
-        i2s_chan_handle_t tx_handle;
         /* Allocate an I2S tx channel */
         i2s_chan_config_t chan_cfg;
         chan_cfg.id = I2S_NUM_0;
@@ -260,7 +258,10 @@ void OutputSound()
         chan_cfg.dma_desc_num = 4; //6
         chan_cfg.dma_frame_num = 1024; //240
         chan_cfg.auto_clear = false;
-        i2s_new_channel(&chan_cfg, &tx_handle, NULL);
+        if (i2s_new_channel(&chan_cfg, &pdm_handle, NULL) != ESP_OK) {
+            pdm_handle = nullptr;
+            return false;
+        }
 
         /* Init the channel into PDM TX mode */
         i2s_pdm_tx_config_t pdm_tx_cfg;
@@ -292,30 +293,19 @@ void OutputSound()
 #endif /* PIN_DAC1 */
         pdm_tx_cfg.gpio_cfg.invert_flags.clk_inv = false;
 
-        i2s_channel_init_pdm_tx_mode(tx_handle, &pdm_tx_cfg);
-        i2s_channel_enable(tx_handle);
-
-        SendI2S (tx_handle, s, n);
-
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
-        
-//#ifdef ESP32S3_I2S_OUT
-//    }
-//    else //i2sOut : It need 3 Pins 
+        i2s_channel_init_pdm_tx_mode(pdm_handle, &pdm_tx_cfg);
+        i2s_channel_enable(pdm_handle);
 
 #ifdef ESP32S3_I2S_OUT
     if (i2sOut) 
     {
-        i2s_chan_handle_t tx_handle;
         /* Get the default channel configuration by helper macro.
         * This helper macro is defined in 'i2s_common.h' and shared by all the i2s communication mode.
         * It can help to specify the I2S role, and port id */
         i2s_chan_config_t chan_cfg = I2S_CHANNEL_DEFAULT_CONFIG(I2S_NUM_AUTO, I2S_ROLE_MASTER);
         /* Allocate a new tx channel and get the handle of this channel */
-        i2s_new_channel(&chan_cfg, &tx_handle, NULL);
+        if (i2s_new_channel(&chan_cfg, &i2s_handle, NULL) != ESP_OK)
+            i2s_handle = nullptr;
 
         /* Setting the configurations, the slot configuration and clock configuration can be generated by the macros
         * These two helper macros is defined in 'i2s_std.h' which can only be used in STD mode.
@@ -336,75 +326,139 @@ void OutputSound()
                 },
             },
         };
-        /* Initialize the channel */
-        i2s_channel_init_std_mode(tx_handle, &std_cfg);
-
-        /* Before write data, start the tx channel first */
-        i2s_channel_enable(tx_handle);
-
-        //i2s_channel_write(tx_handle, src_buf, bytes_to_write, bytes_written, ticks_to_wait);
-        //i2s_channel_write(tx_handle, s, n, &bytes_written, 1000 / portTICK_PERIOD_MS);
-        SendI2S (tx_handle, s, n);
-
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
-
-// /I2S_STD
+        if (i2s_handle != nullptr)
+        {
+            /* Initialize the channel */
+            i2s_channel_init_std_mode(i2s_handle, &std_cfg);
 
+            /* Before write data, start the tx channel first */
+            i2s_channel_enable(i2s_handle);
+        }
     }
 #endif    //ESP32S3_I2S_OUT
 
 #endif //CONFIG_IDF_TARGET_ESP32S3
+    return true;
+}
+
+void PlaySound(const char *s, int n)
+{
+#ifndef CONFIG_IDF_TARGET_ESP32S3
+    for (int i = 0; i < n; i++) {
+        dac_oneshot_output_voltage(dac_handle, (uint8_t)s[i]); // ensure unsigned
+        fnSystem.delay_microseconds(40);
+    }
+#else
+    SendI2S(pdm_handle, s, n);
+#ifdef ESP32S3_I2S_OUT
+    if (i2s_handle != nullptr)
+        SendI2S(i2s_handle, s, n);
+#endif
+#endif
+}
+
+void StopSound()
+{
+#ifndef CONFIG_IDF_TARGET_ESP32S3
+    dac_oneshot_del_channel(dac_handle);
+    dac_handle = nullptr;
+#else
+    /* Have to stop the channel before deleting it */
+    i2s_channel_disable(pdm_handle);
+    /* If the handle is not needed any more, delete it to release the channel resources */
+    i2s_del_channel(pdm_handle);
+    pdm_handle = nullptr;
+#ifdef ESP32S3_I2S_OUT
+    if (i2s_handle != nullptr)
+    {
+        i2s_channel_disable(i2s_handle);
+        i2s_del_channel(i2s_handle);
+        i2s_handle = nullptr;
+    }
+#endif
+#endif
 }
 
 // end of ESP_PLATFORM
 #else
 // !ESP_PLATFORM
 
-static int pos = 0;
+// Rendered audio waiting for the device. SAM renders far faster than
+// real time, so PlaySound() waits for room instead of queueing the
+// whole utterance.
+#define SAM_RING_SIZE (SAM_CHUNK_SIZE * 8)
+static char ring[SAM_RING_SIZE];
+static std::atomic<size_t> ring_head; // advanced by PlaySound()
+static std::atomic<size_t> ring_tail; // advanced by data_callback()
+static std::atomic<bool> rendering;
+static std::atomic<bool> done;
+static ma_device device;
+
 void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
-    int bufferpos = GetBufferLength() / 50;
-    char *buffer = GetBuffer();
+    size_t tail = ring_tail.load(std::memory_order_relaxed);
+    size_t avail = ring_head.load(std::memory_order_acquire) - tail;
     int i;
-    bool *done_ptr = static_cast<bool *>(pDevice->pUserData);
-    if (pos >= bufferpos)
+    if (avail == 0)
     {
-        *done_ptr = true;
+        // the output is pre-silenced, so running dry just plays silence
+        if (!rendering)
+            done = true;
         return;
     }
-    if ((bufferpos - pos) < frameCount)
-        frameCount = (bufferpos - pos);
+    if (avail < frameCount)
+        frameCount = avail;
     for (i = 0; i < frameCount; i++)
-    {
-        ((char *)pOutput)[i] = buffer[pos];
-        pos++;
-    }
+        ((char *)pOutput)[i] = ring[(tail + i) % SAM_RING_SIZE];
+    ring_tail.store(tail + frameCount, std::memory_order_release);
 }
 
-void OutputSound()
+bool StartSound()
 {
-    pos = 0;
-    bool done = false;
+    ring_head = 0;
+    ring_tail = 0;
+    rendering = true;
+    done = false;
     ma_device_config config  = ma_device_config_init(ma_device_type_playback);
     config.playback.format   = ma_format_u8;    // Set to ma_format_unknown to use the device's native format.
     config.playback.channels = 1;               // Set to 0 to use the device's native channel count.
     config.sampleRate        = sample_rate;     // Set to 0 to use the device's native sample rate.
     config.dataCallback      = data_callback;   // This function will be called when miniaudio needs more data.
-    config.pUserData         = &done;           // Can be accessed from the device object (device.pUserData).
 
-    ma_device device;
     if (ma_device_init(NULL, &config, &device) != MA_SUCCESS) {
-        return;  // Failed to initialize the device.
+        return false;  // Failed to initialize the device.
     }
 
     ma_device_start(&device);     // The device is sleeping by default so you'll need to start it manually.
+    return true;
+}
+
+void PlaySound(const char *s, int n)
+{
+    while (n > 0)
+    {
+        size_t head = ring_head.load(std::memory_order_relaxed);
+        size_t room = SAM_RING_SIZE - (head - ring_tail.load(std::memory_order_acquire));
+        if (room == 0)
+        {
+            fnSystem.delay(10);
+            continue;
+        }
+        if (room > (size_t)n)
+            room = n;
+        for (size_t i = 0; i < room; i++)
+            ring[(head + i) % SAM_RING_SIZE] = s[i];
+        ring_head.store(head + room, std::memory_order_release);
+        s += room;
+        n -= room;
+    }
+}
 
-    // Do something here.
+void StopSound()
+{
+    rendering = false;
     while (!done) {
-        fnSystem.delay(100);
+        fnSystem.delay(20);
     }
 
     ma_device_uninit(&device);
@@ -413,6 +467,19 @@ void OutputSound()
     // end of !ESP_PLATFORM
 #endif
 
+static unsigned long sound_start;
+static unsigned long sound_first;
+static unsigned long sound_samples;
+
+// SetOutput() callback
+static void OutputChunk(void *user, const char *samples, int count)
+{
+    if (sound_samples == 0)
+        sound_first = (unsigned long)fnSystem.millis() - sound_start;
+    sound_samples += count;
+    PlaySound(samples, count);
+}
+
 #endif //USESDL
 
 int sam(int argc, char **argv)
@@ -555,6 +622,7 @@ int sam(int argc, char **argv)
 
     // printf("right before SAMMain");
 
+#ifdef USESDL
     if (!SAMMain()) // buffer is allocated in SAMMain, used by OutputSound and WriteWav
     {
         PrintUsage();
@@ -570,6 +638,26 @@ int sam(int argc, char **argv)
 //     else
 // #endif // ESP_PLATFORM
         OutputSound();
+#else
+    if (!StartSound())
+        return 1;
+
+    // chunks go straight to the output as they're rendered
+    sound_start = (unsigned long)fnSystem.millis();
+    sound_samples = 0;
+    SetOutput(OutputChunk, NULL);
+    int rendered = SAMMain();
+    SetOutput(NULL, NULL);
+    StopSound();
+
+    if (!rendered)
+    {
+        PrintUsage();
+        return 1;
+    }
+    Debug_printf("SAM: %lu samples, first audio after %lu ms, done after %lu ms\n", sound_samples, sound_first,
+                 (unsigned long)fnSystem.millis() - sound_start);
+#endif
 
     FreeBuffer();
     return 0;
@@ -30,7 +30,9 @@ void PrintUsage();
 void MixAudio(void *unused, Uint8 *stream, int len);
 void OutputSound();
 #else
-void OutputSound();
+bool StartSound();
+void PlaySound(const char *s, int n);
+void StopSound();
 #endif
 
 int sam(int argc, char **argv);
@@ -0,0 +1,863 @@
+#include "debug.h"
+
+#ifdef DEBUG_ASYNC
+
+#include "DebugLog.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#ifdef ESP_PLATFORM
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#else
+#include <chrono>
+#include <ctime>
+#include <thread>
+#endif
+
+#include "ansi_codes.h"
+
+DebugLog debugLog;
+
+static uint64_t now_us()
+{
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time();
+#else
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void console_write(const char *text, size_t len)
+{
+#if defined(ESP_PLATFORM) && !defined(ENABLE_CONSOLE) && !defined(PINMAP_RS232_S3) && !defined(PINMAP_LYNX_S3)
+    Serial.write(text, len);
+#else
+    fwrite(text, 1, len, stdout);
+    fflush(stdout);
+#endif
+}
+
+/*
+ * printf conversion specs
+ *
+ * Both capture() and format() walk the format with parse_spec(), so they
+ * agree on how many arguments there are and what type each one has.
+ */
+
+enum SpecLength : uint8_t { LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_BIG_L };
+
+struct Spec
+{
+    const char *flags;      // first flag character, right after '%'
+    size_t flags_len;
+    bool width_star;
+    const char *width;      // digits, when not '*'
+    size_t width_len;
+    bool has_precision;
+    bool precision_star;
+    const char *precision;
+    size_t precision_len;
+    SpecLength length;
+    char conv;
+};
+
+// p points at the '%'. Returns the character after the spec, or nullptr if
+// it isn't one we know how to copy.
+static const char *parse_spec(const char *p, Spec &spec)
+{
+    spec = {};
+    p++;
+
+    spec.flags = p;
+    while (*p && strchr("-+ #0", *p))
+        p++;
+    spec.flags_len = p - spec.flags;
+
+    if (*p == '*')
+    {
+        spec.width_star = true;
+        p++;
+    }
+    else
+    {
+        spec.width = p;
+        while (*p >= '0' && *p <= '9')
+            p++;
+        spec.width_len = p - spec.width;
+    }
+
+    if (*p == '.')
+    {
+        spec.has_precision = true;
+        p++;
+        if (*p == '*')
+        {
+            spec.precision_star = true;
+            p++;
+        }
+        else
+        {
+            spec.precision = p;
+            while (*p >= '0' && *p <= '9')
+                p++;
+            spec.precision_len = p - spec.precision;
+        }
+    }
+
+    switch (*p)
+    {
+    case 'h':
+        spec.length = p[1] == 'h' ? LEN_HH : LEN_H;
+        p += p[1] == 'h' ? 2 : 1;
+        break;
+    case 'l':
+        spec.length = p[1] == 'l' ? LEN_LL : LEN_L;
+        p += p[1] == 'l' ? 2 : 1;
+        break;
+    case 'q': spec.length = LEN_LL; p++; break;
+    case 'z': spec.length = LEN_Z; p++; break;
+    case 'j': spec.length = LEN_J; p++; break;
+    case 't': spec.length = LEN_T; p++; break;
+    case 'L': spec.length = LEN_BIG_L; p++; break;
+    default: break;
+    }
+
+    if (*p == '\0' || !strchr("diuoxXcsfFeEgGaApn", *p))
+        return nullptr;
+    spec.conv = *p;
+    return p + 1;
+}
+
+static bool is_signed_conv(char c) { return c == 'd' || c == 'i'; }
+static bool is_unsigned_conv(char c) { return strchr("uoxX", c) != nullptr; }
+static bool is_float_conv(char c) { return strchr("fFeEgGaA", c) != nullptr; }
+
+static int64_t signed_arg(SpecLength length, va_list &args)
+{
+    switch (length)
+    {
+    case LEN_L: return va_arg(args, long);
+    case LEN_LL: return va_arg(args, long long);
+    case LEN_Z: return (int64_t) va_arg(args, size_t);
+    case LEN_J: return va_arg(args, intmax_t);
+    case LEN_T: return va_arg(args, ptrdiff_t);
+    default: return va_arg(args, int);
+    }
+}
+
+static uint64_t unsigned_arg(SpecLength length, va_list &args)
+{
+    switch (length)
+    {
+    case LEN_L: return va_arg(args, unsigned long);
+    case LEN_LL: return va_arg(args, unsigned long long);
+    case LEN_Z: return va_arg(args, size_t);
+    case LEN_J: return va_arg(args, uintmax_t);
+    case LEN_T: return (uint64_t) va_arg(args, ptrdiff_t);
+    default: return va_arg(args, unsigned int);
+    }
+}
+
+// snprintf one value onto the end of out
+template <typename T>
+static void append_value(std::string &out, const char *spec, T value)
+{
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), spec, value);
+    if (len < 0)
+        return;
+    if ((size_t) len < sizeof(buf))
+    {
+        out.append(buf, len);
+        return;
+    }
+    size_t start = out.size();
+    out.resize(start + len + 1);
+    snprintf(&out[start], len + 1, spec, value);
+    out.resize(start + len);
+}
+
+struct DebugLog::Flusher
+{
+    std::string out;
+    std::string plain;          // out without colours, for the history
+    bool line_start = true;
+
+    // History keeps whole lines; this one is still waiting for its newline
+    std::string line_text;
+    uint64_t line_time = 0;
+    int line_module = -1;
+    DebugLogLevel line_level = DebugLogLevel::Debug;
+
+    std::deque<Line> history;   // guarded by _historyMutex
+    size_t history_bytes = 0;
+};
+
+void DebugLog::start()
+{
+    if (_started)
+        return;
+    _started = true;
+
+#ifdef ESP_PLATFORM
+    // Lowest priority above idle, so it only writes when nothing else wants the CPU
+    xTaskCreate([](void *arg) {
+        DebugLog *log = static_cast<DebugLog *>(arg);
+        while (true)
+        {
+            log->flush();
+            vTaskDelay(pdMS_TO_TICKS(DEBUG_LOG_FLUSH_MS));
+        }
+    }, "debug_log", 4096, this, tskIDLE_PRIORITY + 1, nullptr);
+#else
+    std::thread([this]() {
+        while (true)
+        {
+            flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(DEBUG_LOG_FLUSH_MS));
+        }
+    }).detach();
+#endif
+}
+
+/*
+ * Writers
+ */
+
+int DebugLog::module(DebugLogSite &site)
+{
+    int mod = site.module.load(std::memory_order_acquire);
+    if (mod >= 0)
+        return mod;
+
+    const char *name = site.file;
+    for (const char *p = site.file; *p; p++)
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+    const char *dot = strchr(name, '.');
+    size_t len = dot ? dot - name : strlen(name);
+
+    mod = find_module(name, len);
+    site.module.store(mod, std::memory_order_release);
+    return mod;
+}
+
+int DebugLog::find_module(const char *name, size_t len)
+{
+    std::lock_guard<std::mutex> lock(_modulesMutex);
+
+    len = std::min(len, sizeof(_modules[0].name) - 1);
+    int count = _moduleCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; i++)
+        if (strncmp(_modules[i].name, name, len) == 0 && _modules[i].name[len] == '\0')
+            return i;
+
+    // Once the table is full everything else shares the last entry
+    if (count == DEBUG_LOG_MODULES - 1)
+    {
+        name = "other";
+        len = strlen(name);
+    }
+    else if (count == DEBUG_LOG_MODULES)
+        return DEBUG_LOG_MODULES - 1;
+
+    ModuleState &m = _modules[count];
+    memcpy(m.name, name, len);
+    m.name[len] = '\0';
+    m.level.store(_defaultLevel.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m.tokens.store(DEBUG_LOG_BURST, std::memory_order_relaxed);
+    m.refill_ms.store(now_us() / 1000, std::memory_order_relaxed);
+    m.logged.store(0, std::memory_order_relaxed);
+    m.suppressed.store(0, std::memory_order_relaxed);
+    m.reported = 0;
+    _moduleCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+bool DebugLog::allow(int mod, DebugLogLevel level, uint64_t now)
+{
+    ModuleState &m = _modules[mod];
+    if (static_cast<uint8_t>(level) > m.level.load(std::memory_order_relaxed))
+        return false;
+
+    // Token bucket, topped up at most every 10ms. Writers racing on the top
+    // up can lose a few tokens, which only makes the limit a little stricter.
+    uint32_t now_ms = now / 1000;
+    uint32_t last = m.refill_ms.load(std::memory_order_relaxed);
+    uint32_t elapsed = now_ms - last;
+    if (elapsed >= 10 &&
+        m.refill_ms.compare_exchange_strong(last, now_ms, std::memory_order_relaxed))
+    {
+        int64_t tokens = std::max<int32_t>(m.tokens.load(std::memory_order_relaxed), 0);
+        tokens += (uint64_t) elapsed * DEBUG_LOG_RATE / 1000;
+        m.tokens.store(std::min<int64_t>(tokens, DEBUG_LOG_BURST), std::memory_order_relaxed);
+    }
+
+    if (m.tokens.fetch_sub(1, std::memory_order_relaxed) <= 0)
+    {
+        m.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m.logged.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+DebugLog::Record *DebugLog::claim(uint32_t &pos)
+{
+    // Vyukov's bounded queue: a slot is free for pos when its seq is pos, and
+    // holds a record for the flusher when it's pos + 1
+    pos = _head.load(std::memory_order_relaxed);
+    while (true)
+    {
+        uint32_t idx = pos & (DEBUG_LOG_RECORDS - 1);
+        Record &rec = _ring[idx];
+        int32_t diff = (int32_t) (rec.seq.load(std::memory_order_acquire) + idx - pos);
+        if (diff == 0)
+        {
+            if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                return &rec;
+        }
+        else if (diff < 0)
+            return nullptr; // full: the flusher hasn't got to this one yet
+        else
+            pos = _head.load(std::memory_order_relaxed);
+    }
+}
+
+void DebugLog::capture(Record &rec, const char *fmt, va_list args)
+{
+    va_list ap;
+    va_copy(ap, args);
+
+    uint8_t *out = rec.args;
+    uint8_t *end = rec.args + DEBUG_LOG_ARG_BYTES;
+    rec.nargs = 0;
+
+    for (const char *p = fmt; *p; p++)
+    {
+        if (*p != '%')
+            continue;
+        if (p[1] == '%')
+        {
+            p++;
+            continue;
+        }
+
+        Spec spec;
+        const char *next = parse_spec(p, spec);
+        if (next == nullptr)
+            break; // format() writes the rest out as is
+
+        size_t stars = (spec.width_star ? 1 : 0) + (spec.precision_star ? 1 : 0);
+        size_t need = stars * sizeof(int) + (spec.conv == 's' ? 1 : spec.conv == 'n' ? 0 : 8);
+        if (rec.nargs == UINT8_MAX || (size_t) (end - out) < need)
+        {
+            rec.flags |= F_TRUNCATED;
+            break;
+        }
+
+        // Only as much of a %s as its precision asks for is copied
+        long precision = -1;
+        if (spec.has_precision && !spec.precision_star)
+            precision = strtol(spec.precision, nullptr, 10); // stops at the conversion
+        for (size_t i = 0; i < stars; i++)
+        {
+            int star = va_arg(ap, int);
+            memcpy(out, &star, sizeof(star));
+            out += sizeof(star);
+            if (spec.precision_star && i == stars - 1)
+                precision = star;
+        }
+
+        if (is_signed_conv(spec.conv) || spec.conv == 'c')
+        {
+            int64_t v = spec.conv == 'c' ? va_arg(ap, int) : signed_arg(spec.length, ap);
+            memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+        else if (is_unsigned_conv(spec.conv))
+        {
+            uint64_t v = unsigned_arg(spec.length, ap);
+            memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+        else if (is_float_conv(spec.conv))
+        {
+            double v = spec.length == LEN_BIG_L ? (double) va_arg(ap, long double) : va_arg(ap, double);
+            memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+        else if (spec.conv == 'p')
+        {
+            uint64_t v = (uintptr_t) va_arg(ap, void *);
+            memcpy(out, &v, sizeof(v));
+            out += sizeof(v);
+        }
+        else if (spec.conv == 's')
+        {
+            const char *s = spec.length == LEN_L ? (va_arg(ap, void *), "(wide)") : va_arg(ap, const char *);
+            if (s == nullptr)
+                s = "(null)";
+            size_t room = end - out - 1;
+            size_t len = strnlen(s, precision >= 0 && (size_t) precision <= room ? precision : room + 1);
+            if (len > room)
+            {
+                // Doesn't fit: keep what does and mark the cut
+                len = room;
+                memcpy(out, s, len);
+                if (len >= 3)
+                    memcpy(out + len - 3, "...", 3);
+            }
+            else
+                memcpy(out, s, len);
+            out[len] = '\0';
+            out += len + 1;
+        }
+        else // 'n' writes through its pointer, which never happens here
+            (void) va_arg(ap, void *);
+
+        rec.nargs++;
+        p = next - 1;
+    }
+
+    va_end(ap);
+}
+
+void DebugLog::vprintf(DebugLogSite &site, DebugLogLevel level, bool prefix, const char *fmt, va_list args)
+{
+    if (fmt == nullptr)
+        return;
+
+    uint64_t now = now_us();
+    if (!allow(module(site), level, now))
+        return;
+
+    uint32_t pos;
+    Record *rec = claim(pos);
+    if (rec == nullptr)
+    {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    rec->level = static_cast<uint8_t>(level);
+    rec->flags = prefix ? F_PREFIX : 0;
+    rec->time_us = now;
+    rec->site = &site;
+    rec->fmt = fmt;
+    capture(*rec, fmt, args);
+    rec->seq.store(pos + 1 - (pos & (DEBUG_LOG_RECORDS - 1)), std::memory_order_release);
+}
+
+void DebugLog::printf(DebugLogSite &site, DebugLogLevel level, bool prefix, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vprintf(site, level, prefix, fmt, args);
+    va_end(args);
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline)
+{
+    if (newline)
+        printf(site, level, false, "\r\n");
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, const char *str)
+{
+    if (str == nullptr)
+        str = "(null)";
+
+    // Longer strings go out a record's worth at a time
+    const size_t chunk = DEBUG_LOG_ARG_BYTES - sizeof(int) - 1;
+    size_t len = strlen(str);
+    while (len > chunk)
+    {
+        printf(site, level, false, "%.*s", (int) chunk, str);
+        str += chunk;
+        len -= chunk;
+    }
+    if (newline)
+        printf(site, level, false, "%s\r\n", str);
+    else if (len > 0)
+        printf(site, level, false, "%s", str);
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, const std::string &str)
+{
+    print(site, level, newline, str.c_str());
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, int n, int base)
+{
+    print(site, level, newline, (long) n, base);
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, unsigned int n, int base)
+{
+    print(site, level, newline, (unsigned long) n, base);
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, long n, int base)
+{
+    if (base == 10)
+        printf(site, level, false, newline ? "%ld\r\n" : "%ld", n);
+    else
+        print(site, level, newline, (unsigned long) n, base);
+}
+
+void DebugLog::print(DebugLogSite &site, DebugLogLevel level, bool newline, unsigned long n, int base)
+{
+    if (base == 16)
+        printf(site, level, false, newline ? "%lX\r\n" : "%lX", n);
+    else if (base == 8)
+        printf(site, level, false, newline ? "%lo\r\n" : "%lo", n);
+    else
+        printf(site, level, false, newline ? "%lu\r\n" : "%lu", n);
+}
+
+/*
+ * Flusher
+ */
+
+void DebugLog::format(const Record &rec, std::string &out, bool color) const
+{
+    if (rec.flags & F_PREFIX)
+    {
+        char prefix[160];
+        snprintf(prefix, sizeof(prefix), "%s[%s:%u] %s(): %s", color ? ANSI_YELLOW : "",
+                 rec.site->file, (unsigned) rec.site->line, rec.site->function, color ? ANSI_GREEN_BOLD : "");
+        out += prefix;
+    }
+
+    const uint8_t *in = rec.args;
+    unsigned nargs = 0;
+    const char *p = rec.fmt;
+    while (*p)
+    {
+        const char *lit = p;
+        while (*p && *p != '%')
+            p++;
+        out.append(lit, p - lit);
+        if (*p == '\0')
+            break;
+
+        if (p[1] == '%')
+        {
+            out += '%';
+            p += 2;
+            continue;
+        }
+
+        Spec spec;
+        const char *next = nargs < rec.nargs ? parse_spec(p, spec) : nullptr;
+        if (next == nullptr)
+        {
+            if (rec.flags & F_TRUNCATED)
+            {
+                // Out of argument space: keep the line ending so lines don't run together
+                out += " ...";
+                const char *eol = p + strlen(p);
+                while (eol > p && (eol[-1] == '\r' || eol[-1] == '\n'))
+                    eol--;
+                out += eol;
+            }
+            else
+                out += p;
+            break;
+        }
+        p = next;
+        nargs++;
+
+        // Rebuild the spec with any '*' replaced by the captured value
+        std::string fmt = "%";
+        fmt.append(spec.flags, spec.flags_len);
+        int star;
+        if (spec.width_star)
+        {
+            memcpy(&star, in, sizeof(star));
+            in += sizeof(star);
+            fmt += std::to_string(star);
+        }
+        else
+            fmt.append(spec.width, spec.width_len);
+        if (spec.has_precision)
+        {
+            if (spec.precision_star)
+            {
+                memcpy(&star, in, sizeof(star));
+                in += sizeof(star);
+                if (star >= 0)
+                    fmt += "." + std::to_string(star);
+            }
+            else
+            {
+                fmt += '.';
+                fmt.append(spec.precision, spec.precision_len);
+            }
+        }
+
+        static const char *lengths[] = {"", "hh", "h", "l", "ll", "z", "j", "t", ""};
+        if (spec.conv != 'c' && spec.conv != 's' && spec.conv != 'p' && !is_float_conv(spec.conv))
+            fmt += lengths[spec.length];
+        fmt += spec.conv;
+
+        if (is_signed_conv(spec.conv) || spec.conv == 'c')
+        {
+            int64_t v;
+            memcpy(&v, in, sizeof(v));
+            in += sizeof(v);
+            switch (spec.conv == 'c' ? LEN_NONE : spec.length)
+            {
+            case LEN_L: append_value(out, fmt.c_str(), (long) v); break;
+            case LEN_LL: append_value(out, fmt.c_str(), (long long) v); break;
+            case LEN_Z: append_value(out, fmt.c_str(), (size_t) v); break;
+            case LEN_J: append_value(out, fmt.c_str(), (intmax_t) v); break;
+            case LEN_T: append_value(out, fmt.c_str(), (ptrdiff_t) v); break;
+            default: append_value(out, fmt.c_str(), (int) v); break;
+            }
+        }
+        else if (is_unsigned_conv(spec.conv))
+        {
+            uint64_t v;
+            memcpy(&v, in, sizeof(v));
+            in += sizeof(v);
+            switch (spec.length)
+            {
+            case LEN_L: append_value(out, fmt.c_str(), (unsigned long) v); break;
+            case LEN_LL: append_value(out, fmt.c_str(), (unsigned long long) v); break;
+            case LEN_Z: append_value(out, fmt.c_str(), (size_t) v); break;
+            case LEN_J: append_value(out, fmt.c_str(), (uintmax_t) v); break;
+            case LEN_T: append_value(out, fmt.c_str(), (ptrdiff_t) v); break;
+            default: append_value(out, fmt.c_str(), (unsigned int) v); break;
+            }
+        }
+        else if (is_float_conv(spec.conv))
+        {
+            double v;
+            memcpy(&v, in, sizeof(v));
+            in += sizeof(v);
+            append_value(out, fmt.c_str(), v);
+        }
+        else if (spec.conv == 'p')
+        {
+            uint64_t v;
+            memcpy(&v, in, sizeof(v));
+            in += sizeof(v);
+            append_value(out, fmt.c_str(), (void *) (uintptr_t) v);
+        }
+        else if (spec.conv == 's')
+        {
+            const char *s = (const char *) in;
+            in += strlen(s) + 1;
+            append_value(out, fmt.c_str(), s);
+        }
+    }
+
+    if (rec.flags & F_PREFIX)
+        out += color ? ANSI_RESET "\r\n" : "\r\n";
+}
+
+void DebugLog::flush()
+{
+    std::lock_guard<std::mutex> lock(_flushMutex);
+    if (_flusher == nullptr)
+    {
+        std::lock_guard<std::mutex> history_lock(_historyMutex);
+        _flusher = new Flusher;
+    }
+    Flusher &f = *_flusher;
+
+    while (true)
+    {
+        uint32_t idx = _tail & (DEBUG_LOG_RECORDS - 1);
+        Record &rec = _ring[idx];
+        if (rec.seq.load(std::memory_order_acquire) + idx != _tail + 1)
+            break;
+
+        uint64_t time_us = rec.time_us;
+        DebugLogLevel level = static_cast<DebugLogLevel>(rec.level);
+        int mod = rec.site->module.load(std::memory_order_relaxed);
+
+        bool prefix = rec.flags & F_PREFIX;
+
+        f.out.clear();
+        format(rec, f.out, true);
+        if (prefix)
+        {
+            f.plain.clear();
+            format(rec, f.plain, false);
+        }
+
+        // Hand the slot back before writing, the console may be slow
+        rec.seq.store(_tail + DEBUG_LOG_RECORDS - idx, std::memory_order_release);
+        _tail++;
+
+        write(time_us, mod, level, f.out, prefix ? f.plain : f.out);
+    }
+
+    report_losses();
+}
+
+void DebugLog::report_losses()
+{
+    char msg[96];
+
+    uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+    if (dropped != _reportedDropped)
+    {
+        int len = snprintf(msg, sizeof(msg), "[debug_log] %u messages dropped, ring full\r\n",
+                           (unsigned) (dropped - _reportedDropped));
+        _reportedDropped = dropped;
+        std::string text(msg, len);
+        write(now_us(), -1, DebugLogLevel::Warn, text, text);
+    }
+
+    int count = _moduleCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++)
+    {
+        ModuleState &m = _modules[i];
+        uint32_t suppressed = m.suppressed.load(std::memory_order_relaxed);
+        if (suppressed == m.reported)
+            continue;
+        int len = snprintf(msg, sizeof(msg), "[debug_log] %s: %u messages suppressed, rate limit\r\n",
+                           m.name, (unsigned) (suppressed - m.reported));
+        m.reported = suppressed;
+        std::string text(msg, len);
+        write(now_us(), i, DebugLogLevel::Warn, text, text);
+    }
+}
+
+void DebugLog::write(uint64_t time_us, int mod, DebugLogLevel level, const std::string &text, const std::string &plain)
+{
+    if (text.empty())
+        return;
+    Flusher &f = *_flusher;
+
+#ifndef ESP_PLATFORM
+    // Timestamp each line with when it was logged, not when it was written
+    if (f.line_start)
+    {
+        time_t secs = time_us / 1000000;
+        tm tm;
+#if defined(_WIN32)
+        localtime_s(&tm, &secs);
+#else
+        localtime_r(&secs, &tm);
+#endif
+        char stamp[32];
+        size_t len = strftime(stamp, sizeof(stamp), "%H:%M:%S", &tm);
+        len += snprintf(stamp + len, sizeof(stamp) - len, ".%06d > ", (int) (time_us % 1000000));
+        console_write(stamp, len);
+    }
+#endif
+    console_write(text.data(), text.size());
+    f.line_start = text.back() == '\n';
+
+    // History keeps whole lines without their line endings
+    if (f.line_text.empty())
+    {
+        f.line_time = time_us;
+        f.line_module = mod;
+        f.line_level = level;
+    }
+    for (char c : plain)
+    {
+        if (c == '\r')
+            continue;
+        if (c != '\n')
+        {
+            f.line_text += c;
+            continue;
+        }
+
+        Line line;
+        line.time_us = f.line_time;
+        line.level = f.line_level;
+        line.module = f.line_module >= 0 ? _modules[f.line_module].name : "debug_log";
+        line.text = std::move(f.line_text);
+        f.line_text.clear();
+        f.line_time = time_us;
+        f.line_module = mod;
+        f.line_level = level;
+
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        f.history_bytes += line.text.size();
+        f.history.push_back(std::move(line));
+        while (f.history_bytes > DEBUG_LOG_HISTORY && f.history.size() > 1)
+        {
+            f.history_bytes -= f.history.front().text.size();
+            f.history.pop_front();
+        }
+    }
+}
+
+/*
+ * Readers
+ */
+
+void DebugLog::set_level(const char *module, DebugLogLevel level)
+{
+    if (strcmp(module, "*") == 0)
+    {
+        _defaultLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+        int count = _moduleCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; i++)
+            _modules[i].level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+        return;
+    }
+
+    // Modules that haven't logged yet are added now so they start at this level
+    int mod = find_module(module, strlen(module));
+    _modules[mod].level.store(static_cast<uint8_t>(level), std::memory_order_relaxed);
+}
+
+std::vector<DebugLog::Module> DebugLog::modules() const
+{
+    std::vector<Module> out;
+    int count = _moduleCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; i++)
+    {
+        const ModuleState &m = _modules[i];
+        out.push_back({m.name, static_cast<DebugLogLevel>(m.level.load(std::memory_order_relaxed)),
+                       m.logged.load(std::memory_order_relaxed), m.suppressed.load(std::memory_order_relaxed)});
+    }
+    return out;
+}
+
+std::vector<DebugLog::Line> DebugLog::history() const
+{
+    std::lock_guard<std::mutex> lock(_historyMutex);
+    if (_flusher == nullptr)
+        return {};
+    return std::vector<Line>(_flusher->history.begin(), _flusher->history.end());
+}
+
+static const char *level_names[] = {"off", "error", "warn", "info", "debug", "verbose"};
+
+const char *DebugLog::level_name(DebugLogLevel level)
+{
+    return level_names[static_cast<int>(level)];
+}
+
+bool DebugLog::parse_level(const char *name, DebugLogLevel &level)
+{
+    for (size_t i = 0; i < sizeof(level_names) / sizeof(level_names[0]); i++)
+    {
+        if (strcasecmp(name, level_names[i]) == 0)
+        {
+            level = static_cast<DebugLogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif /* DEBUG_ASYNC */
@@ -0,0 +1,191 @@
+#ifndef DEBUGLOG_H
+#define DEBUGLOG_H
+
+#include <atomic>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*
+ * Asynchronous debug log
+ *
+ * Build with -D DEBUG_ASYNC (on top of a debug build) and the Debug_print*
+ * macros in debug.h stop writing to the debug port. They copy the format
+ * pointer and the arguments into a fixed-size record instead. A
+ * low-priority task formats the records and writes them out every
+ * DEBUG_LOG_FLUSH_MS. A bus handler that logs then pays for a few copies,
+ * not for a 115200 baud UART, and its timing stays close to a release build.
+ *
+ * The format must be a string literal, since only its pointer is kept.
+ * %s arguments are copied, truncated to fit the record. Long strings passed
+ * to Debug_print are split over several records.
+ *
+ * Each source file is a module, named after its file name without the
+ * extension ("fnFsTNFS", "sio"). Every module has a runtime log level and
+ * its own rate limit: after DEBUG_LOG_BURST records in a row it may log
+ * DEBUG_LOG_RATE records a second. Anything over the limit is counted and
+ * reported as suppressed. When the ring is full new records are dropped
+ * and counted the same way.
+ *
+ * The last DEBUG_LOG_HISTORY bytes of formatted lines are kept for
+ * GET /api/v1/log. POST /api/v1/log {"module": "sio", "level": "warn"} sets
+ * a module's level; "*" sets all of them.
+ *
+ * Writers never block: a record is claimed with a compare-and-swap on the
+ * ring head and published by bumping its sequence number.
+ */
+
+#define DEBUG_LOG_RECORDS 128       // must be a power of two
+#define DEBUG_LOG_ARG_BYTES 96      // captured arguments per record
+#define DEBUG_LOG_MODULES 96
+#define DEBUG_LOG_HISTORY 8192      // bytes of formatted lines kept
+#define DEBUG_LOG_BURST 64
+#define DEBUG_LOG_RATE 200          // records per second per module
+#define DEBUG_LOG_FLUSH_MS 20
+
+enum class DebugLogLevel : uint8_t {
+    Off,
+    Error,
+    Warn,
+    Info,
+    Debug,      // Debug_print, Debug_printf, Debug_println
+    Verbose,    // Debug_printv
+};
+
+// One per call site, a function-local static created by the debug.h macros.
+// Remembers which module the site belongs to after the first lookup.
+struct DebugLogSite
+{
+    const char *file;
+    const char *function;
+    uint32_t line;
+    std::atomic<int16_t> module{-1};
+
+    constexpr DebugLogSite(const char *file, const char *function, uint32_t line)
+        : file(file), function(function), line(line) {}
+};
+
+#ifdef DEBUG_ASYNC
+
+class DebugLog
+{
+public:
+    struct Module
+    {
+        std::string name;
+        DebugLogLevel level;
+        uint32_t logged;
+        uint32_t suppressed;
+    };
+
+    struct Line
+    {
+        uint64_t time_us;
+        DebugLogLevel level;
+        std::string module;
+        std::string text;
+    };
+
+    // Code that runs before main() logs too, so the log has to work before
+    // its own constructor would have run. Everything here is constant
+    // initialized and the rest is allocated by the first flush.
+    constexpr DebugLog() = default;
+
+    // Start the task that writes queued records out
+    void start();
+    // Format and write out everything queued so far, on the caller's thread
+    void flush();
+
+    void printf(DebugLogSite &site, DebugLogLevel level, bool prefix, const char *fmt, ...)
+        __attribute__((format(printf, 5, 6)));
+    void vprintf(DebugLogSite &site, DebugLogLevel level, bool prefix, const char *fmt, va_list args);
+
+    // Debug_print/Debug_println, matching the overloads the ESP32 debug port has
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, const char *str);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, const std::string &str);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, int n, int base = 10);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, unsigned int n, int base = 10);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, long n, int base = 10);
+    void print(DebugLogSite &site, DebugLogLevel level, bool newline, unsigned long n, int base = 10);
+
+    // Set the level of one module, or of every module for "*"
+    void set_level(const char *module, DebugLogLevel level);
+    std::vector<Module> modules() const;
+    // Formatted lines, oldest first
+    std::vector<Line> history() const;
+    // Records lost because the ring was full
+    uint32_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+
+    static const char *level_name(DebugLogLevel level);
+    static bool parse_level(const char *name, DebugLogLevel &level);
+
+private:
+    enum : uint8_t {
+        F_PREFIX = 0x01,     // Debug_printv: "[file:line] function(): " and a newline
+        F_TRUNCATED = 0x02,  // ran out of argument space partway through fmt
+    };
+
+    // seq is stored minus the slot index, so all zeroes is an empty ring
+    struct Record
+    {
+        std::atomic<uint32_t> seq{0};
+        uint8_t level = 0;
+        uint8_t flags = 0;
+        uint8_t nargs = 0;      // conversions captured from fmt
+        uint64_t time_us = 0;
+        DebugLogSite *site = nullptr;
+        const char *fmt = nullptr;
+        uint8_t args[DEBUG_LOG_ARG_BYTES] = {};
+    };
+
+    struct ModuleState
+    {
+        char name[24] = {};
+        std::atomic<uint8_t> level{0};
+        std::atomic<int32_t> tokens{0};
+        std::atomic<uint32_t> refill_ms{0};
+        std::atomic<uint32_t> logged{0};
+        std::atomic<uint32_t> suppressed{0};
+        uint32_t reported = 0;  // suppressed count already written out, flusher only
+    };
+
+    // Formatting buffers and the history, created by the first flush
+    struct Flusher;
+
+    Record _ring[DEBUG_LOG_RECORDS];
+    std::atomic<uint32_t> _head{0};
+    uint32_t _tail = 0;
+    std::atomic<uint32_t> _dropped{0};
+    uint32_t _reportedDropped = 0;
+
+    ModuleState _modules[DEBUG_LOG_MODULES];
+    std::atomic<int> _moduleCount{0};
+    std::atomic<uint8_t> _defaultLevel{static_cast<uint8_t>(DebugLogLevel::Verbose)};
+    std::mutex _modulesMutex;
+
+    std::mutex _flushMutex;
+    Flusher *_flusher = nullptr;
+    mutable std::mutex _historyMutex;
+
+    bool _started = false;
+
+    int module(DebugLogSite &site);
+    int find_module(const char *name, size_t len);
+    bool allow(int mod, DebugLogLevel level, uint64_t now_us);
+    Record *claim(uint32_t &pos);
+    void capture(Record &rec, const char *fmt, va_list args);
+    void format(const Record &rec, std::string &out, bool color) const;
+    void write(uint64_t time_us, int mod, DebugLogLevel level, const std::string &text, const std::string &plain);
+    void report_losses();
+};
+
+extern DebugLog debugLog;
+
+#endif /* DEBUG_ASYNC */
+
+#endif /* DEBUGLOG_H */
@@ -0,0 +1,60 @@
+#include "record_utils.h"
+
+#include <algorithm>
+#include <cstdio>
+
+void record_put_le(std::string &b, uint64_t v, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        b += (char)(v & 0xFF);
+        v >>= 8;
+    }
+}
+
+void record_put_str(std::string &b, const std::string &s)
+{
+    size_t n = std::min<size_t>(s.size(), 0xFFFF);
+    record_put_le(b, n, 2);
+    b.append(s, 0, n);
+}
+
+uint64_t RecordReader::le(int n)
+{
+    if (!_ok || _p + n > _s.size())
+    {
+        _ok = false;
+        return 0;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++)
+        v |= (uint64_t)(uint8_t)_s[_p + i] << (8 * i);
+    _p += n;
+    return v;
+}
+
+std::string RecordReader::str()
+{
+    size_t n = le(2);
+    if (!_ok || _p + n > _s.size())
+    {
+        _ok = false;
+        return "";
+    }
+    std::string v = _s.substr(_p, n);
+    _p += n;
+    return v;
+}
+
+std::string record_file_name(const std::string &key, const char *ext)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : key)
+    {
+        h ^= (uint8_t)c;
+        h *= 0x100000001b3ULL;
+    }
+    char name[16];
+    snprintf(name, sizeof(name), "%08X.%.3s", (unsigned)(h ^ (h >> 32)), ext);
+    return name;
+}
@@ -0,0 +1,41 @@
+#ifndef _FN_RECORD_UTILS_H
+#define _FN_RECORD_UTILS_H
+
+#include <cstdint>
+#include <string>
+
+/*
+ * Fields of the small binary records FujiNet keeps on the SD card (directory
+ * listings, mail indexes): little-endian integers, and strings after a 2-byte
+ * length.
+ */
+
+void record_put_le(std::string &b, uint64_t v, int n);
+// Strings over 64K are cut short
+void record_put_str(std::string &b, const std::string &s);
+
+// Reads the fields back in order. Past the end it returns 0 or "", and ok()
+// stays false from then on.
+class RecordReader
+{
+public:
+    RecordReader(const std::string &s, size_t start = 0) : _s(s), _p(start) {}
+
+    bool ok() const { return _ok; }
+    size_t pos() const { return _p; }
+
+    uint64_t le(int n);
+    std::string str();
+
+private:
+    const std::string &_s;
+    size_t _p;
+    bool _ok = true;
+};
+
+// File name for a record stored under key: FNV-1a of the key in 8 hex digits,
+// then ext. Short, stable, and 8.3-friendly; two keys can share a name, so
+// the record holds its key and a reader checks it.
+std::string record_file_name(const std::string &key, const char *ext);
+
+#endif // _FN_RECORD_UTILS_H
@@ -104,6 +104,10 @@ void main_shutdown_handler()
     // Give devices an opportunity to clean up before rebooting
 
     SYSTEM_BUS.shutdown();
+
+#ifdef DEBUG_ASYNC
+    debugLog.flush();
+#endif
 }
 
 // Initial setup
@@ -173,6 +177,11 @@ void main_setup(int argc, char *argv[])
     Debug_printf("FujiNet %s Started @ %lu\n", fnSystem.get_fujinet_version(), startms);
 #endif
 
+#ifdef DEBUG_ASYNC
+    // Messages logged so far are queued, the debug port is ready for them now
+    debugLog.start();
+#endif
+
     // Install shutdown handler
 #ifdef ESP_PLATFORM
     esp_register_shutdown_handler(main_shutdown_handler);
@@ -0,0 +1,160 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "utils/DebugLog.h"
+
+// Every check goes through the history, since that's what GET /api/v1/log
+// serves. The flusher writes the same lines to stdout.
+
+static std::string last_line(DebugLog &log)
+{
+    log.flush();
+    auto lines = log.history();
+    return lines.empty() ? std::string() : lines.back().text;
+}
+
+TEST_CASE("Captured arguments format like snprintf")
+{
+    static DebugLog log;
+    static DebugLogSite site(__FILE__, __FUNCTION__, __LINE__);
+    char expect[256];
+
+#define CHECK_FORMAT(fmt, ...) do { \
+        log.printf(site, DebugLogLevel::Debug, false, fmt "\n", __VA_ARGS__); \
+        snprintf(expect, sizeof(expect), fmt, __VA_ARGS__); \
+        CHECK(last_line(log) == expect); \
+    } while (0)
+
+    CHECK_FORMAT("%d %i %u", -42, 7, 3000000000u);
+    CHECK_FORMAT("%hhu %hd %ld %lld", (unsigned char) 200, (short) -5, -123456789L, -1234567890123LL);
+    CHECK_FORMAT("%zu %lu %llx %08X", (size_t) 12345, 99UL, 0xDEADBEEFCAFEULL, 0xABCDu);
+    CHECK_FORMAT("%-6d| %+d %#x %o", 12, 5, 255, 8);
+    CHECK_FORMAT("%*d|%-*d|%.*f", 6, 1, 4, 2, 2, 3.14159);
+    CHECK_FORMAT("%.3f %e %g %10.2f", 1.5, 12345.678, 0.0001, -2.25);
+    CHECK_FORMAT("%c%c %s|%10s|%-4s|%.2s", 'o', 'k', "str", "right", "l", "cut");
+    CHECK_FORMAT("100%% %s", "done");
+    CHECK_FORMAT("%p", (void *) 0x1234);
+
+#undef CHECK_FORMAT
+}
+
+TEST_CASE("Arguments that don't fit are cut, not overrun")
+{
+    static DebugLog log;
+    static DebugLogSite site(__FILE__, __FUNCTION__, __LINE__);
+
+    std::string big(500, 'x');
+    log.printf(site, DebugLogLevel::Debug, false, "%s|%d\n", big.c_str(), 5);
+    std::string line = last_line(log);
+    CHECK(line.size() < 120);
+    CHECK(line.find("...") != std::string::npos);
+
+    // Long strings through Debug_print are split over records instead
+    log.print(site, DebugLogLevel::Debug, true, big);
+    CHECK(last_line(log) == big);
+}
+
+TEST_CASE("Debug_printv prefix and print overloads")
+{
+    static DebugLog log;
+    static DebugLogSite site("lib/device/sio/disk.cpp", "status", 42);
+
+    log.printf(site, DebugLogLevel::Verbose, true, "drive %d", 1);
+    CHECK(last_line(log) == "[lib/device/sio/disk.cpp:42] status(): drive 1");
+    CHECK(log.history().back().module == "disk");
+
+    log.print(site, DebugLogLevel::Debug, false, 255, 16);
+    log.print(site, DebugLogLevel::Debug, false, " ");
+    log.print(site, DebugLogLevel::Debug, true, -3);
+    CHECK(last_line(log) == "FF -3");
+}
+
+TEST_CASE("Module levels filter and the rate limit suppresses")
+{
+    static DebugLog log;
+    static DebugLogSite tnfs("lib/TNFSlib/tnfslib.cpp", "tnfs_read", 1);
+    static DebugLogSite sio("lib/bus/sio/sio.cpp", "service", 1);
+
+    log.set_level("tnfslib", DebugLogLevel::Warn);
+    log.printf(tnfs, DebugLogLevel::Debug, false, "hidden\n");
+    log.printf(sio, DebugLogLevel::Debug, false, "shown\n");
+    CHECK(last_line(log) == "shown");
+
+    log.set_level("*", DebugLogLevel::Verbose);
+    log.printf(tnfs, DebugLogLevel::Debug, false, "back\n");
+    CHECK(last_line(log) == "back");
+
+    // A burst well over DEBUG_LOG_BURST: the excess is counted, not queued
+    for (int i = 0; i < DEBUG_LOG_BURST * 2; i++)
+        log.printf(sio, DebugLogLevel::Debug, false, "spam %d\n", i);
+    log.flush();
+
+    uint32_t suppressed = 0;
+    for (const auto &m : log.modules())
+        if (m.name == "sio")
+            suppressed = m.suppressed;
+    CHECK(suppressed >= DEBUG_LOG_BURST - 2);
+    CHECK(last_line(log).find("messages suppressed") != std::string::npos);
+}
+
+TEST_CASE("A full ring drops and reports instead of blocking")
+{
+    static DebugLog log;
+
+    // Spread over modules so the rate limit doesn't get there first
+    const int modules = DEBUG_LOG_RECORDS * 2 / (DEBUG_LOG_BURST / 2);
+    static std::vector<std::string> files;
+    static std::deque<DebugLogSite> sites;
+    files.reserve(modules);
+    for (int i = 0; i < modules; i++)
+    {
+        files.push_back("mod" + std::to_string(i) + ".cpp");
+        sites.emplace_back(files.back().c_str(), __FUNCTION__, __LINE__);
+    }
+
+    for (auto &site : sites)
+        for (int i = 0; i < DEBUG_LOG_BURST / 2; i++)
+            log.printf(site, DebugLogLevel::Debug, false, "%d\n", i);
+    CHECK(log.dropped() == DEBUG_LOG_RECORDS);
+
+    CHECK(last_line(log).find("messages dropped") != std::string::npos);
+    log.printf(sites[0], DebugLogLevel::Debug, false, "room again\n");
+    CHECK(last_line(log) == "room again");
+}
+
+// Timing only: what a hot path pays per message once it's queued, next to
+// formatting it in place and to the time the line takes to go out of a
+// 115200 baud debug UART, which is what a synchronous Debug_printf waits for
+// on the ESP32. There is no pass/fail threshold.
+TEST_CASE("Benchmark: queued vs synchronous message" * doctest::skip())
+{
+    static DebugLog log;
+    static DebugLogSite site(__FILE__, __FUNCTION__, __LINE__);
+    const int messages = DEBUG_LOG_BURST / 2;
+    char line[128];
+    int len = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; i++)
+        len = snprintf(line, sizeof(line), "tnfs_read sector %d len %u from %s\r\n", i, 256u, "server");
+    std::chrono::duration<double, std::micro> formatted = std::chrono::steady_clock::now() - start;
+
+    // The first message from a site looks its module up
+    log.printf(site, DebugLogLevel::Debug, false, "warm up\r\n");
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < messages; i++)
+        log.printf(site, DebugLogLevel::Debug, false, "tnfs_read sector %d len %u from %s\r\n", i, 256u, "server");
+    std::chrono::duration<double, std::micro> queued = std::chrono::steady_clock::now() - start;
+    log.flush();
+
+    MESSAGE("per message: queued " << queued.count() / messages << " us, snprintf "
+                                   << formatted.count() / messages << " us, 115200 baud UART "
+                                   << len * 10 * 1e6 / 115200 << " us");
+}
@@ -0,0 +1,309 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <strings.h>
+#include <thread>
+
+#include "FileSystem/fnDirCache.h"
+
+// Stand-in for the one lib/utils helper DirCache uses: '*' and '?' only,
+// ignoring case like the real one.
+bool util_wildcard_match(const char *str, const char *pattern)
+{
+    if (*pattern == '\0')
+        return *str == '\0';
+    if (*pattern == '*')
+        return util_wildcard_match(str, pattern + 1) || (*str && util_wildcard_match(str + 1, pattern));
+    if (*str == '\0')
+        return false;
+    if (*pattern != '?' && tolower(*pattern) != tolower(*str))
+        return false;
+    return util_wildcard_match(str + 1, pattern + 1);
+}
+
+static fsdir_entry make_entry(const char *name, bool dir = false, uint32_t size = 0)
+{
+    fsdir_entry e = {};
+    snprintf(e.filename, sizeof(e.filename), "%s", name);
+    e.isDir = dir;
+    e.size = size;
+    return e;
+}
+
+// A server sending `count` entries in reverse name order, `batch` at a time
+// with `delay` between batches, the way a LIST arrives over the network.
+static DirCache::producer_t slow_server(int count, int batch, std::chrono::microseconds delay,
+                                        std::atomic<bool> *stopped = nullptr)
+{
+    return [=](DirCache &cache) {
+        char name[32];
+        for (int i = count - 1; i >= 0; i--)
+        {
+            snprintf(name, sizeof(name), "FILE%05d.ATR", i);
+            if (!cache.add(make_entry(name, false, i)))
+            {
+                if (stopped)
+                    *stopped = true;
+                return false;
+            }
+            if (i % batch == 0)
+                std::this_thread::sleep_for(delay);
+        }
+        return true;
+    };
+}
+
+TEST_CASE("Filled listings are filtered and sorted, directories first")
+{
+    DirCache cache;
+    const char *names[] = {"zork.atr", "GAMES", "adventure.xex", "Basic.atr", "UTILS"};
+    for (const char *n : names)
+        cache.new_entry() = make_entry(n, n[0] >= 'A' && n[0] <= 'Z' && strchr(n, '.') == nullptr);
+
+    cache.apply_filter(nullptr, 0);
+    CHECK_FALSE(cache.partial());
+    CHECK(std::string(cache.read()->filename) == "GAMES");
+    CHECK(std::string(cache.read()->filename) == "UTILS");
+    CHECK(std::string(cache.read()->filename) == "adventure.xex");
+    CHECK(cache.tell() == 3);
+
+    cache.apply_filter("*.atr", 0);
+    CHECK(std::string(cache.read()->filename) == "GAMES"); // directories pass a file pattern
+    CHECK(cache.seek(3));
+    CHECK(std::string(cache.read()->filename) == "zork.atr");
+    CHECK(cache.read() == nullptr);
+    CHECK_FALSE(cache.seek(5));
+
+    cache.clear();
+    CHECK(cache.empty());
+    CHECK(cache.tell() == FNFS_INVALID_DIRPOS);
+}
+
+TEST_CASE("A short background listing still comes back sorted")
+{
+    DirCache cache;
+    cache.fill_async(slow_server(DIRCACHE_FIRST_PAGE / 2, 4, std::chrono::microseconds(200)));
+    cache.apply_filter(nullptr, 0);
+
+    CHECK(std::string(cache.read()->filename) == "FILE00000.ATR");
+    CHECK_FALSE(cache.partial());
+}
+
+TEST_CASE("A long background listing is served before it completes")
+{
+    const int count = 2000;
+    DirCache cache;
+    cache.fill_async(slow_server(count, 100, std::chrono::milliseconds(5)));
+    cache.apply_filter(nullptr, 0);
+
+    // First page in server order, while the rest is still arriving
+    fsdir_entry *first = cache.read();
+    REQUIRE(first != nullptr);
+    CHECK(std::string(first->filename) == "FILE01999.ATR");
+    CHECK(cache.partial());
+
+    // Reading on waits for entries rather than ending early
+    std::set<std::string> seen = {first->filename};
+    while (fsdir_entry *e = cache.read())
+        seen.insert(e->filename);
+    CHECK(seen.size() == count);
+
+    // Back at the start, the complete listing is sorted
+    CHECK(cache.partial());
+    CHECK(cache.seek(0));
+    CHECK_FALSE(cache.partial());
+    CHECK(std::string(cache.read()->filename) == "FILE00000.ATR");
+
+    // A new filter over the finished listing sorts straight away
+    cache.apply_filter("FILE000*", 0);
+    CHECK(std::string(cache.read()->filename) == "FILE00000.ATR");
+    CHECK(cache.seek(100));
+    CHECK(cache.read() == nullptr);
+}
+
+TEST_CASE("Clearing stops a listing in progress")
+{
+    std::atomic<bool> stopped(false);
+    DirCache cache;
+    cache.fill_async(slow_server(100000, 10, std::chrono::milliseconds(1), &stopped));
+    cache.apply_filter(nullptr, DIR_OPTION_UNSORTED);
+    CHECK(cache.read() != nullptr);
+
+    cache.clear();
+    CHECK(stopped);
+    CHECK(cache.empty());
+    CHECK(cache.read() == nullptr);
+}
+
+TEST_CASE("A listing cut short is served, but marked as failed")
+{
+    DirCache cache;
+    cache.fill_async([](DirCache &c) {
+        c.add(make_entry("B.ATR"));
+        c.add(make_entry("A.ATR"));
+        return false; // say, the data connection timed out
+    });
+    cache.apply_filter(nullptr, 0);
+
+    CHECK(std::string(cache.read()->filename) == "A.ATR");
+    CHECK(cache.failed());
+    CHECK_FALSE(cache.partial());
+
+    cache.clear();
+    CHECK_FALSE(cache.failed());
+}
+
+TEST_CASE("Serialized listings come back the same")
+{
+    DirCache cache;
+    cache.new_entry() = make_entry("GAMES", true);
+    cache.new_entry() = make_entry("zork.atr", false, 92176);
+    cache.new_entry() = make_entry("adventure.xex", false, 8192);
+
+    std::string blob("HEAD");
+    cache.serialize(blob);
+
+    DirCache copy;
+    REQUIRE(copy.deserialize(blob, 4));
+    copy.apply_filter(nullptr, DIR_OPTION_UNSORTED);
+    fsdir_entry *e = copy.read();
+    CHECK(std::string(e->filename) == "GAMES");
+    CHECK(e->isDir);
+    e = copy.read();
+    CHECK(std::string(e->filename) == "zork.atr");
+    CHECK(e->size == 92176);
+    CHECK(std::string(copy.read()->filename) == "adventure.xex");
+    CHECK(copy.read() == nullptr);
+
+    // A damaged blob leaves nothing behind
+    CHECK_FALSE(copy.deserialize(blob.substr(0, blob.size() - 3), 4));
+    CHECK(copy.empty());
+}
+
+TEST_CASE("A refresh serves the old listing until the new one is complete")
+{
+    DirCache cache;
+    cache.new_entry() = make_entry("OLD.ATR");
+    cache.fill_async(slow_server(500, 50, std::chrono::milliseconds(2)), true);
+    cache.apply_filter(nullptr, 0);
+
+    // No waiting for the server; the old listing is what there is
+    CHECK(std::string(cache.read()->filename) == "OLD.ATR");
+    CHECK(cache.read() == nullptr);
+    CHECK(cache.partial());
+
+    // Wait for the refresh; the new listing shows up at position 0
+    while (cache.partial())
+    {
+        cache.seek(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CHECK(std::string(cache.read()->filename) == "FILE00000.ATR");
+}
+
+TEST_CASE("A refresh that fails keeps the old listing")
+{
+    DirCache cache;
+    cache.new_entry() = make_entry("OLD.ATR");
+    cache.fill_async([](DirCache &c) {
+        c.add(make_entry("HALF.ATR"));
+        return false;
+    }, true);
+    cache.apply_filter(nullptr, 0);
+
+    while (cache.partial())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    CHECK(cache.seek(0));
+    CHECK(std::string(cache.read()->filename) == "OLD.ATR");
+    CHECK(cache.read() == nullptr);
+    CHECK(cache.failed()); // stale: not to be reused as is
+}
+
+TEST_CASE("A refresh that times out at the end keeps the old listing")
+{
+    DirCache cache;
+    cache.new_entry() = make_entry("OLD.ATR");
+    auto server = slow_server(500, 50, std::chrono::microseconds(200));
+    cache.fill_async([server](DirCache &c) {
+        server(c);
+        return false; // every entry arrived, but no 226
+    }, true);
+    cache.apply_filter(nullptr, 0);
+
+    while (cache.partial())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::string blob;
+    cache.serialize(blob);
+    CHECK(blob.size() < 64); // just OLD.ATR
+
+    CHECK(cache.seek(0));
+    CHECK(std::string(cache.read()->filename) == "OLD.ATR");
+    CHECK(cache.read() == nullptr);
+}
+
+// Timing only: a 10,000 entry directory arriving at ~100 entries per ms.
+// Before, dir_open() returned once every entry was in; now the first page
+// is ready after DIRCACHE_FIRST_PAGE entries. No threshold.
+TEST_CASE("Benchmark: time to first page, 10,000 entries" * doctest::skip())
+{
+    using clock = std::chrono::steady_clock;
+    const int count = 10000, page = 16;
+
+    auto start = clock::now();
+    DirCache cache;
+    cache.fill_async(slow_server(count, 100, std::chrono::milliseconds(1)));
+    cache.apply_filter(nullptr, 0);
+    for (int i = 0; i < page; i++)
+        REQUIRE(cache.read() != nullptr);
+    std::chrono::duration<double, std::milli> first_page = clock::now() - start;
+
+    while (cache.partial())
+    {
+        cache.seek(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::chrono::duration<double, std::milli> complete = clock::now() - start;
+
+    CHECK(std::string(cache.read()->filename) == "FILE00000.ATR");
+    MESSAGE("first page " << first_page.count() << " ms, complete and sorted "
+                          << complete.count() << " ms");
+}
+
+// Timing only: opening a 10,000 entry directory again, listed from the
+// server vs loaded from a stored listing. No threshold.
+TEST_CASE("Benchmark: listing again vs stored listing, 10,000 entries" * doctest::skip())
+{
+    using clock = std::chrono::steady_clock;
+    const int count = 10000;
+
+    auto start = clock::now();
+    DirCache listed;
+    listed.fill_async(slow_server(count, 100, std::chrono::milliseconds(1)));
+    listed.apply_filter(nullptr, 0);
+    while (listed.partial())
+    {
+        listed.seek(0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::chrono::duration<double, std::milli> from_server = clock::now() - start;
+
+    std::string blob;
+    listed.serialize(blob);
+
+    start = clock::now();
+    DirCache stored;
+    REQUIRE(stored.deserialize(blob));
+    stored.apply_filter(nullptr, 0);
+    REQUIRE(stored.read() != nullptr);
+    std::chrono::duration<double, std::milli> from_store = clock::now() - start;
+
+    CHECK(std::string(listed.read()->filename) == "FILE00000.ATR");
+    MESSAGE("listed " << from_server.count() << " ms, stored " << from_store.count()
+                      << " ms (" << blob.size() / 1024 << "K)");
+}
@@ -3,6 +3,9 @@
 
 #include "bus/rs232/FujiBusPacket.h"
 
+#include <chrono>
+#include <random>
+
 static ByteBuffer corrupt_one_byte(ByteBuffer buf)
 {
     if (buf.size() > 5)
@@ -276,3 +279,232 @@ TEST_CASE("invalid: missing leading SLIP_END and no other SLIP_END")
     auto parsed = FujiBusPacket::fromSerialized(serialized);
     CHECK(parsed == nullptr);
 }
+
+// --------------------------------------------------------------------------------
+// STREAMING PARSER
+// --------------------------------------------------------------------------------
+
+// Feeds `bytes` to the parser and collects every packet it completes
+static std::vector<FujiBusPacket> feed_all(FujiBusParser& parser, const ByteBuffer& bytes, int* errors = nullptr)
+{
+    std::vector<FujiBusPacket> packets;
+    for (std::uint8_t val : bytes)
+    {
+        auto result = parser.feed(val);
+        if (result == FujiBusParser::Result::PACKET)
+        {
+            packets.emplace_back();
+            packets.back().assign(parser);
+        }
+        else if (result == FujiBusParser::Result::ERROR && errors)
+            (*errors)++;
+    }
+    return packets;
+}
+
+static FujiBusPacket make_random_packet(std::mt19937& rng)
+{
+    auto dev = static_cast<fujiDeviceID_t>(rng() & 0xFF);
+    auto cmd = static_cast<fujiCommandID_t>(rng() & 0xFF);
+    FujiBusPacket pkt(dev, cmd);
+
+    // Build through the variadic constructor so params go through the
+    // same path as real callers
+    ByteBuffer payload(rng() % 600);
+    for (auto& b : payload)
+        b = (rng() % 4) ? rng() & 0xFF : SLIP_END; // plenty of specials
+
+    switch (rng() % 4)
+    {
+    case 0:
+        pkt = FujiBusPacket(dev, cmd, payload);
+        break;
+    case 1:
+        pkt = FujiBusPacket(dev, cmd, std::uint8_t(rng()), std::uint8_t(rng()), std::uint8_t(rng()),
+                            std::uint8_t(rng()), std::uint8_t(rng()), payload);
+        break;
+    case 2:
+        pkt = FujiBusPacket(dev, cmd, std::uint16_t(rng()), std::uint32_t(rng()), std::uint8_t(rng()));
+        break;
+    default:
+        pkt = FujiBusPacket(dev, cmd, std::uint32_t(rng()), std::uint16_t(rng()), std::uint16_t(rng()),
+                            std::uint16_t(rng()), payload);
+        break;
+    }
+    return pkt;
+}
+
+TEST_CASE("serialize into a reused buffer matches serialize()")
+{
+    FujiBusPacket pkt = make_reference_packet();
+    ByteBuffer out(1000, 0x55); // stale contents must not leak through
+    pkt.serialize(out);
+    CHECK(out == pkt.serialize());
+}
+
+TEST_CASE("parser: back-to-back frames sharing a SLIP_END")
+{
+    FujiBusPacket a = make_reference_packet();
+    FujiBusPacket b(static_cast<fujiDeviceID_t>(1), static_cast<fujiCommandID_t>(2), ByteBuffer{SLIP_END, SLIP_ESCAPE});
+
+    ByteBuffer stream = a.serialize();
+    ByteBuffer second = b.serialize();
+    stream.insert(stream.end(), second.begin() + 1, second.end()); // drop b's opening END
+
+    FujiBusParser parser;
+    auto packets = feed_all(parser, stream);
+    REQUIRE(packets.size() == 2);
+    check_packets_equal(packets[0], a);
+    check_packets_equal(packets[1], b);
+}
+
+TEST_CASE("parser: a bad frame doesn't stop the next one")
+{
+    FujiBusPacket ref = make_reference_packet();
+    ByteBuffer stream = corrupt_one_byte(ref.serialize());
+    ByteBuffer good = ref.serialize();
+    stream.insert(stream.end(), good.begin(), good.end());
+
+    FujiBusParser parser;
+    int errors = 0;
+    auto packets = feed_all(parser, stream, &errors);
+    CHECK(errors == 1);
+    REQUIRE(packets.size() == 1);
+    check_packets_equal(packets[0], ref);
+}
+
+TEST_CASE("parser: truncated frame then good frame")
+{
+    FujiBusPacket big(static_cast<fujiDeviceID_t>(1), static_cast<fujiCommandID_t>(2), ByteBuffer(40, 0x41));
+    FujiBusPacket ref = make_reference_packet();
+
+    // The truncated frame's closing END also opens the good one
+    ByteBuffer stream = big.serialize();
+    stream.resize(20);
+    stream.push_back(SLIP_END);
+    ByteBuffer good = ref.serialize();
+    stream.insert(stream.end(), good.begin() + 1, good.end());
+
+    FujiBusParser parser;
+    int errors = 0;
+    auto packets = feed_all(parser, stream, &errors);
+    CHECK(errors == 1);
+    REQUIRE(packets.size() == 1);
+    check_packets_equal(packets[0], ref);
+}
+
+TEST_CASE("parser: frame longer than its header says is rejected")
+{
+    ByteBuffer serialized = make_reference_packet().serialize();
+    serialized.insert(serialized.end() - 1, 0x00);
+
+    FujiBusParser parser;
+    int errors = 0;
+    CHECK(feed_all(parser, serialized, &errors).empty());
+    CHECK(errors == 1);
+}
+
+TEST_CASE("fuzz: random packets roundtrip through a noisy stream")
+{
+    std::mt19937 rng(1234);
+    std::vector<FujiBusPacket> sent;
+    ByteBuffer stream;
+
+    for (int i = 0; i < 500; i++)
+    {
+        // noise between frames never contains SLIP_END
+        for (unsigned n = rng() % 4; n > 0; n--)
+            stream.push_back((rng() % 0xBF) + 1);
+
+        sent.push_back(make_random_packet(rng));
+        ByteBuffer bytes = sent.back().serialize();
+        stream.insert(stream.end(), bytes.begin(), bytes.end());
+    }
+
+    // noise right after a frame's closing END reads as a bad frame of its
+    // own, so errors are expected here; every real frame must still arrive
+    FujiBusParser parser;
+    auto received = feed_all(parser, stream);
+    REQUIRE(received.size() == sent.size());
+    for (std::size_t i = 0; i < sent.size(); i++)
+    {
+        CAPTURE(i);
+        check_packets_equal(received[i], sent[i]);
+        CHECK(received[i].serialize() == sent[i].serialize());
+    }
+}
+
+TEST_CASE("fuzz: corrupted frames never crash or pass as something else")
+{
+    std::mt19937 rng(5678);
+
+    for (int i = 0; i < 2000; i++)
+    {
+        FujiBusPacket pkt = make_random_packet(rng);
+        ByteBuffer bytes = pkt.serialize();
+
+        // flip, drop or insert a few bytes anywhere in the frame
+        for (unsigned n = 1 + rng() % 3; n > 0; n--)
+        {
+            std::size_t pos = rng() % bytes.size();
+            switch (rng() % 3)
+            {
+            case 0: bytes[pos] ^= 1 << (rng() % 8); break;
+            case 1: bytes.erase(bytes.begin() + pos); break;
+            default: bytes.insert(bytes.begin() + pos, rng() & 0xFF); break;
+            }
+            if (bytes.empty())
+                break;
+        }
+
+        FujiBusParser parser;
+        for (auto& got : feed_all(parser, bytes))
+        {
+            // anything that does parse must be self-consistent
+            auto again = FujiBusPacket::fromSerialized(got.serialize());
+            REQUIRE(again);
+            check_packets_equal(*again, got);
+        }
+    }
+}
+
+// Timing only: sector-sized frames through the reused parser/buffer path
+// and through fromSerialized()/serialize(). There is no pass/fail threshold.
+TEST_CASE("Benchmark: parse and serialize throughput" * doctest::skip())
+{
+    ByteBuffer sector(512);
+    for (std::size_t i = 0; i < sector.size(); i++)
+        sector[i] = i & 0xFF;
+    FujiBusPacket pkt(static_cast<fujiDeviceID_t>(0x31), static_cast<fujiCommandID_t>(0x57),
+                      std::uint32_t{1234}, sector);
+    const ByteBuffer wire = pkt.serialize();
+    const int rounds = 20000;
+
+    auto start = std::chrono::steady_clock::now();
+    std::size_t check = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        auto parsed = FujiBusPacket::fromSerialized(wire);
+        check += parsed->serialize().size();
+    }
+    std::chrono::duration<double> copying = std::chrono::steady_clock::now() - start;
+
+    FujiBusParser parser;
+    FujiBusPacket reused;
+    ByteBuffer out;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        for (std::uint8_t val : wire)
+            if (parser.feed(val) == FujiBusParser::Result::PACKET)
+                reused.assign(parser);
+        reused.serialize(out);
+        check -= out.size();
+    }
+    std::chrono::duration<double> streaming = std::chrono::steady_clock::now() - start;
+
+    double mb = double(wire.size()) * 2 * rounds / (1024 * 1024);
+    MESSAGE("fromSerialized/serialize: " << mb / copying.count() << " MB/s, parser/serialize(out): "
+            << mb / streaming.count() << " MB/s");
+    CHECK(check == 0);
+}
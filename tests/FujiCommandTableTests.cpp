@@ -0,0 +1,181 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+
+#include "device/fujiDevice/FujiCommandTable.h"
+
+// Stand-ins for the bus packet and the fujiDevice mixins, so the table can
+// be tested without a bus.
+struct Packet
+{
+    uint8_t cmd;
+    uint8_t command() const { return cmd; }
+};
+
+struct Counter
+{
+    int calls = 0;
+    uint8_t last = 0;
+    void hit(const Packet &packet) { calls++; last = packet.command(); }
+};
+
+class AlphaMixin : virtual public Counter
+{
+protected:
+    void a1(const Packet &packet) { hit(packet); }
+    void a2(const Packet &packet) { hit(packet); }
+
+public:
+    static constexpr auto commands() {
+        return std::to_array<FujiCommand<AlphaMixin, Packet>>({
+            { 0x10, &AlphaMixin::a1 },
+            { 0x11, &AlphaMixin::a2 },
+            { 0x12, &AlphaMixin::a2 },
+        });
+    }
+};
+
+class BetaMixin : virtual public Counter
+{
+protected:
+    virtual void b1(const Packet &packet) { hit(packet); }
+
+public:
+    static constexpr auto commands() {
+        return std::to_array<FujiCommand<BetaMixin, Packet>>({
+            { 0xF0, &BetaMixin::b1 },
+        });
+    }
+};
+
+class ClashMixin
+{
+protected:
+    void c1(const Packet &) {}
+
+public:
+    static constexpr auto commands() {
+        return std::to_array<FujiCommand<ClashMixin, Packet>>({
+            { 0x11, &ClashMixin::c1 },
+        });
+    }
+};
+
+class Device : public AlphaMixin, public BetaMixin
+{
+public:
+    bool dispatch(const Packet &packet)
+    {
+        static constexpr auto table = makeFujiCommandTable<Device, Packet, AlphaMixin, BetaMixin>();
+        auto handler = table[packet.command()];
+        if (handler == nullptr)
+            return false;
+        handler(*this, packet);
+        return true;
+    }
+
+    int b1_overrides = 0;
+
+protected:
+    // Handlers are called through the mixin, so overrides still apply
+    void b1(const Packet &packet) override { b1_overrides++; BetaMixin::b1(packet); }
+};
+
+class ClashingDevice : public AlphaMixin, public ClashMixin {};
+
+TEST_CASE("Commands reach the mixin that lists them")
+{
+    Device device;
+    CHECK(device.dispatch({0x10}));
+    CHECK(device.dispatch({0x12}));
+    CHECK(device.last == 0x12);
+    CHECK(device.dispatch({0xF0}));
+    CHECK(device.b1_overrides == 1);
+    CHECK_FALSE(device.dispatch({0x13}));
+    CHECK(device.calls == 3);
+}
+
+TEST_CASE("The table is built at compile time and flags duplicates")
+{
+    constexpr auto good = makeFujiCommandTable<Device, Packet, AlphaMixin, BetaMixin>();
+    static_assert(!good.duplicate);
+    static_assert(good[0x10] != nullptr && good[0x00] == nullptr);
+
+    constexpr auto clash = makeFujiCommandTable<ClashingDevice, Packet, AlphaMixin, ClashMixin>();
+    static_assert(clash.duplicate);
+    CHECK(clash.duplicate);
+}
+
+// What dispatch used to do: each mixin returned its handler map by value
+// and the chain tried them in turn.
+class MapMixin
+{
+public:
+    using Handlers = std::unordered_map<uint8_t, void (MapMixin::*)(const Packet &)>;
+
+    explicit MapMixin(uint8_t base)
+    {
+        for (uint8_t i = 0; i < 6; i++)
+            handlers[base + i] = &MapMixin::handle;
+    }
+    virtual ~MapMixin() = default;
+
+    bool processCommand(const Packet &packet)
+    {
+        auto copy = commandHandlers();
+        auto it = copy.find(packet.command());
+        if (it == copy.end())
+            return false;
+        (this->*it->second)(packet);
+        return true;
+    }
+
+    int calls = 0;
+
+protected:
+    virtual Handlers commandHandlers() { return handlers; }
+    void handle(const Packet &) { calls++; }
+
+private:
+    Handlers handlers;
+};
+
+// Timing only: the last mixin's command, and one nobody handles, through
+// the old per-mixin maps and through the table. No pass/fail threshold.
+TEST_CASE("Benchmark: map copies vs compile-time table" * doctest::skip())
+{
+    const int rounds = 20000;
+    const Packet last{0xF0}, unknown{0x99};
+
+    MapMixin maps[4] = {MapMixin(0x10), MapMixin(0x20), MapMixin(0x30), MapMixin(0xF0)};
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        for (const Packet &p : {last, unknown})
+        {
+            bool handled = false;
+            for (auto &m : maps)
+                if ((handled = m.processCommand(p)))
+                    break;
+            (void) handled;
+        }
+    }
+    std::chrono::duration<double, std::nano> before = std::chrono::steady_clock::now() - start;
+
+    Device device;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        device.dispatch(last);
+        device.dispatch(unknown);
+    }
+    std::chrono::duration<double, std::nano> after = std::chrono::steady_clock::now() - start;
+
+    CHECK(maps[3].calls == rounds);
+    CHECK(device.b1_overrides == rounds);
+    MESSAGE("per command: maps " << before.count() / (rounds * 2) << " ns, table "
+                                 << after.count() / (rounds * 2) << " ns");
+}
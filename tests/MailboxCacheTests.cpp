@@ -0,0 +1,137 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <string>
+
+#include "network-protocol/MailboxCache.h"
+
+static void fill(MailboxCache &cache, uint32_t count)
+{
+    for (uint32_t seq = 1; seq <= count; seq++)
+    {
+        MailboxCache::Message &m = cache.place(std::to_string(1000 + seq), seq);
+        m.hasEntry = true;
+        m.entry.subject = "Subject of message " + std::to_string(seq);
+        m.entry.displayName = "Sender " + std::to_string(seq % 17);
+        m.entry.emailAddress = "sender" + std::to_string(seq % 17) + "@example.com";
+        m.entry.timestamp = 1700000000ULL + seq * 60;
+        m.entry.important = seq % 5 == 0;
+    }
+}
+
+TEST_CASE("Entries survive a save and load")
+{
+    MailboxCache cache;
+    cache.validate("42");
+    cache.set_state("1200:199");
+    fill(cache, 199);
+    MailboxCache::Message &m = cache.place("1010", 10);
+    m.hasAttachments = true;
+    m.attachments.push_back({0, "body", "", "text/plain", 120});
+    m.attachments.push_back({1, "report.pdf", "report.pdf", "application/pdf", 123456});
+
+    std::string key = MailboxCache::key("imaps://me@host:993", "INBOX");
+    MailboxCache loaded;
+    REQUIRE(loaded.deserialize(cache.serialize(key), key));
+    CHECK(loaded.state() == "1200:199");
+    CHECK(loaded.size() == 199);
+
+    MailboxCache::Message *at = loaded.at(10);
+    REQUIRE(at != nullptr);
+    CHECK(at->key == "1010");
+    CHECK(at->entry.important);
+    CHECK(at->entry.subject == "Subject of message 10");
+    REQUIRE(at->attachments.size() == 2);
+    CHECK(at->attachments[1].fileName == "report.pdf");
+    CHECK(at->attachments[1].length == 123456);
+
+    CHECK_FALSE(loaded.deserialize("FNMC", key));
+    CHECK_FALSE(loaded.deserialize("garbage", key));
+    CHECK(loaded.size() == 0);
+
+    // A file saved for another folder, whose name hashed the same, is not used
+    CHECK_FALSE(loaded.deserialize(cache.serialize(key), MailboxCache::key("imaps://me@host:993", "Sent")));
+    CHECK(loaded.size() == 0);
+}
+
+TEST_CASE("Validity and positions")
+{
+    MailboxCache cache;
+    cache.validate("1");
+    fill(cache, 10);
+
+    // Positions go, entries stay
+    cache.forget_positions();
+    CHECK(cache.at(3) == nullptr);
+    REQUIRE(cache.find("1003") != nullptr);
+    CHECK(cache.find("1003")->hasEntry);
+
+    // A message taking another's position displaces it
+    cache.place("1003", 4);
+    cache.place("1004", 4);
+    CHECK(cache.at(4)->key == "1004");
+    CHECK(cache.find("1003")->seq == 0);
+
+    cache.validate("2");
+    CHECK(cache.size() == 0);
+    CHECK(cache.state().empty());
+}
+
+TEST_CASE("Trim keeps the most recently used")
+{
+    MailboxCache cache;
+    fill(cache, 50);
+    for (uint32_t seq = 1; seq <= 5; seq++)
+        cache.at(seq);
+    cache.trim(10);
+    CHECK(cache.size() == 10);
+    CHECK(cache.at(1) != nullptr);
+    CHECK(cache.at(50) != nullptr);
+    CHECK(cache.at(20) == nullptr);
+}
+
+TEST_CASE("File names are stable and short")
+{
+    std::string a = MailboxCache::file_name("imaps://me@host:993", "INBOX");
+    CHECK(a == MailboxCache::file_name("imaps://me@host:993", "INBOX"));
+    CHECK(a != MailboxCache::file_name("imaps://me@host:993", "Sent"));
+    CHECK(a.size() == 12);
+}
+
+// Timing only: a 20-message page served from the cache in memory, and with
+// the cache read back from its file first (the first open of a folder). On
+// a cache miss each page costs a FETCH round trip, or one HTTP request per
+// message for Gmail. No pass/fail threshold.
+TEST_CASE("Benchmark: index page flips from the cache" * doctest::skip())
+{
+    MailboxCache cache;
+    fill(cache, 1000);
+    std::string key = MailboxCache::key("imaps://me@host:993", "INBOX");
+    std::string file = cache.serialize(key);
+    const int flips = 200;
+    using clock = std::chrono::steady_clock;
+
+    size_t served = 0;
+    auto start = clock::now();
+    for (int f = 0; f < flips; f++)
+    {
+        uint32_t top = 1000 - (f % 50) * 20;
+        for (uint32_t seq = top; seq > top - 20; seq--)
+            if (MailboxCache::Message *m = cache.at(seq))
+                served += m->hasEntry;
+    }
+    std::chrono::duration<double, std::micro> memory = clock::now() - start;
+
+    start = clock::now();
+    for (int f = 0; f < 20; f++)
+    {
+        MailboxCache loaded;
+        loaded.deserialize(file, key);
+    }
+    std::chrono::duration<double, std::micro> load = clock::now() - start;
+
+    CHECK(served == flips * 20);
+    MESSAGE("page flip: " << memory.count() / flips << " us from memory, first open "
+                          << load.count() / 20 << " us to load " << file.size() << " bytes");
+}
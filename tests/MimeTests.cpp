@@ -0,0 +1,189 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <random>
+#include <string>
+
+#include "encoding/mime.h"
+
+// A mail part arrives in pieces of whatever size the partial FETCH returned;
+// the decoded result has to be the same however it was cut.
+
+static std::string random_text(size_t len, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(len, 0);
+    for (auto &c : s)
+        c = rng();
+    return s;
+}
+
+// base64 in 76-character CRLF lines, as mail carries it
+static std::string mail_base64(const std::string &data)
+{
+    size_t len;
+    auto p = Base64::encode(data.data(), data.size(), &len);
+    std::string flat;
+    for (size_t i = 0; i < len; i++)
+        if (p[i] != '\n')
+            flat += p[i];
+    std::string out;
+    for (size_t i = 0; i < flat.size(); i += 76)
+        out += flat.substr(i, 76) + "\r\n";
+    return out;
+}
+
+static std::string quoted_printable(const std::string &data)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    std::string out;
+    int col = 0;
+    for (unsigned char c : data)
+    {
+        if (col >= 72)
+        {
+            out += "=\r\n";
+            col = 0;
+        }
+        if (c >= 33 && c <= 126 && c != '=')
+        {
+            out += (char)c;
+            col++;
+        }
+        else
+        {
+            out += '=';
+            out += hex[c >> 4];
+            out += hex[c & 15];
+            col += 3;
+        }
+    }
+    return out;
+}
+
+static std::string decode_in_pieces(const std::string &encoding, const std::string &in, size_t piece)
+{
+    MimeDecoder decoder(encoding);
+    std::string out;
+    for (size_t i = 0; i < in.size(); i += piece)
+        decoder.update(in.data() + i, std::min(piece, in.size() - i), out);
+    decoder.update("", 0, out, true);
+    return out;
+}
+
+TEST_CASE("base64 and quoted-printable decode the same in any size pieces")
+{
+    std::string data = random_text(1000, 3);
+    std::string b64 = mail_base64(data);
+    std::string qp = quoted_printable(data);
+
+    for (size_t piece = 1; piece <= 100; piece++)
+    {
+        REQUIRE(decode_in_pieces("base64", b64, piece) == data);
+        REQUIRE(decode_in_pieces("Quoted-Printable", qp, piece) == data);
+        REQUIRE(decode_in_pieces("7bit", qp, piece) == qp);
+    }
+}
+
+TEST_CASE("Quoted-printable edge cases")
+{
+    CHECK(MimeDecoder::qp_decode("a=3Db=\r\nc=\nd") == "a=bcd");
+    CHECK(MimeDecoder::qp_decode("stray=") == "stray");
+    CHECK(MimeDecoder::qp_decode("=zz") == "zz");
+
+    // The held-back tail is decoded as a stray '=' at the end
+    MimeDecoder decoder("QUOTED-PRINTABLE");
+    std::string out;
+    decoder.update("end=4", 5, out);
+    CHECK(out == "end");
+    decoder.update("", 0, out, true);
+    CHECK(out == "end4");
+}
+
+TEST_CASE("Fetch sizes cover the decoded bytes asked for")
+{
+    std::string data = random_text(30000, 5);
+    std::string b64 = mail_base64(data);
+    MimeDecoder decoder("BASE64");
+
+    for (size_t want : {1, 100, 256, 4096})
+    {
+        size_t fetch = decoder.encoded_size(want);
+        // From any offset, one fetch decodes to at least what was asked for
+        for (size_t offset = 0; offset < 200; offset += 7)
+        {
+            MimeDecoder piece("BASE64");
+            std::string out;
+            piece.update(b64.data() + offset, fetch, out);
+            CHECK(out.size() + 3 >= want);
+        }
+    }
+    CHECK(MimeDecoder("binary").encoded_size(512) == 512);
+}
+
+// Stands in for the host translation: CRLF to the host's line ending
+static std::string crlf_to_lf(const std::string &s)
+{
+    std::string out;
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        if (s[i] == '\r' && i + 1 < s.size() && s[i + 1] == '\n')
+            continue;
+        out += s[i];
+    }
+    return out;
+}
+
+// Translate a body a piece at a time as a streamed read does, holding back
+// what text_holdback says between pieces
+static std::string translate_in_pieces(const std::string &body, size_t piece, bool utf8,
+                                       bool *whole_sequences = nullptr)
+{
+    std::string out, carry;
+    for (size_t pos = 0; pos < body.size(); pos += piece)
+    {
+        std::string text = carry + body.substr(pos, piece);
+        carry.clear();
+        if (pos + piece < body.size())
+        {
+            size_t hold = text_holdback(text, "\r\n", utf8);
+            carry = text.substr(text.size() - hold);
+            text.resize(text.size() - hold);
+        }
+        if (whole_sequences != nullptr && text_holdback(text, "", true) != 0)
+            *whole_sequences = false;
+        out += crlf_to_lf(text);
+    }
+    return out;
+}
+
+TEST_CASE("A body split at CR|LF translates as if whole")
+{
+    std::string body = "first line\r\nsecond line\r\n\r\nlast";
+    size_t cr = body.find('\r');
+
+    // Cut exactly between the CR and the LF
+    CHECK(translate_in_pieces(body, cr + 1, false) == crlf_to_lf(body));
+    for (size_t piece = 1; piece <= body.size(); piece++)
+        CHECK(translate_in_pieces(body, piece, false) == crlf_to_lf(body));
+
+    // A CR that ends the body is not held back
+    CHECK(text_holdback("end\r", "\r\n", false) == 1);
+    CHECK(translate_in_pieces("end\r", 2, false) == "end\r");
+}
+
+TEST_CASE("A split UTF-8 sequence is held back until it is complete")
+{
+    std::string body = "caf\xC3\xA9 \xE2\x82\xAC 5 \xF0\x9F\x98\x80!\r\n";
+    for (size_t piece = 1; piece <= body.size(); piece++)
+    {
+        bool whole = true;
+        CHECK(translate_in_pieces(body, piece, true, &whole) == crlf_to_lf(body));
+        CHECK(whole);
+    }
+
+    CHECK(text_holdback("caf\xC3", "", true) == 1);
+    CHECK(text_holdback("\xE2\x82", "", true) == 2);
+    CHECK(text_holdback("caf\xC3\xA9", "", true) == 0);
+    CHECK(text_holdback("caf\xC3", "", false) == 0);
+}
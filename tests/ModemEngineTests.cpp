@@ -0,0 +1,100 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <string>
+
+#include "atascii.h"
+#include "modem-engine/modem-engine.h"
+
+static size_t edit(const ModemCommandLine &line, std::string &cmd, const std::string &in,
+                   std::string *echo, int &eol)
+{
+    return line.edit(cmd, (const uint8_t *)in.data(), in.size(), echo, eol);
+}
+
+TEST_CASE("Ordinary input is appended and echoed in one piece")
+{
+    ModemCommandLine line(256);
+    std::string cmd, echo;
+    int eol;
+
+    CHECK(edit(line, cmd, "ATDT", &echo, eol) == 4);
+    CHECK(edit(line, cmd, "BBS", &echo, eol) == 3);
+    CHECK(eol == -1);
+    CHECK(cmd == "ATDTBBS");
+    CHECK(echo == "ATDTBBS");
+}
+
+TEST_CASE("A line end stops editing, the rest is left for the caller")
+{
+    ModemCommandLine line(256);
+    std::string cmd, echo;
+    int eol;
+
+    std::string in = "ATA\rhello";
+    CHECK(edit(line, cmd, in, &echo, eol) == 4);
+    CHECK(eol == ASCII_CR);
+    CHECK(cmd == "ATA");
+    CHECK(echo == "ATA");
+
+    cmd.clear();
+    in = std::string("ATZ") + (char)ATASCII_EOL;
+    CHECK(edit(line, cmd, in, nullptr, eol) == in.size());
+    CHECK(eol == ATASCII_EOL);
+    CHECK(cmd == "ATZ");
+}
+
+TEST_CASE("Backspace edits the command and echoes a rubout")
+{
+    ModemCommandLine line(256);
+    std::string cmd, echo;
+    int eol;
+
+    std::string in = std::string("ATX") + (char)ASCII_BACKSPACE + "Z" + (char)ATASCII_BACKSPACE;
+    edit(line, cmd, in, &echo, eol);
+    CHECK(cmd == "AT");
+    CHECK(echo == std::string("ATX\b \bZ") + (char)ATASCII_BACKSPACE);
+
+    // Nothing to delete: nothing echoed
+    cmd.clear();
+    echo.clear();
+    edit(line, cmd, std::string(1, (char)ASCII_DELETE), &echo, eol);
+    CHECK(cmd.empty());
+    CHECK(echo.empty());
+}
+
+TEST_CASE("Cursor keys are echoed but not kept")
+{
+    ModemCommandLine line(256);
+    std::string cmd, echo;
+    int eol;
+
+    std::string in = std::string("AT") + (char)ATASCII_CURSOR_LEFT + (char)ATASCII_CLEAR_SCREEN;
+    edit(line, cmd, in, &echo, eol);
+    CHECK(cmd == "AT");
+    CHECK(echo == in);
+}
+
+TEST_CASE("Without ATASCII, EOL and ATASCII backspace are ordinary characters")
+{
+    ModemCommandLine line(256, false);
+    std::string cmd;
+    int eol;
+
+    std::string in = std::string("AT") + (char)ATASCII_EOL + (char)ATASCII_BACKSPACE + "\n";
+    CHECK(edit(line, cmd, in, nullptr, eol) == in.size());
+    CHECK(eol == ASCII_LF);
+    CHECK(cmd == in.substr(0, 4));
+}
+
+TEST_CASE("Commands are kept to the maximum length, echo is not")
+{
+    ModemCommandLine line(4);
+    std::string cmd, echo;
+    int eol;
+
+    edit(line, cmd, "ATDT555", &echo, eol);
+    edit(line, cmd, "1234", &echo, eol);
+    CHECK(cmd == "ATDT");
+    CHECK(echo == "ATDT5551234");
+}
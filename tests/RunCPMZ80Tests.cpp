@@ -0,0 +1,189 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Just enough of a RunCPM host to run the Z80 core on its own: BIOS calls
+// stop the CPU, BDOS calls print characters (2) and '$' strings (9).
+#include "runcpm/globals.h"
+
+static uint8 ram[MEMSIZE];
+static std::string console;
+
+extern "C" void _Bios(void);
+extern "C" void _Bdos(void);
+extern "C" void _puts(const char *str) { console += str; }
+
+static void _HardwareOut(const uint32 Port, const uint32 Value) {}
+static uint32 _HardwareIn(const uint32 Port) { return 0; }
+
+#include "runcpm/cpu.h"
+
+extern "C" void _Bios(void)
+{
+    Status = 1;
+}
+
+extern "C" void _Bdos(void)
+{
+    switch (LOW_REGISTER(BC))
+    {
+    case 2:
+        console += (char)LOW_REGISTER(DE);
+        break;
+    case 9:
+        for (uint16 a = DE; RAM[a] != '$'; a++)
+            console += (char)RAM[a];
+        break;
+    }
+}
+
+// Load a program at 0x0100 with CP/M style entry points: 0x0000 stops the
+// CPU through the BIOS port, 0x0005 jumps to a BDOS stub at 0xFE00.
+static void load(const std::vector<uint8> &program)
+{
+    RAM = ram;
+    memset(ram, 0, sizeof(ram));
+    memcpy(ram + 0x100, program.data(), program.size());
+
+    const uint8 boot[] = {0xD3, 0xFF, 0x00, 0x00, 0x00, 0xC3, 0x00, 0xFE}; // OUT (FF),A / JP FE00
+    memcpy(ram, boot, sizeof(boot));
+    const uint8 bdos[] = {0xDB, 0xFF, 0xC9}; // IN A,(FF) / RET
+    memcpy(ram + 0xFE00, bdos, sizeof(bdos));
+
+    console.clear();
+    Z80reset();
+    AF = BC = DE = HL = IX = IY = 0;
+    PC = 0x100;
+    SP = 0xFE00;
+}
+
+static void run(const std::vector<uint8> &program)
+{
+    load(program);
+    Z80run();
+}
+
+TEST_CASE("ADD sets sign, half carry and overflow")
+{
+    // LD A,7F / ADD A,01 / OUT (FF),A
+    run({0x3E, 0x7F, 0xC6, 0x01, 0xD3, 0xFF});
+    CHECK(HIGH_REGISTER(AF) == 0x80);
+    CHECK(LOW_REGISTER(AF) == (FLAG_S | FLAG_H | FLAG_P));
+}
+
+TEST_CASE("DAA adjusts a BCD addition")
+{
+    // LD A,15 / ADD A,27 / DAA / OUT (FF),A
+    run({0x3E, 0x15, 0xC6, 0x27, 0x27, 0xD3, 0xFF});
+    CHECK(HIGH_REGISTER(AF) == 0x42);
+    CHECK(!TSTFLAG(C));
+}
+
+TEST_CASE("LDIR copies a block and clears P/V")
+{
+    // LD HL,0200 / LD DE,0300 / LD BC,0010 / LDIR / OUT (FF),A
+    load({0x21, 0x00, 0x02, 0x11, 0x00, 0x03, 0x01, 0x10, 0x00, 0xED, 0xB0, 0xD3, 0xFF});
+    for (int i = 0; i < 16; i++)
+        ram[0x200 + i] = 0xA0 + i;
+    Z80run();
+    CHECK(memcmp(ram + 0x200, ram + 0x300, 16) == 0);
+    CHECK(BC == 0);
+    CHECK(HL == 0x210);
+    CHECK(DE == 0x310);
+    CHECK(!TSTFLAG(P));
+}
+
+TEST_CASE("CALL, PUSH, POP and RET keep the stack balanced")
+{
+    // LD BC,1234 / CALL 010A / OUT (FF),A / NOP
+    // 010A: PUSH BC / POP DE / RET
+    run({0x01, 0x34, 0x12, 0xCD, 0x0A, 0x01, 0xD3, 0xFF, 0x00, 0x00, 0xC5, 0xD1, 0xC9});
+    CHECK(DE == 0x1234);
+    CHECK(SP == 0xFE00);
+}
+
+TEST_CASE("Indexed stores and loads go through IX")
+{
+    // LD IX,0400 / LD A,5A / LD (IX+5),A / LD B,(IX+5) / OUT (FF),A
+    run({0xDD, 0x21, 0x00, 0x04, 0x3E, 0x5A, 0xDD, 0x77, 0x05, 0xDD, 0x46, 0x05, 0xD3, 0xFF});
+    CHECK(ram[0x405] == 0x5A);
+    CHECK(HIGH_REGISTER(BC) == 0x5A);
+}
+
+TEST_CASE("EXX and EX AF,AF' swap with the alternate set")
+{
+    // LD BC,1111 / EXX / LD BC,2222 / LD A,33 / EX AF,AF' / OUT (FF),A
+    run({0x01, 0x11, 0x11, 0xD9, 0x01, 0x22, 0x22, 0x3E, 0x33, 0x08, 0xD3, 0xFF});
+    CHECK(BC == 0x2222);
+    CHECK(BC1 == 0x1111);
+    CHECK(HIGH_REGISTER(AF1) == 0x33);
+}
+
+TEST_CASE("BDOS calls see the registers set by the program")
+{
+    // LD C,09 / LD DE,0110 / CALL 0005 / LD C,02 / LD E,'!' / CALL 0005 / JP 0000
+    // 0110: "OK$"
+    std::vector<uint8> program = {0x0E, 0x09, 0x11, 0x10, 0x01, 0xCD, 0x05, 0x00,
+                                  0x0E, 0x02, 0x1E, '!', 0xCD, 0x05, 0x00, 0xC3, 0x00, 0x00};
+    program.resize(0x10);
+    program.insert(program.end(), {'O', 'K', '$'});
+    run(program);
+    CHECK(console == "OK!");
+    CHECK(WORD16(PC) == 0x0002);
+}
+
+// Reports emulated speed for a simple copy/arithmetic loop with a known
+// T-state count. Timing only - there is no pass/fail threshold.
+TEST_CASE("Benchmark: emulated MHz" * doctest::skip())
+{
+    // 0100: LD HL,8000 / LD DE,9000 / LD BC,0000
+    // 0109: LD A,(HL) / ADD A,E / LD (DE),A / INC L / INC E / XOR B / RLCA
+    //       DEC BC / LD A,B / OR C / JP NZ,0109 / OUT (FF),A
+    const std::vector<uint8> program = {0x21, 0x00, 0x80, 0x11, 0x00, 0x90, 0x01, 0x00, 0x00,
+                                        0x7E, 0x83, 0x12, 0x2C, 0x1C, 0xA8, 0x07,
+                                        0x0B, 0x78, 0xB1, 0xC2, 0x09, 0x01, 0xD3, 0xFF};
+    const double tstates_per_run = 30 + 65536.0 * 58;
+    const int runs = 200;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < runs; i++)
+        run(program);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double mhz = tstates_per_run * runs / elapsed.count() / 1e6;
+    MESSAGE("Z80 core: " << runs * 65536.0 * 11 / elapsed.count() / 1e6 << " MIPS, ~" << mhz << " emulated MHz");
+    CHECK(WORD16(BC) == 0);
+}
+
+// zexdoc/zexall aren't shipped with the tree; point RUNCPM_ZEX at a copy of
+// either .COM file to run it (takes minutes) and check it reports no errors.
+TEST_CASE("Conformance: zexdoc/zexall from RUNCPM_ZEX")
+{
+    const char *path = getenv("RUNCPM_ZEX");
+    if (path == nullptr)
+    {
+        MESSAGE("RUNCPM_ZEX not set, skipping");
+        return;
+    }
+
+    FILE *f = fopen(path, "rb");
+    REQUIRE(f != nullptr);
+    std::vector<uint8> program(MEMSIZE - 0x200);
+    program.resize(fread(program.data(), 1, program.size(), f));
+    fclose(f);
+
+    auto start = std::chrono::steady_clock::now();
+    run(program);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    MESSAGE(console);
+    MESSAGE("Finished in " << elapsed.count() << " seconds");
+    CHECK(console.find("ERROR") == std::string::npos);
+    CHECK(console.find("Tests complete") != std::string::npos);
+}
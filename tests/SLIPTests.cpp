@@ -0,0 +1,251 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "devrelay/slip/SLIP.h"
+#include "devrelay/service/Connection.h"
+
+static std::vector<std::vector<uint8_t>> decode_in_chunks(SLIPDecoder &decoder, const std::vector<uint8_t> &wire, size_t chunk)
+{
+    std::vector<std::vector<uint8_t>> packets;
+    for (size_t i = 0; i < wire.size(); i += chunk)
+    {
+        size_t len = std::min(chunk, wire.size() - i);
+        decoder.feed(wire.data() + i, len, [&packets](std::vector<uint8_t> &&packet) {
+            packets.push_back(std::move(packet));
+        });
+    }
+    return packets;
+}
+
+TEST_CASE("Frames split at every boundary decode the same")
+{
+    const std::vector<uint8_t> a = {0x01, SLIP_END, 0x02, SLIP_ESC, 0x03};
+    const std::vector<uint8_t> b = {0x04, 0x05, SLIP_ESC, SLIP_END};
+
+    std::vector<uint8_t> wire = SLIP::encode(a);
+    const std::vector<uint8_t> second = SLIP::encode(b);
+    wire.insert(wire.end(), second.begin(), second.end());
+
+    for (size_t chunk = 1; chunk <= wire.size(); chunk++)
+    {
+        CAPTURE(chunk);
+        SLIPDecoder decoder;
+        auto packets = decode_in_chunks(decoder, wire, chunk);
+        REQUIRE(packets.size() == 2);
+        CHECK(packets[0] == a);
+        CHECK(packets[1] == b);
+    }
+}
+
+TEST_CASE("Shared END between frames and noise outside frames")
+{
+    // noise, frame, shared END, frame, END END (empty frame)
+    const std::vector<uint8_t> wire = {0x55, 0x66, SLIP_END, 0x01, 0x02, SLIP_END, 0x03, SLIP_END, SLIP_END};
+    SLIPDecoder decoder;
+    auto packets = decode_in_chunks(decoder, wire, wire.size());
+    REQUIRE(packets.size() == 2);
+    CHECK(packets[0] == std::vector<uint8_t>{0x01, 0x02});
+    CHECK(packets[1] == std::vector<uint8_t>{0x03});
+}
+
+TEST_CASE("A bad escape drops only that frame")
+{
+    const std::vector<uint8_t> wire = {SLIP_END, 0x01, SLIP_ESC, 0x42, 0x02, SLIP_END, 0x07, SLIP_END};
+    SLIPDecoder decoder;
+    auto packets = decode_in_chunks(decoder, wire, 3);
+    REQUIRE(packets.size() == 1);
+    CHECK(packets[0] == std::vector<uint8_t>{0x07});
+}
+
+TEST_CASE("split_into_packets matches decode")
+{
+    const std::vector<uint8_t> data = {SLIP_END, SLIP_ESC, 0x00, 0xFF};
+    const std::vector<uint8_t> wire = SLIP::encode(data);
+    CHECK(SLIP::decode(wire) == data);
+
+    std::vector<uint8_t> encoded;
+    SLIP::encode_into(data.data(), data.size(), encoded);
+    CHECK(encoded == wire);
+
+    auto packets = SLIP::split_into_packets(wire.data(), wire.size());
+    REQUIRE(packets.size() == 1);
+    CHECK(packets[0] == data);
+}
+
+TEST_CASE("Released buffers are reused by the decoder")
+{
+    SLIPBufferPool pool;
+    SLIPDecoder decoder(&pool);
+    const std::vector<uint8_t> wire = SLIP::encode(std::vector<uint8_t>(300, 0x11));
+
+    // the decoder takes its next buffer from the pool as each frame ends,
+    // so once warmed up the same two buffers take turns
+    std::vector<const uint8_t *> seen;
+    for (int i = 0; i < 4; i++)
+    {
+        decoder.feed(wire.data(), wire.size(), [&](std::vector<uint8_t> &&packet) {
+            CHECK(packet.size() == 300);
+            seen.push_back(packet.data());
+            pool.release(std::move(packet));
+        });
+    }
+    REQUIRE(seen.size() == 4);
+    CHECK(seen[2] == seen[0]);
+    CHECK(seen[3] == seen[1]);
+}
+
+// A connection whose peer answers each request after a fixed link delay,
+// returning the bytes in small pieces the way a serial port or a busy
+// socket would.
+class LoopbackConnection : public Connection
+{
+public:
+    explicit LoopbackConnection(std::chrono::microseconds delay) : delay_(delay)
+    {
+        set_is_connected(true);
+        peer_ = std::thread([this]() { run_peer(); });
+    }
+
+    ~LoopbackConnection() override { close_connection(); }
+
+    void send_data(const std::vector<uint8_t> &data) override
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        SLIP::encode_into(data.data(), data.size(), send_buffer_);
+        std::lock_guard<std::mutex> wire_lock(wire_mutex_);
+        wire_.push_back({std::chrono::steady_clock::now() + delay_, send_buffer_});
+        wire_cv_.notify_all();
+    }
+
+    void create_read_channel() override {}
+
+    void close_connection() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(wire_mutex_);
+            set_is_connected(false);
+        }
+        wire_cv_.notify_all();
+        if (peer_.joinable())
+            peer_.join();
+    }
+
+private:
+    struct InFlight
+    {
+        std::chrono::steady_clock::time_point due;
+        std::vector<uint8_t> bytes;
+    };
+
+    // echoes every frame back as its response, so the ID comes back unchanged
+    void run_peer()
+    {
+        while (true)
+        {
+            InFlight next;
+            {
+                std::unique_lock<std::mutex> lock(wire_mutex_);
+                wire_cv_.wait(lock, [this]() { return !wire_.empty() || !is_connected(); });
+                if (!is_connected())
+                    return;
+                next = std::move(wire_.front());
+                wire_.pop_front();
+            }
+            std::this_thread::sleep_until(next.due);
+            for (size_t i = 0; i < next.bytes.size(); i += 7)
+            {
+                size_t len = std::min<size_t>(7, next.bytes.size() - i);
+                decoder_.feed(next.bytes.data() + i, len, [this](std::vector<uint8_t> &&packet) {
+                    packet_received(std::move(packet));
+                });
+            }
+        }
+    }
+
+    std::chrono::microseconds delay_;
+    std::thread peer_;
+    std::mutex wire_mutex_;
+    std::condition_variable wire_cv_;
+    std::deque<InFlight> wire_;
+};
+
+TEST_CASE("Out of order responses and peer requests are routed")
+{
+    LoopbackConnection connection(std::chrono::microseconds(0));
+
+    connection.expect_response(2);
+    connection.expect_response(1);
+    connection.send_data({1, 0xAA});
+    connection.send_data({9, 0xCC}); // nobody waits for 9, so it's a request
+    connection.send_data({2, 0xBB});
+
+    CHECK(connection.wait_for_response(2, std::chrono::seconds(1)) == std::vector<uint8_t>{2, 0xBB});
+    CHECK(connection.wait_for_response(1, std::chrono::seconds(1)) == std::vector<uint8_t>{1, 0xAA});
+    CHECK(connection.wait_for_request() == std::vector<uint8_t>{9, 0xCC});
+}
+
+TEST_CASE("Requests from the peer keep their order, even with the same ID")
+{
+    LoopbackConnection connection(std::chrono::microseconds(0));
+    connection.send_data({5, 1});
+    connection.send_data({5, 2});
+    connection.send_data({3, 3});
+
+    CHECK(connection.wait_for_request() == std::vector<uint8_t>{5, 1});
+    CHECK(connection.wait_for_request() == std::vector<uint8_t>{5, 2});
+    CHECK(connection.wait_for_request() == std::vector<uint8_t>{3, 3});
+}
+
+// Timing only: one request at a time against several in flight over a link
+// with 1ms of latency. There is no pass/fail threshold.
+TEST_CASE("Benchmark: serial vs pipelined requests" * doctest::skip())
+{
+    const int requests = 64;
+    const int window = 8;
+    const std::vector<uint8_t> payload(512, 0xC0);
+
+    LoopbackConnection connection(std::chrono::microseconds(1000));
+
+    auto make_request = [&payload](uint8_t id) {
+        std::vector<uint8_t> request = payload;
+        request[0] = id;
+        return request;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i++)
+    {
+        connection.expect_response(i);
+        connection.send_data(make_request(i));
+        auto response = connection.wait_for_response(i, std::chrono::seconds(1));
+        REQUIRE(response.size() == payload.size());
+        connection.release_buffer(std::move(response));
+    }
+    std::chrono::duration<double, std::milli> serial = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < requests; i += window)
+    {
+        for (int j = i; j < i + window; j++)
+        {
+            connection.expect_response(j);
+            connection.send_data(make_request(j));
+        }
+        for (int j = i; j < i + window; j++)
+        {
+            auto response = connection.wait_for_response(j, std::chrono::seconds(1));
+            REQUIRE(response.size() == payload.size());
+            connection.release_buffer(std::move(response));
+        }
+    }
+    std::chrono::duration<double, std::milli> pipelined = std::chrono::steady_clock::now() - start;
+
+    MESSAGE(requests << " requests: serial " << serial.count() << " ms, " << window << " in flight "
+                     << pipelined.count() << " ms");
+}
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Minimal NetSIO hub for measuring FujiNet SIO throughput without an emulator.
+
+Listens where the real hub does, waits for a FujiNet (ESP32 or FujiNet-PC
+with BoIP enabled) to connect, then issues the same SIO command over and
+over and reports transactions per second and latency percentiles for
+command -> ACK and command -> COMPLETE + data.
+"""
+
+import argparse
+import socket
+import time
+
+DATA_BYTE = 0x01
+DATA_BLOCK = 0x02
+COMMAND_OFF_SYNC = 0x18
+COMMAND_ON = 0x11
+SYNC_RESPONSE = 0x81
+SPEED_CHANGE = 0x80
+DEVICE_DISCONNECT = 0xC0
+DEVICE_CONNECT = 0xC1
+PING_REQUEST = 0xC2
+PING_RESPONSE = 0xC3
+ALIVE_REQUEST = 0xC4
+ALIVE_RESPONSE = 0xC5
+CREDIT_STATUS = 0xC6
+CREDIT_UPDATE = 0xC7
+
+EMPTY_SYNC = 0x00
+CREDIT = 16
+
+
+def sio_checksum(data):
+    chk = 0
+    for b in data:
+        chk = ((chk + b) >> 8) + ((chk + b) & 0xFF)
+    return chk
+
+
+class Hub:
+    def __init__(self, port):
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("", port))
+        self.peer = None
+        self.sn = 0
+
+    def send(self, *msg):
+        self.sock.sendto(bytes(msg), self.peer)
+
+    def recv(self, timeout):
+        """Next message from the device, handling housekeeping ones"""
+        deadline = time.monotonic() + timeout
+        while True:
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self.sock.settimeout(left)
+            try:
+                data, addr = self.sock.recvfrom(1024)
+            except socket.timeout:
+                return None
+            if not data:
+                continue
+            if data[0] == PING_REQUEST:
+                self.sock.sendto(bytes([PING_RESPONSE]), addr)
+            elif data[0] == DEVICE_CONNECT:
+                self.peer = addr
+                print(f"device connected from {addr[0]}:{addr[1]}")
+                self.send(CREDIT_UPDATE, CREDIT)
+            elif data[0] == ALIVE_REQUEST:
+                self.sock.sendto(bytes([ALIVE_RESPONSE]), addr)
+            elif data[0] == CREDIT_STATUS:
+                self.send(CREDIT_UPDATE, CREDIT)
+            elif data[0] in (SPEED_CHANGE, DEVICE_DISCONNECT):
+                pass
+            else:
+                return data
+
+    def wait_for_device(self):
+        print("waiting for device ...")
+        while self.peer is None:
+            self.recv(1.0)
+
+    def transaction(self, frame, length, timeout):
+        """One SIO command, returns (ack, complete) latency in seconds or None"""
+        self.sn = (self.sn + 1) & 0xFF
+        self.send(CREDIT_UPDATE, CREDIT)
+        self.send(COMMAND_ON)
+        # the device drops the last byte of a data block (sequence number)
+        self.send(DATA_BLOCK, *frame, self.sn)
+        start = time.monotonic()
+        self.send(COMMAND_OFF_SYNC, self.sn)
+
+        ack = None
+        received = bytearray()
+        # COMPLETE/ERROR + data frame + checksum
+        expected = 1 + length + 1 if length else 1
+        while len(received) < expected:
+            msg = self.recv(timeout)
+            if msg is None:
+                return None
+            now = time.monotonic()
+            if msg[0] == SYNC_RESPONSE and len(msg) >= 4 and msg[1] == self.sn:
+                if msg[2] == EMPTY_SYNC:
+                    return None
+                ack = now - start
+            elif msg[0] == DATA_BLOCK:
+                if ack is None:
+                    ack = now - start
+                received += msg[1:]
+            elif msg[0] == DATA_BYTE and len(msg) >= 2:
+                if ack is None:
+                    ack = now - start
+                received.append(msg[1])
+        return ack, time.monotonic() - start
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=9997, help="UDP port to listen on (default 9997)")
+    parser.add_argument("--device", type=lambda x: int(x, 0), default=0x70, help="SIO device id (default 0x70)")
+    parser.add_argument("--command", type=lambda x: int(x, 0), default=0xFA,
+                        help="SIO command (default 0xFA, get WiFi status)")
+    parser.add_argument("--aux", type=lambda x: int(x, 0), default=0, help="AUX1/AUX2 as one 16-bit value")
+    parser.add_argument("--length", type=int, default=1,
+                        help="data frame length the command returns, 0 for none (default 1)")
+    parser.add_argument("--count", type=int, default=1000, help="number of transactions (default 1000)")
+    parser.add_argument("--timeout", type=float, default=2.0, help="per transaction timeout in seconds")
+    args = parser.parse_args()
+
+    frame = [args.device, args.command, args.aux & 0xFF, args.aux >> 8]
+    frame.append(sio_checksum(frame))
+
+    hub = Hub(args.port)
+    hub.wait_for_device()
+    time.sleep(0.5)
+
+    acks, completes, failed = [], [], 0
+    start = time.monotonic()
+    for _ in range(args.count):
+        result = hub.transaction(frame, args.length, args.timeout)
+        if result is None:
+            failed += 1
+            continue
+        acks.append(result[0])
+        completes.append(result[1])
+    elapsed = time.monotonic() - start
+
+    done = len(completes)
+    print(f"{done} transactions in {elapsed:.2f} s, {done / elapsed:.1f}/s, "
+          f"{done * args.length / elapsed / 1024:.1f} KiB/s payload, {failed} failed")
+    if done:
+        for name, values in (("ack", acks), ("complete", completes)):
+            print(f"{name:>8}: p50 {percentile(values, 50) * 1000:.2f} ms  "
+                  f"p90 {percentile(values, 90) * 1000:.2f} ms  "
+                  f"p99 {percentile(values, 99) * 1000:.2f} ms  "
+                  f"max {max(values) * 1000:.2f} ms")
+
+
+if __name__ == "__main__":
+    main()